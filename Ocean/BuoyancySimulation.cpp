@@ -0,0 +1,244 @@
+#include "pch.h"
+#include "BuoyancySimulation.h"
+#include "ThreadPool.h"
+#include "WaveSpectrum.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace Ocean;
+
+namespace
+{
+	// Samples whose wave offsets are evaluated together, their scratch stays on the stack
+	const int blockSize = 256;
+	const int samplesPerBody = 4;
+	// Past this the small angle hull model is meaningless, the body is held there
+	const float maxTilt = 1.f;
+
+	struct Quaternion
+	{
+		float x, y, z, w;
+	};
+
+	Quaternion Multiply(const Quaternion& a, const Quaternion& b)
+	{
+		Quaternion result;
+		result.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+		result.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+		result.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+		result.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+		return result;
+	}
+
+	void Run(ThreadPool* pool, int count, int grain, const std::function<void(int, int)>& body)
+	{
+		if (pool != nullptr)
+			pool->ParallelFor(count, grain, body);
+		else
+			body(0, count);
+	}
+}
+
+BuoyancySimulation::BuoyancySimulation(const GerstnerWaveSet* waveSets, int waveSetCount)
+	: inversionIterations(2), evaluator(waveSets, waveSetCount), waveSets(waveSets, waveSets + waveSetCount), instanceSlotsDirty(false)
+{ }
+
+void BuoyancySimulation::SetWaveSets(const GerstnerWaveSet* waveSets, int waveSetCount)
+{
+	if (waveSetCount == (int)this->waveSets.size() &&
+		(waveSetCount == 0 || memcmp(waveSets, this->waveSets.data(), sizeof(GerstnerWaveSet) * waveSetCount) == 0))
+		return;
+
+	this->waveSets.assign(waveSets, waveSets + waveSetCount);
+	evaluator = GerstnerEvaluator(waveSets, waveSetCount);
+}
+
+int BuoyancySimulation::AddKind(const FloatingBodyKind& kind)
+{
+	assert(kind.halfLength > 0.f && kind.height > 0.f && kind.density > 0.f);
+	kinds.push_back(kind);
+	kindStart.push_back(0);
+	kindCount.push_back(0);
+	return (int)kinds.size() - 1;
+}
+
+int BuoyancySimulation::AddBody(int kind, float x, float z, float yaw, float scale)
+{
+	assert(kind >= 0 && kind < (int)kinds.size() && scale > 0.f);
+	this->kind.push_back(kind);
+	positionX.push_back(x);
+	positionY.push_back(0.f);
+	positionZ.push_back(z);
+	this->yaw.push_back(yaw);
+	this->scale.push_back(scale);
+	velocityY.push_back(0.f);
+	tiltX.push_back(0.f);
+	tiltZ.push_back(0.f);
+	tiltVelocityX.push_back(0.f);
+	tiltVelocityZ.push_back(0.f);
+	instanceSlot.push_back(0);
+
+	// The first query starts from where the samples are on the flat plane
+	int body = (int)positionX.size() - 1;
+	targetX.resize(positionX.size() * samplesPerBody);
+	targetZ.resize(positionX.size() * samplesPerBody);
+	height.resize(positionX.size() * samplesPerBody);
+	GatherSamples(body, body + 1);
+	undisplacedX.insert(undisplacedX.end(), targetX.end() - samplesPerBody, targetX.end());
+	undisplacedZ.insert(undisplacedZ.end(), targetZ.end() - samplesPerBody, targetZ.end());
+
+	instances.resize(positionX.size() * floatsPerInstance);
+	instanceSlotsDirty = true;
+	return body;
+}
+
+void BuoyancySimulation::Clear()
+{
+	for (std::vector<float>* array : { &positionX, &positionY, &positionZ, &yaw, &scale, &velocityY, &tiltX, &tiltZ,
+		&tiltVelocityX, &tiltVelocityZ, &targetX, &targetZ, &undisplacedX, &undisplacedZ, &height, &instances })
+		array->clear();
+	kind.clear();
+	instanceSlot.clear();
+	std::fill(kindStart.begin(), kindStart.end(), 0);
+	std::fill(kindCount.begin(), kindCount.end(), 0);
+	instanceSlotsDirty = false;
+}
+
+void BuoyancySimulation::Step(
+	float seconds,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	ThreadPool* pool)
+{
+	int bodyCount = GetBodyCount();
+	if (bodyCount == 0)
+		return;
+
+	if (instanceSlotsDirty)
+		UpdateInstanceSlots();
+
+	Run(pool, bodyCount, 256, [this](int begin, int end) { GatherSamples(begin, end); });
+
+	int blockCount = (bodyCount * samplesPerBody + blockSize - 1) / blockSize;
+	Run(pool, blockCount, 4, [=](int begin, int end) { QueryHeights(begin, end, time, cameraX, cameraY, cameraZ); });
+
+	Run(pool, bodyCount, 256, [=](int begin, int end) { Integrate(begin, end, seconds); });
+}
+
+void BuoyancySimulation::GatherSamples(int begin, int end)
+{
+	// The body's x axis is (cos yaw, 0, -sin yaw) and its z axis (sin yaw, 0, cos yaw), like a rotation around y
+	for (int i = begin; i < end; i++)
+	{
+		float halfLength = kinds[kind[i]].halfLength * scale[i];
+		float alongX = cosf(yaw[i]) * halfLength;
+		float alongZ = sinf(yaw[i]) * halfLength;
+		float* x = &targetX[i * samplesPerBody];
+		float* z = &targetZ[i * samplesPerBody];
+		x[0] = positionX[i] + alongX; z[0] = positionZ[i] - alongZ;
+		x[1] = positionX[i] - alongX; z[1] = positionZ[i] + alongZ;
+		x[2] = positionX[i] + alongZ; z[2] = positionZ[i] + alongX;
+		x[3] = positionX[i] - alongZ; z[3] = positionZ[i] - alongX;
+	}
+}
+
+void BuoyancySimulation::QueryHeights(int begin, int end, float time, float cameraX, float cameraY, float cameraZ)
+{
+	int sampleCount = (int)targetX.size();
+	float offsetX[blockSize], offsetY[blockSize], offsetZ[blockSize];
+	GerstnerSamples output = { offsetX, offsetY, offsetZ, nullptr, nullptr, nullptr };
+
+	for (int block = begin; block < end; block++)
+	{
+		int first = block * blockSize;
+		int count = std::min(blockSize, sampleCount - first);
+		float* pointX = &undisplacedX[first];
+		float* pointZ = &undisplacedZ[first];
+
+		// p = target - offset(p), the height is the one at the last point evaluated
+		for (int iteration = 0; iteration < inversionIterations; iteration++)
+		{
+			evaluator.Evaluate(pointX, pointZ, count, time, cameraX, cameraY, cameraZ, output);
+			for (int j = 0; j < count; j++)
+			{
+				pointX[j] = targetX[first + j] - offsetX[j];
+				pointZ[j] = targetZ[first + j] - offsetZ[j];
+			}
+		}
+		memcpy(&height[first], offsetY, count * sizeof(float));
+	}
+}
+
+void BuoyancySimulation::Integrate(int begin, int end, float seconds)
+{
+	// Every sample stands for a quarter of the hull and pushes up with the water it displaces. With m = density * volume,
+	// heave accelerates by g (submerged / density - 1) and a tilt of the hull's slab by 3 g (depth+ - depth-) / (4 density height halfLength).
+	for (int i = begin; i < end; i++)
+	{
+		const FloatingBodyKind& bodyKind = kinds[kind[i]];
+		float halfLength = bodyKind.halfLength * scale[i];
+		float hullHeight = bodyKind.height * scale[i];
+		float rise[samplesPerBody] = { halfLength * sinf(tiltX[i]), -halfLength * sinf(tiltX[i]), halfLength * sinf(tiltZ[i]), -halfLength * sinf(tiltZ[i]) };
+
+		float depth[samplesPerBody];
+		float submerged = 0.f;
+		for (int j = 0; j < samplesPerBody; j++)
+		{
+			float bottom = positionY[i] + rise[j] - 0.5f * hullHeight;
+			depth[j] = std::min(std::max(height[i * samplesPerBody + j] - bottom, 0.f), hullHeight);
+			submerged += depth[j];
+		}
+		submerged /= (float)samplesPerBody * hullHeight;
+
+		float heave = gravity * (submerged / bodyKind.density - 1.f) - bodyKind.linearDamping * submerged * velocityY[i];
+		float tilting = 3.f * gravity / (4.f * bodyKind.density * hullHeight * halfLength);
+		float tiltingX = tilting * (depth[0] - depth[1]) - bodyKind.angularDamping * submerged * tiltVelocityX[i];
+		float tiltingZ = tilting * (depth[2] - depth[3]) - bodyKind.angularDamping * submerged * tiltVelocityZ[i];
+
+		// Semi-implicit Euler, the new speeds move the body
+		velocityY[i] += heave * seconds;
+		tiltVelocityX[i] += tiltingX * seconds;
+		tiltVelocityZ[i] += tiltingZ * seconds;
+		positionY[i] += velocityY[i] * seconds;
+		tiltX[i] = std::min(std::max(tiltX[i] + tiltVelocityX[i] * seconds, -maxTilt), maxTilt);
+		tiltZ[i] = std::min(std::max(tiltZ[i] + tiltVelocityZ[i] * seconds, -maxTilt), maxTilt);
+
+		// Turn around y, then raise the x axis by turning around z and the z axis by turning back around x
+		Quaternion turn = { 0.f, sinf(0.5f * yaw[i]), 0.f, cosf(0.5f * yaw[i]) };
+		Quaternion raiseX = { 0.f, 0.f, sinf(0.5f * tiltX[i]), cosf(0.5f * tiltX[i]) };
+		Quaternion raiseZ = { -sinf(0.5f * tiltZ[i]), 0.f, 0.f, cosf(0.5f * tiltZ[i]) };
+		Quaternion rotation = Multiply(turn, Multiply(raiseX, raiseZ));
+
+		float* instance = &instances[instanceSlot[i] * floatsPerInstance];
+		instance[0] = positionX[i];
+		instance[1] = positionY[i];
+		instance[2] = positionZ[i];
+		instance[3] = scale[i];
+		instance[4] = rotation.x;
+		instance[5] = rotation.y;
+		instance[6] = rotation.z;
+		instance[7] = rotation.w;
+	}
+}
+
+void BuoyancySimulation::UpdateInstanceSlots()
+{
+	// Counting sort by kind, bodies of one kind keep their order
+	std::fill(kindCount.begin(), kindCount.end(), 0);
+	for (int bodyKind : kind)
+		kindCount[bodyKind]++;
+
+	int start = 0;
+	for (size_t k = 0; k < kinds.size(); k++)
+	{
+		kindStart[k] = start;
+		start += kindCount[k];
+	}
+
+	std::vector<int> next(kindStart);
+	for (size_t i = 0; i < kind.size(); i++)
+		instanceSlot[i] = next[kind[i]]++;
+	instanceSlotsDirty = false;
+}
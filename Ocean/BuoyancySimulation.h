@@ -0,0 +1,100 @@
+#pragma once
+#include "GerstnerEvaluator.h"
+#include <vector>
+
+namespace Ocean
+{
+	class ThreadPool;
+
+	// Shape and behaviour shared by every body of one kind, before the body's scale
+	struct FloatingBodyKind
+	{
+		// The hull is a box of halfLength * 2 square and height, sampled at the middle of its four sides
+		float halfLength;
+		float height;
+		// Mass over the mass of the water the whole hull displaces, below 1 it floats with that share under water
+		float density;
+		// How fast heaving and tilting die down, per second with the whole hull under water
+		float linearDamping;
+		float angularDamping;
+	};
+
+	// Floating bodies that heave and tilt on the Gerstner waves, kept as structure of arrays.
+	// Every step gathers the four hull samples of every body into one batched height query, which inverts the
+	// horizontal displacement by fixed point iteration warm started from the last step's undisplaced points, then
+	// integrates buoyancy, gravity and damping per body. Both are split over the thread pool.
+	// The bodies stay where they were placed in x, z and spin only around the vertical axis they were placed with.
+	// Only depends on the standard library.
+	class BuoyancySimulation
+	{
+	public:
+		BuoyancySimulation(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		// Only rebuilds the evaluator when the sets differ from the current ones
+		void SetWaveSets(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		int AddKind(const FloatingBodyKind& kind);
+		// Places a body of kind at x, z resting on the undisplaced plane, turned by yaw radians around y.
+		// scale multiplies the kind's size. Returns the body's index.
+		int AddBody(int kind, float x, float z, float yaw, float scale);
+		void Clear();
+
+		// Advances every body by seconds, which has to stay well below a second for the integration to be stable.
+		// The waves are taken at time, faded like the water shader does for a camera at cameraX, cameraY, cameraZ.
+		// pool can be null to run on the calling thread only.
+		void Step(
+			float seconds,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			ThreadPool* pool);
+
+		int GetKindCount() const { return (int)kinds.size(); }
+		int GetBodyCount() const { return (int)kind.size(); }
+
+		// Per body
+		const float* GetPositionX() const { return positionX.data(); }
+		const float* GetPositionY() const { return positionY.data(); }
+		const float* GetPositionZ() const { return positionZ.data(); }
+
+		// Every body as position, scale and a rotation quaternion x, y, z, w, written by Step.
+		// The bodies of one kind are next to each other, from GetInstanceStart(kind) on.
+		static const int floatsPerInstance = 8;
+		const float* GetInstances() const { return instances.data(); }
+		int GetInstanceStart(int kind) const { return kindStart[kind]; }
+		int GetInstanceCount(int kind) const { return kindCount[kind]; }
+
+		// Evaluations per height query, the warm start makes two enough while the waves move less than a wavelength per step
+		int inversionIterations;
+
+	private:
+		void GatherSamples(int begin, int end);
+		void QueryHeights(int begin, int end, float time, float cameraX, float cameraY, float cameraZ);
+		void Integrate(int begin, int end, float seconds);
+		void UpdateInstanceSlots();
+
+		GerstnerEvaluator evaluator;
+		std::vector<GerstnerWaveSet> waveSets;
+		std::vector<FloatingBodyKind> kinds;
+
+		// Per body
+		std::vector<int> kind;
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> yaw, scale;
+		std::vector<float> velocityY;
+		// Rise of the local x and z axes in radians and how fast they change
+		std::vector<float> tiltX, tiltZ;
+		std::vector<float> tiltVelocityX, tiltVelocityZ;
+		std::vector<int> instanceSlot;
+
+		// Per sample, four per body: +x, -x, +z, -z of the body
+		std::vector<float> targetX, targetZ;
+		std::vector<float> undisplacedX, undisplacedZ;
+		std::vector<float> height;
+
+		// Per kind
+		std::vector<int> kindStart, kindCount;
+		bool instanceSlotsDirty;
+
+		std::vector<float> instances;
+	};
+}
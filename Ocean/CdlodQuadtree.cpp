@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "CdlodQuadtree.h"
+#include <cmath>
+
+using namespace Ocean;
+
+CdlodQuadtree::CdlodQuadtree(int levelCount, float leafSize, float firstRange, int rootsAcross)
+	: maxWaveHeight(0.f), maxWaveDisplacement(0.f), morphRatio(0.3f),
+	rootsAcross(rootsAcross), cameraX(0.f), cameraY(0.f), cameraZ(0.f), frustumPlanes(nullptr), visitedNodeCount(0)
+{
+	ranges.resize(levelCount);
+	for (int level = 0; level < levelCount; level++)
+		ranges[level] = firstRange * (float)(1 << level);
+
+	rootSize = leafSize * (float)(1 << (levelCount - 1));
+
+	// The most patches there can be is every leaf within range of the camera, reserve for a fair part of that
+	selection.reserve(rootsAcross * rootsAcross * 16);
+}
+
+float CdlodQuadtree::GetMorphStart(int level) const
+{
+	float previousRange = level > 0 ? ranges[level - 1] : 0.f;
+	return ranges[level] - (ranges[level] - previousRange) * morphRatio;
+}
+
+void CdlodQuadtree::Select(float cameraX, float cameraY, float cameraZ, const float* frustumPlanes)
+{
+	this->cameraX = cameraX;
+	this->cameraY = cameraY;
+	this->cameraZ = cameraZ;
+	this->frustumPlanes = frustumPlanes;
+	selection.clear();
+	visitedNodeCount = 0;
+
+	// The roots follow the camera in whole root steps, so the patches never slide under it
+	float firstRootX = (floorf(cameraX / rootSize) - (float)(rootsAcross / 2)) * rootSize;
+	float firstRootZ = (floorf(cameraZ / rootSize) - (float)(rootsAcross / 2)) * rootSize;
+	int topLevel = (int)ranges.size() - 1;
+
+	for (int z = 0; z < rootsAcross; z++)
+	{
+		for (int x = 0; x < rootsAcross; x++)
+			SelectNode(firstRootX + x * rootSize, firstRootZ + z * rootSize, rootSize, topLevel);
+	}
+}
+
+void CdlodQuadtree::SelectNode(float x, float z, float size, int level)
+{
+	visitedNodeCount++;
+
+	if (!IsInFrustum(x, z, size))
+		return;
+
+	// Children that are out of their own range are still drawn at their level, fully morphed they look
+	// just like this level there. So a node only has to decide whether it needs to be split.
+	if (level == 0 || !IsInRange(x, z, size, ranges[level - 1]))
+	{
+		CdlodPatch patch = { x, z, size, level };
+		selection.push_back(patch);
+		return;
+	}
+
+	float half = size * 0.5f;
+	SelectNode(x, z, half, level - 1);
+	SelectNode(x + half, z, half, level - 1);
+	SelectNode(x, z + half, half, level - 1);
+	SelectNode(x + half, z + half, half, level - 1);
+}
+
+bool CdlodQuadtree::IsInFrustum(float x, float z, float size) const
+{
+	if (frustumPlanes == nullptr)
+		return true;
+
+	float half = size * 0.5f;
+	float centerX = x + half, centerZ = z + half;
+	float extentXZ = half + maxWaveDisplacement;
+	float extentY = maxWaveHeight;
+
+	for (int i = 0; i < 6; i++)
+	{
+		const float* plane = &frustumPlanes[i * 4];
+		float distance = plane[0] * centerX + plane[2] * centerZ + plane[3];
+		float radius = extentXZ * (fabsf(plane[0]) + fabsf(plane[2])) + extentY * fabsf(plane[1]);
+		if (distance + radius < 0.f)
+			return false;
+	}
+
+	return true;
+}
+
+bool CdlodQuadtree::IsInRange(float x, float z, float size, float range) const
+{
+	// Distance to the flat patch, the shader measures the morph distance on the undisplaced grid too
+	float dx = fmaxf(fmaxf(x - cameraX, cameraX - (x + size)), 0.f);
+	float dz = fmaxf(fmaxf(z - cameraZ, cameraZ - (z + size)), 0.f);
+	return dx * dx + cameraY * cameraY + dz * dz <= range * range;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+
+namespace Ocean
+{
+	// A square of the sea drawn with the shared patch mesh, level 0 is the most detailed.
+	struct CdlodPatch
+	{
+		float x;
+		float z;
+		float size;
+		int level;
+	};
+
+	// Continuous distance-dependent LOD (Strugar's CDLOD) over the water plane.
+	// Every level has a distance range, a node is split when its children's range reaches it and the
+	// shader morphs the vertices of each patch into the next level's grid before that range ends, so
+	// neighbouring patches of different levels meet without cracks or popping.
+	// Only depends on the standard library, the frustum comes in as plain plane equations.
+	class CdlodQuadtree
+	{
+	public:
+		// leafSize: size of a level 0 patch, every level doubles it
+		// firstRange: distance covered by level 0, every level doubles it. Patches only meet patches of the next
+		// level, and only where those aren't morphing yet, if it is at least 2.83 * leafSize / (1 - morphRatio).
+		// rootsAcross: number of top level nodes along each side of the covered square
+		CdlodQuadtree(int levelCount, float leafSize, float firstRange, int rootsAcross);
+
+		// frustumPlanes: six inward facing planes as 24 floats (a, b, c, d), nullptr selects everything in range
+		void Select(float cameraX, float cameraY, float cameraZ, const float* frustumPlanes);
+
+		const std::vector<CdlodPatch>& GetSelection() const { return selection; }
+		int GetVisitedNodeCount() const { return visitedNodeCount; }
+
+		int GetLevelCount() const { return (int)ranges.size(); }
+		float GetRootSize() const { return rootSize; }
+		float GetRange(int level) const { return ranges[level]; }
+		// Distance where the patches of a level start morphing into the next level, they are fully morphed at GetRange
+		float GetMorphStart(int level) const;
+
+		// Waves move the surface this much off the patches, the bounds used for frustum culling are widened by it
+		float maxWaveHeight;
+		float maxWaveDisplacement;
+
+		// Part of a level's range, from the previous level's range, that is spent morphing
+		float morphRatio;
+
+	private:
+		void SelectNode(float x, float z, float size, int level);
+		bool IsInFrustum(float x, float z, float size) const;
+		bool IsInRange(float x, float z, float size, float range) const;
+
+		std::vector<float> ranges;
+		float rootSize;
+		int rootsAcross;
+
+		float cameraX, cameraY, cameraZ;
+		const float* frustumPlanes;
+		std::vector<CdlodPatch> selection;
+		int visitedNodeCount;
+	};
+}
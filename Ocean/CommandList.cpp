@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "CommandList.h"
+
+using namespace Ocean;
+
+CommandList::Command& CommandList::Add(RenderCall call, ShaderStage stage, UINT startSlot, UINT count)
+{
+	Command command = { call, stage, startSlot, count, { 0, 0, 0, 0 }, (UINT)objects.size(), (UINT)values.size() };
+	commands.push_back(command);
+	return commands.back();
+}
+
+void CommandList::AddValues(const UINT* source, UINT count)
+{
+	values.insert(values.end(), source, source + count);
+}
+
+void CommandList::Clear()
+{
+	commands.clear();
+	objects.clear();
+	values.clear();
+}
+
+size_t CommandList::GetRecordedSize() const
+{
+	return commands.size() * sizeof(Command) + objects.size() * sizeof(void*) + values.size() * sizeof(UINT);
+}
+
+void CommandList::SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	Add(SetRenderTargetsCall, PixelStage, 0, count);
+	AddObjects(targets, count);
+	AddObjects(&depthStencil, 1);
+}
+
+void CommandList::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	Add(SetRasterizerStateCall, VertexStage, 0, 1);
+	AddObjects(&state, 1);
+}
+
+void CommandList::SetBlendState(ID3D11BlendState* state)
+{
+	Add(SetBlendStateCall, PixelStage, 0, 1);
+	AddObjects(&state, 1);
+}
+
+void CommandList::SetDepthStencilState(ID3D11DepthStencilState* state)
+{
+	Add(SetDepthStencilStateCall, PixelStage, 0, 1);
+	AddObjects(&state, 1);
+}
+
+void CommandList::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	Add(SetInputLayoutCall, VertexStage, 0, 1);
+	AddObjects(&inputLayout, 1);
+}
+
+void CommandList::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	Add(SetPrimitiveTopologyCall, VertexStage, 0, 1).args[0] = (UINT)topology;
+}
+
+void CommandList::SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	Add(SetVertexBuffersCall, VertexStage, startSlot, count);
+	AddObjects(buffers, count);
+	AddValues(strides, count);
+	AddValues(offsets, count);
+}
+
+void CommandList::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	Command& command = Add(SetIndexBufferCall, VertexStage, 0, 1);
+	command.args[0] = (UINT)format;
+	command.args[1] = offset;
+	AddObjects(&buffer, 1);
+}
+
+void CommandList::SetVertexShader(ID3D11VertexShader* shader)
+{
+	Add(SetVertexShaderCall, VertexStage, 0, 1);
+	AddObjects(&shader, 1);
+}
+
+void CommandList::SetPixelShader(ID3D11PixelShader* shader)
+{
+	Add(SetPixelShaderCall, PixelStage, 0, 1);
+	AddObjects(&shader, 1);
+}
+
+void CommandList::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	Add(SetConstantBuffersCall, stage, startSlot, count);
+	AddObjects(buffers, count);
+}
+
+void CommandList::SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	Add(SetConstantBufferRangesCall, stage, startSlot, count);
+	AddObjects(buffers, count);
+	AddValues(firstConstants, count);
+	AddValues(constantCounts, count);
+}
+
+void CommandList::SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	Add(SetShaderResourcesCall, stage, startSlot, count);
+	AddObjects(views, count);
+}
+
+void CommandList::SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	Add(SetSamplersCall, stage, startSlot, count);
+	AddObjects(samplers, count);
+}
+
+void CommandList::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	Command& command = Add(DrawIndexedCall, VertexStage, 0, 1);
+	command.args[0] = indexCount;
+	command.args[1] = startIndex;
+	command.args[2] = (UINT)baseVertex;
+}
+
+void CommandList::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	Command& command = Add(DrawIndexedInstancedCall, VertexStage, 0, instanceCount);
+	command.args[0] = indexCount;
+	command.args[1] = startIndex;
+	command.args[2] = (UINT)baseVertex;
+	command.args[3] = startInstance;
+}
+
+void CommandList::Replay(IRenderContext& target) const
+{
+	for (const Command& command : commands)
+	{
+		const UINT* commandValues = values.data() + command.firstValue;
+		switch (command.call)
+		{
+		case SetRenderTargetsCall:
+			target.SetRenderTargets(command.count, GetObjects<ID3D11RenderTargetView>(command), GetObjects<ID3D11DepthStencilView>(command)[command.count]);
+			break;
+		case SetRasterizerStateCall:
+			target.SetRasterizerState(GetObjects<ID3D11RasterizerState>(command)[0]);
+			break;
+		case SetBlendStateCall:
+			target.SetBlendState(GetObjects<ID3D11BlendState>(command)[0]);
+			break;
+		case SetDepthStencilStateCall:
+			target.SetDepthStencilState(GetObjects<ID3D11DepthStencilState>(command)[0]);
+			break;
+		case SetInputLayoutCall:
+			target.SetInputLayout(GetObjects<ID3D11InputLayout>(command)[0]);
+			break;
+		case SetPrimitiveTopologyCall:
+			target.SetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)command.args[0]);
+			break;
+		case SetVertexBuffersCall:
+			target.SetVertexBuffers(command.startSlot, command.count, GetObjects<ID3D11Buffer>(command), commandValues, commandValues + command.count);
+			break;
+		case SetIndexBufferCall:
+			target.SetIndexBuffer(GetObjects<ID3D11Buffer>(command)[0], (DXGI_FORMAT)command.args[0], command.args[1]);
+			break;
+		case SetVertexShaderCall:
+			target.SetVertexShader(GetObjects<ID3D11VertexShader>(command)[0]);
+			break;
+		case SetPixelShaderCall:
+			target.SetPixelShader(GetObjects<ID3D11PixelShader>(command)[0]);
+			break;
+		case SetConstantBuffersCall:
+			target.SetConstantBuffers(command.stage, command.startSlot, command.count, GetObjects<ID3D11Buffer>(command));
+			break;
+		case SetConstantBufferRangesCall:
+			target.SetConstantBufferRanges(command.stage, command.startSlot, command.count, GetObjects<ID3D11Buffer>(command), commandValues, commandValues + command.count);
+			break;
+		case SetShaderResourcesCall:
+			target.SetShaderResources(command.stage, command.startSlot, command.count, GetObjects<ID3D11ShaderResourceView>(command));
+			break;
+		case SetSamplersCall:
+			target.SetSamplers(command.stage, command.startSlot, command.count, GetObjects<ID3D11SamplerState>(command));
+			break;
+		case DrawIndexedCall:
+			target.DrawIndexed(command.args[0], command.args[1], (INT)command.args[2]);
+			break;
+		case DrawIndexedInstancedCall:
+			target.DrawIndexedInstanced(command.args[0], command.count, command.args[1], (INT)command.args[2], command.args[3]);
+			break;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "RenderContext.h"
+#include <vector>
+
+namespace Ocean
+{
+	// Records the calls made on it with copies of their arguments and replays them in order on another context.
+	// Recording only touches the list, so lists can be filled on different threads at the same time and replayed one
+	// after another on the thread owning the device. The objects are not AddRef'd, they must outlive the replay.
+	class CommandList : public IRenderContext
+	{
+	public:
+		void Replay(IRenderContext& target) const;
+		// Keeps the memory for the next recording
+		void Clear();
+
+		UINT GetCommandCount() const { return (UINT)commands.size(); }
+		// Bytes in use by the recorded calls and their arguments
+		size_t GetRecordedSize() const;
+
+		virtual void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil);
+		virtual void SetRasterizerState(ID3D11RasterizerState* state);
+		virtual void SetBlendState(ID3D11BlendState* state);
+		virtual void SetDepthStencilState(ID3D11DepthStencilState* state);
+
+		virtual void SetInputLayout(ID3D11InputLayout* inputLayout);
+		virtual void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		virtual void SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+		virtual void SetVertexShader(ID3D11VertexShader* shader);
+		virtual void SetPixelShader(ID3D11PixelShader* shader);
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+		virtual void SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+	private:
+		// Arrays and pointers go to objects and values, a command knows where its own start.
+		// args holds the rest: formats, offsets, topologies and draw parameters.
+		struct Command
+		{
+			RenderCall call;
+			ShaderStage stage;
+			UINT startSlot;
+			UINT count;
+			UINT args[4];
+			UINT firstObject;
+			UINT firstValue;
+		};
+
+		Command& Add(RenderCall call, ShaderStage stage, UINT startSlot, UINT count);
+		void AddValues(const UINT* source, UINT count);
+
+		template <typename T>
+		void AddObjects(T* const* source, UINT count)
+		{
+			for (UINT i = 0; i < count; i++)
+				objects.push_back((void*)source[i]);
+		}
+
+		template <typename T>
+		T* const* GetObjects(const Command& command) const { return (T* const*)(objects.data() + command.firstObject); }
+
+		std::vector<Command> commands;
+		std::vector<void*> objects;
+		std::vector<UINT> values;
+	};
+}
@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "ConstantBuffers.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace Ocean;
+
+void Ocean::BindConstants(IRenderContext& renderContext, ShaderStage stage, UINT slot, const ConstantAllocation& allocation)
+{
+	if (allocation.constantCount == 0)
+		renderContext.SetConstantBuffers(stage, slot, 1, &allocation.buffer);
+	else
+		renderContext.SetConstantBufferRanges(stage, slot, 1, &allocation.buffer, &allocation.firstConstant, &allocation.constantCount);
+}
+
+ConstantBufferRing::ConstantBufferRing(BufferFactory createBuffer, UINT pageSize, bool offsetting)
+	: createBuffer(createBuffer), pageSize(pageSize), offsetting(offsetting), pagesUsed(0), pageOffset(0), mapCount(0)
+{
+	assert(pageSize % alignment == 0);
+}
+
+void ConstantBufferRing::BeginFrame()
+{
+	assert(pagesUsed == 0);
+	pageOffset = 0;
+	mapCount = 0;
+}
+
+ConstantAllocation ConstantBufferRing::Allocate(UINT size)
+{
+	UINT alignedSize = (size + alignment - 1) / alignment * alignment;
+
+	// The next page when the allocation doesn't fit, or for every allocation without offsets
+	if (pagesUsed == 0 || !offsetting || pageOffset + alignedSize > pages[pagesUsed - 1].buffer->GetCapacity())
+	{
+		UINT byteWidth = offsetting ? std::max(pageSize, alignedSize) : alignedSize;
+		if (pagesUsed == pages.size())
+			pages.push_back(Page());
+		Page& page = pages[pagesUsed++];
+		if (page.buffer == nullptr || page.buffer->GetCapacity() < byteWidth)
+			page.buffer = createBuffer(byteWidth);
+
+		page.mapped = (byte*)page.buffer->Map();
+		mapCount++;
+		pageOffset = 0;
+	}
+
+	Page& page = pages[pagesUsed - 1];
+	ConstantAllocation allocation;
+	allocation.data = page.mapped + pageOffset;
+	allocation.buffer = page.buffer->GetBuffer();
+	allocation.firstConstant = offsetting ? pageOffset / constantRegisterSize : 0;
+	allocation.constantCount = offsetting ? alignedSize / constantRegisterSize : 0;
+	pageOffset += alignedSize;
+	return allocation;
+}
+
+void ConstantBufferRing::EndFrame()
+{
+	for (size_t i = 0; i < pagesUsed; i++)
+	{
+		pages[i].buffer->Unmap();
+		pages[i].mapped = nullptr;
+	}
+	pagesUsed = 0;
+}
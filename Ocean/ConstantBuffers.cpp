@@ -0,0 +1,82 @@
+#include "pch.h"
+#include "ConstantBuffers.h"
+#include "Common\DirectXHelper.h"
+#include <cassert>
+
+using namespace Ocean;
+
+ConstantBufferSupport Ocean::GetConstantBufferSupport(std::shared_ptr<DX::DeviceResources> deviceResources)
+{
+	ConstantBufferSupport support = { false, false };
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	if (SUCCEEDED(deviceResources->GetD3DDevice()->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+	{
+		support.offsetting = options.ConstantBufferOffsetting != FALSE;
+		support.partialUpdates = options.ConstantBufferPartialUpdate != FALSE;
+	}
+	return support;
+}
+
+void Ocean::FindChangedRegisters(const void* current, const void* previous, UINT size, UINT& first, UINT& end)
+{
+	const byte* a = (const byte*)current;
+	const byte* b = (const byte*)previous;
+	UINT count = size / constantRegisterSize;
+
+	first = 0;
+	while (first < count && memcmp(a + first * constantRegisterSize, b + first * constantRegisterSize, constantRegisterSize) == 0)
+		first++;
+
+	end = count;
+	while (end > first && memcmp(a + (end - 1) * constantRegisterSize, b + (end - 1) * constantRegisterSize, constantRegisterSize) == 0)
+		end--;
+}
+
+StaticConstantBuffer::StaticConstantBuffer(UINT byteWidth)
+	: uploaded(byteWidth), uploadedKnown(false), partialUpdates(false)
+{
+	assert(byteWidth % constantRegisterSize == 0);
+}
+
+void StaticConstantBuffer::CreateBuffer(std::shared_ptr<DX::DeviceResources> deviceResources)
+{
+	CD3D11_BUFFER_DESC constantBufferDesc((UINT)uploaded.size(), D3D11_BIND_CONSTANT_BUFFER);
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDevice()->CreateBuffer(
+			&constantBufferDesc,
+			nullptr,
+			&buffer
+			)
+		);
+
+	partialUpdates = GetConstantBufferSupport(deviceResources).partialUpdates;
+	uploadedKnown = false;
+}
+
+bool StaticConstantBuffer::Upload(std::shared_ptr<DX::DeviceResources> deviceResources, const void* data)
+{
+	UINT size = (UINT)uploaded.size();
+	UINT registerCount = size / constantRegisterSize;
+	UINT first = 0, end = registerCount;
+	if (uploadedKnown)
+	{
+		FindChangedRegisters(data, uploaded.data(), size, first, end);
+		if (first == end)
+			return false;
+	}
+
+	auto context = deviceResources->GetD3DDeviceContext();
+	if (partialUpdates && (first > 0 || end < registerCount))
+	{
+		D3D11_BOX box = { first * constantRegisterSize, 0, 0, end * constantRegisterSize, 1, 1 };
+		context->UpdateSubresource1(buffer.Get(), 0, &box, (const byte*)data + box.left, 0, 0, 0);
+	}
+	else
+	{
+		context->UpdateSubresource(buffer.Get(), 0, nullptr, data, 0, 0);
+	}
+
+	memcpy(uploaded.data(), data, size);
+	uploadedKnown = true;
+	return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "DynamicBuffer.h"
+#include "RenderContext.h"
+#include <functional>
+#include <vector>
+#include <cstring>
+
+namespace Ocean
+{
+	// Binding part of a constant buffer and updating part of one, both optional in D3D 11.1
+	struct ConstantBufferSupport
+	{
+		bool offsetting;
+		bool partialUpdates;
+	};
+
+	ConstantBufferSupport GetConstantBufferSupport(std::shared_ptr<DX::DeviceResources> deviceResources);
+
+	// Constant buffers are made of 16 byte registers, offsets into them count registers
+	static const UINT constantRegisterSize = 16;
+
+	// The registers in [first, end) differ between current and previous, both size bytes. first == end if none do.
+	void FindChangedRegisters(const void* current, const void* previous, UINT size, UINT& first, UINT& end);
+
+	// Constants that change rarely or once a frame, kept in a default usage buffer. Upload compares them with what
+	// was sent last time and only sends the registers that changed, or nothing at all.
+	class StaticConstantBuffer
+	{
+	public:
+		StaticConstantBuffer(UINT byteWidth);
+
+		void CreateBuffer(std::shared_ptr<DX::DeviceResources> deviceResources);
+		// Returns whether anything was sent. Without partial updates a change sends the whole buffer.
+		bool Upload(std::shared_ptr<DX::DeviceResources> deviceResources, const void* data);
+
+		ID3D11Buffer* const* GetAddressOf() const { return buffer.GetAddressOf(); }
+
+	private:
+		std::vector<byte> uploaded;
+		bool uploadedKnown;
+		bool partialUpdates;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	};
+
+	// A StaticConstantBuffer holding one T, which is uploaded by Upload
+	template <typename T>
+	class ConstantBuffer : public StaticConstantBuffer
+	{
+	public:
+		static_assert(sizeof(T) % constantRegisterSize == 0, "Constant buffers are made of whole registers");
+
+		ConstantBuffer() : StaticConstantBuffer(sizeof(T)) { memset(&data, 0, sizeof(T)); }
+
+		bool Upload(std::shared_ptr<DX::DeviceResources> deviceResources) { return StaticConstantBuffer::Upload(deviceResources, &data); }
+
+		T data;
+	};
+
+	// Where ConstantBufferRing put the constants of one draw, valid for the frame they were allocated in.
+	// constantCount is 0 when the buffer holds nothing else and is bound whole.
+	struct ConstantAllocation
+	{
+		void* data;
+		ID3D11Buffer* buffer;
+		UINT firstConstant;
+		UINT constantCount;
+	};
+
+	void BindConstants(IRenderContext& renderContext, ShaderStage stage, UINT slot, const ConstantAllocation& allocation);
+
+	// Per-draw constants, written again every frame. With offsetting the draws of a frame get 256 byte aligned ranges of
+	// a few large dynamic buffers, each mapped once with WRITE_DISCARD, instead of a buffer and an upload each.
+	// Without it every allocation is a dynamic buffer of its own, mapped for just that draw.
+	// Buffers come from createBuffer, so memory stand-ins can take the place of the D3D ones.
+	class ConstantBufferRing
+	{
+	public:
+		typedef std::function<std::shared_ptr<IDynamicBuffer>(UINT byteWidth)> BufferFactory;
+
+		ConstantBufferRing(BufferFactory createBuffer, UINT pageSize, bool offsetting);
+
+		// Allocate between BeginFrame and EndFrame, the buffers can only be drawn with after EndFrame
+		void BeginFrame();
+		ConstantAllocation Allocate(UINT size);
+		void EndFrame();
+
+		// Allocates room for constants and copies them there
+		template <typename T>
+		ConstantAllocation Write(const T& constants)
+		{
+			ConstantAllocation allocation = Allocate((UINT)sizeof(T));
+			memcpy(allocation.data, &constants, sizeof(T));
+			return allocation;
+		}
+
+		// Buffers mapped since BeginFrame, and all kept for the next frames
+		UINT GetMapCount() const { return mapCount; }
+		UINT GetPageCount() const { return (UINT)pages.size(); }
+
+		// Ranges bound with offsets start and end at multiples of 16 registers
+		static const UINT alignment = 256;
+
+	private:
+		struct Page
+		{
+			std::shared_ptr<IDynamicBuffer> buffer;
+			byte* mapped;
+		};
+
+		BufferFactory createBuffer;
+		UINT pageSize;
+		bool offsetting;
+		std::vector<Page> pages;
+		// Pages mapped this frame, the last one is filled up to pageOffset
+		size_t pagesUsed;
+		UINT pageOffset;
+		UINT mapCount;
+	};
+}
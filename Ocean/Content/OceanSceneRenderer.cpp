@@ -1,6 +1,8 @@
 ﻿#include "pch.h"
 #include "Windows.h"
 #include "OceanSceneRenderer.h"
+#include "GerstnerWaveGenerator.h"
+#include <random>
 
 #include "..\Common\DirectXHelper.h"
 
@@ -9,6 +11,9 @@ using namespace Ocean;
 using namespace DirectX;
 using namespace Windows::Foundation;
 
+// Gerstner waves taken from the spectrum, 12 of them keep about two thirds of its energy in three sets
+static const int gerstnerWaveCount = 12;
+
 // Loads vertex and pixel shaders from files and instantiates the cube geometry.
 OceanSceneRenderer::OceanSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
 	loadingComplete(false),
@@ -23,13 +28,23 @@ OceanSceneRenderer::OceanSceneRenderer(const std::shared_ptr<DX::DeviceResources
 void OceanSceneRenderer::InitializeScene()
 {
 	water = std::shared_ptr<Water>(new Water());
-	XMStoreFloat4x4(&water->vsConstantBufferData.model, XMMatrixIdentity());
-	water->vsConstantBufferData.uvWaveSpeed = XMFLOAT4(.4f, -.5f, -.7f, .3f);
-	water->psConstantBufferData.lightDir = XMFLOAT4(-.9f, -.34f, -.25f, 1.f);
-	water->psConstantBufferData.lightColor = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
+	water->material.data.uvWaveSpeed = XMFLOAT4(.4f, -.5f, -.7f, .3f);
+	GenerateWaves();
+
+	frameConstants = std::shared_ptr<ConstantBuffer<FrameConstantBuffer>>(new ConstantBuffer<FrameConstantBuffer>());
+	frameConstants->data.lightDir = XMFLOAT4(-.9f, -.34f, -.25f, 1.f);
+	frameConstants->data.lightColor = XMFLOAT4(1.f, 1.f, 1.f, 1.f);
 	
 	skybox = std::shared_ptr<Skybox>(new Skybox());
 
+	floatingObjects = std::shared_ptr<FloatingObjects>(new FloatingObjects(water->GetWaveSets().data(), (int)water->GetWaveSets().size()));
+	PlaceFloatingObjects();
+
+	drawables.push_back(skybox);
+	drawables.push_back(floatingObjects);
+	drawables.push_back(water);
+	drawQueue = std::shared_ptr<DrawQueue>(new DrawQueue());
+
 	camera = std::shared_ptr<Camera>(new Camera(
 		XMFLOAT4(-10.0f, 7.f, 5.f, 0.0f),
 		XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f),
@@ -37,16 +52,85 @@ void OceanSceneRenderer::InitializeScene()
 		deviceResources));
 }
 
+// Samples the waves from the same sea state the FFT mode simulates
+void OceanSceneRenderer::GenerateWaves()
+{
+	GerstnerSeaState seaState;
+	seaState.windSpeed = 10.f;
+	seaState.fetch = 100000.f;
+	seaState.windDirectionX = 1.f;
+	seaState.windDirectionZ = .4f;
+
+	GerstnerGeneratorSettings settings;
+	settings.frequencyCount = 12;
+	settings.lowestFrequency = .7f;
+	settings.highestFrequency = 4.f;
+	settings.directionCount = 7;
+	settings.maxSteepness = .8f;
+	settings.fadeWavelengths = 30.f;
+	settings.seed = 1;
+	GerstnerWaveGenerator generator(seaState, settings);
+
+	// Every set of four is one more pass over the waves in the vertex shader
+	std::vector<GerstnerWaveSet> waveSets = generator.Generate(gerstnerWaveCount);
+	water->SetWaveSets(waveSets.data(), (int)waveSets.size());
+
+#if defined(_DEBUG)
+	char message[128];
+	snprintf(message, sizeof(message), "Gerstner waves: significant height %.2f m from %d spectrum bins\n",
+		generator.GetSignificantWaveHeight(), generator.GetBinCount());
+	OutputDebugStringA(message);
+	for (int waveCount = 4; waveCount <= maxGerstnerWaveSets * 4; waveCount += 4)
+	{
+		snprintf(message, sizeof(message), "  %2d waves keep %.1f%% of the energy%s\n",
+			waveCount, generator.GetKeptEnergy(waveCount) * 100.f, waveCount == gerstnerWaveCount ? ", in use" : "");
+		OutputDebugStringA(message);
+	}
+#endif
+}
+
+// Buoys on a grid around the origin, marker buoys on a ring around them and debris strewn further out
+void OceanSceneRenderer::PlaceFloatingObjects()
+{
+	int buoyMesh = floatingObjects->AddSphereMesh(8, .5f);
+	int debrisMesh = floatingObjects->AddSphereMesh(4, .5f);
+
+	FloatingBodyKind buoy = { .5f, 1.f, .35f, 1.5f, 2.f };
+	FloatingBodyKind marker = { .5f, 1.f, .5f, 1.5f, 2.f };
+	FloatingBodyKind debris = { .5f, 1.f, .7f, 2.f, 2.f };
+	int buoyKind = floatingObjects->AddKind(buoy, buoyMesh, XMFLOAT4(1.f, .45f, .1f, 1.f));
+	int markerKind = floatingObjects->AddKind(marker, buoyMesh, XMFLOAT4(1.f, .85f, .1f, 1.f));
+	int debrisKind = floatingObjects->AddKind(debris, debrisMesh, XMFLOAT4(.4f, .3f, .2f, 1.f));
+
+	for (int z = -10; z < 10; z++)
+	{
+		for (int x = -10; x < 10; x++)
+			floatingObjects->AddObject(buoyKind, (float)x * 12.f + 6.f, (float)z * 12.f + 6.f, 0.f, 1.f);
+	}
+
+	for (int i = 0; i < 64; i++)
+	{
+		float angle = (float)i * XM_2PI / 64.f;
+		floatingObjects->AddObject(markerKind, cosf(angle) * 150.f, sinf(angle) * 150.f, angle, 1.5f);
+	}
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> place(-300.f, 300.f), turn(0.f, XM_2PI), size(.4f, 1.2f);
+	for (int i = 0; i < 2000; i++)
+		floatingObjects->AddObject(debrisKind, place(random), place(random), turn(random), size(random));
+}
+
 // Initializes view parameters when the window size changes.
 void OceanSceneRenderer::CreateWindowSizeDependentResources()
 {
 	auto outputSize = deviceResources->GetOutputSize();
 	camera->aspectRatio = outputSize.Width / outputSize.Height;
 
-	XMStoreFloat4x4(&water->vsConstantBufferData.projection, camera->getProjection());
-	XMStoreFloat4x4(&skybox->vsConstantBufferData.projection, camera->getProjection());
+	XMStoreFloat4x4(&frameConstants->data.projection, camera->getProjection());
 
-	water->UpdateMeshes(deviceResources, camera);
+	// Until then the loader is still building the meshes, and it generates them for the current size
+	if (loadingComplete)
+		water->UpdateMeshes(deviceResources, camera);
 }
 
 // Called once per frame, rotates the cube and calculates the model and view matrices.
@@ -57,19 +141,40 @@ void OceanSceneRenderer::Update(DX::StepTimer const& timer)
 	XMVECTOR oldEye = camera->getEye();
 	camera->Update(timer, deviceResources);
 
-	water->UpdateMeshes(deviceResources, camera);
-
-	XMStoreFloat4x4(&water->vsConstantBufferData.view, camera->getView());
-	XMStoreFloat4(&water->vsConstantBufferData.cameraPos, camera->getEye());
+	// The FFT simulation in UpdateMeshes runs at this frame's time
 	float totalTime = (float)timer.GetTotalSeconds();
-	water->vsConstantBufferData.totalTime = XMFLOAT4(totalTime, totalTime, totalTime, totalTime);
+	water->totalTime = totalTime;
+	frameConstants->data.totalTime = XMFLOAT4(totalTime, totalTime, totalTime, totalTime);
+
+	// The frame's updates read the wave sets, so they are only replaced here and not by the loader.
+	// The objects have to ride the waves that are drawn.
+	if (loadingComplete && !bakedWaveSets.empty())
+	{
+		water->SetWaveSets(bakedWaveSets.data(), (int)bakedWaveSets.size());
+		floatingObjects->SetWaveSets(water->GetWaveSets().data(), (int)water->GetWaveSets().size());
+		bakedWaveSets.clear();
+	}
+
+	// The loader builds the meshes and the culling's containers, and nothing is drawn before it is done
+	if (loadingComplete)
+	{
+		water->UpdateMeshes(deviceResources, camera);
+		water->UpdateRipples(deviceResources, camera, (float)timer.GetElapsedSeconds());
+	}
+
+	if (loadingComplete)
+		floatingObjects->Update(deviceResources, camera, totalTime, (float)timer.GetElapsedSeconds(), water->GetThreadPool().get());
+
+	XMStoreFloat4x4(&frameConstants->data.view, camera->getView());
+	XMStoreFloat4(&frameConstants->data.cameraPos, camera->getEye());
 	
-	XMStoreFloat4x4(&skybox->vsConstantBufferData.model, XMMatrixTranspose(XMMatrixScaling(1000.f, 1000.f, 1000.f) * XMMatrixTranslationFromVector(camera->getEye())));
-	XMStoreFloat4x4(&skybox->vsConstantBufferData.view, camera->getView());
+	XMStoreFloat4x4(&skybox->objectConstants.model, XMMatrixTranspose(XMMatrixScaling(1000.f, 1000.f, 1000.f) * XMMatrixTranslationFromVector(camera->getEye())));
 }
 
 // Processes user input
 float timeWhenFKeyPressed = 0.f;
+float timeWhenMKeyPressed = 0.f;
+float timeWhenRKeyPressed = 0.f;
 void OceanSceneRenderer::ProcessInput(DX::StepTimer const& timer)
 {
 	using namespace Windows::UI::Core;
@@ -84,6 +189,40 @@ void OceanSceneRenderer::ProcessInput(DX::StepTimer const& timer)
 		timeWhenFKeyPressed = (float)timer.GetTotalSeconds();
 		water->wireframe = !water->wireframe;
 	}
+
+	if (window->GetAsyncKeyState(VirtualKey::M) == CoreVirtualKeyStates::Down &&
+		timer.GetTotalSeconds() - timeWhenMKeyPressed > .1f)
+	{
+		timeWhenMKeyPressed = (float)timer.GetTotalSeconds();
+		// Polar (or Projected when looking down) -> CDLOD -> Tiled -> Fft -> Baked -> Cpu
+		if (water->meshMode == MeshMode::CDLOD)
+			water->meshMode = MeshMode::Tiled;
+		else if (water->meshMode == MeshMode::Tiled)
+			water->meshMode = MeshMode::Fft;
+		else if (water->meshMode == MeshMode::Fft)
+			water->meshMode = MeshMode::Baked;
+		else if (water->meshMode == MeshMode::Baked)
+			water->meshMode = MeshMode::Cpu;
+		else if (water->meshMode == MeshMode::Cpu)
+			water->meshMode = MeshMode::Polar;
+		else
+			water->meshMode = MeshMode::CDLOD;
+	}
+
+	// Drops a stone where the camera looks at the water
+	if (window->GetAsyncKeyState(VirtualKey::R) == CoreVirtualKeyStates::Down &&
+		timer.GetTotalSeconds() - timeWhenRKeyPressed > .1f)
+	{
+		timeWhenRKeyPressed = (float)timer.GetTotalSeconds();
+		XMFLOAT3 eye, direction;
+		XMStoreFloat3(&eye, camera->getEye());
+		XMStoreFloat3(&direction, camera->getDirection());
+		if (direction.y < 0.f)
+		{
+			float distance = -eye.y / direction.y;
+			water->AddRipple(eye.x + direction.x * distance, eye.z + direction.z * distance, 1.5f, .5f);
+		}
+	}
 }
 
 // Renders one frame using the vertex and pixel shaders.
@@ -95,36 +234,71 @@ void OceanSceneRenderer::Render()
 		return;
 	}
 	
-	auto context = deviceResources->GetD3DDeviceContext();
-
-	// Set render targets to the screen.
-	ID3D11RenderTargetView *const targets[1] = { deviceResources->GetBackBufferRenderTargetView() };
-	context->OMSetRenderTargets(1, targets, deviceResources->GetDepthStencilView());
-
-	context->RSSetState(states->CullClockwise());
-	skybox->Draw(deviceResources);
-	
-	if (water->wireframe)
-		context->RSSetState(states->Wireframe());
-	else
-		context->RSSetState(states->CullCounterClockwise());
-
-	context->OMSetBlendState(states->AlphaBlend(), nullptr, 0xFFFFFFFF);
-	water->Draw(deviceResources);
+	// OceanMain has set the render targets, and the text overlay binds its own state after us every frame
+	renderContext->Invalidate();
+	renderContext->ResetStats();
+
+	// Only the registers that changed since the last frame are sent, and every draw's own constants in one go
+	frameConstants->Upload(deviceResources);
+	objectConstants->BeginFrame();
+	skybox->PrepareConstants(*objectConstants);
+	water->PrepareConstants(deviceResources, *objectConstants);
+	objectConstants->EndFrame();
+
+	renderContext->SetConstantBuffers(VertexStage, FrameConstantSlot, 1, frameConstants->GetAddressOf());
+	renderContext->SetConstantBuffers(PixelStage, FrameConstantSlot, 1, frameConstants->GetAddressOf());
+
+	// Opaque objects front to back with the sky behind them, then the water blended over all of it
+	drawQueue->BeginFrame(camera->farClippingPane);
+	for (auto& drawable : drawables)
+		drawable->SubmitDraws(*drawQueue, *states);
+	drawQueue->Sort();
+	drawQueue->Execute(deviceResources, *renderContext, water->GetThreadPool().get());
 }
 
 void OceanSceneRenderer::CreateDeviceDependentResources()
 {
 	states = std::shared_ptr<CommonStates>(new CommonStates(deviceResources->GetD3DDevice()));
+	stateCache = std::shared_ptr<StateObjectCache>(new StateObjectCache(deviceResources));
+	renderContext = std::shared_ptr<StateFilteringContext>(new StateFilteringContext(std::shared_ptr<IRenderContext>(new D3DRenderContext(deviceResources))));
+	frameConstants->CreateBuffer(deviceResources);
+
+	// 64 KB pages, the most one binding can reach
+	auto resources = deviceResources;
+	objectConstants = std::shared_ptr<ConstantBufferRing>(new ConstantBufferRing([resources](UINT byteWidth) {
+		return std::shared_ptr<IDynamicBuffer>(new D3DDynamicBuffer(resources, byteWidth, D3D11_BIND_CONSTANT_BUFFER));
+	}, 64 * 1024, GetConstantBufferSupport(deviceResources).offsetting));
 
 	auto loadWaterVSTask = DX::ReadDataAsync(L"WaterVertexShader.cso");
+	auto loadWaterPatchVSTask = DX::ReadDataAsync(L"WaterPatchVertexShader.cso");
+	auto loadWaterFftVSTask = DX::ReadDataAsync(L"WaterFftVertexShader.cso");
+	auto loadWaterBakedVSTask = DX::ReadDataAsync(L"WaterBakedVertexShader.cso");
+	auto loadWaterCpuVSTask = DX::ReadDataAsync(L"WaterCpuVertexShader.cso");
 	auto loadWaterPSTask = DX::ReadDataAsync(L"WaterPixelShader.cso");
 	auto loadWaterWFPSTask = DX::ReadDataAsync(L"SolidColorPixelShader.cso");
 	auto loadSkyboxVSTask = DX::ReadDataAsync(L"SkyboxVertexShader.cso");
 	auto loadSkyboxPSTask = DX::ReadDataAsync(L"SkyboxPixelShader.cso");
+	auto loadFloatingObjectVSTask = DX::ReadDataAsync(L"FloatingObjectVertexShader.cso");
+	auto loadFloatingObjectPSTask = DX::ReadDataAsync(L"FloatingObjectPixelShader.cso");
 
 	auto createWaterVSTask = loadWaterVSTask.then([this](const std::vector<byte>& fileData) {
-		water->LoadVertexShader(deviceResources, fileData);
+		water->LoadVertexShader(deviceResources, *stateCache, fileData);
+	});
+
+	auto createWaterPatchVSTask = loadWaterPatchVSTask.then([this](const std::vector<byte>& fileData) {
+		water->LoadPatchVertexShader(deviceResources, *stateCache, fileData);
+	});
+
+	auto createWaterFftVSTask = loadWaterFftVSTask.then([this](const std::vector<byte>& fileData) {
+		water->LoadFftVertexShader(deviceResources, fileData);
+	});
+
+	auto createWaterBakedVSTask = loadWaterBakedVSTask.then([this](const std::vector<byte>& fileData) {
+		bakedWaveSets = water->LoadBakedVertexShader(deviceResources, fileData);
+	});
+
+	auto createWaterCpuVSTask = loadWaterCpuVSTask.then([this](const std::vector<byte>& fileData) {
+		water->LoadCpuVertexShader(deviceResources, *stateCache, fileData);
 	});
 
 	auto createWaterPSTask = loadWaterPSTask.then([this](const std::vector<byte>& fileData) {
@@ -136,9 +310,9 @@ void OceanSceneRenderer::CreateDeviceDependentResources()
 		water->LoadWireFramePixelShader(deviceResources, fileData);
 	});
 
-	auto loadWaterAssetsTask = (createWaterVSTask && createWaterPSTask && createWaterWFPSTask).then([this] () {
+	auto loadWaterAssetsTask = (createWaterVSTask && createWaterPatchVSTask && createWaterFftVSTask && createWaterBakedVSTask && createWaterCpuVSTask && createWaterPSTask && createWaterWFPSTask).then([this] () {
 		water->LoadMeshes(deviceResources, camera);
-		water->LoadTextures(deviceResources, 
+		water->LoadTextures(deviceResources, *stateCache,
 			L"assets/textures/water_normal.dds",
 			L"assets/textures/water_normal.dds",
 			L"assets/textures/skybox.dds",
@@ -147,8 +321,7 @@ void OceanSceneRenderer::CreateDeviceDependentResources()
 
 
 	auto createSkyboxVSTask = loadSkyboxVSTask.then([this](const std::vector<byte>& fileData) {
-		skybox->LoadVertexShader(deviceResources, fileData);
-		skybox->CreateConstantBuffers(deviceResources);
+		skybox->LoadVertexShader(deviceResources, *stateCache, fileData);
 	});
 
 	auto createSkyboxPSTask = loadSkyboxPSTask.then([this](const std::vector<byte>& fileData) {
@@ -157,11 +330,24 @@ void OceanSceneRenderer::CreateDeviceDependentResources()
 
 	auto loadSkyboxAssetsTask = (createSkyboxVSTask && createSkyboxPSTask).then([this]() {
 		skybox->LoadMesh(deviceResources);
-		skybox->LoadTextures(deviceResources, L"assets/textures/skybox.dds");
+		skybox->LoadTextures(deviceResources, *stateCache, L"assets/textures/skybox.dds");
+	});
+
+	auto createFloatingObjectVSTask = loadFloatingObjectVSTask.then([this](const std::vector<byte>& fileData) {
+		floatingObjects->LoadVertexShader(deviceResources, *stateCache, fileData);
+	});
+
+	auto createFloatingObjectPSTask = loadFloatingObjectPSTask.then([this](const std::vector<byte>& fileData) {
+		floatingObjects->LoadPixelShader(deviceResources, fileData);
+	});
+
+	auto loadFloatingObjectAssetsTask = (createFloatingObjectVSTask && createFloatingObjectPSTask).then([this]() {
+		floatingObjects->LoadMeshes(deviceResources);
 	});
 
 	// Once the everything is loaded, the scene is ready to be rendered.
-	(loadWaterAssetsTask && loadSkyboxAssetsTask).then([this] () {
+	(loadWaterAssetsTask && loadSkyboxAssetsTask && loadFloatingObjectAssetsTask).then([this] () {
+		stateCache->ReportStats();
 		loadingComplete = true;
 	});
 }
@@ -170,7 +356,12 @@ void OceanSceneRenderer::ReleaseDeviceDependentResources()
 {
 	loadingComplete = false;
 	states.reset();
+	stateCache.reset();
+	renderContext.reset();
+	objectConstants.reset();
 	camera.reset();
 	water.reset();
 	skybox.reset();
+	floatingObjects.reset();
+	drawables.clear();
 }
\ No newline at end of file
@@ -9,6 +9,11 @@
 #include "Camera.h"
 #include "Water.h"
 #include "Skybox.h"
+#include "FloatingObjects.h"
+#include "StateFilteringContext.h"
+#include "ConstantBuffers.h"
+#include "StateObjectCache.h"
+#include "DrawQueue.h"
 
 namespace Ocean
 {
@@ -26,6 +31,9 @@ namespace Ocean
 		void Render();
 
 	private:
+		void GenerateWaves();
+		void PlaceFloatingObjects();
+
 		// Cached pointer to device resources.
 		std::shared_ptr<DX::DeviceResources> deviceResources;
 
@@ -33,11 +41,26 @@ namespace Ocean
 		std::shared_ptr<Camera> camera;
 		std::shared_ptr<Water> water;
 		std::shared_ptr<Skybox> skybox;
+		std::shared_ptr<FloatingObjects> floatingObjects;
+		// Everything that queues draws, Render doesn't need to know about new kinds of objects
+		std::vector<std::shared_ptr<IDrawable>> drawables;
+		// The waves the bake snapped to its tile, left by the loader for Update to swap in
+		std::vector<GerstnerWaveSet> bakedWaveSets;
+		// Camera and light for every draw
+		std::shared_ptr<ConstantBuffer<FrameConstantBuffer>> frameConstants;
 		
 
 		// Variables used with the rendering loop.
 		bool	loadingComplete;
 		std::shared_ptr<CommonStates> states;
+		// Input layouts and samplers shared by the scene objects
+		std::shared_ptr<StateObjectCache> stateCache;
+		// Every bind of the scene goes through it, so unchanged state isn't sent again
+		std::shared_ptr<StateFilteringContext> renderContext;
+		// The per-draw constants of a frame, written before the first draw
+		std::shared_ptr<ConstantBufferRing> objectConstants;
+		// The frame's draws, sorted before they are sent
+		std::shared_ptr<DrawQueue> drawQueue;
 	};
 }
 
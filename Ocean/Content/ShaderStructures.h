@@ -1,6 +1,10 @@
 ﻿#pragma once
+#include "..\GerstnerWaves.h"
+#include <DirectXPackedVector.h>
+#include <cstddef>
 
 using namespace DirectX;
+using namespace DirectX::PackedVector;
 
 namespace Ocean
 {
@@ -12,22 +16,59 @@ namespace Ocean
 		XMFLOAT4X4 projection;
 	};
 
-	struct WaterVSConstantBuffer
+	// Constant buffer registers shared by all shaders, see FrameConstants.hlsli
+	enum ConstantBufferSlot
+	{
+		FrameConstantSlot,
+		ObjectConstantSlot,
+		MaterialConstantSlot
+	};
+
+	// Camera and light, uploaded once a frame and bound for every draw
+	struct FrameConstantBuffer
 	{
-		XMFLOAT4X4 model;
 		XMFLOAT4X4 view;
 		XMFLOAT4X4 projection;
 		XMFLOAT4 cameraPos;
 		XMFLOAT4 totalTime;
-		XMFLOAT4 uvWaveSpeed;
+		XMFLOAT4 lightDir;
+		XMFLOAT4 lightColor;
 	};
 
-	struct WaterPSConstantBuffer
+	// Per-draw constants of objects that only need to be placed
+	struct ModelConstantBuffer
 	{
-		XMFLOAT4 lightDir;
-		XMFLOAT4 lightColor;
+		XMFLOAT4X4 model;
 	};
 
+	// Per-draw constants of the water, they follow the camera
+	struct WaterObjectConstantBuffer
+	{
+		XMFLOAT4X4 model;
+		XMFLOAT4 positionDecode;
+		// Lookup of the FFT or baked wave maps. x: texture coordinates per world unit, y: per second,
+		// zw: half a texel and half a frame, to sample the baked maps at the points they were baked at
+		XMFLOAT4 waveMapTiling;
+		// Lookup of the ripple map. x: texture coordinates per world unit, yz: at the world origin, w: 1 with ripples
+		XMFLOAT4 rippleMapping;
+	};
+
+	// Water constants that only change with the waves
+	struct WaterMaterialConstantBuffer
+	{
+		XMFLOAT4 uvWaveSpeed;
+
+		// Gerstner wave sets, four waves each, ordered from the one that fades out last.
+		// waveFade: fade start, fade end, normal intensity
+		XMUINT4 waveSetCount;
+		XMFLOAT4 waveAmplitude[maxGerstnerWaveSets];
+		XMFLOAT4 waveFrequency[maxGerstnerWaveSets];
+		XMFLOAT4 waveSteepness[maxGerstnerWaveSets];
+		XMFLOAT4 waveSpeed[maxGerstnerWaveSets];
+		XMFLOAT4 waveDirectionX[maxGerstnerWaveSets];
+		XMFLOAT4 waveDirectionZ[maxGerstnerWaveSets];
+		XMFLOAT4 waveFade[maxGerstnerWaveSets];
+	};
 
 	// Used to send per-vertex data to the vertex shader.
 	struct VertexPositionColor
@@ -42,6 +83,26 @@ namespace Ocean
 		XMFLOAT3 normal;
 	};
 
+	// Water vertices only need their place on the plane, the shader computes everything else
+	struct VertexPositionXZ
+	{
+		XMFLOAT2 position;
+	};
+
+	// The same in 16 bit, relative to the mesh's bounds. WaterObjectConstantBuffer::positionDecode holds the scale and the offset.
+	struct VertexPositionXZQuantized
+	{
+		XMSHORTN2 position;
+	};
+
+	// Water vertices displaced on the CPU, in world space. planePosition is the x, z of the undisplaced point.
+	struct VertexPositionNormalPlane
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 normal;
+		XMFLOAT2 planePosition;
+	};
+
 	struct VertexPositionNormalTextureTangentBinormal
 	{
 		XMFLOAT3 position;
@@ -61,4 +122,132 @@ namespace Ocean
 			binormal(binormal)
 		{ }
 	};
+
+	// Per-instance data of a CDLOD patch drawn with the shared patch mesh
+	struct PatchInstance
+	{
+		XMFLOAT4 originScale;	// x, z of the corner, size of a quad, level
+		XMFLOAT4 morph;			// distance where morphing starts, distance where it ends
+	};
+
+	// Per-instance data of a floating object drawn with its kind's mesh
+	struct FloatingObjectInstance
+	{
+		XMFLOAT4 positionScale;	// position of the hull's centre, uniform scale
+		XMFLOAT4 rotation;		// quaternion x, y, z, w
+		XMFLOAT4 color;
+	};
+
+	// Input layouts are generated from the vertex structs, so the layout, the offsets and the stride can't disagree
+	template <typename T> struct DxgiFormatOf;
+	template <> struct DxgiFormatOf<XMFLOAT2> { static const DXGI_FORMAT value = DXGI_FORMAT_R32G32_FLOAT; };
+	template <> struct DxgiFormatOf<XMFLOAT3> { static const DXGI_FORMAT value = DXGI_FORMAT_R32G32B32_FLOAT; };
+	template <> struct DxgiFormatOf<XMFLOAT4> { static const DXGI_FORMAT value = DXGI_FORMAT_R32G32B32A32_FLOAT; };
+	template <> struct DxgiFormatOf<XMSHORTN2> { static const DXGI_FORMAT value = DXGI_FORMAT_R16G16_SNORM; };
+
+#define OCEAN_VERTEX_ELEMENT(Vertex, member, semantic) \
+	{ semantic, 0, DxgiFormatOf<decltype(Vertex::member)>::value, 0, offsetof(Vertex, member), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+
+#define OCEAN_INSTANCE_ELEMENT(Instance, member, semantic, slot) \
+	{ semantic, 0, DxgiFormatOf<decltype(Instance::member)>::value, slot, offsetof(Instance, member), D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+
+	template <typename T> struct VertexFormat;
+
+	template <> struct VertexFormat<VertexPositionNormal>
+	{
+		static_assert(sizeof(VertexPositionNormal) == sizeof(XMFLOAT3) * 2, "VertexPositionNormal has members its layout doesn't describe");
+		static const UINT stride = sizeof(VertexPositionNormal);
+		static const UINT elementCount = 2;
+		static const D3D11_INPUT_ELEMENT_DESC* Elements()
+		{
+			static const D3D11_INPUT_ELEMENT_DESC elements[elementCount] =
+			{
+				OCEAN_VERTEX_ELEMENT(VertexPositionNormal, position, "SV_Position"),
+				OCEAN_VERTEX_ELEMENT(VertexPositionNormal, normal, "NORMAL")
+			};
+			return elements;
+		}
+	};
+
+	template <> struct VertexFormat<VertexPositionNormalPlane>
+	{
+		static_assert(sizeof(VertexPositionNormalPlane) == sizeof(XMFLOAT3) * 2 + sizeof(XMFLOAT2), "VertexPositionNormalPlane has members its layout doesn't describe");
+		static const UINT stride = sizeof(VertexPositionNormalPlane);
+		static const UINT elementCount = 3;
+		static const D3D11_INPUT_ELEMENT_DESC* Elements()
+		{
+			static const D3D11_INPUT_ELEMENT_DESC elements[elementCount] =
+			{
+				OCEAN_VERTEX_ELEMENT(VertexPositionNormalPlane, position, "SV_Position"),
+				OCEAN_VERTEX_ELEMENT(VertexPositionNormalPlane, normal, "NORMAL"),
+				OCEAN_VERTEX_ELEMENT(VertexPositionNormalPlane, planePosition, "TEXCOORD")
+			};
+			return elements;
+		}
+	};
+
+	template <> struct VertexFormat<VertexPositionXZ>
+	{
+		static_assert(sizeof(VertexPositionXZ) == sizeof(XMFLOAT2), "VertexPositionXZ has members its layout doesn't describe");
+		static const UINT stride = sizeof(VertexPositionXZ);
+		static const UINT elementCount = 1;
+		static const D3D11_INPUT_ELEMENT_DESC* Elements()
+		{
+			static const D3D11_INPUT_ELEMENT_DESC elements[elementCount] =
+			{
+				OCEAN_VERTEX_ELEMENT(VertexPositionXZ, position, "SV_Position")
+			};
+			return elements;
+		}
+	};
+
+	template <> struct VertexFormat<VertexPositionXZQuantized>
+	{
+		static_assert(sizeof(VertexPositionXZQuantized) == sizeof(XMSHORTN2), "VertexPositionXZQuantized has members its layout doesn't describe");
+		static const UINT stride = sizeof(VertexPositionXZQuantized);
+		static const UINT elementCount = 1;
+		static const D3D11_INPUT_ELEMENT_DESC* Elements()
+		{
+			static const D3D11_INPUT_ELEMENT_DESC elements[elementCount] =
+			{
+				OCEAN_VERTEX_ELEMENT(VertexPositionXZQuantized, position, "SV_Position")
+			};
+			return elements;
+		}
+	};
+
+	// Read from the second vertex buffer slot, next to the patch mesh's VertexPositionXZ
+	template <> struct VertexFormat<PatchInstance>
+	{
+		static_assert(sizeof(PatchInstance) == sizeof(XMFLOAT4) * 2, "PatchInstance has members its layout doesn't describe");
+		static const UINT stride = sizeof(PatchInstance);
+		static const UINT elementCount = 2;
+		static const D3D11_INPUT_ELEMENT_DESC* Elements()
+		{
+			static const D3D11_INPUT_ELEMENT_DESC elements[elementCount] =
+			{
+				OCEAN_INSTANCE_ELEMENT(PatchInstance, originScale, "PATCHORIGINSCALE", 1),
+				OCEAN_INSTANCE_ELEMENT(PatchInstance, morph, "PATCHMORPH", 1)
+			};
+			return elements;
+		}
+	};
+
+	// Read from the second vertex buffer slot, next to the object mesh's VertexPositionNormal
+	template <> struct VertexFormat<FloatingObjectInstance>
+	{
+		static_assert(sizeof(FloatingObjectInstance) == sizeof(XMFLOAT4) * 3, "FloatingObjectInstance has members its layout doesn't describe");
+		static const UINT stride = sizeof(FloatingObjectInstance);
+		static const UINT elementCount = 3;
+		static const D3D11_INPUT_ELEMENT_DESC* Elements()
+		{
+			static const D3D11_INPUT_ELEMENT_DESC elements[elementCount] =
+			{
+				OCEAN_INSTANCE_ELEMENT(FloatingObjectInstance, positionScale, "INSTANCEPOSITIONSCALE", 1),
+				OCEAN_INSTANCE_ELEMENT(FloatingObjectInstance, rotation, "INSTANCEROTATION", 1),
+				OCEAN_INSTANCE_ELEMENT(FloatingObjectInstance, color, "COLOR", 1)
+			};
+			return elements;
+		}
+	};
 }
\ No newline at end of file
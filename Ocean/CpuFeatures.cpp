@@ -0,0 +1,48 @@
+#include "pch.h"
+#include "CpuFeatures.h"
+
+#if defined(OCEAN_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace Ocean;
+
+#if defined(OCEAN_SIMD_X86)
+static bool DetectAvx()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return false;
+
+	// The OS has to save the YMM registers on context switches
+	unsigned long long xcr0 = _xgetbv(0);
+	return (xcr0 & 0x6) == 0x6;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") != 0;
+#endif
+}
+#endif
+
+bool CpuFeatures::HasSse2()
+{
+#if defined(OCEAN_SIMD_X86)
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool CpuFeatures::HasAvx()
+{
+#if defined(OCEAN_SIMD_X86)
+	static const bool avx = DetectAvx();
+	return avx;
+#else
+	return false;
+#endif
+}
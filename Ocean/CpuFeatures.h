@@ -0,0 +1,23 @@
+#pragma once
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define OCEAN_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Functions using AVX intrinsics are compiled for AVX only on compilers that need to be told
+#if defined(__GNUC__) && !defined(_MSC_VER)
+#define OCEAN_TARGET_AVX __attribute__((target("avx")))
+#else
+#define OCEAN_TARGET_AVX
+#endif
+
+namespace Ocean
+{
+	// Instruction sets the running CPU supports, queried once.
+	struct CpuFeatures
+	{
+		static bool HasSse2();
+		static bool HasAvx();
+	};
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+#include "DrawQueue.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Ocean;
+
+static_assert(DrawQueue::materialBits + DrawQueue::shaderBits + DrawQueue::depthBits + DrawQueue::layerBits + DrawQueue::passBits == 64, "The key fields fill 64 bits");
+
+void Ocean::RadixSortDraws(DrawSortEntry* entries, DrawSortEntry* scratch, size_t count)
+{
+	if (count < 2)
+		return;
+
+	// The histograms of all bytes in one read of the keys
+	static const int byteCount = sizeof(UINT64);
+	std::vector<size_t> histograms(byteCount * 256, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		UINT64 key = entries[i].key;
+		for (int b = 0; b < byteCount; b++)
+			histograms[b * 256 + ((key >> (b * 8)) & 0xff)]++;
+	}
+
+	DrawSortEntry* from = entries;
+	DrawSortEntry* to = scratch;
+	for (int b = 0; b < byteCount; b++)
+	{
+		// Bytes every key shares need no pass, with the few passes, shaders and materials of a frame most of them
+		size_t* histogram = &histograms[b * 256];
+		if (histogram[(from[0].key >> (b * 8)) & 0xff] == count)
+			continue;
+
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			to[histogram[(from[i].key >> (b * 8)) & 0xff]++] = from[i];
+		std::swap(from, to);
+	}
+
+	if (from != entries)
+		memcpy(entries, from, count * sizeof(DrawSortEntry));
+}
+
+DrawQueue::DrawQueue()
+	: farDepth(1.f)
+{
+}
+
+void DrawQueue::BeginFrame(float farDepth)
+{
+	this->farDepth = farDepth;
+	packets.clear();
+	ids.clear();
+}
+
+UINT DrawQueue::GetId(const void* object, UINT bits)
+{
+	// Past the field's range ids wrap, which only costs some state changes
+	auto found = ids.insert(std::make_pair(object, (UINT)ids.size()));
+	return found.first->second & ((1u << bits) - 1);
+}
+
+UINT64 DrawQueue::MakeKey(DrawPass pass, DrawLayer layer, float depth, const void* shader, const void* material)
+{
+	const UINT maxBucket = (1u << depthBits) - 1;
+	float normalizedDepth = std::min(std::max(depth / farDepth, 0.f), 1.f);
+	UINT64 bucket = (UINT64)(normalizedDepth * (float)maxBucket);
+	if (layer == TransparentLayer)
+		bucket = maxBucket - bucket;
+
+	UINT64 key = (UINT64)pass;
+	key = (key << layerBits) | (UINT64)layer;
+	key = (key << depthBits) | bucket;
+	key = (key << shaderBits) | GetId(shader, shaderBits);
+	key = (key << materialBits) | GetId(material, materialBits);
+	return key;
+}
+
+void DrawQueue::Submit(const DrawPacket& packet)
+{
+	packets.push_back(packet);
+}
+
+void DrawQueue::Sort()
+{
+	size_t count = packets.size();
+	sorted.resize(count);
+	scratch.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		sorted[i].key = packets[i].key;
+		sorted[i].index = (UINT)i;
+	}
+
+	RadixSortDraws(sorted.data(), scratch.data(), count);
+}
+
+void DrawQueue::ExecutePacket(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, const DrawPacket& packet)
+{
+	renderContext.SetRasterizerState(packet.rasterizerState);
+	renderContext.SetBlendState(packet.blendState);
+	renderContext.SetDepthStencilState(packet.depthStencilState);
+	packet.drawable->Draw(deviceResources, renderContext, packet.item);
+}
+
+void DrawQueue::Execute(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, ThreadPool* pool)
+{
+	size_t count = sorted.size();
+	size_t listCount = pool != nullptr ? std::min((size_t)pool->GetThreadCount(), count / std::max(minPacketsPerList, 1u)) : 0;
+	if (listCount < 2)
+	{
+		for (const DrawSortEntry& entry : sorted)
+			ExecutePacket(deviceResources, renderContext, packets[entry.index]);
+		return;
+	}
+
+	// Each list gets a run of the sorted packets, replaying the lists one after the other keeps their order
+	if (commandLists.size() < listCount)
+		commandLists.resize(listCount);
+
+	pool->ParallelFor((int)listCount, 1, [&](int begin, int end) {
+		for (int l = begin; l < end; l++)
+		{
+			CommandList& list = commandLists[l];
+			list.Clear();
+			for (size_t i = count * l / listCount; i < count * (l + 1) / listCount; i++)
+				ExecutePacket(deviceResources, list, packets[sorted[i].index]);
+		}
+	});
+
+	for (size_t l = 0; l < listCount; l++)
+		commandLists[l].Replay(renderContext);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "RenderContext.h"
+#include "CommandList.h"
+#include "ThreadPool.h"
+#include <unordered_map>
+#include <vector>
+
+namespace DirectX
+{
+	class CommonStates;
+}
+
+namespace Ocean
+{
+	class DrawQueue;
+
+	// Something drawn through the queue. SubmitDraws adds its packets every frame, Draw is called back with the item
+	// of each packet once they are sorted. Draw may run on worker threads, for several items at once, so it should
+	// only read the object and bind through renderContext.
+	class IDrawable
+	{
+	public:
+		virtual ~IDrawable() { }
+
+		virtual void SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states) = 0;
+		virtual void Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item) = 0;
+	};
+
+	// Passes run one after the other, the scene is the only one so far
+	enum DrawPass
+	{
+		ScenePass
+	};
+
+	// Opaque draws go front to back, transparent ones after them back to front
+	enum DrawLayer
+	{
+		OpaqueLayer,
+		TransparentLayer
+	};
+
+	// One draw call and the pipeline states it needs, the rest is bound by the drawable
+	struct DrawPacket
+	{
+		UINT64 key;
+		ID3D11RasterizerState* rasterizerState;
+		ID3D11BlendState* blendState;
+		ID3D11DepthStencilState* depthStencilState;
+		IDrawable* drawable;
+		UINT item;
+	};
+
+	// A packet's key and its place in the queue, what the sort moves around
+	struct DrawSortEntry
+	{
+		UINT64 key;
+		UINT index;
+	};
+
+	// Stable LSD radix sort on the keys, a byte per pass. scratch holds count entries as well.
+	void RadixSortDraws(DrawSortEntry* entries, DrawSortEntry* scratch, size_t count);
+
+	// The draws of a frame, executed in the order of their keys. From the most significant bits down a key holds the
+	// pass, the layer, the depth bucket, then the shader and the material, so draws at the same depth share state.
+	// Packets with the same key keep the order they were submitted in.
+	class DrawQueue
+	{
+	public:
+		DrawQueue();
+
+		// Drops last frame's packets. Depths are bucketed between 0 and farDepth.
+		void BeginFrame(float farDepth);
+		// shader and material only need to tell different objects apart, they are numbered in the order they show up
+		UINT64 MakeKey(DrawPass pass, DrawLayer layer, float depth, const void* shader, const void* material);
+		void Submit(const DrawPacket& packet);
+
+		void Sort();
+		// Sets each packet's states and draws it, Sort first. With a pool and enough packets runs of them are recorded
+		// into command lists on its threads, which are then replayed in order on renderContext.
+		void Execute(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, ThreadPool* pool = nullptr);
+
+		UINT GetPacketCount() const { return (UINT)packets.size(); }
+		// The packets in their sorted order
+		const DrawPacket& GetSortedPacket(UINT i) const { return packets[sorted[i].index]; }
+
+		static const UINT materialBits = 20;
+		static const UINT shaderBits = 16;
+		static const UINT depthBits = 23;
+		static const UINT layerBits = 1;
+		static const UINT passBits = 4;
+
+		// Command lists get at least this many packets, too few for two lists are drawn on the calling thread
+		UINT minPacketsPerList = 64;
+
+	private:
+		UINT GetId(const void* object, UINT bits);
+		void ExecutePacket(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, const DrawPacket& packet);
+
+		float farDepth;
+		std::vector<DrawPacket> packets;
+		std::vector<DrawSortEntry> sorted;
+		std::vector<DrawSortEntry> scratch;
+		std::unordered_map<const void*, UINT> ids;
+		std::vector<CommandList> commandLists;
+	};
+}
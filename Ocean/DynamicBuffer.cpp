@@ -0,0 +1,39 @@
+#include "pch.h"
+#include "DynamicBuffer.h"
+#include "Common\DirectXHelper.h"
+
+using namespace Ocean;
+
+D3DDynamicBuffer::D3DDynamicBuffer(std::shared_ptr<DX::DeviceResources> deviceResources, UINT byteWidth, UINT bindFlags)
+	: deviceResources(deviceResources), capacity(byteWidth)
+{
+	CD3D11_BUFFER_DESC bufferDesc(byteWidth, bindFlags, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDevice()->CreateBuffer(
+			&bufferDesc,
+			nullptr,
+			&buffer
+			)
+		);
+}
+
+void* D3DDynamicBuffer::Map()
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDeviceContext()->Map(
+			buffer.Get(),
+			0,
+			D3D11_MAP_WRITE_DISCARD,
+			0,
+			&mappedResource
+			)
+		);
+
+	return mappedResource.pData;
+}
+
+void D3DDynamicBuffer::Unmap()
+{
+	deviceResources->GetD3DDeviceContext()->Unmap(buffer.Get(), 0);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Common\DeviceResources.h"
+
+namespace Ocean
+{
+	// A buffer whose whole contents are rewritten by the CPU every frame.
+	class IDynamicBuffer
+	{
+	public:
+		virtual ~IDynamicBuffer() { }
+
+		// Discards the previous contents and returns writable memory of GetCapacity() bytes.
+		virtual void* Map() = 0;
+		virtual void Unmap() = 0;
+		virtual UINT GetCapacity() const = 0;
+
+		// The buffer to bind for drawing.
+		virtual ID3D11Buffer* GetBuffer() const = 0;
+	};
+
+	// Dynamic D3D buffer refilled with Map(WRITE_DISCARD), the driver renames the memory for us.
+	class D3DDynamicBuffer : public IDynamicBuffer
+	{
+	public:
+		D3DDynamicBuffer(std::shared_ptr<DX::DeviceResources> deviceResources, UINT byteWidth, UINT bindFlags);
+
+		virtual void* Map();
+		virtual void Unmap();
+		virtual UINT GetCapacity() const { return capacity; }
+		virtual ID3D11Buffer* GetBuffer() const { return buffer.Get(); }
+
+	private:
+		std::shared_ptr<DX::DeviceResources> deviceResources;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		UINT capacity;
+	};
+}
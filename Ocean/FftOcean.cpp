@@ -0,0 +1,318 @@
+#include "pch.h"
+#include "FftOcean.h"
+#include "WaveSpectrum.h"
+#include "ThreadPool.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+using namespace Ocean;
+
+namespace
+{
+	const float pi = 3.14159265358979324f;
+
+	// Columns transformed together, a few cache lines of every row
+	const int columnBlockWidth = 32;
+
+	void ButterflyScalar(float* ar, float* ai, float* br, float* bi, float wr, float wi)
+	{
+		float tr = *br * wr - *bi * wi;
+		float ti = *br * wi + *bi * wr;
+		*br = *ar - tr;
+		*bi = *ai - ti;
+		*ar += tr;
+		*ai += ti;
+	}
+
+#if defined(OCEAN_SIMD_X86)
+	// Four butterflies with their own twiddles
+	void ButterflySse(float* ar, float* ai, float* br, float* bi, __m128 wr, __m128 wi)
+	{
+		__m128 xr = _mm_loadu_ps(ar), xi = _mm_loadu_ps(ai);
+		__m128 yr = _mm_loadu_ps(br), yi = _mm_loadu_ps(bi);
+		__m128 tr = _mm_sub_ps(_mm_mul_ps(yr, wr), _mm_mul_ps(yi, wi));
+		__m128 ti = _mm_add_ps(_mm_mul_ps(yr, wi), _mm_mul_ps(yi, wr));
+		_mm_storeu_ps(ar, _mm_add_ps(xr, tr));
+		_mm_storeu_ps(ai, _mm_add_ps(xi, ti));
+		_mm_storeu_ps(br, _mm_sub_ps(xr, tr));
+		_mm_storeu_ps(bi, _mm_sub_ps(xi, ti));
+	}
+#endif
+
+	void Run(ThreadPool* pool, int count, int grain, const std::function<void(int, int)>& body)
+	{
+		if (pool != nullptr)
+			pool->ParallelFor(count, grain, body);
+		else
+			body(0, count);
+	}
+}
+
+FftOcean::FftOcean(const FftOceanSettings& settings)
+	: size(settings.size), patchLength(settings.patchLength), choppiness(settings.choppiness), maxHeight(0.f), maxDisplacement(0.f)
+{
+	// The SIMD kernels work on four columns or four butterflies of a stage at a time
+	assert(size >= 16 && (size & (size - 1)) == 0);
+
+	log2Size = 0;
+	while ((1 << log2Size) < size)
+		log2Size++;
+
+	int count = size * size;
+	initial.real.resize(count);
+	initial.imaginary.resize(count);
+	initialConjugate.real.resize(count);
+	initialConjugate.imaginary.resize(count);
+	frequency.resize(count);
+	for (Field& field : fields)
+	{
+		field.real.resize(count);
+		field.imaginary.resize(count);
+	}
+	displacement.resize(count * 4);
+	slope.resize(count * 2);
+	rowMaxHeight.resize(size);
+	rowMaxDisplacement.resize(size);
+
+	float windLength = sqrtf(settings.windDirectionX * settings.windDirectionX + settings.windDirectionZ * settings.windDirectionZ);
+	float windX = settings.windDirectionX / windLength, windZ = settings.windDirectionZ / windLength;
+	float deltaK = 2.f * pi / patchLength;
+
+	std::mt19937 random(settings.seed);
+	std::normal_distribution<float> gaussian(0.f, 1.f);
+
+	for (int z = 0; z < size; z++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			int i = z * size + x;
+			float kx = (float)(x - size / 2) * deltaK;
+			float kz = (float)(z - size / 2) * deltaK;
+			float k = sqrtf(kx * kx + kz * kz);
+			frequency[i] = DeepWaterFrequency(k);
+
+			// Variance of the wave's complex amplitude
+			float variance = 0.f;
+			if (settings.spectrum == OceanSpectrum::Phillips)
+			{
+				variance = PhillipsSpectrum(kx, kz, settings.windSpeed, windX, windZ, settings.phillipsAmplitude);
+			}
+			else if (k > 0.f)
+			{
+				// S(omega) to the energy of this cell of wave vectors: d omega / dk = g / (2 omega), polar area k dk dtheta
+				float omega = frequency[i];
+				float theta = atan2f(kx * windZ - kz * windX, kx * windX + kz * windZ);
+				float density = JonswapSpectrum(omega, settings.windSpeed, settings.fetch) * gravity / (2.f * omega) / k * DirectionalSpreading(theta);
+				variance = density * deltaK * deltaK * 0.5f;
+			}
+
+			// The Nyquist row and column have no partner at -k, leaving them out keeps the outputs real
+			if (x == 0 || z == 0)
+				variance = 0.f;
+
+			float amplitude = sqrtf(variance * 0.5f);
+			initial.real[i] = gaussian(random) * amplitude;
+			initial.imaginary[i] = gaussian(random) * amplitude;
+		}
+	}
+
+	for (int z = 0; z < size; z++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			int mirrored = ((size - z) % size) * size + (size - x) % size;
+			initialConjugate.real[z * size + x] = initial.real[mirrored];
+			initialConjugate.imaginary[z * size + x] = -initial.imaginary[mirrored];
+		}
+	}
+
+	// Inverse transform, so the twiddles turn the positive way
+	twiddleReal.resize(size);
+	twiddleImaginary.resize(size);
+	for (int half = 1; half < size; half *= 2)
+	{
+		for (int j = 0; j < half; j++)
+		{
+			twiddleReal[half + j] = cosf(pi * (float)j / (float)half);
+			twiddleImaginary[half + j] = sinf(pi * (float)j / (float)half);
+		}
+	}
+
+	bitReverse.resize(size);
+	for (int i = 0; i < size; i++)
+	{
+		unsigned int reversed = 0;
+		for (int bit = 0; bit < log2Size; bit++)
+			reversed |= ((i >> bit) & 1) << (log2Size - 1 - bit);
+		bitReverse[i] = reversed;
+	}
+}
+
+void FftOcean::Update(float time, ThreadPool* pool)
+{
+	Run(pool, size, 8, [&](int begin, int end) { AnimateSpectrum(time, begin, end); });
+
+	Run(pool, 3 * size, 16, [&](int begin, int end)
+	{
+		for (int row = begin; row < end; row++)
+			TransformRows(fields[row / size], row % size, row % size + 1);
+	});
+
+	int blocksAcross = size / std::min(size, columnBlockWidth);
+	Run(pool, 3 * blocksAcross, 1, [&](int begin, int end)
+	{
+		for (int block = begin; block < end; block++)
+		{
+			int firstColumn = (block % blocksAcross) * columnBlockWidth;
+			TransformColumns(fields[block / blocksAcross], firstColumn, std::min(firstColumn + columnBlockWidth, size));
+		}
+	});
+
+	Run(pool, size, 8, [&](int begin, int end) { ResolveRows(begin, end); });
+
+	maxHeight = *std::max_element(rowMaxHeight.begin(), rowMaxHeight.end());
+	maxDisplacement = *std::max_element(rowMaxDisplacement.begin(), rowMaxDisplacement.end());
+}
+
+void FftOcean::AnimateSpectrum(float time, int firstRow, int endRow)
+{
+	float deltaK = 2.f * pi / patchLength;
+	for (int z = firstRow; z < endRow; z++)
+	{
+		float kz = (float)(z - size / 2) * deltaK;
+		for (int x = 0; x < size; x++)
+		{
+			int i = z * size + x;
+			float kx = (float)(x - size / 2) * deltaK;
+			float k = sqrtf(kx * kx + kz * kz);
+
+			// h(k, t) = h0(k) e^(i omega t) + conj(h0(-k)) e^(-i omega t)
+			float c = cosf(frequency[i] * time), s = sinf(frequency[i] * time);
+			float hr = initial.real[i] * c - initial.imaginary[i] * s + initialConjugate.real[i] * c + initialConjugate.imaginary[i] * s;
+			float hi = initial.real[i] * s + initial.imaginary[i] * c + initialConjugate.imaginary[i] * c - initialConjugate.real[i] * s;
+
+			// Displacement -i k/|k| h, slope i k h
+			float nx = k > 0.f ? kx / k : 0.f, nz = k > 0.f ? kz / k : 0.f;
+			float dxr = nx * hi, dxi = -nx * hr;
+			float dzr = nz * hi, dzi = -nz * hr;
+			float sxr = -kx * hi, sxi = kx * hr;
+			float szr = -kz * hi, szi = kz * hr;
+
+			// Two real results share one complex transform, a + i b
+			fields[0].real[i] = hr - dxi;
+			fields[0].imaginary[i] = hi + dxr;
+			fields[1].real[i] = dzr - sxi;
+			fields[1].imaginary[i] = dzi + sxr;
+			fields[2].real[i] = szr;
+			fields[2].imaginary[i] = szi;
+		}
+	}
+}
+
+void FftOcean::TransformRows(Field& field, int firstRow, int endRow) const
+{
+	for (int row = firstRow; row < endRow; row++)
+	{
+		float* re = &field.real[row * size];
+		float* im = &field.imaginary[row * size];
+
+		for (int i = 0; i < size; i++)
+		{
+			int j = (int)bitReverse[i];
+			if (i < j)
+			{
+				std::swap(re[i], re[j]);
+				std::swap(im[i], im[j]);
+			}
+		}
+
+		for (int half = 1; half < size; half *= 2)
+		{
+			for (int start = 0; start < size; start += 2 * half)
+			{
+				int j = 0;
+#if defined(OCEAN_SIMD_X86)
+				for (; j + 4 <= half; j += 4)
+				{
+					ButterflySse(re + start + j, im + start + j, re + start + j + half, im + start + j + half,
+						_mm_loadu_ps(&twiddleReal[half + j]), _mm_loadu_ps(&twiddleImaginary[half + j]));
+				}
+#endif
+				for (; j < half; j++)
+				{
+					ButterflyScalar(re + start + j, im + start + j, re + start + j + half, im + start + j + half,
+						twiddleReal[half + j], twiddleImaginary[half + j]);
+				}
+			}
+		}
+	}
+}
+
+void FftOcean::TransformColumns(Field& field, int firstColumn, int endColumn) const
+{
+	float* re = field.real.data();
+	float* im = field.imaginary.data();
+
+	for (int i = 0; i < size; i++)
+	{
+		int j = (int)bitReverse[i];
+		if (i < j)
+		{
+			std::swap_ranges(re + i * size + firstColumn, re + i * size + endColumn, re + j * size + firstColumn);
+			std::swap_ranges(im + i * size + firstColumn, im + i * size + endColumn, im + j * size + firstColumn);
+		}
+	}
+
+	// Every butterfly of a column stage uses one twiddle for the whole row segment
+	for (int half = 1; half < size; half *= 2)
+	{
+		for (int start = 0; start < size; start += 2 * half)
+		{
+			for (int j = 0; j < half; j++)
+			{
+				int a = (start + j) * size, b = (start + j + half) * size;
+				float wr = twiddleReal[half + j], wi = twiddleImaginary[half + j];
+
+				int column = firstColumn;
+#if defined(OCEAN_SIMD_X86)
+				__m128 wr4 = _mm_set1_ps(wr), wi4 = _mm_set1_ps(wi);
+				for (; column + 4 <= endColumn; column += 4)
+					ButterflySse(re + a + column, im + a + column, re + b + column, im + b + column, wr4, wi4);
+#endif
+				for (; column < endColumn; column++)
+					ButterflyScalar(re + a + column, im + a + column, re + b + column, im + b + column, wr, wi);
+			}
+		}
+	}
+}
+
+void FftOcean::ResolveRows(int firstRow, int endRow)
+{
+	for (int z = firstRow; z < endRow; z++)
+	{
+		float rowHeight = 0.f, rowDisplacement = 0.f;
+		for (int x = 0; x < size; x++)
+		{
+			int i = z * size + x;
+
+			// The wave vectors start at -size / 2 instead of 0, which flips the sign of every other result
+			float sign = ((x + z) & 1) ? -1.f : 1.f;
+			float height = fields[0].real[i] * sign;
+			float displacementX = fields[0].imaginary[i] * sign * choppiness;
+			float displacementZ = fields[1].real[i] * sign * choppiness;
+			displacement[i * 4 + 0] = displacementX;
+			displacement[i * 4 + 1] = height;
+			displacement[i * 4 + 2] = displacementZ;
+			displacement[i * 4 + 3] = 0.f;
+			slope[i * 2 + 0] = fields[1].imaginary[i] * sign;
+			slope[i * 2 + 1] = fields[2].real[i] * sign;
+			rowHeight = std::max(rowHeight, fabsf(height));
+			rowDisplacement = std::max(rowDisplacement, sqrtf(displacementX * displacementX + displacementZ * displacementZ));
+		}
+		rowMaxHeight[z] = rowHeight;
+		rowMaxDisplacement[z] = rowDisplacement;
+	}
+}
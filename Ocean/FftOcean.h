@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+
+namespace Ocean
+{
+	class ThreadPool;
+
+	enum OceanSpectrum
+	{
+		Phillips,
+		Jonswap
+	};
+
+	struct FftOceanSettings
+	{
+		// Grid points along each side, a power of two
+		int size;
+		// Side of the square the grid covers, the simulated sea repeats after it
+		float patchLength;
+		float windSpeed;
+		float windDirectionX;
+		float windDirectionZ;
+		OceanSpectrum spectrum;
+		// Scales the Phillips spectrum
+		float phillipsAmplitude;
+		// Open water the wind blows over for JONSWAP, in the units of patchLength
+		float fetch;
+		// How far the horizontal displacement pulls the crests together, 0 gives round waves
+		float choppiness;
+		unsigned int seed;
+	};
+
+	// Statistical ocean simulation after Tessendorf's "Simulating Ocean Water".
+	// The spectrum is sampled once, every Update then animates it and runs three complex inverse FFTs
+	// (height and x displacement, z displacement and x slope, z slope) for a periodic patch of sea.
+	// The FFTs are radix 2 with SSE butterflies, split into rows and column blocks over the thread pool.
+	// Only depends on the standard library.
+	class FftOcean
+	{
+	public:
+		FftOcean(const FftOceanSettings& settings);
+
+		// pool can be null to run on the calling thread only
+		void Update(float time, ThreadPool* pool);
+
+		int GetSize() const { return size; }
+		float GetPatchLength() const { return patchLength; }
+
+		// size * size texels each, row z of the patch starts at z * size.
+		// Displacement is x, height, z and 0 for a float4 texture, slope is dh/dx and dh/dz for a float2 one.
+		const float* GetDisplacement() const { return displacement.data(); }
+		const float* GetSlope() const { return slope.data(); }
+
+		// How far the last Update moved any point up or down and sideways, for culling
+		float GetMaxHeight() const { return maxHeight; }
+		float GetMaxDisplacement() const { return maxDisplacement; }
+
+	private:
+		// A complex field as separate real and imaginary planes
+		struct Field
+		{
+			std::vector<float> real;
+			std::vector<float> imaginary;
+		};
+
+		void AnimateSpectrum(float time, int firstRow, int endRow);
+		void TransformRows(Field& field, int firstRow, int endRow) const;
+		void TransformColumns(Field& field, int firstColumn, int endColumn) const;
+		void ResolveRows(int firstRow, int endRow);
+
+		int size;
+		int log2Size;
+		float patchLength;
+		float choppiness;
+
+		// h0(k) and conj(h0(-k)), and the angular frequency of every wave vector
+		Field initial;
+		Field initialConjugate;
+		std::vector<float> frequency;
+
+		// Twiddles of the stage with half length h are at [h, 2h)
+		std::vector<float> twiddleReal;
+		std::vector<float> twiddleImaginary;
+		std::vector<unsigned int> bitReverse;
+
+		Field fields[3];
+		std::vector<float> displacement;
+		std::vector<float> slope;
+		std::vector<float> rowMaxHeight;
+		std::vector<float> rowMaxDisplacement;
+		float maxHeight;
+		float maxDisplacement;
+	};
+}
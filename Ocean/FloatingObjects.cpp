@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "FloatingObjects.h"
+#include "Camera.h"
+#include "CommonStates.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace Ocean;
+
+FloatingObjects::FloatingObjects(const GerstnerWaveSet* waveSets, int waveSetCount)
+{
+	simulation = std::shared_ptr<BuoyancySimulation>(new BuoyancySimulation(waveSets, waveSetCount));
+}
+
+void FloatingObjects::SetWaveSets(const GerstnerWaveSet* waveSets, int waveSetCount)
+{
+	simulation->SetWaveSets(waveSets, waveSetCount);
+}
+
+int FloatingObjects::AddSphereMesh(int bands, float radius)
+{
+	MeshBatch batch;
+	batch.mesh = std::shared_ptr<GeneratedMesh>(new GeneratedMesh());
+	batch.mesh->optimizeVertexCache = true;
+	batch.bands = bands;
+	batch.radius = radius;
+	batch.startInstance = 0;
+	batch.instanceCount = 0;
+	batch.nearestDistance = 0.f;
+	meshes.push_back(batch);
+	return (int)meshes.size() - 1;
+}
+
+int FloatingObjects::AddKind(const FloatingBodyKind& kind, int mesh, XMFLOAT4 color)
+{
+	kindMesh.push_back(mesh);
+	kindColor.push_back(color);
+	return simulation->AddKind(kind);
+}
+
+int FloatingObjects::AddObject(int kind, float x, float z, float yaw, float scale)
+{
+	return simulation->AddBody(kind, x, z, yaw, scale);
+}
+
+void FloatingObjects::LoadVertexShader(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	StateObjectCache& stateCache,
+	const std::vector<byte>& vsFileData)
+{
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDevice()->CreateVertexShader(
+			&vsFileData[0],
+			vsFileData.size(),
+			nullptr,
+			&vertexShader
+			)
+		);
+
+	// Mesh vertices in slot 0, per object data in slot 1
+	D3D11_INPUT_ELEMENT_DESC vertexDesc[VertexFormat<VertexPositionNormal>::elementCount + VertexFormat<FloatingObjectInstance>::elementCount];
+	std::copy_n(VertexFormat<VertexPositionNormal>::Elements(), VertexFormat<VertexPositionNormal>::elementCount, vertexDesc);
+	std::copy_n(VertexFormat<FloatingObjectInstance>::Elements(), VertexFormat<FloatingObjectInstance>::elementCount, vertexDesc + VertexFormat<VertexPositionNormal>::elementCount);
+
+	inputLayout = stateCache.GetInputLayout(
+		vertexDesc,
+		ARRAYSIZE(vertexDesc),
+		vsFileData
+		);
+}
+
+void FloatingObjects::LoadPixelShader(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	const std::vector<byte>& psFileData)
+{
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDevice()->CreatePixelShader(
+			&psFileData[0],
+			psFileData.size(),
+			nullptr,
+			&pixelShader
+			)
+		);
+}
+
+void FloatingObjects::LoadMeshes(
+	std::shared_ptr<DX::DeviceResources> deviceResources)
+{
+	for (MeshBatch& batch : meshes)
+		batch.mesh->GenerateSphereMesh(deviceResources, batch.bands, batch.bands, batch.radius);
+}
+
+void FloatingObjects::Update(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	std::shared_ptr<Camera> camera,
+	float totalTime,
+	float elapsedSeconds,
+	ThreadPool* pool)
+{
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, camera->getEye());
+
+	// Fixed steps keep the integration stable whatever the frame rate, the last one ends at totalTime
+	leftOverSeconds += elapsedSeconds;
+	int steps = 0;
+	while (leftOverSeconds >= stepSeconds && steps < maxStepsPerUpdate)
+	{
+		leftOverSeconds -= stepSeconds;
+		simulation->Step(stepSeconds, totalTime - leftOverSeconds, eye.x, eye.y, eye.z, pool);
+		steps++;
+	}
+
+	// Falling behind drops time instead of running ever more steps
+	if (steps == maxStepsPerUpdate)
+		leftOverSeconds = std::min(leftOverSeconds, stepSeconds);
+
+	// The camera moves even when the objects don't, the meshes are ordered by their nearest object
+	for (MeshBatch& batch : meshes)
+		batch.nearestDistance = FLT_MAX;
+	for (int kind = 0; kind < simulation->GetKindCount(); kind++)
+	{
+		MeshBatch& batch = meshes[kindMesh[kind]];
+		const float* source = simulation->GetInstances() + simulation->GetInstanceStart(kind) * BuoyancySimulation::floatsPerInstance;
+		for (int i = 0; i < simulation->GetInstanceCount(kind); i++, source += BuoyancySimulation::floatsPerInstance)
+		{
+			float dx = source[0] - eye.x, dy = source[1] - eye.y, dz = source[2] - eye.z;
+			batch.nearestDistance = std::min(batch.nearestDistance, sqrtf(dx * dx + dy * dy + dz * dz));
+		}
+	}
+
+	int objectCount = simulation->GetBodyCount();
+	if (objectCount == 0 || (steps == 0 && instanceBuffer != nullptr))
+		return;
+
+	UINT byteWidth = sizeof(FloatingObjectInstance) * objectCount;
+	if (instanceBuffer == nullptr || instanceBuffer->GetCapacity() < byteWidth)
+		instanceBuffer = std::shared_ptr<IDynamicBuffer>(new D3DDynamicBuffer(deviceResources, byteWidth, D3D11_BIND_VERTEX_BUFFER));
+
+	// The simulation keeps the objects of a kind together, the kinds of a mesh are put next to each other here
+	static_assert(BuoyancySimulation::floatsPerInstance == 8, "The instances are copied as position, scale and rotation");
+	FloatingObjectInstance* instances = (FloatingObjectInstance*)instanceBuffer->Map();
+	UINT instanceCount = 0;
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		meshes[m].startInstance = instanceCount;
+		for (int kind = 0; kind < simulation->GetKindCount(); kind++)
+		{
+			if (kindMesh[kind] != (int)m)
+				continue;
+
+			const float* source = simulation->GetInstances() + simulation->GetInstanceStart(kind) * BuoyancySimulation::floatsPerInstance;
+			for (int i = 0; i < simulation->GetInstanceCount(kind); i++, source += BuoyancySimulation::floatsPerInstance)
+			{
+				FloatingObjectInstance& instance = instances[instanceCount++];
+				instance.positionScale = XMFLOAT4(source[0], source[1], source[2], source[3]);
+				instance.rotation = XMFLOAT4(source[4], source[5], source[6], source[7]);
+				instance.color = kindColor[kind];
+			}
+		}
+		meshes[m].instanceCount = instanceCount - meshes[m].startInstance;
+	}
+	instanceBuffer->Unmap();
+}
+
+void FloatingObjects::SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states)
+{
+	if (instanceBuffer == nullptr)
+		return;
+
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		const MeshBatch& batch = meshes[m];
+		if (batch.instanceCount == 0 || batch.mesh->indexCount <= 0)
+			continue;
+
+		DrawPacket packet;
+		packet.key = queue.MakeKey(ScenePass, OpaqueLayer, batch.nearestDistance, pixelShader.Get(), batch.mesh.get());
+		packet.rasterizerState = states.CullCounterClockwise();
+		packet.blendState = states.Opaque();
+		packet.depthStencilState = states.DepthDefault();
+		packet.drawable = this;
+		packet.item = (UINT)m;
+		queue.Submit(packet);
+	}
+}
+
+void FloatingObjects::Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item)
+{
+	// Instancing needs feature level 9_3
+	if (instanceBuffer == nullptr || deviceResources->GetDeviceFeatureLevel() < D3D_FEATURE_LEVEL_9_3)
+		return;
+
+	renderContext.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	renderContext.SetInputLayout(inputLayout.Get());
+
+	// Camera and light come from the frame's constants, everything else from the instances
+	renderContext.SetVertexShader(vertexShader.Get());
+	renderContext.SetPixelShader(pixelShader.Get());
+
+	// The objects of the packet's mesh in one instanced call
+	const MeshBatch& batch = meshes[item];
+	ID3D11Buffer* vertexBuffers[] = { batch.mesh->vertexBuffer.Get(), instanceBuffer->GetBuffer() };
+	UINT strides[] = { batch.mesh->vertexStride, VertexFormat<FloatingObjectInstance>::stride };
+	UINT offsets[] = { 0, 0 };
+	renderContext.SetVertexBuffers(
+		0,
+		2,
+		vertexBuffers,
+		strides,
+		offsets
+		);
+
+	renderContext.SetIndexBuffer(
+		batch.mesh->indexBuffer.Get(),
+		DXGI_FORMAT_R32_UINT,
+		0
+		);
+
+	renderContext.DrawIndexedInstanced(
+		batch.mesh->indexCount,
+		batch.instanceCount,
+		0,
+		0,
+		batch.startInstance
+		);
+}
+
+FloatingObjects::~FloatingObjects()
+{
+	vertexShader.Reset();
+	pixelShader.Reset();
+	inputLayout.Reset();
+}
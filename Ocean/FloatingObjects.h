@@ -0,0 +1,79 @@
+#pragma once
+#include "GeneratedMesh.h"
+#include "DynamicBuffer.h"
+#include "RenderContext.h"
+#include "DrawQueue.h"
+#include "StateObjectCache.h"
+#include "BuoyancySimulation.h"
+#include "ThreadPool.h"
+#include <vector>
+
+namespace Ocean
+{
+	// Buoys, debris and markers riding the Gerstner waves. BuoyancySimulation moves them, and all objects whose kinds
+	// share a mesh are drawn with one instanced call.
+	class FloatingObjects : public IDrawable
+	{
+	public:
+		FloatingObjects(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		// The objects follow the same waves as the water, call it whenever the water's sets change
+		void SetWaveSets(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		// Spheres of bands latitude and longitude bands, generated in LoadMeshes. Kinds refer to them by index.
+		int AddSphereMesh(int bands, float radius);
+		int AddKind(const FloatingBodyKind& kind, int mesh, XMFLOAT4 color);
+		int AddObject(int kind, float x, float z, float yaw, float scale);
+		int GetObjectCount() const { return simulation->GetBodyCount(); }
+
+		void LoadVertexShader(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
+			const std::vector<byte>& vsFileData);
+		void LoadPixelShader(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			const std::vector<byte>& psFileData);
+		void LoadMeshes(
+			std::shared_ptr<DX::DeviceResources> deviceResources);
+		// Runs the fixed steps that fit into elapsedSeconds at the water's time and refills the instance buffer
+		void Update(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			std::shared_ptr<Camera> camera,
+			float totalTime,
+			float elapsedSeconds,
+			ThreadPool* pool);
+		// A draw per mesh, nearest first
+		virtual void SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states);
+		virtual void Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item);
+
+		~FloatingObjects();
+
+		float stepSeconds = 1.f / 60.f;
+		int maxStepsPerUpdate = 4;
+
+	protected:
+		struct MeshBatch
+		{
+			std::shared_ptr<GeneratedMesh> mesh;
+			int bands;
+			float radius;
+			// Instances drawn with the mesh, the kinds using it are next to each other in the instance buffer
+			UINT startInstance;
+			UINT instanceCount;
+			// From the camera to the closest of them, updated every frame
+			float nearestDistance;
+		};
+
+		std::shared_ptr<BuoyancySimulation> simulation;
+		std::vector<MeshBatch> meshes;
+		std::vector<int> kindMesh;
+		std::vector<XMFLOAT4> kindColor;
+		float leftOverSeconds = 0.f;
+
+		std::shared_ptr<IDynamicBuffer> instanceBuffer;
+
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>         vertexShader;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>          pixelShader;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>          inputLayout;
+	};
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "Frustum.h"
+#include "CpuFeatures.h"
+
+using namespace Ocean;
+
+Frustum::Frustum() { }
+
+Frustum::Frustum(FXMMATRIX viewProjection)
+{
+	// The columns of the matrix, points are transformed as row vectors
+	XMMATRIX columns = XMMatrixTranspose(viewProjection);
+
+	XMStoreFloat4(&planes[0], XMPlaneNormalize(columns.r[3] + columns.r[0]));	// left
+	XMStoreFloat4(&planes[1], XMPlaneNormalize(columns.r[3] - columns.r[0]));	// right
+	XMStoreFloat4(&planes[2], XMPlaneNormalize(columns.r[3] + columns.r[1]));	// bottom
+	XMStoreFloat4(&planes[3], XMPlaneNormalize(columns.r[3] - columns.r[1]));	// top
+	XMStoreFloat4(&planes[4], XMPlaneNormalize(columns.r[2]));					// near, z goes from 0 to w
+	XMStoreFloat4(&planes[5], XMPlaneNormalize(columns.r[3] - columns.r[2]));	// far
+}
+
+Frustum Frustum::FromCamera(std::shared_ptr<Camera> camera)
+{
+	// The camera hands out transposed matrices for the shaders
+	return Frustum(XMMatrixTranspose(camera->getView()) * XMMatrixTranspose(camera->getProjection()));
+}
+
+bool Frustum::IntersectsBox(const XMFLOAT3& center, const XMFLOAT3& extents) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& plane = planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = extents.x * fabsf(plane.x) + extents.y * fabsf(plane.y) + extents.z * fabsf(plane.z);
+		if (distance + radius < 0.f)
+			return false;
+	}
+
+	return true;
+}
+
+int Frustum::CullBoxes(
+	const float* centerX, const float* centerY, const float* centerZ,
+	const float* extentX, const float* extentY, const float* extentZ,
+	int count, unsigned int* visible) const
+{
+	int visibleCount = 0;
+	int i = 0;
+
+#if defined(OCEAN_SIMD_X86)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	__m128 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+		absPlaneX[p] = _mm_set1_ps(fabsf(planes[p].x));
+		absPlaneY[p] = _mm_set1_ps(fabsf(planes[p].y));
+		absPlaneZ[p] = _mm_set1_ps(fabsf(planes[p].z));
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(centerX + i), cy = _mm_loadu_ps(centerY + i), cz = _mm_loadu_ps(centerZ + i);
+		__m128 ex = _mm_loadu_ps(extentX + i), ey = _mm_loadu_ps(extentY + i), ez = _mm_loadu_ps(extentZ + i);
+
+		// A lane goes to zero as soon as its box is completely behind one of the planes
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(absPlaneX[p], ex), _mm_mul_ps(absPlaneY[p], ey)),
+				_mm_mul_ps(absPlaneZ[p], ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; k++)
+		{
+			if (mask & (1 << k))
+				visible[visibleCount++] = i + k;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		if (IntersectsBox(XMFLOAT3(centerX[i], centerY[i], centerZ[i]), XMFLOAT3(extentX[i], extentY[i], extentZ[i])))
+			visible[visibleCount++] = i;
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "Camera.h"
+
+namespace Ocean
+{
+	// The six planes of a view frustum, pointing inwards.
+	class Frustum
+	{
+	public:
+		Frustum();
+		// Takes a row-major (not transposed) view * projection matrix
+		Frustum(FXMMATRIX viewProjection);
+		static Frustum FromCamera(std::shared_ptr<Camera> camera);
+
+		// Conservative test, boxes near the frustum's corners may pass without actually intersecting it
+		bool IntersectsBox(const XMFLOAT3& center, const XMFLOAT3& extents) const;
+
+		// The same test for count boxes in structure-of-arrays form, four at a time with SSE.
+		// Writes the indices of the boxes that pass into visible and returns how many there are.
+		int CullBoxes(
+			const float* centerX, const float* centerY, const float* centerZ,
+			const float* extentX, const float* extentY, const float* extentZ,
+			int count, unsigned int* visible) const;
+
+		XMFLOAT4 planes[6];
+	};
+}
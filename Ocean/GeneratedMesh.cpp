@@ -1,18 +1,33 @@
 #include "pch.h"
 #include "GeneratedMesh.h"
+#include "ProjectedGridKernel.h"
+#include <cassert>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
 
 using namespace Ocean;
 
-GeneratedMesh::GeneratedMesh() { }
+GeneratedMesh::GeneratedMesh()
+	: indexCount(0), vertexCount(0), optimizeVertexCache(false),
+	vertexEncoding(VertexEncoding::PositionNormal), vertexStride(VertexFormat<VertexPositionNormal>::stride), positionDecode(1.f, 1.f, 0.f, 0.f),
+	keepPlanePositions(false)
+{ }
 
 void GeneratedMesh::GenerateSphereMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int latitudeBands, int longitudeBands, float radius)
 {
 	float PI;
 	XMStoreFloat(&PI, g_XMPi);
 
-	std::vector<VertexPositionNormal> verticesVector;
-	std::vector<unsigned int> indicesVector;
+	sections.clear();
 
+	UINT sphereVertexCount = (latitudeBands + 1) * (longitudeBands + 1);
+	UINT sphereIndexCount = latitudeBands * longitudeBands * 2 * 3;
+	scratch.Reset(ScratchArena::SizeOf<VertexPositionNormal>(sphereVertexCount) + ScratchArena::SizeOf<unsigned int>(sphereIndexCount) + GetOptimizationScratchSize(sphereVertexCount));
+	VertexPositionNormal* vertices = scratch.Allocate<VertexPositionNormal>(sphereVertexCount);
+	unsigned int* indices = scratch.Allocate<unsigned int>(sphereIndexCount);
+
+	int vertexIndex = 0;
 	for (int latNumber = 0; latNumber <= latitudeBands; latNumber++) {
 		float theta = (float)latNumber * PI / (float)latitudeBands;
 		float sinTheta = sin(theta);
@@ -31,63 +46,44 @@ void GeneratedMesh::GenerateSphereMesh(std::shared_ptr<DX::DeviceResources> devi
 			//vs.tangent = XMFLOAT3();
 			//vs.binormal = XMFLOAT3();
 
-			verticesVector.push_back(vs);
+			vertices[vertexIndex++] = vs;
 		}
 	}
 
+	int index = 0;
 	for (int latNumber = 0; latNumber < latitudeBands; latNumber++) {
 		for (int longNumber = 0; longNumber < longitudeBands; longNumber++) {
 			unsigned int first = (latNumber * (longitudeBands + 1)) + longNumber;
 			unsigned int second = first + longitudeBands + 1;
 
-			indicesVector.push_back(first);
-			indicesVector.push_back(second);
-			indicesVector.push_back(first + 1);
-
-			indicesVector.push_back(second);
-			indicesVector.push_back(second + 1);
-			indicesVector.push_back(first + 1);
+			indices[index++] = first;
+			indices[index++] = second;
+			indices[index++] = first + 1;
 
+			indices[index++] = second;
+			indices[index++] = second + 1;
+			indices[index++] = first + 1;
 		}
 	}
 
-	VertexPositionNormal* vertices = &verticesVector[0];
-	unsigned int* indices = &indicesVector[0];
-
-
-	D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-	vertexBufferData.pSysMem = vertices;
-	vertexBufferData.SysMemPitch = 0;
-	vertexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionNormal) * verticesVector.size(), D3D11_BIND_VERTEX_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&vertexBufferDesc,
-			&vertexBufferData,
-			&vertexBuffer
-			)
-		);
-
-	indexCount = indicesVector.size();
+	if (optimizeVertexCache)
+		OptimizeVertexCache(vertices, sphereVertexCount, indices, sphereIndexCount);
 
-	D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-	indexBufferData.pSysMem = indices;
-	indexBufferData.SysMemPitch = 0;
-	indexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * indicesVector.size(), D3D11_BIND_INDEX_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&indexBufferDesc,
-			&indexBufferData,
-			&indexBuffer
-			)
-		);
+	CreateBuffers(deviceResources, vertices, sphereVertexCount, indices, sphereIndexCount);
 }
 
 void GeneratedMesh::GenerateSimpleGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int width, int height, float stride)
 {
+	sections.clear();
+
 	UINT vbSize = (width + 1) * (height + 1);
-	VertexPositionNormal* planeVertices = new VertexPositionNormal[vbSize];
+	UINT gridIndexCount = width * height * 2 * 3;
+	if (optimizeVertexCache)
+		scratch.Reset(ScratchArena::SizeOf<VertexPositionNormal>(vbSize) + ScratchArena::SizeOf<unsigned int>(gridIndexCount) + GetOptimizationScratchSize(vbSize));
+	else
+		scratch.Reset(ScratchArena::SizeOf<VertexPositionNormal>(vbSize));
+	VertexPositionNormal* planeVertices = scratch.Allocate<VertexPositionNormal>(vbSize);
+
 	XMFLOAT3 topLeftCorner(-width * stride / 2.f, 0, -height * stride / 2.f);
 	for (int z = 0; z < height + 1; z++)
 	{
@@ -104,59 +100,39 @@ void GeneratedMesh::GenerateSimpleGridMesh(std::shared_ptr<DX::DeviceResources>
 		}
 	}
 
-	D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-	vertexBufferData.pSysMem = planeVertices;
-	vertexBufferData.SysMemPitch = 0;
-	vertexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionNormal) * vbSize, D3D11_BIND_VERTEX_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&vertexBufferDesc,
-			&vertexBufferData,
-			&vertexBuffer
-			)
-		);
-
-	indexCount = width * height * 2 * 3;
-	unsigned int* planeIndices = new unsigned int[indexCount];
-	for (int z = 0; z < height; z++)
+	GridTopology topology = { width, height, GridWinding::Clockwise };
+	if (optimizeVertexCache)
 	{
-		for (int x = 0; x < width; x++)
-		{
-			planeIndices[(z*width + x) * 6] = z * (width + 1) + x;
-			planeIndices[(z*width + x) * 6 + 1] = z * (width + 1) + x + 1;
-			planeIndices[(z*width + x) * 6 + 2] = (z + 1) * (width + 1) + x;
-
-			planeIndices[(z*width + x) * 6 + 3] = (z + 1) * (width + 1) + x + 1;
-			planeIndices[(z*width + x) * 6 + 4] = (z + 1) * (width + 1) + x;
-			planeIndices[(z*width + x) * 6 + 5] = z * (width + 1) + x + 1;
-		}
+		// The optimized indices only fit these vertices, the shared grid index buffer can't be used
+		unsigned int* planeIndices = scratch.Allocate<unsigned int>(gridIndexCount);
+		WriteGridIndices(planeIndices, topology);
+		OptimizeVertexCache(planeVertices, vbSize, planeIndices, gridIndexCount);
+		CreateBuffers(deviceResources, planeVertices, vbSize, planeIndices, gridIndexCount);
+		return;
 	}
 
-	D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-	indexBufferData.pSysMem = planeIndices;
-	indexBufferData.SysMemPitch = 0;
-	indexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * indexCount, D3D11_BIND_INDEX_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&indexBufferDesc,
-			&indexBufferData,
-			&indexBuffer
-			)
-		);
+	CreateVertexBuffer(deviceResources, planeVertices, vbSize);
+	vertexCount = vbSize;
+	indexCount = gridIndexCount;
+	indexBuffer = GetGridIndexBuffer(deviceResources, topology);
 }
 
-void GeneratedMesh::GeneratePolarGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int rads, int angs, float radius)
+void GeneratedMesh::GeneratePolarGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int rads, int angs, float radius, int wedges, int radialBands)
 {
-	std::vector<VertexPositionNormal> verticesVector;
-	std::vector<unsigned int> indicesVector;
-
-	float epsilon = 0.001f;
-	for (float rad = 0.0f; rad < radius + epsilon; rad += radius / (float)rads)
+	UINT polarVertexCount = (rads + 1) * (angs + 1);
+	UINT polarIndexCount = rads * angs * 2 * 3;
+	scratch.Reset(ScratchArena::SizeOf<VertexPositionNormal>(polarVertexCount) + ScratchArena::SizeOf<unsigned int>(polarIndexCount) + GetOptimizationScratchSize(polarVertexCount));
+	VertexPositionNormal* vertices = scratch.Allocate<VertexPositionNormal>(polarVertexCount);
+	unsigned int* indices = scratch.Allocate<unsigned int>(polarIndexCount);
+
+	int vertexIndex = 0;
+	for (int radNumber = 0; radNumber <= rads; radNumber++)
 	{
-		for (float angle = 0.0f; angle < 2.0f * XM_PI + epsilon; angle += (2.0f * XM_PI) / angs)
+		float rad = radius * (float)radNumber / (float)rads;
+		for (int angNumber = 0; angNumber <= angs; angNumber++)
 		{
+			float angle = 2.0f * XM_PI * (float)angNumber / (float)angs;
+
 			VertexPositionNormal vertex;
 			vertex.position = XMFLOAT3(rad * cosf(angle), 0, rad * sinf(angle));
 			vertex.normal = XMFLOAT3(0, 1, 0);
@@ -164,139 +140,371 @@ void GeneratedMesh::GeneratePolarGridMesh(std::shared_ptr<DX::DeviceResources> d
 			//vertex.tangent = XMFLOAT3(1, 0, 0);
 			//vertex.binormal = XMFLOAT3(0, 0, 1);
 
-			verticesVector.push_back(vertex);
+			vertices[vertexIndex++] = vertex;
 		}
 	}
 
-	for (int radNumber = 0; radNumber < rads; radNumber++) 
+	// Band by band and wedge by wedge inside a band, so every section is a contiguous range of indices
+	// and the visible wedges of a band are mostly one range. Bands get four times wider going outwards,
+	// every wedge touches the centre so the inner band is there to keep the rest of the wedge cullable.
+	int index = 0;
+	sections.clear();
+	for (int band = 0; band < radialBands; band++)
 	{
-		for (int angNumber = 0; angNumber < angs; angNumber++) 
+		int firstRad = band == 0 ? 0 : rads >> (2 * (radialBands - band));
+		int lastRad = rads >> (2 * (radialBands - 1 - band));
+		if (lastRad <= firstRad)
+			continue;
+
+		for (int wedge = 0; wedge < wedges; wedge++)
 		{
-			unsigned int first = (radNumber * (angs + 1)) + angNumber;
-			unsigned int second = first + angs + 1;
+			int firstAng = wedge * angs / wedges;
+			int lastAng = (wedge + 1) * angs / wedges;
 
-			indicesVector.push_back(first);
-			indicesVector.push_back(second);
-			indicesVector.push_back(first + 1);
+			MeshSection section;
+			section.startIndex = index;
+			for (int radNumber = firstRad; radNumber < lastRad; radNumber++)
+			{
+				for (int angNumber = firstAng; angNumber < lastAng; angNumber++)
+				{
+					unsigned int first = (radNumber * (angs + 1)) + angNumber;
+					unsigned int second = first + angs + 1;
+
+					indices[index++] = first;
+					indices[index++] = second;
+					indices[index++] = first + 1;
+
+					indices[index++] = second;
+					indices[index++] = second + 1;
+					indices[index++] = first + 1;
+				}
+			}
+			section.indexCount = index - section.startIndex;
+
+			XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+			XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+			for (int radNumber = firstRad; radNumber <= lastRad; radNumber++)
+			{
+				for (int angNumber = firstAng; angNumber <= lastAng; angNumber++)
+				{
+					XMVECTOR position = XMLoadFloat3(&vertices[radNumber * (angs + 1) + angNumber].position);
+					boundsMin = XMVectorMin(boundsMin, position);
+					boundsMax = XMVectorMax(boundsMax, position);
+				}
+			}
+			XMStoreFloat3(&section.boundsCenter, (boundsMax + boundsMin) * 0.5f);
+			XMStoreFloat3(&section.boundsExtents, (boundsMax - boundsMin) * 0.5f);
 
-			indicesVector.push_back(second);
-			indicesVector.push_back(second + 1);
-			indicesVector.push_back(first + 1);
+			sections.push_back(section);
 		}
 	}
 
+	if (optimizeVertexCache)
+		OptimizeVertexCache(vertices, polarVertexCount, indices, polarIndexCount);
 
-	VertexPositionNormal* vertices = &verticesVector[0];
-	unsigned int* indices = &indicesVector[0];
+	CreateBuffers(deviceResources, vertices, polarVertexCount, indices, polarIndexCount);
+}
 
-	D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-	vertexBufferData.pSysMem = vertices;
-	vertexBufferData.SysMemPitch = 0;
-	vertexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionNormal) * verticesVector.size(), D3D11_BIND_VERTEX_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&vertexBufferDesc,
-			&vertexBufferData,
-			&vertexBuffer
-			)
-		);
+void GeneratedMesh::GeneratePatchMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int resolution)
+{
+	sections.clear();
+
+	UINT patchVertexCount = (resolution + 1) * (resolution + 1);
+	scratch.Reset(ScratchArena::SizeOf<VertexPositionNormal>(patchVertexCount));
+	VertexPositionNormal* vertices = scratch.Allocate<VertexPositionNormal>(patchVertexCount);
+
+	for (int z = 0; z <= resolution; z++)
+	{
+		for (int x = 0; x <= resolution; x++)
+		{
+			VertexPositionNormal vertex;
+			vertex.position = XMFLOAT3((float)x, 0.f, (float)z);
+			vertex.normal = XMFLOAT3(0.f, 1.f, 0.f);
+			vertices[z * (resolution + 1) + x] = vertex;
+		}
+	}
+
+	vertexEncoding = VertexEncoding::PositionXZ;
+	CreateVertexBuffer(deviceResources, vertices, patchVertexCount);
+	vertexCount = patchVertexCount;
+
+	GridTopology topology = { resolution, resolution, GridWinding::Clockwise };
+	indexCount = resolution * resolution * 2 * 3;
+	indexBuffer = GetGridIndexBuffer(deviceResources, topology);
+}
+
+void GeneratedMesh::GenerateProjectedGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int width, int height, const Projector& projector)
+{
+	XMVECTOR screenBottomLeftCorner = XMLoadFloat3(&projector.bottomLeft);
+	XMVECTOR screenBottomRightCorner = XMLoadFloat3(&projector.bottomRight);
+	XMVECTOR screenTopLeftCorner = XMLoadFloat3(&projector.topLeft);
+	XMVECTOR screenTopRightCorner = XMLoadFloat3(&projector.topRight);
+
+	XMFLOAT4 plane(0.f, 1.f, 0.f, 0.f);
+	sections.clear();
+
+	// The grid lies on the water plane, only x and z are stored
+	vertexEncoding = VertexEncoding::PositionXZ;
+	vertexStride = VertexFormat<VertexPositionXZ>::stride;
+	positionDecode = XMFLOAT4(1.f, 1.f, 0.f, 0.f);
+
+	// In dynamic mode the vertices go straight into the mapped buffer, otherwise into a temporary array.
+	// Kept plane positions are generated in place and copied to the buffer afterwards.
+	UINT maxVertices = (width + 1) * (height + 1);
+	VertexPositionXZ* planeVertices;
+	if (keepPlanePositions)
+	{
+		if (planePositions.size() < maxVertices)
+			planePositions.resize(maxVertices);
+		planeVertices = planePositions.data();
+	}
+	else if (IsDynamic())
+	{
+		assert(dynamicVertexBuffer->GetCapacity() >= sizeof(VertexPositionXZ) * maxVertices);
+		planeVertices = (VertexPositionXZ*)dynamicVertexBuffer->Map();
+	}
+	else
+	{
+		scratch.Reset(ScratchArena::SizeOf<VertexPositionXZ>(maxVertices));
+		planeVertices = scratch.Allocate<VertexPositionXZ>(maxVertices);
+	}
+
+	int quadRows = -1;
+	vertexCount = 0;
+	for (int z = 0; z <= height && projector.visible; z++)
+	{
+		float i = (float)z / (float)height;
+		XMFLOAT3 left, right;
+		XMStoreFloat3(&left, XMVectorLerp(screenBottomLeftCorner, screenTopLeftCorner, i));
+		XMStoreFloat3(&right, XMVectorLerp(screenBottomRightCorner, screenTopRightCorner, i));
+
+		// Stop at the first row that reaches the horizon, a range fitted projector never gets there
+		if (!IntersectGridRow(projector.eye, left, right, width, plane, &planeVertices[vertexCount]))
+			break;
+
+		vertexCount += width + 1;
+		quadRows++;
+	}
+
+	if (IsDynamic())
+	{
+		if (keepPlanePositions)
+		{
+			assert(dynamicVertexBuffer->GetCapacity() >= sizeof(VertexPositionXZ) * maxVertices);
+			memcpy(dynamicVertexBuffer->Map(), planeVertices, sizeof(VertexPositionXZ) * vertexCount);
+		}
+		dynamicVertexBuffer->Unmap();
+	}
 
-	indexCount = indicesVector.size();
+	if (quadRows <= 0)
+	{
+		vertexCount = 0;
+		indexCount = 0;
+		vertexBuffer = nullptr;
+		indexBuffer = nullptr;
+		return;
+	}
 
+	if (IsDynamic())
+	{
+		vertexBuffer = dynamicVertexBuffer->GetBuffer();
+	}
+	else
+	{
+		D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
+		vertexBufferData.pSysMem = planeVertices;
+		vertexBufferData.SysMemPitch = 0;
+		vertexBufferData.SysMemSlicePitch = 0;
+		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionXZ) * vertexCount, D3D11_BIND_VERTEX_BUFFER);
+		DX::ThrowIfFailed(
+			deviceResources->GetD3DDevice()->CreateBuffer(
+				&vertexBufferDesc,
+				&vertexBufferData,
+				&vertexBuffer
+				)
+			);
+	}
+
+	// Only after the vertices are uploaded, a topology that isn't cached yet is written into the scratch arena they may be in.
+	// Rows cut by the horizon simply draw a shorter prefix of the full grid's indices.
+	GridTopology topology = { width, height, GridWinding::CounterClockwise };
+	indexCount = width * quadRows * 2 * 3;
+	indexBuffer = GetGridIndexBuffer(deviceResources, topology);
+}
+
+void GeneratedMesh::EnsureDynamicBuffers(std::shared_ptr<DX::DeviceResources> deviceResources, UINT maxVertices)
+{
+	if (dynamicVertexBuffer == nullptr || dynamicVertexBuffer->GetCapacity() < sizeof(VertexPositionXZ) * maxVertices)
+	{
+		dynamicVertexBuffer = std::shared_ptr<IDynamicBuffer>(new D3DDynamicBuffer(deviceResources, sizeof(VertexPositionXZ) * maxVertices, D3D11_BIND_VERTEX_BUFFER));
+	}
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeneratedMesh::GetGridIndexBuffer(std::shared_ptr<DX::DeviceResources> deviceResources, GridTopology topology)
+{
+	auto cached = gridIndexBuffers.find(topology);
+	if (cached != gridIndexBuffers.end())
+		return cached->second;
+
+	// Window resizes change the grid width, don't keep every shape we have ever seen
+	if (gridIndexBuffers.size() >= maxCachedGridTopologies)
+		gridIndexBuffers.clear();
+
+	UINT gridIndexCount = topology.width * topology.rows * 2 * 3;
+	scratch.Reset(ScratchArena::SizeOf<unsigned int>(gridIndexCount));
+	unsigned int* planeIndices = scratch.Allocate<unsigned int>(gridIndexCount);
+	WriteGridIndices(planeIndices, topology);
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> gridIndexBuffer;
 	D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-	indexBufferData.pSysMem = indices;
+	indexBufferData.pSysMem = planeIndices;
 	indexBufferData.SysMemPitch = 0;
 	indexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * indicesVector.size(), D3D11_BIND_INDEX_BUFFER);
+	CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * gridIndexCount, D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
 	DX::ThrowIfFailed(
 		deviceResources->GetD3DDevice()->CreateBuffer(
 			&indexBufferDesc,
 			&indexBufferData,
-			&indexBuffer
+			&gridIndexBuffer
 			)
 		);
+
+	gridIndexBuffers[topology] = gridIndexBuffer;
+	return gridIndexBuffer;
 }
 
-XMVECTOR LinePlaneIntersection(XMVECTOR linePoint1, XMVECTOR linePoint2, XMVECTOR planeNormal, float planeDistanceFromOrigin)
+void GeneratedMesh::WriteGridIndices(unsigned int* planeIndices, GridTopology topology)
 {
-	XMVECTOR line = linePoint2 - linePoint1;
-	float nDotA = XMVectorGetX(XMVector3Dot(planeNormal, linePoint1));
-	float nDotLine = XMVectorGetX(XMVector3Dot(planeNormal, line));
+	int width = topology.width;
+	for (int z = 0; z < topology.rows; z++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned int* quad = &planeIndices[(z*width + x) * 6];
+			if (topology.winding == GridWinding::Clockwise)
+			{
+				quad[0] = z * (width + 1) + x;
+				quad[1] = z * (width + 1) + x + 1;
+				quad[2] = (z + 1) * (width + 1) + x;
+
+				quad[3] = (z + 1) * (width + 1) + x + 1;
+				quad[4] = (z + 1) * (width + 1) + x;
+				quad[5] = z * (width + 1) + x + 1;
+			}
+			else
+			{
+				quad[0] = z * (width + 1) + x;
+				quad[1] = (z + 1) * (width + 1) + x;
+				quad[2] = z * (width + 1) + x + 1;
 
-	return linePoint1 + (((planeDistanceFromOrigin - nDotA) / nDotLine) * line);
+				quad[3] = (z + 1) * (width + 1) + x + 1;
+				quad[4] = z * (width + 1) + x + 1;
+				quad[5] = (z + 1) * (width + 1) + x;
+			}
+		}
+	}
 }
 
-void GeneratedMesh::GenerateProjectedGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int width, int height, float bias, std::shared_ptr<Camera> camera)
+void GeneratedMesh::OptimizeVertexCache(VertexPositionNormal* vertices, UINT meshVertexCount, unsigned int* indices, UINT meshIndexCount)
 {
-	XMVECTOR viewDir = camera->getDirection();
-	XMVECTOR eye = camera->getEye() - viewDir * bias;
-
-	XMVECTOR screenCenter = eye + viewDir * camera->nearClippingPane;
-	float screenHeight = 2 * camera->nearClippingPane * tanf(camera->fov / 2.f);
-	float screenWidth = screenHeight * camera->aspectRatio;
+#if defined(_DEBUG)
+	VertexCacheStats before = VertexCacheOptimizer::Simulate(indices, meshIndexCount, meshVertexCount);
+#endif
 
-	XMVECTOR screenRight = XMVector3Normalize(XMVector3Cross(viewDir, camera->getUp()));
-	XMVECTOR screenUp = XMVector3Normalize(XMVector3Cross(screenRight, viewDir));
+	// Triangles never move between sections, so culling keeps working on the optimized mesh
+	VertexCacheOptimizer optimizer;
+	if (sections.empty())
+	{
+		optimizer.OptimizeTriangleOrder(indices, meshIndexCount, meshVertexCount);
+	}
+	else
+	{
+		for (const MeshSection& section : sections)
+			optimizer.OptimizeTriangleOrder(indices + section.startIndex, section.indexCount, meshVertexCount);
+	}
 
-	XMVECTOR screenBottomLeftCorner = screenCenter - screenRight * (screenWidth / 2.f) - screenUp * (screenHeight / 2.f);
-	XMVECTOR screenBottomRightCorner = screenBottomLeftCorner + screenRight * screenWidth;
-	XMVECTOR screenTopLeftCorner = screenBottomLeftCorner + screenUp * screenHeight;
-	XMVECTOR screenTopRightCorner = screenBottomLeftCorner + screenRight * screenWidth + screenUp * screenHeight;
+	// Renumber the vertices in the order the triangles first use them
+	unsigned int* remap = scratch.Allocate<unsigned int>(meshVertexCount);
+	VertexPositionNormal* remappedVertices = scratch.Allocate<VertexPositionNormal>(meshVertexCount);
+	VertexCacheOptimizer::BuildFetchRemap(indices, meshIndexCount, meshVertexCount, remap);
+	VertexCacheOptimizer::RemapIndices(indices, meshIndexCount, remap);
+	VertexCacheOptimizer::RemapVertices(vertices, meshVertexCount, remap, remappedVertices);
+	memcpy(vertices, remappedVertices, sizeof(VertexPositionNormal) * meshVertexCount);
+
+#if defined(_DEBUG)
+	// Two more passes over the indices, only worth it while debugging
+	VertexCacheStats after = VertexCacheOptimizer::Simulate(indices, meshIndexCount, meshVertexCount);
+
+	char message[128];
+	snprintf(message, sizeof(message), "Vertex cache optimization: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+	OutputDebugStringA(message);
+#endif
+}
 
-	XMVECTOR planeNormal = XMVectorSet(0, 1, 0, 1);
-	float planeDistanceFromOrigin = 0;
+size_t GeneratedMesh::GetOptimizationScratchSize(UINT meshVertexCount)
+{
+	if (!optimizeVertexCache)
+		return 0;
 
-	std::vector<VertexPositionNormal> planeVerticesVector;
+	return ScratchArena::SizeOf<unsigned int>(meshVertexCount) + ScratchArena::SizeOf<VertexPositionNormal>(meshVertexCount);
+}
 
-	float epsilon = .001f;
-	bool horizonReached = false;
-	int quadRows = -1;
-	for (float i = 0; i < 1.f + epsilon; i += 1.f / (float)height)
+void GeneratedMesh::CreateVertexBuffer(std::shared_ptr<DX::DeviceResources> deviceResources, VertexPositionNormal* vertices, UINT meshVertexCount)
+{
+	if (keepPlanePositions)
 	{
-		XMVECTOR left = XMVectorLerp(screenBottomLeftCorner, screenTopLeftCorner, i);
-		XMVECTOR right = XMVectorLerp(screenBottomRightCorner, screenTopRightCorner, i);
+		planePositions.resize(meshVertexCount);
+		for (UINT i = 0; i < meshVertexCount; i++)
+			planePositions[i].position = XMFLOAT2(vertices[i].position.x, vertices[i].position.z);
+	}
 
-		for (float j = 0; j < 1.f + epsilon; j += 1.f / (float)width)
+	// The packed vertices are written over the generated ones, packed vertex i ends before generated vertex i + 1 starts
+	positionDecode = XMFLOAT4(1.f, 1.f, 0.f, 0.f);
+	if (vertexEncoding == VertexEncoding::PositionXZ)
+	{
+		VertexPositionXZ* packed = (VertexPositionXZ*)vertices;
+		for (UINT i = 0; i < meshVertexCount; i++)
 		{
-			XMVECTOR screenPosition = XMVectorLerp(left, right,	j);
-			XMVECTOR intersection = LinePlaneIntersection(eye, screenPosition, planeNormal, planeDistanceFromOrigin);
-			if (XMVectorGetX(XMVector3Dot(intersection - eye, viewDir)) < 0.f)
-			{
-				horizonReached = true;
-				break;
-			}
+			XMFLOAT3 position = vertices[i].position;
+			packed[i].position = XMFLOAT2(position.x, position.z);
+		}
+		vertexStride = VertexFormat<VertexPositionXZ>::stride;
+	}
+	else if (vertexEncoding == VertexEncoding::PositionXZQuantized)
+	{
+		XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+		for (UINT i = 0; i < meshVertexCount; i++)
+		{
+			XMVECTOR position = XMLoadFloat3(&vertices[i].position);
+			boundsMin = XMVectorMin(boundsMin, position);
+			boundsMax = XMVectorMax(boundsMax, position);
+		}
 
-			VertexPositionNormal vertex;
-			XMFLOAT3 position;
-			XMStoreFloat3(&position, intersection);
-			vertex.position = position;
-			vertex.normal = XMFLOAT3(0.f, 1.f, 0.f);
-			//vertex.textureCoordinate = XMFLOAT2(position.x, position.z);
-			//vertex.tangent = XMFLOAT3(1.f, 0.f, 0.f);
-			//vertex.binormal = XMFLOAT3(0.f, 0.f, 1.f);
+		// Map the bounds to -1..1, flat axes would divide by zero
+		XMFLOAT3 center, halfSize;
+		XMStoreFloat3(&center, (boundsMax + boundsMin) * 0.5f);
+		XMStoreFloat3(&halfSize, XMVectorMax((boundsMax - boundsMin) * 0.5f, XMVectorReplicate(FLT_MIN)));
 
-			planeVerticesVector.push_back(vertex);
+		VertexPositionXZQuantized* packed = (VertexPositionXZQuantized*)vertices;
+		for (UINT i = 0; i < meshVertexCount; i++)
+		{
+			XMFLOAT3 position = vertices[i].position;
+			packed[i].position = XMSHORTN2((position.x - center.x) / halfSize.x, (position.z - center.z) / halfSize.z);
 		}
-
-		if (horizonReached)
-			break;
-		
-		quadRows++;
+		vertexStride = VertexFormat<VertexPositionXZQuantized>::stride;
+		positionDecode = XMFLOAT4(halfSize.x, halfSize.z, center.x, center.z);
 	}
-
-	if (planeVerticesVector.size() <= 0)
+	else
 	{
-		vertexBuffer = nullptr;
-		indexBuffer = nullptr;
-		return;
+		vertexStride = VertexFormat<VertexPositionNormal>::stride;
 	}
 
 	D3D11_SUBRESOURCE_DATA vertexBufferData = { 0 };
-	vertexBufferData.pSysMem = &planeVerticesVector[0];
+	vertexBufferData.pSysMem = vertices;
 	vertexBufferData.SysMemPitch = 0;
 	vertexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(VertexPositionNormal) * planeVerticesVector.size(), D3D11_BIND_VERTEX_BUFFER);
+	CD3D11_BUFFER_DESC vertexBufferDesc(vertexStride * meshVertexCount, D3D11_BIND_VERTEX_BUFFER);
 	DX::ThrowIfFailed(
 		deviceResources->GetD3DDevice()->CreateBuffer(
 			&vertexBufferDesc,
@@ -304,28 +512,17 @@ void GeneratedMesh::GenerateProjectedGridMesh(std::shared_ptr<DX::DeviceResource
 			&vertexBuffer
 			)
 		);
+}
 
-	indexCount = width * quadRows * 2 * 3;
-	unsigned int* planeIndices = new unsigned int[indexCount];
-	for (int z = 0; z < quadRows; z++)
-	{
-		for (int x = 0; x < width; x++)
-		{
-			planeIndices[(z*width + x) * 6] = z * (width + 1) + x;
-			planeIndices[(z*width + x) * 6 + 1] = (z + 1) * (width + 1) + x;
-			planeIndices[(z*width + x) * 6 + 2] = z * (width + 1) + x + 1;
-
-			planeIndices[(z*width + x) * 6 + 3] = (z + 1) * (width + 1) + x + 1;
-			planeIndices[(z*width + x) * 6 + 4] = z * (width + 1) + x + 1;
-			planeIndices[(z*width + x) * 6 + 5] = (z + 1) * (width + 1) + x;
-		}
-	}
+void GeneratedMesh::CreateBuffers(std::shared_ptr<DX::DeviceResources> deviceResources, VertexPositionNormal* vertices, UINT meshVertexCount, const unsigned int* indices, UINT meshIndexCount)
+{
+	CreateVertexBuffer(deviceResources, vertices, meshVertexCount);
 
 	D3D11_SUBRESOURCE_DATA indexBufferData = { 0 };
-	indexBufferData.pSysMem = planeIndices;
+	indexBufferData.pSysMem = indices;
 	indexBufferData.SysMemPitch = 0;
 	indexBufferData.SysMemSlicePitch = 0;
-	CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * indexCount, D3D11_BIND_INDEX_BUFFER);
+	CD3D11_BUFFER_DESC indexBufferDesc(sizeof(unsigned int) * meshIndexCount, D3D11_BIND_INDEX_BUFFER);
 	DX::ThrowIfFailed(
 		deviceResources->GetD3DDevice()->CreateBuffer(
 			&indexBufferDesc,
@@ -333,10 +530,15 @@ void GeneratedMesh::GenerateProjectedGridMesh(std::shared_ptr<DX::DeviceResource
 			&indexBuffer
 			)
 		);
+
+	vertexCount = meshVertexCount;
+	indexCount = meshIndexCount;
 }
 
 GeneratedMesh::~GeneratedMesh()
 {
 	vertexBuffer.Reset();
 	indexBuffer.Reset();
+	dynamicVertexBuffer.reset();
+	gridIndexBuffers.clear();
 }
\ No newline at end of file
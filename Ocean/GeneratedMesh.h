@@ -1,21 +1,112 @@
 #pragma once
 #include "Camera.h"
+#include "Projector.h"
 #include "Content\ShaderStructures.h"
+#include "DynamicBuffer.h"
+#include "ScratchArena.h"
+#include "VertexCacheOptimizer.h"
+
+#include <map>
+#include <vector>
 
 namespace Ocean
 {
+	// Triangle order of grid quads, the two grid generators use opposite windings.
+	enum GridWinding
+	{
+		Clockwise,
+		CounterClockwise
+	};
+
+	struct GridTopology
+	{
+		int width;
+		int rows;
+		GridWinding winding;
+
+		bool operator<(const GridTopology& other) const
+		{
+			if (width != other.width) return width < other.width;
+			if (rows != other.rows) return rows < other.rows;
+			return winding < other.winding;
+		}
+	};
+
+	// What the vertex buffer holds, see the vertex structs in ShaderStructures.h
+	enum VertexEncoding
+	{
+		PositionNormal,
+		PositionXZ,
+		PositionXZQuantized
+	};
+
+	// A contiguous range of the index buffer with the bounds of the triangles it draws.
+	struct MeshSection
+	{
+		UINT startIndex;
+		UINT indexCount;
+		XMFLOAT3 boundsCenter;
+		XMFLOAT3 boundsExtents;
+	};
+
 	class GeneratedMesh
 	{
 	public:
 		GeneratedMesh();
 		void GenerateSphereMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int latitudeBands, int longitudeBands, float radius);
 		void GenerateSimpleGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int width, int height, float stride);
-		void GeneratePolarGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int rads, int angs, float radius);
-		void GenerateProjectedGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int width, int height, float bias, std::shared_ptr<Camera> camera);
+		// The disc is built as angular wedges cut into radial bands, each one a section so the invisible ones can be skipped when drawing
+		void GeneratePolarGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int rads, int angs, float radius, int wedges = 1, int radialBands = 1);
+		// Grid of resolution x resolution quads with vertices at whole grid units, the CDLOD patches are instances of it
+		void GeneratePatchMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int resolution);
+		void GenerateProjectedGridMesh(std::shared_ptr<DX::DeviceResources> deviceResources, int width, int height, const Projector& projector);
+
+		// Dynamic mode: the vertex buffer is allocated once for the largest mesh and refilled by the generators.
+		// Grid indices never change with the camera, they come from the topology cache instead.
+		void EnsureDynamicBuffers(std::shared_ptr<DX::DeviceResources> deviceResources, UINT maxVertices);
+		inline bool IsDynamic() { return dynamicVertexBuffer != nullptr; }
 		~GeneratedMesh();
 
 		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 		int indexCount;
+		int vertexCount;
+
+		// Empty for meshes that are always drawn whole
+		std::vector<MeshSection> sections;
+
+		// Reorder the sphere and the static grids for the vertex cache when they are generated.
+		// Projected grids are left alone, their draws depend on the rows being in order.
+		bool optimizeVertexCache;
+
+		// Set before generating the sphere and the static grids. Projected grids are always PositionXZ.
+		VertexEncoding vertexEncoding;
+		UINT vertexStride;
+		// Scale in xy and offset in zw that turn quantized positions back into object space
+		XMFLOAT4 positionDecode;
+
+		// Set before generating to keep the x, z of every vertex on the CPU, in vertex buffer order.
+		// The first vertexCount entries are the current mesh's, the projected grid only grows the array.
+		bool keepPlanePositions;
+		std::vector<VertexPositionXZ> planePositions;
+
+	protected:
+		void CreateBuffers(std::shared_ptr<DX::DeviceResources> deviceResources, VertexPositionNormal* vertices, UINT meshVertexCount, const unsigned int* indices, UINT meshIndexCount);
+		void CreateVertexBuffer(std::shared_ptr<DX::DeviceResources> deviceResources, VertexPositionNormal* vertices, UINT meshVertexCount);
+		Microsoft::WRL::ComPtr<ID3D11Buffer> GetGridIndexBuffer(std::shared_ptr<DX::DeviceResources> deviceResources, GridTopology topology);
+		static void WriteGridIndices(unsigned int* indices, GridTopology topology);
+
+		// Optimizes section by section so the sections stay intact, needs GetOptimizationScratchSize more scratch memory
+		void OptimizeVertexCache(VertexPositionNormal* vertices, UINT meshVertexCount, unsigned int* indices, UINT meshIndexCount);
+		size_t GetOptimizationScratchSize(UINT meshVertexCount);
+
+		std::shared_ptr<IDynamicBuffer> dynamicVertexBuffer;
+
+		// Generators write into this instead of the heap, it is sized exactly from the mesh parameters
+		ScratchArena scratch;
+
+		// Immutable index buffers of row-major grids, a grid with fewer rows draws a prefix of them.
+		std::map<GridTopology, Microsoft::WRL::ComPtr<ID3D11Buffer>> gridIndexBuffers;
+		static const int maxCachedGridTopologies = 4;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "pch.h"
+#include "GerstnerBaker.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+using namespace Ocean;
+
+namespace
+{
+	const float pi = 3.14159265358979324f;
+
+	// Far enough from the camera that nothing fades, the baked waves are faded where they are drawn
+	const float noFadeStart = 1e18f;
+	const float noFadeEnd = 2e18f;
+
+	std::vector<GerstnerWaveSet> WithoutFades(const std::vector<GerstnerWaveSet>& waveSets)
+	{
+		std::vector<GerstnerWaveSet> result = waveSets;
+		for (GerstnerWaveSet& waves : result)
+		{
+			waves.lodFadeStart = noFadeStart;
+			waves.lodFadeEnd = noFadeEnd;
+		}
+		return result;
+	}
+
+	// Nearest multiple of step that isn't zero
+	float SnapNonZero(float value, float step)
+	{
+		float steps = floorf(value / step + 0.5f);
+		if (steps == 0.f)
+			steps = value < 0.f ? -1.f : 1.f;
+		return steps * step;
+	}
+
+	std::vector<GerstnerWaveSet> SnapToTile(const GerstnerWaveSet* waveSets, int waveSetCount, const GerstnerBakeSettings& settings)
+	{
+		float waveNumberStep = 2.f * pi / settings.tileLength;
+		float speedStep = 2.f * pi / settings.period;
+
+		std::vector<GerstnerWaveSet> result(waveSets, waveSets + waveSetCount);
+		for (GerstnerWaveSet& waves : result)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				waves.speed[i] = SnapNonZero(waves.speed[i], speedStep);
+
+				// The shader's wave vector is frequency * direction, the frequency stays so the steepness means the same
+				float frequency = waves.frequency[i];
+				if (frequency == 0.f)
+					continue;
+
+				float kx = frequency * waves.directionX[i];
+				float kz = frequency * waves.directionZ[i];
+				float snappedX = floorf(kx / waveNumberStep + 0.5f) * waveNumberStep;
+				float snappedZ = floorf(kz / waveNumberStep + 0.5f) * waveNumberStep;
+
+				// Waves longer than the tile become the longest one it holds along their larger axis
+				if (snappedX == 0.f && snappedZ == 0.f)
+				{
+					if (fabsf(kx) >= fabsf(kz))
+						snappedX = SnapNonZero(kx, waveNumberStep);
+					else
+						snappedZ = SnapNonZero(kz, waveNumberStep);
+				}
+
+				waves.directionX[i] = snappedX / frequency;
+				waves.directionZ[i] = snappedZ / frequency;
+			}
+		}
+		return result;
+	}
+
+	// Texel below a coordinate in texels and the weight of the one after it, wrapping around count
+	void WrapTexel(float coordinate, int count, int& first, int& second, float& weight)
+	{
+		float below = floorf(coordinate);
+		weight = coordinate - below;
+		first = (int)below % count;
+		if (first < 0)
+			first += count;
+		second = first + 1 < count ? first + 1 : 0;
+	}
+}
+
+GerstnerBaker::GerstnerBaker(const GerstnerWaveSet* waveSets, int waveSetCount, const GerstnerBakeSettings& settings)
+	: size(settings.size), frameCount(settings.frameCount), tileLength(settings.tileLength), period(settings.period),
+	snappedWaveSets(SnapToTile(waveSets, waveSetCount, settings)),
+	evaluator(WithoutFades(snappedWaveSets).data(), waveSetCount),
+	bakeSeconds(0.f)
+{
+	assert(size > 0 && frameCount > 0 && tileLength > 0.f && period > 0.f);
+
+	evaluator.attenuationStart = noFadeStart;
+	evaluator.attenuationEnd = noFadeEnd;
+
+	displacement.resize((size_t)frameCount * size * size * 4);
+	slope.resize((size_t)frameCount * size * size * 2);
+}
+
+void GerstnerBaker::Bake(ThreadPool* pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	auto body = [this](int begin, int end) { BakeRows(begin, end); };
+	if (pool != nullptr)
+		pool->ParallelFor(frameCount * size, 4, body);
+	else
+		body(0, frameCount * size);
+
+	bakeSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+void GerstnerBaker::BakeRows(int firstRow, int endRow)
+{
+	// One row of points at a time through the evaluator's SIMD path
+	std::vector<float> x(size), z(size), samples(size * 6);
+	GerstnerSamples output = { &samples[0], &samples[size], &samples[size * 2], &samples[size * 3], &samples[size * 4], &samples[size * 5] };
+
+	float texelLength = tileLength / (float)size;
+	for (int i = 0; i < size; i++)
+		x[i] = (float)i * texelLength;
+
+	for (int row = firstRow; row < endRow; row++)
+	{
+		int frame = row / size;
+		float time = (float)frame * period / (float)frameCount;
+		std::fill(z.begin(), z.end(), (float)(row % size) * texelLength);
+		evaluator.Evaluate(x.data(), z.data(), size, time, 0.f, 0.f, 0.f, output);
+
+		float* rowDisplacement = &displacement[(size_t)row * size * 4];
+		float* rowSlope = &slope[(size_t)row * size * 2];
+		for (int i = 0; i < size; i++)
+		{
+			rowDisplacement[i * 4 + 0] = output.offsetX[i];
+			rowDisplacement[i * 4 + 1] = output.offsetY[i];
+			rowDisplacement[i * 4 + 2] = output.offsetZ[i];
+			rowDisplacement[i * 4 + 3] = 0.f;
+			rowSlope[i * 2 + 0] = -output.normalX[i] / output.normalY[i];
+			rowSlope[i * 2 + 1] = -output.normalZ[i] / output.normalY[i];
+		}
+	}
+}
+
+void GerstnerBaker::Sample(float x, float z, float time, float* offset, float* normal) const
+{
+	int x0, x1, z0, z1, f0, f1;
+	float wx, wz, wf;
+	WrapTexel(x / tileLength * (float)size, size, x0, x1, wx);
+	WrapTexel(z / tileLength * (float)size, size, z0, z1, wz);
+	WrapTexel(time / period * (float)frameCount, frameCount, f0, f1, wf);
+
+	float filtered[5] = {};
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float weight = (corner & 1 ? wx : 1.f - wx) * (corner & 2 ? wz : 1.f - wz) * (corner & 4 ? wf : 1.f - wf);
+		size_t texel = ((size_t)(corner & 4 ? f1 : f0) * size + (corner & 2 ? z1 : z0)) * size + (corner & 1 ? x1 : x0);
+		for (int channel = 0; channel < 3; channel++)
+			filtered[channel] += displacement[texel * 4 + channel] * weight;
+		filtered[3] += slope[texel * 2 + 0] * weight;
+		filtered[4] += slope[texel * 2 + 1] * weight;
+	}
+
+	offset[0] = filtered[0];
+	offset[1] = filtered[1];
+	offset[2] = filtered[2];
+
+	float length = sqrtf(filtered[3] * filtered[3] + 1.f + filtered[4] * filtered[4]);
+	normal[0] = -filtered[3] / length;
+	normal[1] = 1.f / length;
+	normal[2] = -filtered[4] / length;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "GerstnerEvaluator.h"
+#include <cstddef>
+#include <vector>
+
+namespace Ocean
+{
+	class ThreadPool;
+
+	struct GerstnerBakeSettings
+	{
+		// Texels along each side of the tile
+		int size;
+		// Side of the square tile, the baked waves repeat after it
+		float tileLength;
+		// Frames over one period
+		int frameCount;
+		// Seconds after which the baked waves repeat
+		float period;
+	};
+
+	// Samples the Gerstner waves into a frameCount deep stack of size * size displacement and slope maps,
+	// so a vertex can look them up with one filtered fetch each instead of evaluating every wave.
+	// The waves are only periodic in the tile and period after snapping each wave vector to a multiple of
+	// 2 pi / tileLength and each speed to a multiple of 2 pi / period, which moves their directions and speeds a little.
+	// Drawing the snapped sets analytically gives the same sea as the baked maps, minus filtering.
+	// The baked waves aren't faded or attenuated by distance. Only depends on the standard library.
+	class GerstnerBaker
+	{
+	public:
+		GerstnerBaker(const GerstnerWaveSet* waveSets, int waveSetCount, const GerstnerBakeSettings& settings);
+
+		// pool can be null to run on the calling thread only
+		void Bake(ThreadPool* pool);
+
+		int GetSize() const { return size; }
+		int GetFrameCount() const { return frameCount; }
+		float GetTileLength() const { return tileLength; }
+		float GetPeriod() const { return period; }
+		const std::vector<GerstnerWaveSet>& GetSnappedWaveSets() const { return snappedWaveSets; }
+
+		// size * size texels per frame, row z of frame f starts at (f * size + z) * size.
+		// Texel x, z holds the point x, z * tileLength / size at time f * period / frameCount.
+		// Displacement is x, height, z and 0 for a float4 texture, slope is -normal.x / normal.y and -normal.z / normal.y
+		// of the normal at the displaced point for a float2 one.
+		const float* GetDisplacement() const { return displacement.data(); }
+		const float* GetSlope() const { return slope.data(); }
+
+		float GetBakeSeconds() const { return bakeSeconds; }
+		size_t GetMemorySize() const { return (displacement.size() + slope.size()) * sizeof(float); }
+
+		// Filters the baked maps like a wrapping trilinear texture fetch would, offset and normal have three floats each
+		void Sample(float x, float z, float time, float* offset, float* normal) const;
+
+	private:
+		void BakeRows(int firstRow, int endRow);
+
+		int size;
+		int frameCount;
+		float tileLength;
+		float period;
+
+		// The snapped sets keep their fades, the evaluator ignores them
+		std::vector<GerstnerWaveSet> snappedWaveSets;
+		GerstnerEvaluator evaluator;
+
+		std::vector<float> displacement;
+		std::vector<float> slope;
+		float bakeSeconds;
+	};
+}
@@ -0,0 +1,770 @@
+#include "pch.h"
+#include "GerstnerEvaluator.h"
+#include "CpuFeatures.h"
+#include <cassert>
+#include <cmath>
+
+using namespace Ocean;
+
+namespace
+{
+	// 2 pi split in two so that subtracting whole turns keeps the bits of large phases (Cody and Waite)
+	const float twoPiHigh = 6.28125f;
+	const float twoPiLow = 0.0019353071795864769f;
+	const float invTwoPi = 0.15915494309189535f;
+	const float pi = 3.14159265358979324f;
+	const float halfPi = 1.57079632679489662f;
+
+	// Minimax polynomials on [-pi/2, pi/2], the same DirectXMath uses for XMScalarSinCos
+	const float sin3 = -0.16666667f, sin5 = 0.0083333310f, sin7 = -0.00019840874f, sin9 = 2.7525562e-06f, sin11 = -2.3889859e-08f;
+	const float cos2 = -0.5f, cos4 = 0.041666638f, cos6 = -0.0013888378f, cos8 = 2.4760495e-05f, cos10 = -2.6051615e-07f;
+
+	// Everything a batch of points needs besides the points
+	struct Batch
+	{
+		const GerstnerEvaluator::Wave* waves;
+		const float* intensities;
+		const float* fadeEnds;
+		const float* fadeScales;
+		int setCount;
+		float time;
+		float cameraX, cameraY, cameraZ;
+		float attenuationEnd;
+		float attenuationScale;
+	};
+
+	Batch MakeBatch(
+		const std::vector<GerstnerEvaluator::Wave>& waves,
+		const std::vector<float>& intensities,
+		const std::vector<float>& fadeEnds,
+		const std::vector<float>& fadeScales,
+		float attenuationStart, float attenuationEnd,
+		float time,
+		float cameraX, float cameraY, float cameraZ)
+	{
+		Batch batch;
+		batch.waves = waves.data();
+		batch.intensities = intensities.data();
+		batch.fadeEnds = fadeEnds.data();
+		batch.fadeScales = fadeScales.data();
+		batch.setCount = (int)intensities.size();
+		batch.time = time;
+		batch.cameraX = cameraX;
+		batch.cameraY = cameraY;
+		batch.cameraZ = cameraZ;
+		batch.attenuationEnd = attenuationEnd;
+		batch.attenuationScale = 1.f / ((attenuationStart - attenuationEnd) * (attenuationStart - attenuationEnd));
+		return batch;
+	}
+
+	void SinCosScalar(float x, float& sine, float& cosine)
+	{
+		float turns = floorf(x * invTwoPi + 0.5f);
+		float y = (x - turns * twoPiHigh) - turns * twoPiLow;
+
+		// Fold into [-pi/2, pi/2], the cosine changes sign there
+		float cosineSign = 1.f;
+		if (y > halfPi)
+		{
+			y = pi - y;
+			cosineSign = -1.f;
+		}
+		else if (y < -halfPi)
+		{
+			y = -pi - y;
+			cosineSign = -1.f;
+		}
+
+		float y2 = y * y;
+		sine = (((((sin11 * y2 + sin9) * y2 + sin7) * y2 + sin5) * y2 + sin3) * y2 + 1.f) * y;
+		cosine = ((((((cos10 * y2 + cos8) * y2 + cos6) * y2 + cos4) * y2 + cos2) * y2) + 1.f) * cosineSign;
+	}
+
+	// CalculateWaveAttenuation of the shader
+	float AttenuationScalar(const Batch& batch, float distance)
+	{
+		if (distance > batch.attenuationEnd)
+			return 0.f;
+
+		float fromEnd = distance - batch.attenuationEnd;
+		return fminf(fromEnd * fromEnd * batch.attenuationScale, 1.f);
+	}
+
+	void EvaluateScalar(const Batch& batch, const float* x, const float* z, int first, int count, const GerstnerSamples& output)
+	{
+		for (int i = first; i < count; i++)
+		{
+			// Each set is weighted by its distance fade and the overall attenuation
+			float dx = x[i] - batch.cameraX, dy = -batch.cameraY, dz = z[i] - batch.cameraZ;
+			float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+			float attenuation = AttenuationScalar(batch, distance);
+			float weights[maxGerstnerWaveSets];
+
+			float offsetX = 0.f, offsetY = 0.f, offsetZ = 0.f;
+			for (int set = 0; set < batch.setCount; set++)
+			{
+				weights[set] = fminf(fmaxf((batch.fadeEnds[set] - distance) * batch.fadeScales[set], 0.f), 1.f) * attenuation;
+
+				float setX = 0.f, setY = 0.f, setZ = 0.f;
+				for (int w = set * 4; w < set * 4 + 4; w++)
+				{
+					const GerstnerEvaluator::Wave& wave = batch.waves[w];
+					float sine, cosine;
+					SinCosScalar(wave.frequencyX * x[i] + wave.frequencyZ * z[i] + batch.time * wave.speed, sine, cosine);
+					setX += wave.offsetX * cosine;
+					setZ += wave.offsetZ * cosine;
+					setY += wave.amplitude * sine;
+				}
+
+				offsetX += setX * weights[set];
+				offsetY += setY * weights[set];
+				offsetZ += setZ * weights[set];
+			}
+
+			output.offsetX[i] = offsetX;
+			output.offsetY[i] = offsetY;
+			output.offsetZ[i] = offsetZ;
+
+			if (output.normalX == nullptr)
+				continue;
+
+			// Every set's normal is normalized on its own before they are added up
+			float displacedX = x[i] + offsetX, displacedZ = z[i] + offsetZ;
+			float normalX = 0.f, normalY = 0.f, normalZ = 0.f;
+			for (int set = 0; set < batch.setCount; set++)
+			{
+				float setX = 0.f, setZ = 0.f;
+				for (int w = set * 4; w < set * 4 + 4; w++)
+				{
+					const GerstnerEvaluator::Wave& wave = batch.waves[w];
+					float sine, cosine;
+					SinCosScalar(wave.frequencyX * displacedX + wave.frequencyZ * displacedZ + batch.time * wave.speed, sine, cosine);
+					setX -= wave.normalX * cosine;
+					setZ -= wave.normalZ * cosine;
+				}
+
+				setX *= batch.intensities[set];
+				setZ *= batch.intensities[set];
+				float weight = weights[set] / sqrtf(setX * setX + 4.f + setZ * setZ);
+				normalX += setX * weight;
+				normalY += 2.f * weight;
+				normalZ += setZ * weight;
+			}
+
+			// Straight up where every set has faded out
+			float lengthSquared = normalX * normalX + normalY * normalY + normalZ * normalZ;
+			float invLength = lengthSquared > 0.f ? 1.f / sqrtf(lengthSquared) : 0.f;
+			output.normalX[i] = normalX * invLength;
+			output.normalY[i] = lengthSquared > 0.f ? normalY * invLength : 1.f;
+			output.normalZ[i] = normalZ * invLength;
+		}
+	}
+
+	void EvaluateLatticeScalar(const Batch& batch, const GerstnerLattice& lattice, int renormalizeInterval, const GerstnerSamples& output)
+	{
+		int waveCount = batch.setCount * 4;
+		float sines[maxGerstnerWaveSets * 4], cosines[maxGerstnerWaveSets * 4];
+		float stepSines[maxGerstnerWaveSets * 4], stepCosines[maxGerstnerWaveSets * 4];
+		for (int w = 0; w < waveCount; w++)
+			SinCosScalar(batch.waves[w].frequencyX * lattice.spacing, stepSines[w], stepCosines[w]);
+
+		for (int row = 0; row < lattice.rows; row++)
+		{
+			float z = lattice.originZ + (float)row * lattice.spacing;
+			for (int w = 0; w < waveCount; w++)
+			{
+				const GerstnerEvaluator::Wave& wave = batch.waves[w];
+				SinCosScalar(wave.frequencyX * lattice.originX + wave.frequencyZ * z + batch.time * wave.speed, sines[w], cosines[w]);
+			}
+
+			int sinceRenormalize = 0;
+			for (int column = 0; column < lattice.columns; column++)
+			{
+				float x = lattice.originX + (float)column * lattice.spacing;
+				float dx = x - batch.cameraX, dy = -batch.cameraY, dz = z - batch.cameraZ;
+				float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+				float attenuation = AttenuationScalar(batch, distance);
+
+				float offsetX = 0.f, offsetY = 0.f, offsetZ = 0.f;
+				for (int set = 0; set < batch.setCount; set++)
+				{
+					float weight = fminf(fmaxf((batch.fadeEnds[set] - distance) * batch.fadeScales[set], 0.f), 1.f) * attenuation;
+					for (int w = set * 4; w < set * 4 + 4; w++)
+					{
+						const GerstnerEvaluator::Wave& wave = batch.waves[w];
+						offsetX += wave.offsetX * cosines[w] * weight;
+						offsetZ += wave.offsetZ * cosines[w] * weight;
+						offsetY += wave.amplitude * sines[w] * weight;
+					}
+				}
+
+				int index = row * lattice.columns + column;
+				output.offsetX[index] = offsetX;
+				output.offsetY[index] = offsetY;
+				output.offsetZ[index] = offsetZ;
+
+				// On to the next column, sin(a + b) and cos(a + b) from those of a and b
+				bool renormalize = ++sinceRenormalize >= renormalizeInterval;
+				for (int w = 0; w < waveCount; w++)
+				{
+					float sine = sines[w] * stepCosines[w] + cosines[w] * stepSines[w];
+					float cosine = cosines[w] * stepCosines[w] - sines[w] * stepSines[w];
+					// One Newton step towards unit length, the error is tiny so that's enough
+					float scale = renormalize ? 1.5f - 0.5f * (sine * sine + cosine * cosine) : 1.f;
+					sines[w] = sine * scale;
+					cosines[w] = cosine * scale;
+				}
+				if (renormalize)
+					sinceRenormalize = 0;
+			}
+		}
+	}
+
+#if defined(OCEAN_SIMD_X86)
+	void SinCosSse(__m128 x, __m128& sine, __m128& cosine)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.f);
+		const __m128 one = _mm_set1_ps(1.f);
+
+		// Rounds to nearest, phases too large for an int are hopeless in float anyway
+		__m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(invTwoPi))));
+		__m128 y = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(twoPiHigh))), _mm_mul_ps(turns, _mm_set1_ps(twoPiLow)));
+
+		__m128 sign = _mm_and_ps(y, signMask);
+		__m128 fold = _mm_cmpgt_ps(_mm_andnot_ps(signMask, y), _mm_set1_ps(halfPi));
+		__m128 folded = _mm_sub_ps(_mm_or_ps(_mm_set1_ps(pi), sign), y);
+		y = _mm_or_ps(_mm_and_ps(fold, folded), _mm_andnot_ps(fold, y));
+		__m128 cosineSign = _mm_or_ps(_mm_and_ps(fold, signMask), one);
+
+		__m128 y2 = _mm_mul_ps(y, y);
+		__m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sin11), y2), _mm_set1_ps(sin9));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(sin7));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(sin5));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(sin3));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), one);
+		sine = _mm_mul_ps(s, y);
+
+		__m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(cos10), y2), _mm_set1_ps(cos8));
+		c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(cos6));
+		c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(cos4));
+		c = _mm_add_ps(_mm_mul_ps(c, y2), _mm_set1_ps(cos2));
+		c = _mm_add_ps(_mm_mul_ps(c, y2), one);
+		cosine = _mm_mul_ps(c, cosineSign);
+	}
+
+	void EvaluateSse(const Batch& batch, const float* x, const float* z, int count, const GerstnerSamples& output)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 two = _mm_set1_ps(2.f);
+		const __m128 time = _mm_set1_ps(batch.time);
+		const __m128 cameraX = _mm_set1_ps(batch.cameraX);
+		const __m128 cameraY2 = _mm_set1_ps(batch.cameraY * batch.cameraY);
+		const __m128 cameraZ = _mm_set1_ps(batch.cameraZ);
+		const __m128 attenuationEnd = _mm_set1_ps(batch.attenuationEnd);
+		const __m128 attenuationScale = _mm_set1_ps(batch.attenuationScale);
+
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 px = _mm_loadu_ps(x + i), pz = _mm_loadu_ps(z + i);
+
+			__m128 dx = _mm_sub_ps(px, cameraX), dz = _mm_sub_ps(pz, cameraZ);
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), cameraY2), _mm_mul_ps(dz, dz)));
+			__m128 fromEnd = _mm_sub_ps(distance, attenuationEnd);
+			__m128 attenuation = _mm_min_ps(_mm_mul_ps(_mm_mul_ps(fromEnd, fromEnd), attenuationScale), one);
+			attenuation = _mm_and_ps(attenuation, _mm_cmple_ps(distance, attenuationEnd));
+
+			__m128 weights[maxGerstnerWaveSets];
+			__m128 offsetX = zero, offsetY = zero, offsetZ = zero;
+			for (int set = 0; set < batch.setCount; set++)
+			{
+				__m128 fade = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(batch.fadeEnds[set]), distance), _mm_set1_ps(batch.fadeScales[set]));
+				weights[set] = _mm_mul_ps(_mm_min_ps(_mm_max_ps(fade, zero), one), attenuation);
+
+				__m128 setX = zero, setY = zero, setZ = zero;
+				for (int w = set * 4; w < set * 4 + 4; w++)
+				{
+					const GerstnerEvaluator::Wave& wave = batch.waves[w];
+					__m128 phase = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(wave.frequencyX), px), _mm_mul_ps(_mm_set1_ps(wave.frequencyZ), pz)),
+						_mm_mul_ps(time, _mm_set1_ps(wave.speed)));
+					__m128 sine, cosine;
+					SinCosSse(phase, sine, cosine);
+					setX = _mm_add_ps(setX, _mm_mul_ps(_mm_set1_ps(wave.offsetX), cosine));
+					setZ = _mm_add_ps(setZ, _mm_mul_ps(_mm_set1_ps(wave.offsetZ), cosine));
+					setY = _mm_add_ps(setY, _mm_mul_ps(_mm_set1_ps(wave.amplitude), sine));
+				}
+
+				offsetX = _mm_add_ps(offsetX, _mm_mul_ps(setX, weights[set]));
+				offsetY = _mm_add_ps(offsetY, _mm_mul_ps(setY, weights[set]));
+				offsetZ = _mm_add_ps(offsetZ, _mm_mul_ps(setZ, weights[set]));
+			}
+
+			_mm_storeu_ps(output.offsetX + i, offsetX);
+			_mm_storeu_ps(output.offsetY + i, offsetY);
+			_mm_storeu_ps(output.offsetZ + i, offsetZ);
+
+			if (output.normalX == nullptr)
+				continue;
+
+			__m128 displacedX = _mm_add_ps(px, offsetX), displacedZ = _mm_add_ps(pz, offsetZ);
+			__m128 normalX = zero, normalY = zero, normalZ = zero;
+			for (int set = 0; set < batch.setCount; set++)
+			{
+				__m128 setX = zero, setZ = zero;
+				for (int w = set * 4; w < set * 4 + 4; w++)
+				{
+					const GerstnerEvaluator::Wave& wave = batch.waves[w];
+					__m128 phase = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(wave.frequencyX), displacedX), _mm_mul_ps(_mm_set1_ps(wave.frequencyZ), displacedZ)),
+						_mm_mul_ps(time, _mm_set1_ps(wave.speed)));
+					__m128 sine, cosine;
+					SinCosSse(phase, sine, cosine);
+					setX = _mm_sub_ps(setX, _mm_mul_ps(_mm_set1_ps(wave.normalX), cosine));
+					setZ = _mm_sub_ps(setZ, _mm_mul_ps(_mm_set1_ps(wave.normalZ), cosine));
+				}
+
+				__m128 intensity = _mm_set1_ps(batch.intensities[set]);
+				setX = _mm_mul_ps(setX, intensity);
+				setZ = _mm_mul_ps(setZ, intensity);
+				__m128 weight = _mm_div_ps(weights[set], _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(setX, setX), _mm_set1_ps(4.f)), _mm_mul_ps(setZ, setZ))));
+				normalX = _mm_add_ps(normalX, _mm_mul_ps(setX, weight));
+				normalY = _mm_add_ps(normalY, _mm_mul_ps(two, weight));
+				normalZ = _mm_add_ps(normalZ, _mm_mul_ps(setZ, weight));
+			}
+
+			// Straight up where every set has faded out
+			__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(normalZ, normalZ));
+			__m128 waving = _mm_cmpgt_ps(lengthSquared, zero);
+			__m128 invLength = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(lengthSquared)), waving);
+			_mm_storeu_ps(output.normalX + i, _mm_mul_ps(normalX, invLength));
+			_mm_storeu_ps(output.normalY + i, _mm_or_ps(_mm_mul_ps(normalY, invLength), _mm_andnot_ps(waving, one)));
+			_mm_storeu_ps(output.normalZ + i, _mm_mul_ps(normalZ, invLength));
+		}
+
+		EvaluateScalar(batch, x, z, i, count, output);
+	}
+
+	// Every lane walks its own column of the row and steps four columns at a time,
+	// so the rotation is by four times the phase step between neighbouring points
+	void EvaluateLatticeSse(const Batch& batch, const GerstnerLattice& lattice, int renormalizeInterval, const GerstnerSamples& output)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 cameraX = _mm_set1_ps(batch.cameraX);
+		const __m128 cameraY2 = _mm_set1_ps(batch.cameraY * batch.cameraY);
+		const __m128 cameraZ = _mm_set1_ps(batch.cameraZ);
+		const __m128 attenuationEnd = _mm_set1_ps(batch.attenuationEnd);
+		const __m128 attenuationScale = _mm_set1_ps(batch.attenuationScale);
+		const __m128 laneOffsets = _mm_mul_ps(_mm_setr_ps(0.f, 1.f, 2.f, 3.f), _mm_set1_ps(lattice.spacing));
+
+		int waveCount = batch.setCount * 4;
+		__m128 sines[maxGerstnerWaveSets * 4], cosines[maxGerstnerWaveSets * 4];
+		__m128 stepSines[maxGerstnerWaveSets * 4], stepCosines[maxGerstnerWaveSets * 4];
+		for (int w = 0; w < waveCount; w++)
+		{
+			float stepSine, stepCosine;
+			SinCosScalar(batch.waves[w].frequencyX * lattice.spacing * 4.f, stepSine, stepCosine);
+			stepSines[w] = _mm_set1_ps(stepSine);
+			stepCosines[w] = _mm_set1_ps(stepCosine);
+		}
+
+		for (int row = 0; row < lattice.rows; row++)
+		{
+			__m128 pz = _mm_set1_ps(lattice.originZ + (float)row * lattice.spacing);
+			__m128 rowX = _mm_add_ps(_mm_set1_ps(lattice.originX), laneOffsets);
+			for (int w = 0; w < waveCount; w++)
+			{
+				const GerstnerEvaluator::Wave& wave = batch.waves[w];
+				__m128 phase = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(wave.frequencyX), rowX), _mm_mul_ps(_mm_set1_ps(wave.frequencyZ), pz)),
+					_mm_set1_ps(batch.time * wave.speed));
+				SinCosSse(phase, sines[w], cosines[w]);
+			}
+
+			int sinceRenormalize = 0;
+			for (int column = 0; column < lattice.columns; column += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps(lattice.originX + (float)column * lattice.spacing), laneOffsets);
+				__m128 dx = _mm_sub_ps(px, cameraX), dz = _mm_sub_ps(pz, cameraZ);
+				__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), cameraY2), _mm_mul_ps(dz, dz)));
+				__m128 fromEnd = _mm_sub_ps(distance, attenuationEnd);
+				__m128 attenuation = _mm_min_ps(_mm_mul_ps(_mm_mul_ps(fromEnd, fromEnd), attenuationScale), one);
+				attenuation = _mm_and_ps(attenuation, _mm_cmple_ps(distance, attenuationEnd));
+
+				bool renormalize = ++sinceRenormalize >= renormalizeInterval;
+				if (renormalize)
+					sinceRenormalize = 0;
+
+				__m128 offsetX = zero, offsetY = zero, offsetZ = zero;
+				for (int set = 0; set < batch.setCount; set++)
+				{
+					__m128 fade = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(batch.fadeEnds[set]), distance), _mm_set1_ps(batch.fadeScales[set]));
+					__m128 weight = _mm_mul_ps(_mm_min_ps(_mm_max_ps(fade, zero), one), attenuation);
+
+					__m128 setX = zero, setY = zero, setZ = zero;
+					for (int w = set * 4; w < set * 4 + 4; w++)
+					{
+						const GerstnerEvaluator::Wave& wave = batch.waves[w];
+						__m128 sine = sines[w], cosine = cosines[w];
+						setX = _mm_add_ps(setX, _mm_mul_ps(_mm_set1_ps(wave.offsetX), cosine));
+						setZ = _mm_add_ps(setZ, _mm_mul_ps(_mm_set1_ps(wave.offsetZ), cosine));
+						setY = _mm_add_ps(setY, _mm_mul_ps(_mm_set1_ps(wave.amplitude), sine));
+
+						// On to the next columns, sin(a + b) and cos(a + b) from those of a and b
+						__m128 nextSine = _mm_add_ps(_mm_mul_ps(sine, stepCosines[w]), _mm_mul_ps(cosine, stepSines[w]));
+						__m128 nextCosine = _mm_sub_ps(_mm_mul_ps(cosine, stepCosines[w]), _mm_mul_ps(sine, stepSines[w]));
+						if (renormalize)
+						{
+							__m128 lengthSquared = _mm_add_ps(_mm_mul_ps(nextSine, nextSine), _mm_mul_ps(nextCosine, nextCosine));
+							__m128 scale = _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_set1_ps(0.5f), lengthSquared));
+							nextSine = _mm_mul_ps(nextSine, scale);
+							nextCosine = _mm_mul_ps(nextCosine, scale);
+						}
+						sines[w] = nextSine;
+						cosines[w] = nextCosine;
+					}
+
+					offsetX = _mm_add_ps(offsetX, _mm_mul_ps(setX, weight));
+					offsetY = _mm_add_ps(offsetY, _mm_mul_ps(setY, weight));
+					offsetZ = _mm_add_ps(offsetZ, _mm_mul_ps(setZ, weight));
+				}
+
+				int index = row * lattice.columns + column;
+				if (column + 4 <= lattice.columns)
+				{
+					_mm_storeu_ps(output.offsetX + index, offsetX);
+					_mm_storeu_ps(output.offsetY + index, offsetY);
+					_mm_storeu_ps(output.offsetZ + index, offsetZ);
+				}
+				else
+				{
+					float lastX[4], lastY[4], lastZ[4];
+					_mm_storeu_ps(lastX, offsetX);
+					_mm_storeu_ps(lastY, offsetY);
+					_mm_storeu_ps(lastZ, offsetZ);
+					for (int lane = 0; lane < lattice.columns - column; lane++)
+					{
+						output.offsetX[index + lane] = lastX[lane];
+						output.offsetY[index + lane] = lastY[lane];
+						output.offsetZ[index + lane] = lastZ[lane];
+					}
+				}
+			}
+		}
+	}
+
+	OCEAN_TARGET_AVX void SinCosAvx(__m256 x, __m256& sine, __m256& cosine)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.f);
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		__m256 turns = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(invTwoPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 y = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(turns, _mm256_set1_ps(twoPiHigh))), _mm256_mul_ps(turns, _mm256_set1_ps(twoPiLow)));
+
+		__m256 sign = _mm256_and_ps(y, signMask);
+		__m256 fold = _mm256_cmp_ps(_mm256_andnot_ps(signMask, y), _mm256_set1_ps(halfPi), _CMP_GT_OQ);
+		__m256 folded = _mm256_sub_ps(_mm256_or_ps(_mm256_set1_ps(pi), sign), y);
+		y = _mm256_or_ps(_mm256_and_ps(fold, folded), _mm256_andnot_ps(fold, y));
+		__m256 cosineSign = _mm256_or_ps(_mm256_and_ps(fold, signMask), one);
+
+		__m256 y2 = _mm256_mul_ps(y, y);
+		__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(sin11), y2), _mm256_set1_ps(sin9));
+		s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(sin7));
+		s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(sin5));
+		s = _mm256_add_ps(_mm256_mul_ps(s, y2), _mm256_set1_ps(sin3));
+		s = _mm256_add_ps(_mm256_mul_ps(s, y2), one);
+		sine = _mm256_mul_ps(s, y);
+
+		__m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(cos10), y2), _mm256_set1_ps(cos8));
+		c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(cos6));
+		c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(cos4));
+		c = _mm256_add_ps(_mm256_mul_ps(c, y2), _mm256_set1_ps(cos2));
+		c = _mm256_add_ps(_mm256_mul_ps(c, y2), one);
+		cosine = _mm256_mul_ps(c, cosineSign);
+	}
+
+	OCEAN_TARGET_AVX void EvaluateAvx(const Batch& batch, const float* x, const float* z, int count, const GerstnerSamples& output)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 two = _mm256_set1_ps(2.f);
+		const __m256 time = _mm256_set1_ps(batch.time);
+		const __m256 cameraX = _mm256_set1_ps(batch.cameraX);
+		const __m256 cameraY2 = _mm256_set1_ps(batch.cameraY * batch.cameraY);
+		const __m256 cameraZ = _mm256_set1_ps(batch.cameraZ);
+		const __m256 attenuationEnd = _mm256_set1_ps(batch.attenuationEnd);
+		const __m256 attenuationScale = _mm256_set1_ps(batch.attenuationScale);
+
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 px = _mm256_loadu_ps(x + i), pz = _mm256_loadu_ps(z + i);
+
+			__m256 dx = _mm256_sub_ps(px, cameraX), dz = _mm256_sub_ps(pz, cameraZ);
+			__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), cameraY2), _mm256_mul_ps(dz, dz)));
+			__m256 fromEnd = _mm256_sub_ps(distance, attenuationEnd);
+			__m256 attenuation = _mm256_min_ps(_mm256_mul_ps(_mm256_mul_ps(fromEnd, fromEnd), attenuationScale), one);
+			attenuation = _mm256_and_ps(attenuation, _mm256_cmp_ps(distance, attenuationEnd, _CMP_LE_OQ));
+
+			__m256 weights[maxGerstnerWaveSets];
+			__m256 offsetX = zero, offsetY = zero, offsetZ = zero;
+			for (int set = 0; set < batch.setCount; set++)
+			{
+				__m256 fade = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(batch.fadeEnds[set]), distance), _mm256_set1_ps(batch.fadeScales[set]));
+				weights[set] = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(fade, zero), one), attenuation);
+
+				__m256 setX = zero, setY = zero, setZ = zero;
+				for (int w = set * 4; w < set * 4 + 4; w++)
+				{
+					const GerstnerEvaluator::Wave& wave = batch.waves[w];
+					__m256 phase = _mm256_add_ps(
+						_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(wave.frequencyX), px), _mm256_mul_ps(_mm256_set1_ps(wave.frequencyZ), pz)),
+						_mm256_mul_ps(time, _mm256_set1_ps(wave.speed)));
+					__m256 sine, cosine;
+					SinCosAvx(phase, sine, cosine);
+					setX = _mm256_add_ps(setX, _mm256_mul_ps(_mm256_set1_ps(wave.offsetX), cosine));
+					setZ = _mm256_add_ps(setZ, _mm256_mul_ps(_mm256_set1_ps(wave.offsetZ), cosine));
+					setY = _mm256_add_ps(setY, _mm256_mul_ps(_mm256_set1_ps(wave.amplitude), sine));
+				}
+
+				offsetX = _mm256_add_ps(offsetX, _mm256_mul_ps(setX, weights[set]));
+				offsetY = _mm256_add_ps(offsetY, _mm256_mul_ps(setY, weights[set]));
+				offsetZ = _mm256_add_ps(offsetZ, _mm256_mul_ps(setZ, weights[set]));
+			}
+
+			_mm256_storeu_ps(output.offsetX + i, offsetX);
+			_mm256_storeu_ps(output.offsetY + i, offsetY);
+			_mm256_storeu_ps(output.offsetZ + i, offsetZ);
+
+			if (output.normalX == nullptr)
+				continue;
+
+			__m256 displacedX = _mm256_add_ps(px, offsetX), displacedZ = _mm256_add_ps(pz, offsetZ);
+			__m256 normalX = zero, normalY = zero, normalZ = zero;
+			for (int set = 0; set < batch.setCount; set++)
+			{
+				__m256 setX = zero, setZ = zero;
+				for (int w = set * 4; w < set * 4 + 4; w++)
+				{
+					const GerstnerEvaluator::Wave& wave = batch.waves[w];
+					__m256 phase = _mm256_add_ps(
+						_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(wave.frequencyX), displacedX), _mm256_mul_ps(_mm256_set1_ps(wave.frequencyZ), displacedZ)),
+						_mm256_mul_ps(time, _mm256_set1_ps(wave.speed)));
+					__m256 sine, cosine;
+					SinCosAvx(phase, sine, cosine);
+					setX = _mm256_sub_ps(setX, _mm256_mul_ps(_mm256_set1_ps(wave.normalX), cosine));
+					setZ = _mm256_sub_ps(setZ, _mm256_mul_ps(_mm256_set1_ps(wave.normalZ), cosine));
+				}
+
+				__m256 intensity = _mm256_set1_ps(batch.intensities[set]);
+				setX = _mm256_mul_ps(setX, intensity);
+				setZ = _mm256_mul_ps(setZ, intensity);
+				__m256 weight = _mm256_div_ps(weights[set], _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(setX, setX), _mm256_set1_ps(4.f)), _mm256_mul_ps(setZ, setZ))));
+				normalX = _mm256_add_ps(normalX, _mm256_mul_ps(setX, weight));
+				normalY = _mm256_add_ps(normalY, _mm256_mul_ps(two, weight));
+				normalZ = _mm256_add_ps(normalZ, _mm256_mul_ps(setZ, weight));
+			}
+
+			// Straight up where every set has faded out
+			__m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX, normalX), _mm256_mul_ps(normalY, normalY)), _mm256_mul_ps(normalZ, normalZ));
+			__m256 waving = _mm256_cmp_ps(lengthSquared, zero, _CMP_GT_OQ);
+			__m256 invLength = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared)), waving);
+			_mm256_storeu_ps(output.normalX + i, _mm256_mul_ps(normalX, invLength));
+			_mm256_storeu_ps(output.normalY + i, _mm256_or_ps(_mm256_mul_ps(normalY, invLength), _mm256_andnot_ps(waving, one)));
+			_mm256_storeu_ps(output.normalZ + i, _mm256_mul_ps(normalZ, invLength));
+		}
+
+		EvaluateScalar(batch, x, z, i, count, output);
+	}
+	OCEAN_TARGET_AVX void EvaluateLatticeAvx(const Batch& batch, const GerstnerLattice& lattice, int renormalizeInterval, const GerstnerSamples& output)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 cameraX = _mm256_set1_ps(batch.cameraX);
+		const __m256 cameraY2 = _mm256_set1_ps(batch.cameraY * batch.cameraY);
+		const __m256 cameraZ = _mm256_set1_ps(batch.cameraZ);
+		const __m256 attenuationEnd = _mm256_set1_ps(batch.attenuationEnd);
+		const __m256 attenuationScale = _mm256_set1_ps(batch.attenuationScale);
+		const __m256 laneOffsets = _mm256_mul_ps(_mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f), _mm256_set1_ps(lattice.spacing));
+
+		int waveCount = batch.setCount * 4;
+		__m256 sines[maxGerstnerWaveSets * 4], cosines[maxGerstnerWaveSets * 4];
+		__m256 stepSines[maxGerstnerWaveSets * 4], stepCosines[maxGerstnerWaveSets * 4];
+		for (int w = 0; w < waveCount; w++)
+		{
+			float stepSine, stepCosine;
+			SinCosScalar(batch.waves[w].frequencyX * lattice.spacing * 8.f, stepSine, stepCosine);
+			stepSines[w] = _mm256_set1_ps(stepSine);
+			stepCosines[w] = _mm256_set1_ps(stepCosine);
+		}
+
+		for (int row = 0; row < lattice.rows; row++)
+		{
+			__m256 pz = _mm256_set1_ps(lattice.originZ + (float)row * lattice.spacing);
+			__m256 rowX = _mm256_add_ps(_mm256_set1_ps(lattice.originX), laneOffsets);
+			for (int w = 0; w < waveCount; w++)
+			{
+				const GerstnerEvaluator::Wave& wave = batch.waves[w];
+				__m256 phase = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(wave.frequencyX), rowX), _mm256_mul_ps(_mm256_set1_ps(wave.frequencyZ), pz)),
+					_mm256_set1_ps(batch.time * wave.speed));
+				SinCosAvx(phase, sines[w], cosines[w]);
+			}
+
+			int sinceRenormalize = 0;
+			for (int column = 0; column < lattice.columns; column += 8)
+			{
+				__m256 px = _mm256_add_ps(_mm256_set1_ps(lattice.originX + (float)column * lattice.spacing), laneOffsets);
+				__m256 dx = _mm256_sub_ps(px, cameraX), dz = _mm256_sub_ps(pz, cameraZ);
+				__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), cameraY2), _mm256_mul_ps(dz, dz)));
+				__m256 fromEnd = _mm256_sub_ps(distance, attenuationEnd);
+				__m256 attenuation = _mm256_min_ps(_mm256_mul_ps(_mm256_mul_ps(fromEnd, fromEnd), attenuationScale), one);
+				attenuation = _mm256_and_ps(attenuation, _mm256_cmp_ps(distance, attenuationEnd, _CMP_LE_OQ));
+
+				bool renormalize = ++sinceRenormalize >= renormalizeInterval;
+				if (renormalize)
+					sinceRenormalize = 0;
+
+				__m256 offsetX = zero, offsetY = zero, offsetZ = zero;
+				for (int set = 0; set < batch.setCount; set++)
+				{
+					__m256 fade = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(batch.fadeEnds[set]), distance), _mm256_set1_ps(batch.fadeScales[set]));
+					__m256 weight = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(fade, zero), one), attenuation);
+
+					__m256 setX = zero, setY = zero, setZ = zero;
+					for (int w = set * 4; w < set * 4 + 4; w++)
+					{
+						const GerstnerEvaluator::Wave& wave = batch.waves[w];
+						__m256 sine = sines[w], cosine = cosines[w];
+						setX = _mm256_add_ps(setX, _mm256_mul_ps(_mm256_set1_ps(wave.offsetX), cosine));
+						setZ = _mm256_add_ps(setZ, _mm256_mul_ps(_mm256_set1_ps(wave.offsetZ), cosine));
+						setY = _mm256_add_ps(setY, _mm256_mul_ps(_mm256_set1_ps(wave.amplitude), sine));
+
+						// On to the next columns, sin(a + b) and cos(a + b) from those of a and b
+						__m256 nextSine = _mm256_add_ps(_mm256_mul_ps(sine, stepCosines[w]), _mm256_mul_ps(cosine, stepSines[w]));
+						__m256 nextCosine = _mm256_sub_ps(_mm256_mul_ps(cosine, stepCosines[w]), _mm256_mul_ps(sine, stepSines[w]));
+						if (renormalize)
+						{
+							__m256 lengthSquared = _mm256_add_ps(_mm256_mul_ps(nextSine, nextSine), _mm256_mul_ps(nextCosine, nextCosine));
+							__m256 scale = _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_set1_ps(0.5f), lengthSquared));
+							nextSine = _mm256_mul_ps(nextSine, scale);
+							nextCosine = _mm256_mul_ps(nextCosine, scale);
+						}
+						sines[w] = nextSine;
+						cosines[w] = nextCosine;
+					}
+
+					offsetX = _mm256_add_ps(offsetX, _mm256_mul_ps(setX, weight));
+					offsetY = _mm256_add_ps(offsetY, _mm256_mul_ps(setY, weight));
+					offsetZ = _mm256_add_ps(offsetZ, _mm256_mul_ps(setZ, weight));
+				}
+
+				int index = row * lattice.columns + column;
+				if (column + 8 <= lattice.columns)
+				{
+					_mm256_storeu_ps(output.offsetX + index, offsetX);
+					_mm256_storeu_ps(output.offsetY + index, offsetY);
+					_mm256_storeu_ps(output.offsetZ + index, offsetZ);
+				}
+				else
+				{
+					float lastX[8], lastY[8], lastZ[8];
+					_mm256_storeu_ps(lastX, offsetX);
+					_mm256_storeu_ps(lastY, offsetY);
+					_mm256_storeu_ps(lastZ, offsetZ);
+					for (int lane = 0; lane < lattice.columns - column; lane++)
+					{
+						output.offsetX[index + lane] = lastX[lane];
+						output.offsetY[index + lane] = lastY[lane];
+						output.offsetZ[index + lane] = lastZ[lane];
+					}
+				}
+			}
+		}
+	}
+
+#endif
+}
+
+GerstnerEvaluator::GerstnerEvaluator(const GerstnerWaveSet* waveSets, int waveSetCount)
+	: attenuationStart(gerstnerAttenuationStart), attenuationEnd(gerstnerAttenuationEnd), renormalizeInterval(16),
+	simd(CpuFeatures::HasAvx() ? GerstnerAvx : CpuFeatures::HasSse2() ? GerstnerSse : GerstnerScalar)
+{
+	// The SIMD paths keep a weight per set on the stack
+	assert(waveSetCount <= maxGerstnerWaveSets);
+
+	waves.resize(waveSetCount * 4);
+	intensities.resize(waveSetCount);
+	fadeEnds.resize(waveSetCount);
+	fadeScales.resize(waveSetCount);
+	for (int set = 0; set < waveSetCount; set++)
+	{
+		const GerstnerWaveSet& source = waveSets[set];
+		intensities[set] = source.intensity;
+		fadeEnds[set] = source.lodFadeEnd;
+		fadeScales[set] = source.lodFadeEnd > source.lodFadeStart ? 1.f / (source.lodFadeEnd - source.lodFadeStart) : 1e30f;
+		for (int i = 0; i < 4; i++)
+		{
+			Wave& wave = waves[set * 4 + i];
+			wave.frequencyX = source.frequency[i] * source.directionX[i];
+			wave.frequencyZ = source.frequency[i] * source.directionZ[i];
+			wave.speed = source.speed[i];
+			wave.amplitude = source.amplitude[i];
+			wave.offsetX = source.steepness[i] * source.amplitude[i] * source.directionX[i];
+			wave.offsetZ = source.steepness[i] * source.amplitude[i] * source.directionZ[i];
+			wave.normalX = source.frequency[i] * source.amplitude[i] * source.directionX[i];
+			wave.normalZ = source.frequency[i] * source.amplitude[i] * source.directionZ[i];
+		}
+	}
+}
+
+void GerstnerEvaluator::Evaluate(
+	const float* x,
+	const float* z,
+	int count,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	const GerstnerSamples& output) const
+{
+	Batch batch = MakeBatch(waves, intensities, fadeEnds, fadeScales, attenuationStart, attenuationEnd, time, cameraX, cameraY, cameraZ);
+
+#if defined(OCEAN_SIMD_X86)
+	if (simd >= GerstnerAvx && CpuFeatures::HasAvx())
+		EvaluateAvx(batch, x, z, count, output);
+	else if (simd >= GerstnerSse)
+		EvaluateSse(batch, x, z, count, output);
+	else
+#endif
+		EvaluateScalar(batch, x, z, 0, count, output);
+}
+
+void GerstnerEvaluator::EvaluateLattice(
+	const GerstnerLattice& lattice,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	const GerstnerSamples& output) const
+{
+	assert(output.normalX == nullptr && output.normalY == nullptr && output.normalZ == nullptr);
+	assert(renormalizeInterval > 0);
+
+	Batch batch = MakeBatch(waves, intensities, fadeEnds, fadeScales, attenuationStart, attenuationEnd, time, cameraX, cameraY, cameraZ);
+
+#if defined(OCEAN_SIMD_X86)
+	if (simd >= GerstnerAvx && CpuFeatures::HasAvx())
+		EvaluateLatticeAvx(batch, lattice, renormalizeInterval, output);
+	else if (simd >= GerstnerSse)
+		EvaluateLatticeSse(batch, lattice, renormalizeInterval, output);
+	else
+#endif
+		EvaluateLatticeScalar(batch, lattice, renormalizeInterval, output);
+}
+
+float GerstnerEvaluator::GetOffsetY(float x, float z, float time, float cameraX, float cameraY, float cameraZ) const
+{
+	float offsetX, offsetY, offsetZ;
+	GerstnerSamples output = { &offsetX, &offsetY, &offsetZ, nullptr, nullptr, nullptr };
+	Evaluate(&x, &z, 1, time, cameraX, cameraY, cameraZ, output);
+	return offsetY;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "GerstnerWaves.h"
+#include <vector>
+
+namespace Ocean
+{
+	// Structure-of-arrays output of GerstnerEvaluator, every array holds count floats.
+	// The normal arrays can be null when only the displacement is needed.
+	struct GerstnerSamples
+	{
+		float* offsetX;
+		float* offsetY;
+		float* offsetZ;
+		float* normalX;
+		float* normalY;
+		float* normalZ;
+	};
+
+	// Widest instruction set GerstnerEvaluator uses
+	enum GerstnerSimd
+	{
+		GerstnerScalar,
+		GerstnerSse,
+		GerstnerAvx
+	};
+
+	// Regular grid of undisplaced points, point column, row is at originX + column * spacing, originZ + row * spacing
+	// and its results go to index row * columns + column
+	struct GerstnerLattice
+	{
+		float originX;
+		float originZ;
+		float spacing;
+		int columns;
+		int rows;
+	};
+
+	// Evaluates the waves the way DisplaceWaterSurface in WaterCommon.hlsli does, so the CPU knows where the surface is.
+	// The points are on the undisplaced y = 0 plane. Every set is scaled by its LOD fade and the distance attenuation
+	// like in the shader, and the normal is taken at the displaced point. Within a kilometre of the origin it matches
+	// exact math to 3e-5 units in the offsets, most of it float rounding of the phase like on the GPU, and 2e-6 in the
+	// normals. Points where every set has faded out get an up normal, like in the shader.
+	// Points are processed 8 or 4 at a time with AVX or SSE, whichever the CPU supports unless simd is lowered, using a
+	// polynomial sin/cos. Every path gets the same results to float rounding.
+	// Takes at most maxGerstnerWaveSets sets and only depends on the standard library.
+	class GerstnerEvaluator
+	{
+	public:
+		GerstnerEvaluator(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		void Evaluate(
+			const float* x,
+			const float* z,
+			int count,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			const GerstnerSamples& output) const;
+
+		// Same offsets as Evaluate on the lattice's points without a sin or cos per wave and point. Along a row the phase
+		// of every wave grows by the same step, so its sine and cosine are rotated by that step with one complex multiply.
+		// Each row starts from exact values and the rotated ones are pulled back to unit length every
+		// renormalizeInterval steps, which keeps the offsets within 3e-5 units of Evaluate on rows of a thousand points.
+		// Both are about 2e-5 off exact math there, the phase steps are rounded like the phases.
+		// Every SIMD lane walks its own column and steps 8 or 4 columns at a time. Only fills the offsets, the normal
+		// arrays have to be null since the normals are taken at the displaced points, which aren't on the lattice.
+		void EvaluateLattice(
+			const GerstnerLattice& lattice,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			const GerstnerSamples& output) const;
+
+		// Height of the surface above the undisplaced point x, z
+		float GetOffsetY(float x, float z, float time, float cameraX, float cameraY, float cameraZ) const;
+
+		float attenuationStart;
+		float attenuationEnd;
+		int renormalizeInterval;
+
+		// Starts at the best the CPU supports, asking for more than that falls back to it
+		GerstnerSimd simd;
+
+		// Per wave constants with the shader's products folded in, four waves per set
+		struct Wave
+		{
+			float frequencyX, frequencyZ;
+			float speed;
+			float amplitude;
+			float offsetX, offsetZ;
+			float normalX, normalZ;
+		};
+
+	private:
+		std::vector<Wave> waves;
+		std::vector<float> intensities;
+		std::vector<float> fadeEnds;
+		std::vector<float> fadeScales;
+	};
+}
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "GerstnerMeshDisplacer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+using namespace Ocean;
+
+namespace
+{
+	// Vertices evaluated together, their scratch stays on the stack
+	const int blockSize = 256;
+}
+
+GerstnerMeshDisplacer::GerstnerMeshDisplacer(const GerstnerWaveSet* waveSets, int waveSetCount)
+	: evaluator(waveSets, waveSetCount)
+{ }
+
+void GerstnerMeshDisplacer::Displace(
+	const float* planeXZ,
+	int count,
+	float originX, float originZ,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	float* vertices,
+	ThreadPool* pool) const
+{
+	int blockCount = (count + blockSize - 1) / blockSize;
+	auto body = [=](int begin, int end) {
+		for (int block = begin; block < end; block++)
+		{
+			int first = block * blockSize;
+			DisplaceBlock(planeXZ + first * 2, std::min(blockSize, count - first), originX, originZ, time,
+				cameraX, cameraY, cameraZ, vertices + first * floatsPerVertex);
+		}
+	};
+
+	if (pool != nullptr)
+		pool->ParallelFor(blockCount, 4, body);
+	else
+		body(0, blockCount);
+}
+
+void GerstnerMeshDisplacer::DisplaceBlock(
+	const float* planeXZ,
+	int count,
+	float originX, float originZ,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	float* vertices) const
+{
+	float x[blockSize] = { }, z[blockSize] = { }, samples[blockSize * 6];
+	for (int i = 0; i < count; i++)
+	{
+		x[i] = planeXZ[i * 2] + originX;
+		z[i] = planeXZ[i * 2 + 1] + originZ;
+	}
+
+	GerstnerSamples output = { samples, samples + blockSize, samples + blockSize * 2, samples + blockSize * 3, samples + blockSize * 4, samples + blockSize * 5 };
+	evaluator.Evaluate(x, z, count, time, cameraX, cameraY, cameraZ, output);
+
+	for (int i = 0; i < count; i++)
+	{
+		float* vertex = vertices + i * floatsPerVertex;
+		vertex[0] = x[i] + output.offsetX[i];
+		vertex[1] = output.offsetY[i];
+		vertex[2] = z[i] + output.offsetZ[i];
+		vertex[3] = output.normalX[i];
+		vertex[4] = output.normalY[i];
+		vertex[5] = output.normalZ[i];
+		vertex[6] = x[i];
+		vertex[7] = z[i];
+	}
+}
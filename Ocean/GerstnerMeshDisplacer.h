@@ -0,0 +1,42 @@
+#pragma once
+#include "GerstnerEvaluator.h"
+
+namespace Ocean
+{
+	class ThreadPool;
+
+	// Moves the vertices of a flat water mesh by the Gerstner waves on the CPU, for devices where the vertex shader
+	// can't afford the waves. Every vertex comes out as eight floats: the displaced position and the normal in world
+	// space and the undisplaced x, z, which the pixel shader's normal maps scroll with. Blocks of vertices go through
+	// GerstnerEvaluator's SIMD paths split over the thread pool, so the results match the water vertex shader.
+	// Only depends on the standard library.
+	class GerstnerMeshDisplacer
+	{
+	public:
+		GerstnerMeshDisplacer(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		static const int floatsPerVertex = 8;
+
+		// planeXZ holds x, z pairs of count vertices in the mesh's space, originX, originZ moves them into world space.
+		// pool can be null to run on the calling thread only.
+		void Displace(
+			const float* planeXZ,
+			int count,
+			float originX, float originZ,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			float* vertices,
+			ThreadPool* pool) const;
+
+	private:
+		void DisplaceBlock(
+			const float* planeXZ,
+			int count,
+			float originX, float originZ,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			float* vertices) const;
+
+		GerstnerEvaluator evaluator;
+	};
+}
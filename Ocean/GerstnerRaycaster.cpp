@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "GerstnerRaycaster.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace Ocean;
+
+namespace
+{
+	// Below this the ray runs along the slab
+	const float flatDirection = 1e-6f;
+
+	// Where the line through two samples on either side of the surface crosses it
+	float FalsePosition(float low, float high, float lowGap, float highGap)
+	{
+		float denominator = lowGap - highGap;
+		return denominator > 0.f ? low + (high - low) * lowGap / denominator : (low + high) * 0.5f;
+	}
+}
+
+GerstnerRaycaster::GerstnerRaycaster(const GerstnerWaveSet* waveSets, int waveSetCount)
+	: maxMarchSteps(64), refineIterations(6), inversionIterations(3), tolerance(1e-3f),
+	evaluator(waveSets, waveSetCount)
+{
+	maxHeight = GetMaxGerstnerHeight(waveSets, waveSetCount);
+
+	float shortestWavelength = FLT_MAX;
+	for (int set = 0; set < waveSetCount; set++)
+		shortestWavelength = std::min(shortestWavelength, GetShortestGerstnerWavelength(waveSets[set]));
+	stepLength = shortestWavelength < FLT_MAX ? shortestWavelength * 0.25f : FLT_MAX;
+}
+
+void GerstnerRaycaster::Intersect(
+	const GerstnerRays& rays,
+	int count,
+	float maxDistance,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	float* hitDistance)
+{
+	low.resize(count);
+	high.resize(count);
+	lowGap.resize(count);
+	highGap.resize(count);
+	marchStart.resize(count);
+	marchStep.resize(count);
+	marchStepCount.resize(count);
+	marchStepIndex.resize(count);
+	lastSide.resize(count);
+	undisplacedX.resize(count);
+	undisplacedZ.resize(count);
+
+	// Clip to the slab between the lowest trough and the highest crest
+	active.clear();
+	for (int i = 0; i < count; i++)
+	{
+		hitDistance[i] = -1.f;
+
+		// Under the lowest trough the origin is under water whichever way the ray goes, clipping would
+		// move it up to the slab or drop it
+		float originY = rays.originY[i], directionY = rays.directionY[i];
+		if (originY < -maxHeight)
+		{
+			hitDistance[i] = 0.f;
+			continue;
+		}
+
+		float enter = 0.f, exit = maxDistance;
+		if (fabsf(directionY) > flatDirection)
+		{
+			float top = (maxHeight - originY) / directionY;
+			float bottom = (-maxHeight - originY) / directionY;
+			enter = std::max(enter, std::min(top, bottom));
+			exit = std::min(exit, std::max(top, bottom));
+		}
+		else if (fabsf(originY) > maxHeight)
+		{
+			continue;
+		}
+
+		if (enter > exit)
+			continue;
+
+		float horizontalLength = sqrtf(rays.directionX[i] * rays.directionX[i] + rays.directionZ[i] * rays.directionZ[i]);
+		float length = sqrtf(horizontalLength * horizontalLength + directionY * directionY);
+		float steps = ceilf((exit - enter) * length / stepLength);
+		marchStepCount[i] = (int)std::min(std::max(steps, 1.f), (float)maxMarchSteps);
+		marchStepIndex[i] = 0;
+		marchStart[i] = enter;
+		marchStep[i] = (exit - enter) / (float)marchStepCount[i];
+		low[i] = enter;
+		lastSide[i] = 0;
+		undisplacedX[i] = rays.originX[i] + rays.directionX[i] * enter;
+		undisplacedZ[i] = rays.originZ[i] + rays.directionZ[i] * enter;
+		active.push_back(i);
+	}
+
+	// Rays that enter the slab under the surface hit right there, that's at 0 for origins in the slab under water
+	sampleDistance.resize(active.size());
+	for (size_t j = 0; j < active.size(); j++)
+		sampleDistance[j] = low[active[j]];
+	EvaluateGaps(rays, time, cameraX, cameraY, cameraZ);
+
+	size_t kept = 0;
+	for (size_t j = 0; j < active.size(); j++)
+	{
+		int i = active[j];
+		if (sampleGap[j] <= 0.f)
+			hitDistance[i] = low[i];
+		else
+		{
+			lowGap[i] = sampleGap[j];
+			active[kept++] = i;
+		}
+	}
+	active.resize(kept);
+
+	// March until each ray is under the surface, that brackets its first hit
+	refining.clear();
+	while (!active.empty())
+	{
+		sampleDistance.resize(active.size());
+		for (size_t j = 0; j < active.size(); j++)
+		{
+			int i = active[j];
+			marchStepIndex[i]++;
+			sampleDistance[j] = marchStart[i] + marchStep[i] * (float)marchStepIndex[i];
+		}
+		EvaluateGaps(rays, time, cameraX, cameraY, cameraZ);
+
+		kept = 0;
+		for (size_t j = 0; j < active.size(); j++)
+		{
+			int i = active[j];
+			if (sampleGap[j] <= 0.f)
+			{
+				high[i] = sampleDistance[j];
+				highGap[i] = sampleGap[j];
+				refining.push_back(i);
+			}
+			else
+			{
+				low[i] = sampleDistance[j];
+				lowGap[i] = sampleGap[j];
+				if (marchStepIndex[i] < marchStepCount[i])
+					active[kept++] = i;
+			}
+		}
+		active.resize(kept);
+	}
+
+	// Illinois: halving the gap kept on the side that didn't move stops regula falsi from stalling
+	active.swap(refining);
+	for (int iteration = 0; iteration < refineIterations && !active.empty(); iteration++)
+	{
+		sampleDistance.resize(active.size());
+		for (size_t j = 0; j < active.size(); j++)
+		{
+			int i = active[j];
+			sampleDistance[j] = FalsePosition(low[i], high[i], lowGap[i], highGap[i]);
+		}
+		EvaluateGaps(rays, time, cameraX, cameraY, cameraZ);
+
+		kept = 0;
+		for (size_t j = 0; j < active.size(); j++)
+		{
+			int i = active[j];
+			float gap = sampleGap[j];
+			hitDistance[i] = sampleDistance[j];
+			if (fabsf(gap) <= tolerance)
+				continue;
+
+			if (gap > 0.f)
+			{
+				low[i] = sampleDistance[j];
+				lowGap[i] = gap;
+				if (lastSide[i] > 0)
+					highGap[i] *= 0.5f;
+				lastSide[i] = 1;
+			}
+			else
+			{
+				high[i] = sampleDistance[j];
+				highGap[i] = gap;
+				if (lastSide[i] < 0)
+					lowGap[i] *= 0.5f;
+				lastSide[i] = -1;
+			}
+			active[kept++] = i;
+		}
+		active.resize(kept);
+	}
+
+	// Rays out of iterations take the last estimate
+	for (int i : active)
+		hitDistance[i] = FalsePosition(low[i], high[i], lowGap[i], highGap[i]);
+}
+
+void GerstnerRaycaster::GetHeights(
+	const float* x,
+	const float* z,
+	int count,
+	float time,
+	float cameraX, float cameraY, float cameraZ,
+	float* height)
+{
+	targetX.assign(x, x + count);
+	targetZ.assign(z, z + count);
+	pointX.assign(x, x + count);
+	pointZ.assign(z, z + count);
+
+	// No earlier sample to start from, so twice the iterations
+	for (int pass = 0; pass < 2; pass++)
+		InvertDisplacement(count, time, cameraX, cameraY, cameraZ);
+
+	std::copy(offsetY.begin(), offsetY.begin() + count, height);
+}
+
+void GerstnerRaycaster::InvertDisplacement(int count, float time, float cameraX, float cameraY, float cameraZ)
+{
+	offsetX.resize(count);
+	offsetY.resize(count);
+	offsetZ.resize(count);
+	GerstnerSamples output = { offsetX.data(), offsetY.data(), offsetZ.data(), nullptr, nullptr, nullptr };
+
+	// p = target - offset(p), it converges where the waves don't fold over
+	for (int iteration = 0; iteration < inversionIterations; iteration++)
+	{
+		evaluator.Evaluate(pointX.data(), pointZ.data(), count, time, cameraX, cameraY, cameraZ, output);
+		for (int j = 0; j < count; j++)
+		{
+			pointX[j] = targetX[j] - offsetX[j];
+			pointZ[j] = targetZ[j] - offsetZ[j];
+		}
+	}
+}
+
+void GerstnerRaycaster::EvaluateGaps(const GerstnerRays& rays, float time, float cameraX, float cameraY, float cameraZ)
+{
+	int count = (int)active.size();
+	targetX.resize(count);
+	targetZ.resize(count);
+	pointX.resize(count);
+	pointZ.resize(count);
+	sampleGap.resize(count);
+
+	for (int j = 0; j < count; j++)
+	{
+		int i = active[j];
+		targetX[j] = rays.originX[i] + rays.directionX[i] * sampleDistance[j];
+		targetZ[j] = rays.originZ[i] + rays.directionZ[i] * sampleDistance[j];
+		pointX[j] = undisplacedX[i];
+		pointZ[j] = undisplacedZ[i];
+	}
+
+	InvertDisplacement(count, time, cameraX, cameraY, cameraZ);
+
+	for (int j = 0; j < count; j++)
+	{
+		int i = active[j];
+		undisplacedX[i] = pointX[j];
+		undisplacedZ[i] = pointZ[j];
+		sampleGap[j] = rays.originY[i] + rays.directionY[i] * sampleDistance[j] - offsetY[j];
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "GerstnerEvaluator.h"
+#include <vector>
+
+namespace Ocean
+{
+	// Rays as structure of arrays. The directions don't have to be normalized, hit distances are in multiples of them.
+	struct GerstnerRays
+	{
+		const float* originX;
+		const float* originY;
+		const float* originZ;
+		const float* directionX;
+		const float* directionY;
+		const float* directionZ;
+	};
+
+	// Intersects rays with the surface GerstnerEvaluator describes, the one the water shader draws.
+	// Each ray is clipped to the slab the waves can reach, marched across it in steps of a quarter of the shortest
+	// wave until it is below the surface and then refined with regula falsi (Illinois) iterations.
+	// The height under a point of the ray needs the undisplaced point the waves move there, which is found
+	// by fixed point iteration warm started from the ray's previous sample.
+	// All rays advance together so every step is one batched call to the evaluator.
+	// Keeps scratch memory between calls, so one raycaster can't be used from several threads at once.
+	// Only depends on the standard library.
+	class GerstnerRaycaster
+	{
+	public:
+		GerstnerRaycaster(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+		// hitDistance gets the first t in [0, maxDistance] where origin + t * direction is on or below the surface,
+		// or -1 for rays that miss. Rays that start under water hit at 0, whichever way they point.
+		void Intersect(
+			const GerstnerRays& rays,
+			int count,
+			float maxDistance,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			float* hitDistance);
+
+		// Height of the surface over the world position x, z, which is not the undisplaced point the evaluator takes
+		void GetHeights(
+			const float* x,
+			const float* z,
+			int count,
+			float time,
+			float cameraX, float cameraY, float cameraZ,
+			float* height);
+
+		// Most march steps across the slab, grazing rays are cut short after them
+		int maxMarchSteps;
+		int refineIterations;
+		// Evaluations per height query, each one brings the undisplaced point closer
+		int inversionIterations;
+		// Refining stops once the ray is this close to the surface vertically
+		float tolerance;
+
+	private:
+		// Moves pointX, pointZ towards the undisplaced points the waves carry to targetX, targetZ.
+		// offsetY ends up with the height at the last point evaluated.
+		void InvertDisplacement(int count, float time, float cameraX, float cameraY, float cameraZ);
+
+		// sampleGap gets how far the rays in active are above the surface at sampleDistance, negative below it
+		void EvaluateGaps(const GerstnerRays& rays, float time, float cameraX, float cameraY, float cameraZ);
+
+		GerstnerEvaluator evaluator;
+		float maxHeight;
+		float stepLength;
+
+		// Per ray
+		std::vector<float> low, high, lowGap, highGap;
+		std::vector<float> marchStart, marchStep;
+		std::vector<int> marchStepCount, marchStepIndex, lastSide;
+		std::vector<float> undisplacedX, undisplacedZ;
+
+		// Per active ray
+		std::vector<int> active, refining;
+		std::vector<float> sampleDistance, sampleGap;
+		std::vector<float> targetX, targetZ, pointX, pointZ, offsetX, offsetY, offsetZ;
+	};
+}
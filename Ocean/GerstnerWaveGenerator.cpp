@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "GerstnerWaveGenerator.h"
+#include "WaveSpectrum.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+using namespace Ocean;
+
+namespace
+{
+	const float pi = 3.14159265358979324f;
+
+	// Integral of the spectrum between two frequencies, midpoints in log frequency where it changes the least
+	float IntegrateSpectrum(float lowest, float highest, int steps, float windSpeed, float fetch)
+	{
+		float logStep = logf(highest / lowest) / (float)steps;
+		float energy = 0.f;
+		for (int i = 0; i < steps; i++)
+		{
+			float omega = lowest * expf(((float)i + 0.5f) * logStep);
+			energy += JonswapSpectrum(omega, windSpeed, fetch) * omega * logStep;
+		}
+		return energy;
+	}
+
+	// Integral of DirectionalSpreading from -pi / 2 to theta
+	float SpreadingBelow(float theta)
+	{
+		return (theta + pi * 0.5f) / pi + sinf(2.f * theta) / (2.f * pi);
+	}
+}
+
+GerstnerWaveGenerator::GerstnerWaveGenerator(const GerstnerSeaState& seaState, const GerstnerGeneratorSettings& settings)
+	: settings(settings)
+{
+	assert(seaState.windSpeed > 0.f && seaState.fetch > 0.f);
+	assert(settings.frequencyCount > 0 && settings.directionCount > 0);
+	assert(settings.lowestFrequency > 0.f && settings.highestFrequency > settings.lowestFrequency);
+
+	float windLength = sqrtf(seaState.windDirectionX * seaState.windDirectionX + seaState.windDirectionZ * seaState.windDirectionZ);
+	float windAngle = windLength > 0.f ? atan2f(seaState.windDirectionZ, seaState.windDirectionX) : 0.f;
+	float peak = JonswapPeakFrequency(seaState.windSpeed, seaState.fetch);
+
+	// Nearly all of the energy is within a decade around the peak, the spreading integrates to one
+	totalEnergy = IntegrateSpectrum(peak * 0.1f, peak * 100.f, 4096, seaState.windSpeed, seaState.fetch);
+
+	std::mt19937 random(settings.seed);
+	std::uniform_real_distribution<float> jitter(0.f, 1.f);
+
+	float bandRatio = powf(settings.highestFrequency / settings.lowestFrequency, 1.f / (float)settings.frequencyCount);
+	float sectorAngle = pi / (float)settings.directionCount;
+	waves.reserve(settings.frequencyCount * settings.directionCount);
+	for (int band = 0; band < settings.frequencyCount; band++)
+	{
+		float lowest = peak * settings.lowestFrequency * powf(bandRatio, (float)band);
+		float bandEnergy = IntegrateSpectrum(lowest, lowest * bandRatio, 16, seaState.windSpeed, seaState.fetch);
+
+		for (int sector = 0; sector < settings.directionCount; sector++)
+		{
+			float theta = -pi * 0.5f + (float)sector * sectorAngle;
+			float share = SpreadingBelow(theta + sectorAngle) - SpreadingBelow(theta);
+
+			Wave wave;
+			wave.energy = bandEnergy * share;
+			wave.angularFrequency = lowest * powf(bandRatio, jitter(random));
+			wave.waveNumber = wave.angularFrequency * wave.angularFrequency / gravity;
+			float angle = windAngle + theta + sectorAngle * jitter(random);
+			wave.directionX = cosf(angle);
+			wave.directionZ = sinf(angle);
+			waves.push_back(wave);
+		}
+	}
+
+	std::stable_sort(waves.begin(), waves.end(), [](const Wave& a, const Wave& b) { return a.energy > b.energy; });
+}
+
+std::vector<GerstnerWaveSet> GerstnerWaveGenerator::Generate(int waveCount) const
+{
+	waveCount = std::max(0, std::min(std::min(waveCount, maxGerstnerWaveSets * 4), (int)waves.size()));
+
+	std::vector<Wave> kept(waves.begin(), waves.begin() + waveCount);
+	std::stable_sort(kept.begin(), kept.end(), [](const Wave& a, const Wave& b) { return a.waveNumber < b.waveNumber; });
+
+	std::vector<GerstnerWaveSet> waveSets((waveCount + 3) / 4);
+	for (size_t set = 0; set < waveSets.size(); set++)
+	{
+		GerstnerWaveSet& waveSet = waveSets[set];
+		waveSet.intensity = 1.f;
+		for (int i = 0; i < 4; i++)
+		{
+			int index = (int)set * 4 + i;
+			if (index >= waveCount)
+			{
+				waveSet.amplitude[i] = 0.f;
+				waveSet.frequency[i] = 0.f;
+				waveSet.steepness[i] = 0.f;
+				waveSet.speed[i] = 0.f;
+				waveSet.directionX[i] = 1.f;
+				waveSet.directionZ[i] = 0.f;
+				continue;
+			}
+
+			const Wave& wave = kept[index];
+			float amplitude = sqrtf(2.f * wave.energy);
+			waveSet.amplitude[i] = amplitude;
+			waveSet.frequency[i] = wave.waveNumber;
+			// Every wave takes the same share of maxSteepness
+			waveSet.steepness[i] = amplitude > 0.f ? settings.maxSteepness / (wave.waveNumber * amplitude * (float)waveCount) : 0.f;
+			// The shader's phase is k.x + speed * t, so a negative speed moves the crests along the direction
+			waveSet.speed[i] = -wave.angularFrequency;
+			waveSet.directionX[i] = wave.directionX;
+			waveSet.directionZ[i] = wave.directionZ;
+		}
+
+		SetGerstnerLodFromWavelength(waveSet, settings.fadeWavelengths);
+	}
+
+	return waveSets;
+}
+
+float GerstnerWaveGenerator::GetSignificantWaveHeight() const
+{
+	return 4.f * sqrtf(totalEnergy);
+}
+
+float GerstnerWaveGenerator::GetKeptEnergy(int waveCount) const
+{
+	float kept = 0.f;
+	for (int i = 0; i < std::min(waveCount, (int)waves.size()); i++)
+		kept += waves[i].energy;
+	return totalEnergy > 0.f ? kept / totalEnergy : 0.f;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "GerstnerWaves.h"
+#include <vector>
+
+namespace Ocean
+{
+	struct GerstnerSeaState
+	{
+		// Wind speed in m/s over fetch m of open water, blowing along windDirectionX, windDirectionZ
+		float windSpeed;
+		float fetch;
+		float windDirectionX;
+		float windDirectionZ;
+	};
+
+	struct GerstnerGeneratorSettings
+	{
+		// The spectrum is cut into frequencyCount log spaced bands between lowestFrequency and highestFrequency
+		// times its peak frequency, and each band into directionCount sectors of the half plane downwind
+		int frequencyCount;
+		float lowestFrequency;
+		float highestFrequency;
+		int directionCount;
+		// Upper bound of the summed steepness * wave number * amplitude, below 1 crests can't fold over themselves
+		float maxSteepness;
+		// Sets fade out at this many of their shortest wavelengths, see SetGerstnerLodFromWavelength
+		float fadeWavelengths;
+		// Jitters every wave inside its bin so the sea doesn't line up on the bin grid
+		unsigned int seed;
+	};
+
+	// Turns a JONSWAP sea state into Gerstner waves. The directional spectrum S(omega) D(theta) is integrated over
+	// every frequency and direction bin, each bin becomes one wave with the amplitude sqrt(2 E) of its energy E,
+	// and Generate keeps the most energetic ones. Steepness is split evenly over the kept waves so their sum stays at
+	// maxSteepness. The waves travel downwind with deep water speeds and all start in phase at the origin, since the
+	// shader has no phase parameter. Only depends on the standard library.
+	class GerstnerWaveGenerator
+	{
+	public:
+		GerstnerWaveGenerator(const GerstnerSeaState& seaState, const GerstnerGeneratorSettings& settings);
+
+		// The waveCount most energetic waves, longest first, in sets of four with their fades set.
+		// At most maxGerstnerWaveSets sets, unused waves of the last set are flat.
+		std::vector<GerstnerWaveSet> Generate(int waveCount) const;
+
+		// Variance of the surface height over the whole spectrum, in m^2
+		float GetTotalEnergy() const { return totalEnergy; }
+		float GetSignificantWaveHeight() const;
+
+		// Share of the total energy the waveCount most energetic waves hold, the rest is in the bins left out
+		// and the tails outside the sampled frequencies
+		float GetKeptEnergy(int waveCount) const;
+
+		int GetBinCount() const { return (int)waves.size(); }
+
+	private:
+		struct Wave
+		{
+			float energy;
+			float waveNumber;
+			float angularFrequency;
+			float directionX;
+			float directionZ;
+		};
+
+		GerstnerGeneratorSettings settings;
+		// Most energetic first
+		std::vector<Wave> waves;
+		float totalEnergy;
+	};
+}
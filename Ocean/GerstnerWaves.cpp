@@ -0,0 +1,80 @@
+#include "pch.h"
+#include "GerstnerWaves.h"
+#include <cfloat>
+#include <cmath>
+
+using namespace Ocean;
+
+// Both sets fade out at 30 of their shortest wavelengths, like SetGerstnerLodFromWavelength(set, 30) does
+const GerstnerWaveSet Ocean::defaultGerstnerWaveSets[defaultGerstnerWaveSetCount] =
+{
+	{
+		1.0f,
+		720.f, 960.f,
+		{ 0.48f, 0.72f, 0.55f, 0.65f },
+		{ 0.15f, 0.12f, 0.2f, 0.15f },
+		{ 5.0f, 1.7f, 4.5f, 1.4f },
+		{ -1.0f, 0.7f, 0.3f, 1.0f },
+		{ 0.47f, -0.2f, 0.7f, 0.71f },
+		{ 0.35f, 0.1f, -0.68f, -0.2f }
+	},
+	{
+		1.0f,
+		300.f, 400.f,
+		{ 0.25f, 0.30f, 0.19f, 0.15f },
+		{ 0.75f, 0.9f, 0.6f, 0.4f },
+		{ 2.0f, 3.0f, 4.0f, 5.0f },
+		{ 0.5f, 0.7f, 0.25f, 1.0f },
+		{ 0.44f, -0.35f, 0.12f, -0.11f },
+		{ 0.15f, -0.15f, 0.78f, -0.54f }
+	}
+};
+
+float Ocean::GetMaxGerstnerHeight(const GerstnerWaveSet* waveSets, int waveSetCount)
+{
+	float height = 0.f;
+	for (int set = 0; set < waveSetCount; set++)
+	{
+		for (int i = 0; i < 4; i++)
+			height += fabsf(waveSets[set].amplitude[i]);
+	}
+
+	return height;
+}
+
+float Ocean::GetMaxGerstnerDisplacement(const GerstnerWaveSet* waveSets, int waveSetCount)
+{
+	// The directions aren't normalized in the shader, so their length counts too
+	float displacement = 0.f;
+	for (int set = 0; set < waveSetCount; set++)
+	{
+		const GerstnerWaveSet& waves = waveSets[set];
+		for (int i = 0; i < 4; i++)
+		{
+			float directionLength = sqrtf(waves.directionX[i] * waves.directionX[i] + waves.directionZ[i] * waves.directionZ[i]);
+			displacement += fabsf(waves.steepness[i] * waves.amplitude[i]) * directionLength;
+		}
+	}
+
+	return displacement;
+}
+
+float Ocean::GetShortestGerstnerWavelength(const GerstnerWaveSet& waveSet)
+{
+	// The shader doesn't normalize the directions, they scale the wave number
+	float largestWaveNumber = 0.f;
+	for (int i = 0; i < 4; i++)
+	{
+		float directionLength = sqrtf(waveSet.directionX[i] * waveSet.directionX[i] + waveSet.directionZ[i] * waveSet.directionZ[i]);
+		largestWaveNumber = fmaxf(largestWaveNumber, waveSet.frequency[i] * directionLength);
+	}
+
+	return largestWaveNumber > 0.f ? 6.28318531f / largestWaveNumber : FLT_MAX;
+}
+
+void Ocean::SetGerstnerLodFromWavelength(GerstnerWaveSet& waveSet, float wavelengths)
+{
+	float wavelength = GetShortestGerstnerWavelength(waveSet);
+	waveSet.lodFadeEnd = wavelength < FLT_MAX ? wavelength * wavelengths : FLT_MAX;
+	waveSet.lodFadeStart = waveSet.lodFadeEnd * 0.75f;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace Ocean
+{
+	// Four Gerstner waves in the layout the water shader uses, one float4 per parameter.
+	// The set fades out between lodFadeStart and lodFadeEnd from the camera, the shader stops evaluating it there.
+	struct GerstnerWaveSet
+	{
+		float intensity;
+		float lodFadeStart;
+		float lodFadeEnd;
+		float amplitude[4];
+		float frequency[4];
+		float steepness[4];
+		float speed[4];
+		float directionX[4];
+		float directionZ[4];
+	};
+
+	// The most sets WaterMaterialConstantBuffer has room for
+	static const int maxGerstnerWaveSets = 4;
+
+	// Hand tuned waves, the scene generates its own from a spectrum with GerstnerWaveGenerator
+	static const int defaultGerstnerWaveSetCount = 2;
+	extern const GerstnerWaveSet defaultGerstnerWaveSets[defaultGerstnerWaveSetCount];
+
+	// Waves fade out between these distances from the camera
+	static const float gerstnerAttenuationStart = 400.f;
+	static const float gerstnerAttenuationEnd = 1000.f;
+
+	// Upper bounds of how far the waves move a point of the plane, up or down and sideways
+	float GetMaxGerstnerHeight(const GerstnerWaveSet* waveSets, int waveSetCount);
+	float GetMaxGerstnerDisplacement(const GerstnerWaveSet* waveSets, int waveSetCount);
+
+	// Length of the shortest wave of the set
+	float GetShortestGerstnerWavelength(const GerstnerWaveSet& waveSet);
+
+	// Fades the set out when its shortest wave is wavelengths of its own length away, over the last quarter of that
+	void SetGerstnerLodFromWavelength(GerstnerWaveSet& waveSet, float wavelengths);
+}
@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "ProjectedGridKernel.h"
+#include "CpuFeatures.h"
+
+using namespace Ocean;
+
+namespace
+{
+	// The rays of a row in structure-of-arrays form: direction(j) = a + j * b, j = x / width
+	struct GridRow
+	{
+		float ex, ez;
+		float ax, ay, az;
+		float bx, by, bz;
+		float na, nb;
+		float numerator;
+		float invWidth;
+	};
+
+	bool IntersectScalar(const GridRow& row, int first, int count, VertexPositionXZ* output)
+	{
+		for (int x = first; x < count; x++)
+		{
+			float j = (float)x * row.invWidth;
+			float nDotLine = row.na + j * row.nb;
+
+			// The hit has to be in front of the eye, this also rejects rays parallel to the plane
+			if (row.numerator * nDotLine <= 0.f)
+				return false;
+
+			float t = row.numerator / nDotLine;
+			output[x].position = XMFLOAT2(
+				row.ex + t * (row.ax + j * row.bx),
+				row.ez + t * (row.az + j * row.bz));
+		}
+
+		return true;
+	}
+
+#if defined(OCEAN_SIMD_X86)
+	bool IntersectSse(const GridRow& row, int count, VertexPositionXZ* output)
+	{
+		const __m128 lane = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+		const __m128 invWidth = _mm_set1_ps(row.invWidth);
+		const __m128 na = _mm_set1_ps(row.na), nb = _mm_set1_ps(row.nb);
+		const __m128 numerator = _mm_set1_ps(row.numerator);
+		const __m128 zero = _mm_setzero_ps();
+
+		int x = 0;
+		for (; x + 4 <= count; x += 4)
+		{
+			__m128 j = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), lane), invWidth);
+			__m128 nDotLine = _mm_add_ps(na, _mm_mul_ps(j, nb));
+			if (_mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(numerator, nDotLine), zero)) != 0)
+				return false;
+
+			__m128 t = _mm_div_ps(numerator, nDotLine);
+			__m128 dx = _mm_add_ps(_mm_set1_ps(row.ax), _mm_mul_ps(j, _mm_set1_ps(row.bx)));
+			__m128 dz = _mm_add_ps(_mm_set1_ps(row.az), _mm_mul_ps(j, _mm_set1_ps(row.bz)));
+			__m128 px = _mm_add_ps(_mm_set1_ps(row.ex), _mm_mul_ps(t, dx));
+			__m128 pz = _mm_add_ps(_mm_set1_ps(row.ez), _mm_mul_ps(t, dz));
+
+			// Interleave back into x z x z
+			float* out = &output[x].position.x;
+			_mm_storeu_ps(out, _mm_unpacklo_ps(px, pz));
+			_mm_storeu_ps(out + 4, _mm_unpackhi_ps(px, pz));
+		}
+
+		return IntersectScalar(row, x, count, output);
+	}
+
+	OCEAN_TARGET_AVX bool IntersectAvx(const GridRow& row, int count, VertexPositionXZ* output)
+	{
+		const __m256 lane = _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+		const __m256 invWidth = _mm256_set1_ps(row.invWidth);
+		const __m256 na = _mm256_set1_ps(row.na), nb = _mm256_set1_ps(row.nb);
+		const __m256 numerator = _mm256_set1_ps(row.numerator);
+		const __m256 zero = _mm256_setzero_ps();
+
+		int x = 0;
+		for (; x + 8 <= count; x += 8)
+		{
+			__m256 j = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)x), lane), invWidth);
+			__m256 nDotLine = _mm256_add_ps(na, _mm256_mul_ps(j, nb));
+			if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_mul_ps(numerator, nDotLine), zero, _CMP_LE_OQ)) != 0)
+				return false;
+
+			__m256 t = _mm256_div_ps(numerator, nDotLine);
+			__m256 dx = _mm256_add_ps(_mm256_set1_ps(row.ax), _mm256_mul_ps(j, _mm256_set1_ps(row.bx)));
+			__m256 dz = _mm256_add_ps(_mm256_set1_ps(row.az), _mm256_mul_ps(j, _mm256_set1_ps(row.bz)));
+			__m256 px = _mm256_add_ps(_mm256_set1_ps(row.ex), _mm256_mul_ps(t, dx));
+			__m256 pz = _mm256_add_ps(_mm256_set1_ps(row.ez), _mm256_mul_ps(t, dz));
+
+			// Unpacking works inside the 128 bit halves, the permutes put the halves back in order
+			__m256 low = _mm256_unpacklo_ps(px, pz);
+			__m256 high = _mm256_unpackhi_ps(px, pz);
+			float* out = &output[x].position.x;
+			_mm256_storeu_ps(out, _mm256_permute2f128_ps(low, high, 0x20));
+			_mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(low, high, 0x31));
+		}
+
+		return IntersectScalar(row, x, count, output);
+	}
+#endif
+}
+
+bool Ocean::IntersectGridRow(
+	const XMFLOAT3& eye,
+	const XMFLOAT3& left,
+	const XMFLOAT3& right,
+	int width,
+	const XMFLOAT4& plane,
+	VertexPositionXZ* output)
+{
+	GridRow row;
+	row.ex = eye.x; row.ez = eye.z;
+	row.ax = left.x - eye.x; row.ay = left.y - eye.y; row.az = left.z - eye.z;
+	row.bx = right.x - left.x; row.by = right.y - left.y; row.bz = right.z - left.z;
+	row.na = plane.x * row.ax + plane.y * row.ay + plane.z * row.az;
+	row.nb = plane.x * row.bx + plane.y * row.by + plane.z * row.bz;
+	row.numerator = plane.w - (plane.x * eye.x + plane.y * eye.y + plane.z * eye.z);
+	row.invWidth = 1.f / (float)width;
+
+	int count = width + 1;
+
+#if defined(OCEAN_SIMD_X86)
+	if (CpuFeatures::HasAvx())
+		return IntersectAvx(row, count, output);
+	else
+		return IntersectSse(row, count, output);
+#else
+	return IntersectScalar(row, 0, count, output);
+#endif
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "Content\ShaderStructures.h"
+
+namespace Ocean
+{
+	// Intersects the rays going from eye through lerp(left, right, x / width), x = 0..width, with the plane
+	// dot(plane.xyz, p) = plane.w and writes the x and z of the width + 1 hit points straight into output.
+	// Returns false if any of the rays misses the plane in front of the eye, the row is past the horizon then.
+	// The rays are processed 8 or 4 at a time with AVX or SSE, whichever the CPU supports.
+	bool IntersectGridRow(
+		const XMFLOAT3& eye,
+		const XMFLOAT3& left,
+		const XMFLOAT3& right,
+		int width,
+		const XMFLOAT4& plane,
+		VertexPositionXZ* output);
+}
@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "Projector.h"
+#include <algorithm>
+
+using namespace Ocean;
+
+// Keeps the fitted range from blowing up when displaced water comes very close to the eye
+static const float maxRangeExtent = 2.f;
+
+Projector::Projector()
+	: mode(ProjectorMode::RangeFitted),
+	bias(7.f),
+	maxWaveHeight(0.f),
+	maxWaveDisplacement(0.f),
+	visible(false)
+{ }
+
+void Projector::Update(std::shared_ptr<Camera> camera)
+{
+	if (mode == ProjectorMode::RangeFitted)
+		UpdateRangeFitted(camera);
+	else
+		UpdateBiased(camera);
+}
+
+void Projector::SetRectangle(XMVECTOR projectorEye, XMVECTOR viewDir, XMVECTOR right, XMVECTOR up,
+	float nearDistance, float halfWidth, float halfHeight, float left, float rightEdge, float bottom, float top)
+{
+	XMVECTOR screenCenter = projectorEye + viewDir * nearDistance;
+
+	XMStoreFloat3(&eye, projectorEye);
+	XMStoreFloat3(&bottomLeft, screenCenter + right * (left * halfWidth) + up * (bottom * halfHeight));
+	XMStoreFloat3(&bottomRight, screenCenter + right * (rightEdge * halfWidth) + up * (bottom * halfHeight));
+	XMStoreFloat3(&topLeft, screenCenter + right * (left * halfWidth) + up * (top * halfHeight));
+	XMStoreFloat3(&topRight, screenCenter + right * (rightEdge * halfWidth) + up * (top * halfHeight));
+}
+
+void Projector::UpdateBiased(std::shared_ptr<Camera> camera)
+{
+	XMVECTOR viewDir = camera->getDirection();
+	XMVECTOR screenRight = XMVector3Normalize(XMVector3Cross(viewDir, camera->getUp()));
+	XMVECTOR screenUp = XMVector3Normalize(XMVector3Cross(screenRight, viewDir));
+
+	float halfHeight = camera->nearClippingPane * tanf(camera->fov / 2.f);
+	float halfWidth = halfHeight * camera->aspectRatio;
+
+	visible = true;
+	SetRectangle(camera->getEye() - viewDir * bias, viewDir, screenRight, screenUp,
+		camera->nearClippingPane, halfWidth, halfHeight, -1.f, 1.f, -1.f, 1.f);
+}
+
+void Projector::UpdateRangeFitted(std::shared_ptr<Camera> camera)
+{
+	XMVECTOR cameraEye = camera->getEye();
+	XMVECTOR viewDir = camera->getDirection();
+	XMVECTOR screenRight = XMVector3Normalize(XMVector3Cross(viewDir, camera->getUp()));
+	XMVECTOR screenUp = XMVector3Normalize(XMVector3Cross(screenRight, viewDir));
+
+	float tanHalfHeight = tanf(camera->fov / 2.f);
+	float tanHalfWidth = tanHalfHeight * camera->aspectRatio;
+
+	// Corners of the view frustum, near plane first
+	XMVECTOR corners[8];
+	float distances[2] = { camera->nearClippingPane, camera->farClippingPane };
+	for (int plane = 0; plane < 2; plane++)
+	{
+		XMVECTOR center = cameraEye + viewDir * distances[plane];
+		XMVECTOR right = screenRight * (distances[plane] * tanHalfWidth);
+		XMVECTOR up = screenUp * (distances[plane] * tanHalfHeight);
+		corners[plane * 4 + 0] = center - right - up;
+		corners[plane * 4 + 1] = center + right - up;
+		corners[plane * 4 + 2] = center + right + up;
+		corners[plane * 4 + 3] = center - right + up;
+	}
+
+	static const int edges[12][2] =
+	{
+		{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },
+		{ 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+	};
+
+	// Points of the frustum inside the water volume and where its edges cross the volume's bounding planes
+	XMFLOAT3 points[8 + 12 * 2];
+	int pointCount = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		float y = XMVectorGetY(corners[i]);
+		if (y >= -maxWaveHeight && y <= maxWaveHeight)
+			XMStoreFloat3(&points[pointCount++], corners[i]);
+	}
+
+	for (int i = 0; i < 12; i++)
+	{
+		XMVECTOR p = corners[edges[i][0]];
+		XMVECTOR q = corners[edges[i][1]];
+		float py = XMVectorGetY(p);
+		float qy = XMVectorGetY(q);
+
+		float heights[2] = { -maxWaveHeight, maxWaveHeight };
+		for (int j = 0; j < (maxWaveHeight > 0.f ? 2 : 1); j++)
+		{
+			float h = heights[j];
+			if ((py - h) * (qy - h) < 0.f)
+				XMStoreFloat3(&points[pointCount++], XMVectorLerp(p, q, (h - py) / (qy - py)));
+		}
+	}
+
+	if (pointCount == 0)
+	{
+		visible = false;
+		return;
+	}
+
+	// The grid has to be above the highest wave, looking in the camera's direction
+	XMVECTOR projectorEye = cameraEye;
+	float minEyeHeight = maxWaveHeight + camera->nearClippingPane;
+	if (XMVectorGetY(projectorEye) < minEyeHeight)
+		projectorEye = XMVectorSetY(projectorEye, minEyeHeight);
+
+	// Flatten the points onto the base plane, widened by the horizontal wave displacement,
+	// and find the range they cover on the projector's screen
+	static const float offsets[5][2] = { { 0.f, 0.f }, { 1.f, 0.f }, { -1.f, 0.f }, { 0.f, 1.f }, { 0.f, -1.f } };
+	int offsetCount = maxWaveDisplacement > 0.f ? 5 : 1;
+
+	float left = maxRangeExtent, rightEdge = -maxRangeExtent;
+	float bottom = maxRangeExtent, top = -maxRangeExtent;
+	bool anyInFront = false;
+	for (int i = 0; i < pointCount; i++)
+	{
+		for (int o = 0; o < offsetCount; o++)
+		{
+			XMVECTOR point = XMVectorSet(
+				points[i].x + offsets[o][0] * maxWaveDisplacement,
+				0.f,
+				points[i].z + offsets[o][1] * maxWaveDisplacement,
+				0.f);
+
+			XMVECTOR toPoint = point - projectorEye;
+			float depth = XMVectorGetX(XMVector3Dot(toPoint, viewDir));
+			if (depth < camera->nearClippingPane)
+				continue;
+
+			float x = XMVectorGetX(XMVector3Dot(toPoint, screenRight)) / (depth * tanHalfWidth);
+			float y = XMVectorGetX(XMVector3Dot(toPoint, screenUp)) / (depth * tanHalfHeight);
+			left = std::min(left, x);
+			rightEdge = std::max(rightEdge, x);
+			bottom = std::min(bottom, y);
+			top = std::max(top, y);
+			anyInFront = true;
+		}
+	}
+
+	if (!anyInFront)
+	{
+		visible = false;
+		return;
+	}
+
+	left = std::max(left, -maxRangeExtent);
+	rightEdge = std::min(rightEdge, maxRangeExtent);
+	bottom = std::max(bottom, -maxRangeExtent);
+	top = std::min(top, maxRangeExtent);
+
+	float nearDistance = camera->nearClippingPane;
+	visible = true;
+	SetRectangle(projectorEye, viewDir, screenRight, screenUp,
+		nearDistance, nearDistance * tanHalfWidth, nearDistance * tanHalfHeight, left, rightEdge, bottom, top);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Camera.h"
+
+namespace Ocean
+{
+	enum ProjectorMode
+	{
+		// Spreads the grid over the whole screen seen from an eye pushed back by a fixed bias
+		Biased,
+		// Spreads the grid over the screen range where the frustum meets the water volume
+		RangeFitted
+	};
+
+	// Decides where the projected grid's rays go: from eye through the rectangle spanned by the corners.
+	class Projector
+	{
+	public:
+		Projector();
+		void Update(std::shared_ptr<Camera> camera);
+
+		ProjectorMode mode;
+		float bias;
+
+		// Bounds of the wave displacement around the y = 0 plane, used by the range fitting
+		float maxWaveHeight;
+		float maxWaveDisplacement;
+
+		// Results of the last Update
+		bool visible;
+		XMFLOAT3 eye;
+		XMFLOAT3 bottomLeft;
+		XMFLOAT3 bottomRight;
+		XMFLOAT3 topLeft;
+		XMFLOAT3 topRight;
+
+	private:
+		void UpdateBiased(std::shared_ptr<Camera> camera);
+		void UpdateRangeFitted(std::shared_ptr<Camera> camera);
+		void SetRectangle(XMVECTOR projectorEye, XMVECTOR viewDir, XMVECTOR right, XMVECTOR up,
+			float nearDistance, float halfWidth, float halfHeight, float left, float rightEdge, float bottom, float top);
+	};
+}
@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "RenderContext.h"
+#include "Common\DeviceResources.h"
+
+using namespace Ocean;
+
+void D3DRenderContext::SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	deviceResources->GetD3DDeviceContext()->OMSetRenderTargets(count, targets, depthStencil);
+}
+
+void D3DRenderContext::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	deviceResources->GetD3DDeviceContext()->RSSetState(state);
+}
+
+void D3DRenderContext::SetBlendState(ID3D11BlendState* state)
+{
+	deviceResources->GetD3DDeviceContext()->OMSetBlendState(state, nullptr, 0xFFFFFFFF);
+}
+
+void D3DRenderContext::SetDepthStencilState(ID3D11DepthStencilState* state)
+{
+	deviceResources->GetD3DDeviceContext()->OMSetDepthStencilState(state, 0);
+}
+
+void D3DRenderContext::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	deviceResources->GetD3DDeviceContext()->IASetInputLayout(inputLayout);
+}
+
+void D3DRenderContext::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	deviceResources->GetD3DDeviceContext()->IASetPrimitiveTopology(topology);
+}
+
+void D3DRenderContext::SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	deviceResources->GetD3DDeviceContext()->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void D3DRenderContext::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	deviceResources->GetD3DDeviceContext()->IASetIndexBuffer(buffer, format, offset);
+}
+
+void D3DRenderContext::SetVertexShader(ID3D11VertexShader* shader)
+{
+	deviceResources->GetD3DDeviceContext()->VSSetShader(shader, nullptr, 0);
+}
+
+void D3DRenderContext::SetPixelShader(ID3D11PixelShader* shader)
+{
+	deviceResources->GetD3DDeviceContext()->PSSetShader(shader, nullptr, 0);
+}
+
+void D3DRenderContext::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	if (stage == VertexStage)
+		deviceResources->GetD3DDeviceContext()->VSSetConstantBuffers(startSlot, count, buffers);
+	else
+		deviceResources->GetD3DDeviceContext()->PSSetConstantBuffers(startSlot, count, buffers);
+}
+
+void D3DRenderContext::SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	// The Windows 8.0 runtime keeps the old offsets when a buffer is bound again where it already was, so the slots are cleared first
+	ID3D11Buffer* nullBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT] = {};
+	auto context = deviceResources->GetD3DDeviceContext();
+	if (stage == VertexStage)
+	{
+		context->VSSetConstantBuffers(startSlot, count, nullBuffers);
+		context->VSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+	}
+	else
+	{
+		context->PSSetConstantBuffers(startSlot, count, nullBuffers);
+		context->PSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+	}
+}
+
+void D3DRenderContext::SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	if (stage == VertexStage)
+		deviceResources->GetD3DDeviceContext()->VSSetShaderResources(startSlot, count, views);
+	else
+		deviceResources->GetD3DDeviceContext()->PSSetShaderResources(startSlot, count, views);
+}
+
+void D3DRenderContext::SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	if (stage == VertexStage)
+		deviceResources->GetD3DDeviceContext()->VSSetSamplers(startSlot, count, samplers);
+	else
+		deviceResources->GetD3DDeviceContext()->PSSetSamplers(startSlot, count, samplers);
+}
+
+void D3DRenderContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	deviceResources->GetD3DDeviceContext()->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3DRenderContext::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	deviceResources->GetD3DDeviceContext()->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
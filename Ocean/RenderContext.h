@@ -0,0 +1,145 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+namespace DX
+{
+	class DeviceResources;
+}
+
+namespace Ocean
+{
+	enum ShaderStage
+	{
+		VertexStage,
+		PixelStage
+	};
+
+	// The pipeline binds and draws the scene objects issue, so they can be filtered or recorded without a device.
+	// Blend states use no blend factor and every sample, depth stencil states a stencil reference of 0.
+	class IRenderContext
+	{
+	public:
+		virtual ~IRenderContext() { }
+
+		virtual void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil) = 0;
+		virtual void SetRasterizerState(ID3D11RasterizerState* state) = 0;
+		virtual void SetBlendState(ID3D11BlendState* state) = 0;
+		virtual void SetDepthStencilState(ID3D11DepthStencilState* state) = 0;
+
+		virtual void SetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+		virtual void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+		virtual void SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+
+		virtual void SetVertexShader(ID3D11VertexShader* shader) = 0;
+		virtual void SetPixelShader(ID3D11PixelShader* shader) = 0;
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) = 0;
+		// Binds constantCounts registers from firstConstants on, needs the device's support for constant buffer offsetting
+		virtual void SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) = 0;
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) = 0;
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) = 0;
+
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) = 0;
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+	};
+
+	// Forwards every call to the device's immediate context.
+	class D3DRenderContext : public IRenderContext
+	{
+	public:
+		D3DRenderContext(std::shared_ptr<DX::DeviceResources> deviceResources) : deviceResources(deviceResources) { }
+
+		virtual void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil);
+		virtual void SetRasterizerState(ID3D11RasterizerState* state);
+		virtual void SetBlendState(ID3D11BlendState* state);
+		virtual void SetDepthStencilState(ID3D11DepthStencilState* state);
+
+		virtual void SetInputLayout(ID3D11InputLayout* inputLayout);
+		virtual void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		virtual void SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+		virtual void SetVertexShader(ID3D11VertexShader* shader);
+		virtual void SetPixelShader(ID3D11PixelShader* shader);
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+		virtual void SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+	private:
+		std::shared_ptr<DX::DeviceResources> deviceResources;
+	};
+
+	enum RenderCall
+	{
+		SetRenderTargetsCall,
+		SetRasterizerStateCall,
+		SetBlendStateCall,
+		SetDepthStencilStateCall,
+		SetInputLayoutCall,
+		SetPrimitiveTopologyCall,
+		SetVertexBuffersCall,
+		SetIndexBufferCall,
+		SetVertexShaderCall,
+		SetPixelShaderCall,
+		SetConstantBuffersCall,
+		SetConstantBufferRangesCall,
+		SetShaderResourcesCall,
+		SetSamplersCall,
+		DrawIndexedCall,
+		DrawIndexedInstancedCall
+	};
+
+	// One call as the recording stand-in saw it. object is the first object bound, or the index count of a draw.
+	// firstConstant is the first register of the first constant buffer range.
+	struct RecordedCall
+	{
+		RenderCall call;
+		ShaderStage stage;
+		UINT startSlot;
+		UINT count;
+		const void* object;
+		UINT firstConstant;
+	};
+
+	// CPU stand-in that only records the calls, used to exercise the filtering without a device.
+	class RecordingRenderContext : public IRenderContext
+	{
+	public:
+		virtual void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil) { Record(SetRenderTargetsCall, VertexStage, 0, count, count > 0 ? targets[0] : nullptr); }
+		virtual void SetRasterizerState(ID3D11RasterizerState* state) { Record(SetRasterizerStateCall, VertexStage, 0, 1, state); }
+		virtual void SetBlendState(ID3D11BlendState* state) { Record(SetBlendStateCall, PixelStage, 0, 1, state); }
+		virtual void SetDepthStencilState(ID3D11DepthStencilState* state) { Record(SetDepthStencilStateCall, PixelStage, 0, 1, state); }
+
+		virtual void SetInputLayout(ID3D11InputLayout* inputLayout) { Record(SetInputLayoutCall, VertexStage, 0, 1, inputLayout); }
+		virtual void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) { Record(SetPrimitiveTopologyCall, VertexStage, 0, 1, nullptr); }
+		virtual void SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) { Record(SetVertexBuffersCall, VertexStage, startSlot, count, buffers[0]); }
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) { Record(SetIndexBufferCall, VertexStage, 0, 1, buffer); }
+
+		virtual void SetVertexShader(ID3D11VertexShader* shader) { Record(SetVertexShaderCall, VertexStage, 0, 1, shader); }
+		virtual void SetPixelShader(ID3D11PixelShader* shader) { Record(SetPixelShaderCall, PixelStage, 0, 1, shader); }
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers) { Record(SetConstantBuffersCall, stage, startSlot, count, buffers[0]); }
+		virtual void SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts) { Record(SetConstantBufferRangesCall, stage, startSlot, count, buffers[0], firstConstants[0]); }
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) { Record(SetShaderResourcesCall, stage, startSlot, count, views[0]); }
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) { Record(SetSamplersCall, stage, startSlot, count, samplers[0]); }
+
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) { Record(DrawIndexedCall, VertexStage, startIndex, 1, (const void*)(size_t)indexCount); }
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) { Record(DrawIndexedInstancedCall, VertexStage, startInstance, instanceCount, (const void*)(size_t)indexCount); }
+
+		const std::vector<RecordedCall>& GetCalls() const { return calls; }
+		void Clear() { calls.clear(); }
+
+	private:
+		void Record(RenderCall call, ShaderStage stage, UINT startSlot, UINT count, const void* object, UINT firstConstant = 0)
+		{
+			RecordedCall recorded = { call, stage, startSlot, count, object, firstConstant };
+			calls.push_back(recorded);
+		}
+
+		std::vector<RecordedCall> calls;
+	};
+}
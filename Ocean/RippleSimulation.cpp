@@ -0,0 +1,190 @@
+#include "pch.h"
+#include "RippleSimulation.h"
+#include "ThreadPool.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace Ocean;
+
+namespace
+{
+	const float pi = 3.14159265358979324f;
+
+	void Run(ThreadPool* pool, int count, int grain, const std::function<void(int, int)>& body)
+	{
+		if (pool != nullptr)
+			pool->ParallelFor(count, grain, body);
+		else
+			body(0, count);
+	}
+}
+
+RippleSimulation::RippleSimulation(const RippleSettings& settings)
+	: maxStepsPerAdvance(4), size(settings.size), cellSize(settings.cellSize), damping(settings.damping), stepSeconds(settings.stepSeconds),
+	originX(0.f), originZ(0.f), leftOverSeconds(0.f)
+{
+	assert(size >= 3);
+
+	float courant = settings.waveSpeed * stepSeconds / cellSize;
+	assert(courant < 0.7071f);
+	coupling = courant * courant;
+
+	current.assign(size * size, 0.f);
+	previous.assign(size * size, 0.f);
+	scrollScratch.resize(size * size);
+	surface.assign(size * size * 4, 0.f);
+
+	originX = -0.5f * (float)size * cellSize;
+	originZ = -0.5f * (float)size * cellSize;
+}
+
+void RippleSimulation::Recenter(float x, float z)
+{
+	// Whole cells only, so the ripples don't blur while the grid moves
+	float targetX = floorf(x / cellSize - 0.5f * (float)size) * cellSize;
+	float targetZ = floorf(z / cellSize - 0.5f * (float)size) * cellSize;
+	int cellsX = (int)floorf((targetX - originX) / cellSize + 0.5f);
+	int cellsZ = (int)floorf((targetZ - originZ) / cellSize + 0.5f);
+	if (cellsX == 0 && cellsZ == 0)
+		return;
+
+	Scroll(current, cellsX, cellsZ);
+	Scroll(previous, cellsX, cellsZ);
+	originX += (float)cellsX * cellSize;
+	originZ += (float)cellsZ * cellSize;
+}
+
+void RippleSimulation::Scroll(std::vector<float>& field, int cellsX, int cellsZ)
+{
+	// Cell x, z takes the value of cell x + cellsX, z + cellsZ
+	std::fill(scrollScratch.begin(), scrollScratch.end(), 0.f);
+	int firstX = std::max(0, -cellsX), endX = std::min(size, size - cellsX);
+	for (int z = std::max(0, -cellsZ); z < std::min(size, size - cellsZ); z++)
+	{
+		if (firstX < endX)
+			memcpy(&scrollScratch[z * size + firstX], &field[(z + cellsZ) * size + firstX + cellsX], (endX - firstX) * sizeof(float));
+	}
+	field.swap(scrollScratch);
+}
+
+void RippleSimulation::AddImpulse(float x, float z, float radius, float strength)
+{
+	int centerX = (int)floorf((x - originX) / cellSize + 0.5f);
+	int centerZ = (int)floorf((z - originZ) / cellSize + 0.5f);
+	int reach = (int)ceilf(radius / cellSize);
+
+	// Raised cosine, the border cells stay at zero
+	for (int cz = std::max(1, centerZ - reach); cz <= std::min(size - 2, centerZ + reach); cz++)
+	{
+		for (int cx = std::max(1, centerX - reach); cx <= std::min(size - 2, centerX + reach); cx++)
+		{
+			float dx = originX + (float)cx * cellSize - x;
+			float dz = originZ + (float)cz * cellSize - z;
+			float distance = sqrtf(dx * dx + dz * dz);
+			if (distance < radius)
+				current[cz * size + cx] -= strength * 0.5f * (1.f + cosf(pi * distance / radius));
+		}
+	}
+}
+
+int RippleSimulation::Advance(float seconds, ThreadPool* pool)
+{
+	leftOverSeconds += seconds;
+	int steps = 0;
+	while (leftOverSeconds >= stepSeconds && steps < maxStepsPerAdvance)
+	{
+		Run(pool, size - 2, 16, [this](int begin, int end) { StepRows(begin + 1, end + 1); });
+		current.swap(previous);
+		leftOverSeconds -= stepSeconds;
+		steps++;
+	}
+
+	// Falling behind drops time instead of running ever more steps
+	if (steps == maxStepsPerAdvance)
+		leftOverSeconds = std::min(leftOverSeconds, stepSeconds);
+
+	if (steps > 0)
+		Run(pool, size, 16, [this](int begin, int end) { ResolveRows(begin, end); });
+	return steps;
+}
+
+void RippleSimulation::StepRows(int firstRow, int endRow)
+{
+	// next = (2 h - previous + c^2 (left + right + up + down - 4 h)) * damping, written over previous
+	for (int z = firstRow; z < endRow; z++)
+	{
+		const float* h = &current[z * size];
+		const float* up = h - size;
+		const float* down = h + size;
+		float* next = &previous[z * size];
+
+		int x = 1;
+#if defined(OCEAN_SIMD_X86)
+		const __m128 two = _mm_set1_ps(2.f), four = _mm_set1_ps(4.f);
+		const __m128 coupling4 = _mm_set1_ps(coupling), damping4 = _mm_set1_ps(damping);
+		for (; x + 4 <= size - 1; x += 4)
+		{
+			__m128 center = _mm_loadu_ps(h + x);
+			__m128 neighbours = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(h + x - 1), _mm_loadu_ps(h + x + 1)), _mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x)));
+			__m128 laplacian = _mm_sub_ps(neighbours, _mm_mul_ps(center, four));
+			__m128 result = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(center, two), _mm_loadu_ps(next + x)), _mm_mul_ps(laplacian, coupling4));
+			_mm_storeu_ps(next + x, _mm_mul_ps(result, damping4));
+		}
+#endif
+		for (; x < size - 1; x++)
+		{
+			float laplacian = h[x - 1] + h[x + 1] + up[x] + down[x] - 4.f * h[x];
+			next[x] = (2.f * h[x] - next[x] + coupling * laplacian) * damping;
+		}
+	}
+}
+
+void RippleSimulation::ResolveRows(int firstRow, int endRow)
+{
+	float toSlope = 0.5f / cellSize;
+	for (int z = firstRow; z < endRow; z++)
+	{
+		const float* h = &current[z * size];
+		const float* up = z > 0 ? h - size : h;
+		const float* down = z < size - 1 ? h + size : h;
+		float* output = &surface[z * size * 4];
+
+		// The border cells take one sided differences
+		for (int x : { 0, size - 1 })
+		{
+			float left = h[x > 0 ? x - 1 : x], right = h[x < size - 1 ? x + 1 : x];
+			output[x * 4 + 0] = h[x];
+			output[x * 4 + 1] = (right - left) * toSlope;
+			output[x * 4 + 2] = (down[x] - up[x]) * toSlope;
+			output[x * 4 + 3] = 0.f;
+		}
+
+		int x = 1;
+#if defined(OCEAN_SIMD_X86)
+		// Four cells at a time, transposed into four texels
+		const __m128 toSlope4 = _mm_set1_ps(toSlope);
+		for (; x + 4 <= size - 1; x += 4)
+		{
+			__m128 height = _mm_loadu_ps(h + x);
+			__m128 slopeX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(h + x + 1), _mm_loadu_ps(h + x - 1)), toSlope4);
+			__m128 slopeZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(down + x), _mm_loadu_ps(up + x)), toSlope4);
+			__m128 zero = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(height, slopeX, slopeZ, zero);
+			_mm_storeu_ps(output + x * 4, height);
+			_mm_storeu_ps(output + x * 4 + 4, slopeX);
+			_mm_storeu_ps(output + x * 4 + 8, slopeZ);
+			_mm_storeu_ps(output + x * 4 + 12, zero);
+		}
+#endif
+		for (; x < size - 1; x++)
+		{
+			output[x * 4 + 0] = h[x];
+			output[x * 4 + 1] = (h[x + 1] - h[x - 1]) * toSlope;
+			output[x * 4 + 2] = (down[x] - up[x]) * toSlope;
+			output[x * 4 + 3] = 0.f;
+		}
+	}
+}
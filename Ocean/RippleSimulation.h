@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+
+namespace Ocean
+{
+	class ThreadPool;
+
+	struct RippleSettings
+	{
+		// Cells along each side of the square grid
+		int size;
+		float cellSize;
+		// How fast the ripples spread, waveSpeed * stepSeconds / cellSize has to stay below 1 / sqrt(2)
+		float waveSpeed;
+		// Share of the motion kept every step
+		float damping;
+		float stepSeconds;
+	};
+
+	// Damped 2D wave equation on a heightfield that follows the camera, for disturbances the Gerstner sum can't show.
+	// Two height fields take turns, every step writes the next heights over the previous ones with an SSE stencil
+	// split by rows over the thread pool. The border is held at zero.
+	// Only depends on the standard library.
+	class RippleSimulation
+	{
+	public:
+		RippleSimulation(const RippleSettings& settings);
+
+		// Moves the grid in whole cells so it stays centred on x, z, water scrolling in starts calm
+		void Recenter(float x, float z);
+
+		// Pushes the water down by strength at x, z, fading out smoothly over radius. Negative strength lifts it.
+		void AddImpulse(float x, float z, float radius, float strength);
+
+		// Runs as many fixed steps as fit into seconds and the time left over from earlier calls, at most
+		// maxStepsPerAdvance, then resolves the surface. pool can be null to run on the calling thread only.
+		// Returns the number of steps taken.
+		int Advance(float seconds, ThreadPool* pool);
+
+		int GetSize() const { return size; }
+		float GetCellSize() const { return cellSize; }
+
+		// World position of cell 0, 0, cell x, z is at origin + (x, z) * cellSize
+		float GetOriginX() const { return originX; }
+		float GetOriginZ() const { return originZ; }
+
+		// size * size cells of height, dh/dx, dh/dz and 0 for a float4 texture, as of the last Advance
+		const float* GetSurface() const { return surface.data(); }
+
+		int maxStepsPerAdvance;
+
+	private:
+		void StepRows(int firstRow, int endRow);
+		void ResolveRows(int firstRow, int endRow);
+		void Scroll(std::vector<float>& field, int cellsX, int cellsZ);
+
+		int size;
+		float cellSize;
+		float damping;
+		float stepSeconds;
+		// (waveSpeed * stepSeconds / cellSize)^2
+		float coupling;
+
+		float originX;
+		float originZ;
+		float leftOverSeconds;
+
+		// The current heights and the ones before, the next step overwrites the older ones
+		std::vector<float> current;
+		std::vector<float> previous;
+		std::vector<float> scrollScratch;
+		std::vector<float> surface;
+	};
+}
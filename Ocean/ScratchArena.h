@@ -0,0 +1,62 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+namespace Ocean
+{
+	// Bump allocator over a single block that is kept between uses.
+	// Reset is told the exact amount of memory the next batch of allocations needs and only
+	// touches the heap when that is more than the block has ever held, so regenerating
+	// meshes of the same size runs without heap allocations after the first time.
+	class ScratchArena
+	{
+	public:
+		static const size_t alignment = 16;
+
+		ScratchArena() : capacity(0), used(0), allocationCount(0) { }
+
+		// Size of count T's in the arena, sum these up for Reset
+		template <typename T>
+		static size_t SizeOf(size_t count)
+		{
+			return (count * sizeof(T) + alignment - 1) & ~(alignment - 1);
+		}
+
+		void Reset(size_t bytes)
+		{
+			if (bytes > capacity)
+			{
+				block.reset(new unsigned char[bytes + alignment]);
+				capacity = bytes;
+				allocationCount++;
+			}
+
+			used = 0;
+		}
+
+		template <typename T>
+		T* Allocate(size_t count)
+		{
+			size_t bytes = SizeOf<T>(count);
+
+			// Everything has to be accounted for in Reset, the arena never grows behind the caller's back
+			assert(used + bytes <= capacity);
+
+			unsigned char* base = block.get();
+			size_t offset = (alignment - ((size_t)base & (alignment - 1))) & (alignment - 1);
+			T* memory = (T*)(base + offset + used);
+			used += bytes;
+			return memory;
+		}
+
+		// Number of times the arena had to go to the heap
+		size_t GetAllocationCount() const { return allocationCount; }
+
+	private:
+		std::unique_ptr<unsigned char[]> block;
+		size_t capacity;
+		size_t used;
+		size_t allocationCount;
+	};
+}
@@ -0,0 +1,15 @@
+#include "FrameConstants.hlsli"
+
+struct PixelShaderInput
+{
+	float4 pos : SV_Position;
+	float3 normalWS : NORMAL;
+	float4 color : COLOR;
+};
+
+// Diffuse light with some ambient so the shaded side doesn't go black
+float4 main(PixelShaderInput input) : SV_TARGET
+{
+	float diffuse = saturate(dot(normalize(input.normalWS), -normalize(lightDir.xyz)));
+	return float4(input.color.rgb * (0.3 + 0.7 * diffuse), input.color.a);
+}
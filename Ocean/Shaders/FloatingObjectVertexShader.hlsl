@@ -0,0 +1,36 @@
+#include "FrameConstants.hlsli"
+
+// The kind's mesh in slot 0, the object's place in slot 1
+struct VertexShaderInput
+{
+	float3 pos : SV_Position;
+	float3 normal : NORMAL;
+	float4 instancePositionScale : INSTANCEPOSITIONSCALE;
+	float4 instanceRotation : INSTANCEROTATION;
+	float4 color : COLOR;
+};
+
+struct PixelShaderInput
+{
+	float4 pos : SV_Position;
+	float3 normalWS : NORMAL;
+	float4 color : COLOR;
+};
+
+float3 Rotate(float4 q, float3 v)
+{
+	float3 t = 2.0 * cross(q.xyz, v);
+	return v + q.w * t + cross(q.xyz, t);
+}
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	PixelShaderInput output;
+	float3 posWS = Rotate(input.instanceRotation, input.pos * input.instancePositionScale.w) + input.instancePositionScale.xyz;
+
+	output.pos = mul(mul(float4(posWS, 1.0), view), projection);
+	output.normalWS = Rotate(input.instanceRotation, input.normal);
+	output.color = input.color;
+
+	return output;
+}
@@ -0,0 +1,13 @@
+// Constant buffer registers shared by all shaders, ConstantBufferSlot in ShaderStructures.h.
+// b0 is set once a frame for every draw, b1 holds the draw's own constants and b2 its material's.
+
+// Camera and light, FrameConstantBuffer in ShaderStructures.h
+cbuffer FrameConstantBuffer : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float4 cameraPos;
+	float4 totalTime;
+	float4 lightDir;
+	float4 lightColor;
+};
@@ -1,9 +1,9 @@
-// A constant buffer that stores the three basic column-major matrices for composing geometry.
-cbuffer ModelViewProjectionConstantBuffer : register(b0)
+#include "FrameConstants.hlsli"
+
+// Centres the sky on the camera
+cbuffer ModelConstantBuffer : register(b1)
 {
 	matrix model;
-	matrix view;
-	matrix projection;
 };
 
 // Per-vertex data used as input to the vertex shader.
@@ -26,7 +26,8 @@ PixelShaderInput main(VertexShaderInput input)
 	float4 pos = float4(input.pos, 1.0f);
 
 	float4x4 MVP = mul(model, mul(view, projection));
-	output.pos = mul(pos, MVP);
+	// On the far plane whatever its size, drawn with a LESS_EQUAL depth test after the opaque geometry
+	output.pos = mul(pos, MVP).xyww;
 	output.texCoord = input.pos;
 
 	return output;
@@ -0,0 +1,27 @@
+#include "WaterCommon.hlsli"
+
+// Gerstner waves baked over one tile and period at load, frames stacked along w: displacement (x, height, z)
+// and slope (dh/dx, dh/dz) at the displaced point
+Texture3D displacementMap : register(t0);
+Texture3D slopeMap : register(t1);
+
+struct VertexShaderInput
+{
+	float2 posOS : SV_Position;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	float2 posXZ = input.posOS * positionDecode.xy + positionDecode.zw;
+	float3 posWS = mul(float4(posXZ.x, 0.0, posXZ.y, 1.0), model).xyz;
+
+	// The baked waves don't fade per set, only into the distance like all the waves
+	float waveAttenuation = CalculateWaveAttenuation(length(posWS - cameraPos.xyz), 400, 1000);
+	float3 uvw = float3(posWS.xz * waveMapTiling.x + waveMapTiling.z, totalTime.x * waveMapTiling.y + waveMapTiling.w);
+	float3 offset = displacementMap.SampleLevel(wrapSampler, uvw, 0).xyz * waveAttenuation;
+	float2 slope = slopeMap.SampleLevel(wrapSampler, uvw, 0).xy * waveAttenuation;
+
+	offset.y += GetRippleHeight(posWS.xz + offset.xz);
+
+	return OutputWaterVertex(posWS, posWS + offset, normalize(float3(-slope.x, 1.0, -slope.y)));
+}
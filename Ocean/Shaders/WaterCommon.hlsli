@@ -0,0 +1,130 @@
+#include "WaterConstants.hlsli"
+
+// Per-pixel color data passed through the pixel shader.
+struct PixelShaderInput
+{
+	float4 posPS : SV_Position;
+	float3 posWS : POSITION;
+	float3 normalWS : NORMAL;
+	float2 normalUV1 : TEXCOORD0;
+	float2 normalUV2 : TEXCOORD1;
+	float3 viewWS : VIEWVECTORS;
+};
+
+float3 CalculateGerstnerOffset(
+	float2 xzPos, float4 steepness, float4 amp, float4 freq,
+	float4 speed, float4 dirX, float4 dirZ, float time)
+{
+	float4 phase = freq * (dirX * xzPos.x + dirZ * xzPos.y) + time * speed;
+	float4 COS = cos(phase);
+	float4 SIN = sin(phase);
+
+	float4 horizontal = steepness * amp * COS;
+	return float3(dot(horizontal, dirX), dot(SIN, amp), dot(horizontal, dirZ));
+}
+
+float3 CalculateGerstnerNormal(
+	float2 xzPos, float intensity, float4 amp, float4 freq,
+	float4 speed, float4 dirX, float4 dirZ, float time)
+{
+	float4 phase = freq * (dirX * xzPos.x + dirZ * xzPos.y) + time * speed;
+	float4 slope = freq * amp * cos(phase);
+
+	float3 normal = float3(-dot(slope, dirX), 2.0, -dot(slope, dirZ));
+	normal.xz *= intensity;
+	return normalize(normal);
+}
+
+float CalculateWaveAttenuation(float d, float dmin, float dmax)
+{
+	// Quadratic curve that is 1 at dmin and 0 at dmax
+	// Constant 1 for less than dmin, constant 0 for more than dmax
+	if (d > dmax) return 0.f;
+	else
+	{
+		return saturate((1.f / ((dmin - dmax)*(dmin - dmax))) * ((d-dmax) * (d - dmax)));
+	}
+}
+
+// Ripples around the camera, every water vertex shader adds their height and the pixel shader their slopes
+Texture2D rippleMap : register(t2);
+SamplerState wrapSampler : register(s0);
+
+// Ripple map coordinates of a world position and whether the ripple grid covers it
+float2 GetRippleUV(float2 xzWS)
+{
+	return xzWS * rippleMapping.x + rippleMapping.yz;
+}
+
+float GetRippleMask(float2 uv)
+{
+	return all(saturate(uv) == uv) ? rippleMapping.w : 0.0;
+}
+
+// Ripple height at a displaced world position, 0 outside the ripple grid
+float GetRippleHeight(float2 xzWS)
+{
+	float2 uv = GetRippleUV(xzWS);
+	return rippleMap.SampleLevel(wrapSampler, uv, 0).x * GetRippleMask(uv);
+}
+
+// Fills in everything the pixel shader needs for a point of the flat water plane moved to displacedWS
+PixelShaderInput OutputWaterVertex(float3 posWS, float3 displacedWS, float3 normalWS)
+{
+	PixelShaderInput output;
+	output.normalUV1 = posWS.xz * .05 + uvWaveSpeed.xy * totalTime.x * .025;
+	output.normalUV2 = posWS.xz * .05 + uvWaveSpeed.zw * totalTime.x * .025 + float2(.5, .5);
+
+	float4x4 VP = mul(view, projection);
+
+	output.posPS = mul(float4(displacedWS, 1), VP);
+	output.posWS = displacedWS;
+	output.viewWS = posWS - cameraPos.xyz;
+	output.normalWS = normalWS;
+
+	return output;
+}
+
+// Moves a point of the flat water plane by the waves and fills in everything the pixel shader needs
+PixelShaderInput DisplaceWaterSurface(float3 posWS)
+{
+	float distanceToCamera = length(posWS - cameraPos.xyz);
+	float waveAttenuation = CalculateWaveAttenuation(distanceToCamera, 400, 1000);
+
+	// The sets are ordered by fade distance, the first one faded out ends the loop so far vertices
+	// only pay for the long waves that still show there
+	uint setCount = 0;
+	float setFade[MAX_WAVE_SETS];
+	float3 offset = float3(0, 0, 0);
+	[loop]
+	for (uint set = 0; set < waveSetCount.x; set++)
+	{
+		float fade = saturate((waveFade[set].y - distanceToCamera) / (waveFade[set].y - waveFade[set].x));
+		[branch]
+		if (fade <= 0.0)
+			break;
+
+		setFade[set] = fade * waveAttenuation;
+		offset += CalculateGerstnerOffset(
+			posWS.xz, waveSteepness[set], waveAmplitude[set], waveFrequency[set],
+			waveSpeed[set], waveDirectionX[set], waveDirectionZ[set], totalTime.x) * setFade[set];
+		setCount++;
+	}
+
+	float3 displacedWS = posWS + offset;
+	displacedWS.y += GetRippleHeight(displacedWS.xz);
+
+	float3 normal = float3(0, 0, 0);
+	[loop]
+	for (uint normalSet = 0; normalSet < setCount; normalSet++)
+	{
+		normal += CalculateGerstnerNormal(
+			displacedWS.xz, waveFade[normalSet].z, waveAmplitude[normalSet], waveFrequency[normalSet],
+			waveSpeed[normalSet], waveDirectionX[normalSet], waveDirectionZ[normalSet], totalTime.x) * setFade[normalSet];
+	}
+
+	// Flat where every set has faded out
+	normal = dot(normal, normal) > 0.0 ? normalize(normal) : float3(0, 1, 0);
+
+	return OutputWaterVertex(posWS, displacedWS, normal);
+}
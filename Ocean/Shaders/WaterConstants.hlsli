@@ -0,0 +1,30 @@
+#include "FrameConstants.hlsli"
+
+// maxGerstnerWaveSets in GerstnerWaves.h
+#define MAX_WAVE_SETS 4
+
+// Written for every draw of the water
+cbuffer WaterObjectConstantBuffer : register(b1)
+{
+	matrix model;
+	float4 positionDecode;
+	float4 waveMapTiling;
+	float4 rippleMapping;
+};
+
+// Only changes with the waves
+cbuffer WaterMaterialConstantBuffer : register(b2)
+{
+	float4 uvWaveSpeed;
+
+	// Sets of four Gerstner waves, ordered from the one that fades out last.
+	// waveFade: fade start, fade end, normal intensity
+	uint4 waveSetCount;
+	float4 waveAmplitude[MAX_WAVE_SETS];
+	float4 waveFrequency[MAX_WAVE_SETS];
+	float4 waveSteepness[MAX_WAVE_SETS];
+	float4 waveSpeed[MAX_WAVE_SETS];
+	float4 waveDirectionX[MAX_WAVE_SETS];
+	float4 waveDirectionZ[MAX_WAVE_SETS];
+	float4 waveFade[MAX_WAVE_SETS];
+};
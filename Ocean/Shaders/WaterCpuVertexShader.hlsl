@@ -0,0 +1,19 @@
+#include "WaterCommon.hlsli"
+
+// Vertices the CPU already moved by the waves, in world space
+struct VertexShaderInput
+{
+	float3 posWS : SV_Position;
+	float3 normalWS : NORMAL;
+	// x, z of the point before it was displaced, the normal maps scroll with it
+	float2 planeWS : TEXCOORD0;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	// The CPU moved the vertex by the waves, the ripples come from their texture like in the other modes
+	float3 displacedWS = input.posWS;
+	displacedWS.y += GetRippleHeight(displacedWS.xz);
+
+	return OutputWaterVertex(float3(input.planeWS.x, 0.0, input.planeWS.y), displacedWS, input.normalWS);
+}
\ No newline at end of file
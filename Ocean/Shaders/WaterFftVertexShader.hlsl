@@ -0,0 +1,26 @@
+#include "WaterCommon.hlsli"
+
+// Displacement (x, height, z) and slope (dh/dx, dh/dz) of the FFT simulated patch, it repeats over the sea
+Texture2D displacementMap : register(t0);
+Texture2D slopeMap : register(t1);
+
+struct VertexShaderInput
+{
+	float2 posOS : SV_Position;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	float2 posXZ = input.posOS * positionDecode.xy + positionDecode.zw;
+	float3 posWS = mul(float4(posXZ.x, 0.0, posXZ.y, 1.0), model).xyz;
+
+	// The same fade into the distance as the Gerstner waves, it hides the repeating patch
+	float waveAttenuation = CalculateWaveAttenuation(length(posWS - cameraPos.xyz), 400, 1000);
+	float2 uv = posWS.xz * waveMapTiling.x;
+	float3 offset = displacementMap.SampleLevel(wrapSampler, uv, 0).xyz * waveAttenuation;
+	float2 slope = slopeMap.SampleLevel(wrapSampler, uv, 0).xy * waveAttenuation;
+
+	offset.y += GetRippleHeight(posWS.xz + offset.xz);
+
+	return OutputWaterVertex(posWS, posWS + offset, normalize(float3(-slope.x, 1.0, -slope.y)));
+}
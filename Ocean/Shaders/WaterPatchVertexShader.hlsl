@@ -0,0 +1,24 @@
+#include "WaterCommon.hlsli"
+
+// The shared patch mesh is a grid in whole grid units, the instance places it in the world.
+struct VertexShaderInput
+{
+	float2 gridPos : SV_Position;
+	float4 patchOriginScale : PATCHORIGINSCALE;
+	float4 patchMorph : PATCHMORPH;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	float quadSize = input.patchOriginScale.z;
+	float2 posXZ = input.patchOriginScale.xy + input.gridPos * quadSize;
+
+	// Morph towards the next level's grid by sliding the odd vertices onto their even neighbours,
+	// measured on the flat grid like the quadtree selection does
+	float distanceToCamera = distance(float3(posXZ.x, 0.0, posXZ.y), cameraPos.xyz);
+	float morph = saturate((distanceToCamera - input.patchMorph.x) / (input.patchMorph.y - input.patchMorph.x));
+	float2 oddVertex = frac(input.gridPos * 0.5) * 2.0;
+	posXZ -= oddVertex * quadSize * morph;
+
+	return DisplaceWaterSurface(float3(posXZ.x, 0.0, posXZ.y));
+}
\ No newline at end of file
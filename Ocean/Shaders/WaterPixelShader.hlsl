@@ -1,17 +1,14 @@
+#include "WaterConstants.hlsli"
+
 Texture2D normalMap1 : register(t[0]);
 Texture2D normalMap2 : register(t[1]);
 TextureCube environmentMap : register(t[2]);
 Texture2D foamMap : register(t[3]);
+// Height, dh/dx and dh/dz of the ripple simulation around the camera
+Texture2D rippleMap : register(t[4]);
 
 SamplerState samLinear : register(s[0]);
 
-// A constant buffer.
-cbuffer MyConstantBuffer : register(b0)
-{
-	float4 lightDir;
-	float4 lightColor;
-};
-
 // Per-pixel color data passed through the pixel shader.
 struct PixelShaderInput
 {
@@ -37,6 +34,12 @@ float4 main(PixelShaderInput input) : SV_TARGET
 {
 	float4 color;
 
+	// tilting the wave normal by the ripples
+	float2 rippleUV = input.posWS.xz * rippleMapping.x + rippleMapping.yz;
+	float rippleMask = all(saturate(rippleUV) == rippleUV) ? rippleMapping.w : 0.0;
+	float2 rippleSlope = rippleMap.Sample(samLinear, rippleUV).yz * rippleMask;
+	input.normalWS = normalize(input.normalWS - float3(rippleSlope.x, 0, rippleSlope.y));
+
 	// calculating normal vector
 	float normalMapAttenuation = 0.3f;
 	float3 normalTS1 = normalize(normalMap1.Sample(samLinear, input.normalUV1) * 2.0 - 1.0).rgb;
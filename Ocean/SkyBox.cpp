@@ -1,17 +1,21 @@
 #include "pch.h"
 #include "Skybox.h"
+#include <cfloat>
 
 #include "DDSTextureLoader.h"
+#include "CommonStates.h"
 
 using namespace Ocean;
 
 Skybox::Skybox()
 { 
 	mesh = std::shared_ptr<GeneratedMesh>(new GeneratedMesh());
+	mesh->optimizeVertexCache = true;
 }
 
 void Skybox::LoadTextures(
 		std::shared_ptr<DX::DeviceResources> deviceResources,
+		StateObjectCache& stateCache,
 		const wchar_t* diffuseTextureFile)
 {
 	auto device = deviceResources->GetD3DDevice();
@@ -19,21 +23,13 @@ void Skybox::LoadTextures(
 	// Load textures
 	DX::ThrowIfFailed(DirectX::CreateDDSTextureFromFile(device, diffuseTextureFile, nullptr, diffuseTexture.ReleaseAndGetAddressOf()));
 
-	// Create samplers
-	D3D11_SAMPLER_DESC sampDesc;
-	ZeroMemory(&sampDesc, sizeof(sampDesc));
-	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-	sampDesc.MinLOD = 0;
-	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&sampDesc, &linearSampler);
+	// The same sampler as the water's
+	linearSampler = stateCache.GetLinearWrapSampler();
 }
 
 void Skybox::LoadVertexShader(
 	std::shared_ptr<DX::DeviceResources> deviceResources,
+	StateObjectCache& stateCache,
 	const std::vector<byte>& vsFileData)
 {
 	// Vertex Shader
@@ -47,23 +43,10 @@ void Skybox::LoadVertexShader(
 		);
 
 	// Input Layout
-	static const D3D11_INPUT_ELEMENT_DESC vertexDesc[] =
-	{
-		{ "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 44, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-	};
-
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateInputLayout(
-			vertexDesc,
-			ARRAYSIZE(vertexDesc),
-			&vsFileData[0],
-			vsFileData.size(),
-			&inputLayout
-			)
+	inputLayout = stateCache.GetInputLayout(
+		VertexFormat<VertexPositionNormal>::Elements(),
+		VertexFormat<VertexPositionNormal>::elementCount,
+		vsFileData
 		);
 }
 
@@ -81,43 +64,38 @@ void Skybox::LoadPixelShader(
 		);
 }
 
-void Skybox::CreateConstantBuffers(
-	std::shared_ptr<DX::DeviceResources> deviceResources)
-{
-	CD3D11_BUFFER_DESC vsConstantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&vsConstantBufferDesc,
-			nullptr,
-			&vsConstantBuffer
-			)
-		);
-}
-
 void Skybox::LoadMesh(
 	std::shared_ptr<DX::DeviceResources> deviceResources)
 {
 	mesh->GenerateSphereMesh(deviceResources, 20, 20, .5f);
 }
 
-void Skybox::Draw(
-	std::shared_ptr<DX::DeviceResources> deviceResources)
+void Skybox::PrepareConstants(ConstantBufferRing& ring)
 {
+	objectAllocation = ring.Write(objectConstants);
+}
 
-	auto device = deviceResources->GetD3DDevice();
-	auto context = deviceResources->GetD3DDeviceContext();
-
-	context->UpdateSubresource(
-		vsConstantBuffer.Get(),
-		0,
-		NULL,
-		&vsConstantBufferData,
-		0,
-		0);
+void Skybox::SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states)
+{
+	// Seen from inside, and tested against the depth of what is in front without writing its own
+	DrawPacket packet;
+	packet.key = queue.MakeKey(ScenePass, OpaqueLayer, FLT_MAX, pixelShader.Get(), diffuseTexture.Get());
+	packet.rasterizerState = states.CullClockwise();
+	packet.blendState = states.Opaque();
+	packet.depthStencilState = states.DepthRead();
+	packet.drawable = this;
+	packet.item = 0;
+	queue.Submit(packet);
+}
 
-	UINT stride = sizeof(VertexPositionNormal);
+void Skybox::Draw(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	IRenderContext& renderContext,
+	UINT item)
+{
+	UINT stride = mesh->vertexStride;
 	UINT offset = 0;
-	context->IASetVertexBuffers(
+	renderContext.SetVertexBuffers(
 		0,
 		1,
 		mesh->vertexBuffer.GetAddressOf(),
@@ -125,42 +103,30 @@ void Skybox::Draw(
 		&offset
 		);
 
-	context->IASetIndexBuffer(
+	renderContext.SetIndexBuffer(
 		mesh->indexBuffer.Get(),
 		DXGI_FORMAT_R32_UINT,
 		0
 		);
 
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	renderContext.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	context->IASetInputLayout(inputLayout.Get());
+	renderContext.SetInputLayout(inputLayout.Get());
 
 	// Attach our vertex shader.
-	context->VSSetShader(
-		vertexShader.Get(),
-		nullptr,
-		0
-		);
+	renderContext.SetVertexShader(vertexShader.Get());
 
-	// Send the constant buffer to the graphics device.
-	context->VSSetConstantBuffers(
-		0,
-		1,
-		vsConstantBuffer.GetAddressOf()
-		);
+	// The camera is in the frame's constants, the draw's own only place the sky around it.
+	BindConstants(renderContext, VertexStage, ObjectConstantSlot, objectAllocation);
 
 	// Attach our pixel shader.
-	context->PSSetShader(
-		pixelShader.Get(),
-		nullptr,
-		0
-		);
+	renderContext.SetPixelShader(pixelShader.Get());
 
-	context->PSSetShaderResources(0, 1, diffuseTexture.GetAddressOf());
-	context->PSSetSamplers(0, 1, linearSampler.GetAddressOf());
+	renderContext.SetShaderResources(PixelStage, 0, 1, diffuseTexture.GetAddressOf());
+	renderContext.SetSamplers(PixelStage, 0, 1, linearSampler.GetAddressOf());
 
 	// Draw the objects.
-	context->DrawIndexed(
+	renderContext.DrawIndexed(
 		mesh->indexCount,
 		0,
 		0
@@ -171,8 +137,6 @@ Skybox::~Skybox()
 {
 	vertexShader.Reset();
 	pixelShader.Reset();
-	vsConstantBuffer.Reset();
-	psConstantBuffer.Reset();
 	inputLayout.Reset();
 	diffuseTexture.Reset();
 	linearSampler.Reset();
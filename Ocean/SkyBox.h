@@ -1,40 +1,47 @@
 #pragma once
 #include "GeneratedMesh.h"
+#include "RenderContext.h"
+#include "DrawQueue.h"
+#include "ConstantBuffers.h"
+#include "StateObjectCache.h"
 
 namespace Ocean
 {
-	class Skybox
+	class Skybox : public IDrawable
 	{
 	public:
 		Skybox();
 
 		void LoadTextures(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
 			const wchar_t* diffuseTextureFile);
 		void LoadVertexShader(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
 			const std::vector<byte>& vsFileData);
 		void LoadPixelShader(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
 			const std::vector<byte>& psFileData);
-		void CreateConstantBuffers(
-			std::shared_ptr<DX::DeviceResources> deviceResources);
 		void LoadMesh(
 			std::shared_ptr<DX::DeviceResources> deviceResources);
-		void Draw(std::shared_ptr<DX::DeviceResources> deviceResources);
+		// Writes the draw's constants into the frame's ring
+		void PrepareConstants(ConstantBufferRing& ring);
+		// Opaque and at the far plane, so it goes after the other opaque draws and only shades what they left uncovered
+		virtual void SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states);
+		virtual void Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item);
 
 		~Skybox();
 
-		ModelViewProjectionConstantBuffer vsConstantBufferData;
+		ModelConstantBuffer objectConstants;
 
 	protected:
 
 		std::shared_ptr<GeneratedMesh> mesh;
+		ConstantAllocation objectAllocation;
 
 		Microsoft::WRL::ComPtr<ID3D11VertexShader>         vertexShader;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>          pixelShader;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>               vsConstantBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>               psConstantBuffer;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>          inputLayout;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   diffuseTexture;
 		Microsoft::WRL::ComPtr<ID3D11SamplerState>         linearSampler;
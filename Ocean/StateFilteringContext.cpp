@@ -0,0 +1,315 @@
+#include "pch.h"
+#include "StateFilteringContext.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace Ocean;
+
+namespace
+{
+	template <typename T>
+	bool Changes(T& bound, bool& known, T value)
+	{
+		if (known && bound == value)
+			return false;
+		bound = value;
+		known = true;
+		return true;
+	}
+
+	// Stores values into bound from startSlot on. first, end get the changed range relative to startSlot, empty if none.
+	template <typename T, typename Equal>
+	bool UpdateSlots(T* bound, bool* known, UINT startSlot, UINT count, const T* values, UINT& first, UINT& end, Equal equal)
+	{
+		first = count;
+		end = 0;
+		for (UINT i = 0; i < count; i++)
+		{
+			UINT slot = startSlot + i;
+			if (known[slot] && equal(bound[slot], values[i]))
+				continue;
+			bound[slot] = values[i];
+			known[slot] = true;
+			first = std::min(first, i);
+			end = i + 1;
+		}
+		return end > 0;
+	}
+
+	template <typename T>
+	bool Same(const T& a, const T& b)
+	{
+		return a == b;
+	}
+}
+
+StateFilteringContext::StateFilteringContext(std::shared_ptr<IRenderContext> target)
+	: target(target)
+{
+	ResetStats();
+	Invalidate();
+}
+
+void StateFilteringContext::Invalidate()
+{
+	renderTargetsKnown = false;
+	rasterizerStateKnown = blendStateKnown = depthStencilStateKnown = false;
+	inputLayoutKnown = topologyKnown = vertexShaderKnown = pixelShaderKnown = false;
+	indexBufferKnown = false;
+	std::fill(vertexBufferKnown, vertexBufferKnown + maxSlots, false);
+
+	for (StageState& stage : stages)
+	{
+		std::fill(stage.constantBufferKnown, stage.constantBufferKnown + maxSlots, false);
+		std::fill(stage.samplerKnown, stage.samplerKnown + maxSlots, false);
+		std::fill(stage.viewKnown, stage.viewKnown + maxSlots, false);
+		std::fill(stage.pendingSet, stage.pendingSet + maxSlots, false);
+		stage.pendingFirst = maxSlots;
+		stage.pendingEnd = 0;
+	}
+}
+
+void StateFilteringContext::ResetStats()
+{
+	stats.bindsRequested = 0;
+	stats.bindsIssued = 0;
+	stats.drawCalls = 0;
+}
+
+void StateFilteringContext::SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil)
+{
+	assert(count <= maxRenderTargets);
+	stats.bindsRequested++;
+	if (renderTargetsKnown && count == renderTargetCount && depthStencil == this->depthStencil &&
+		std::equal(targets, targets + count, renderTargets))
+		return;
+
+	renderTargetCount = count;
+	std::copy_n(targets, count, renderTargets);
+	this->depthStencil = depthStencil;
+	renderTargetsKnown = true;
+	stats.bindsIssued++;
+	target->SetRenderTargets(count, targets, depthStencil);
+}
+
+void StateFilteringContext::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	stats.bindsRequested++;
+	if (!Changes(rasterizerState, rasterizerStateKnown, state))
+		return;
+	stats.bindsIssued++;
+	target->SetRasterizerState(state);
+}
+
+void StateFilteringContext::SetBlendState(ID3D11BlendState* state)
+{
+	stats.bindsRequested++;
+	if (!Changes(blendState, blendStateKnown, state))
+		return;
+	stats.bindsIssued++;
+	target->SetBlendState(state);
+}
+
+void StateFilteringContext::SetDepthStencilState(ID3D11DepthStencilState* state)
+{
+	stats.bindsRequested++;
+	if (!Changes(depthStencilState, depthStencilStateKnown, state))
+		return;
+	stats.bindsIssued++;
+	target->SetDepthStencilState(state);
+}
+
+void StateFilteringContext::SetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	stats.bindsRequested++;
+	if (!Changes(this->inputLayout, inputLayoutKnown, inputLayout))
+		return;
+	stats.bindsIssued++;
+	target->SetInputLayout(inputLayout);
+}
+
+void StateFilteringContext::SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	stats.bindsRequested++;
+	if (!Changes(this->topology, topologyKnown, topology))
+		return;
+	stats.bindsIssued++;
+	target->SetPrimitiveTopology(topology);
+}
+
+void StateFilteringContext::SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	assert(startSlot + count <= maxSlots);
+	stats.bindsRequested++;
+
+	VertexBufferSlot slots[maxSlots];
+	for (UINT i = 0; i < count; i++)
+	{
+		slots[i].buffer = buffers[i];
+		slots[i].stride = strides[i];
+		slots[i].offset = offsets[i];
+	}
+
+	UINT first, end;
+	auto same = [](const VertexBufferSlot& a, const VertexBufferSlot& b) { return a.buffer == b.buffer && a.stride == b.stride && a.offset == b.offset; };
+	if (!UpdateSlots(vertexBuffers, vertexBufferKnown, startSlot, count, slots, first, end, same))
+		return;
+	stats.bindsIssued++;
+	target->SetVertexBuffers(startSlot + first, end - first, buffers + first, strides + first, offsets + first);
+}
+
+void StateFilteringContext::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	stats.bindsRequested++;
+	if (indexBufferKnown && buffer == indexBuffer && format == indexFormat && offset == indexOffset)
+		return;
+
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	indexBufferKnown = true;
+	stats.bindsIssued++;
+	target->SetIndexBuffer(buffer, format, offset);
+}
+
+void StateFilteringContext::SetVertexShader(ID3D11VertexShader* shader)
+{
+	stats.bindsRequested++;
+	if (!Changes(vertexShader, vertexShaderKnown, shader))
+		return;
+	stats.bindsIssued++;
+	target->SetVertexShader(shader);
+}
+
+void StateFilteringContext::SetPixelShader(ID3D11PixelShader* shader)
+{
+	stats.bindsRequested++;
+	if (!Changes(pixelShader, pixelShaderKnown, shader))
+		return;
+	stats.bindsIssued++;
+	target->SetPixelShader(shader);
+}
+
+void StateFilteringContext::SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers)
+{
+	SetConstantBufferSlots(stage, startSlot, count, buffers, nullptr, nullptr);
+}
+
+void StateFilteringContext::SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	SetConstantBufferSlots(stage, startSlot, count, buffers, firstConstants, constantCounts);
+}
+
+void StateFilteringContext::SetConstantBufferSlots(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts)
+{
+	assert(startSlot + count <= maxSlots);
+	stats.bindsRequested++;
+
+	ConstantBufferSlot slots[maxSlots];
+	for (UINT i = 0; i < count; i++)
+	{
+		slots[i].buffer = buffers[i];
+		slots[i].firstConstant = firstConstants != nullptr ? firstConstants[i] : 0;
+		slots[i].constantCount = constantCounts != nullptr ? constantCounts[i] : 0;
+	}
+
+	StageState& state = stages[stage];
+	UINT first, end;
+	auto same = [](const ConstantBufferSlot& a, const ConstantBufferSlot& b) { return a.buffer == b.buffer && a.firstConstant == b.firstConstant && a.constantCount == b.constantCount; };
+	if (!UpdateSlots(state.constantBuffers, state.constantBufferKnown, startSlot, count, slots, first, end, same))
+		return;
+	stats.bindsIssued++;
+
+	if (firstConstants != nullptr)
+		target->SetConstantBufferRanges(stage, startSlot + first, end - first, buffers + first, firstConstants + first, constantCounts + first);
+	else
+		target->SetConstantBuffers(stage, startSlot + first, end - first, buffers + first);
+}
+
+void StateFilteringContext::SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views)
+{
+	assert(startSlot + count <= maxSlots);
+	stats.bindsRequested++;
+
+	// Passed on with the other views of the stage before the next draw
+	StageState& state = stages[stage];
+	std::copy_n(views, count, state.pendingViews + startSlot);
+	std::fill(state.pendingSet + startSlot, state.pendingSet + startSlot + count, true);
+	state.pendingFirst = std::min(state.pendingFirst, startSlot);
+	state.pendingEnd = std::max(state.pendingEnd, startSlot + count);
+}
+
+void StateFilteringContext::SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	assert(startSlot + count <= maxSlots);
+	stats.bindsRequested++;
+
+	StageState& state = stages[stage];
+	UINT first, end;
+	if (!UpdateSlots(state.samplers, state.samplerKnown, startSlot, count, samplers, first, end, Same<ID3D11SamplerState*>))
+		return;
+	stats.bindsIssued++;
+	target->SetSamplers(stage, startSlot + first, end - first, samplers + first);
+}
+
+void StateFilteringContext::FlushShaderResources()
+{
+	for (int stage = VertexStage; stage <= PixelStage; stage++)
+	{
+		StageState& state = stages[stage];
+		ID3D11ShaderResourceView* desired[maxSlots];
+		UINT runStart = maxSlots, runEnd = 0;
+		for (UINT slot = state.pendingFirst; slot <= state.pendingEnd; slot++)
+		{
+			// Slots in between that weren't asked for can join the call with their bound view, unless it is unknown
+			bool changed = false, joinable = false;
+			if (slot < state.pendingEnd && state.pendingSet[slot])
+			{
+				desired[slot] = state.pendingViews[slot];
+				changed = !state.viewKnown[slot] || state.views[slot] != desired[slot];
+				joinable = true;
+			}
+			else if (slot < state.pendingEnd && state.viewKnown[slot])
+			{
+				desired[slot] = state.views[slot];
+				joinable = true;
+			}
+
+			if (changed)
+			{
+				runStart = std::min(runStart, slot);
+				runEnd = slot + 1;
+			}
+			else if (!joinable && runEnd > 0)
+			{
+				stats.bindsIssued++;
+				target->SetShaderResources((ShaderStage)stage, runStart, runEnd - runStart, desired + runStart);
+				for (UINT bound = runStart; bound < runEnd; bound++)
+				{
+					state.views[bound] = desired[bound];
+					state.viewKnown[bound] = true;
+				}
+				runStart = maxSlots;
+				runEnd = 0;
+			}
+		}
+
+		std::fill(state.pendingSet, state.pendingSet + maxSlots, false);
+		state.pendingFirst = maxSlots;
+		state.pendingEnd = 0;
+	}
+}
+
+void StateFilteringContext::DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+{
+	FlushShaderResources();
+	stats.drawCalls++;
+	target->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateFilteringContext::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+{
+	FlushShaderResources();
+	stats.drawCalls++;
+	target->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "RenderContext.h"
+
+namespace Ocean
+{
+	struct RenderContextStats
+	{
+		// Bind calls made on the filter and the ones it passed on, the rest changed nothing or were merged
+		UINT bindsRequested;
+		UINT bindsIssued;
+		UINT drawCalls;
+
+		UINT GetBindsSkipped() const { return bindsRequested - bindsIssued; }
+	};
+
+	// Remembers what is bound and only passes on the binds that change something. Slot ranges are trimmed to the
+	// slots that change. Shader resources are held back until the next draw, so views set one slot at a time go
+	// out as one call per stage covering every changed slot.
+	// Starts out knowing nothing, call Invalidate whenever something else used the context behind its back.
+	class StateFilteringContext : public IRenderContext
+	{
+	public:
+		StateFilteringContext(std::shared_ptr<IRenderContext> target);
+
+		// Forgets every bind, the next one of each kind is passed on again. Drops the views not yet passed on.
+		void Invalidate();
+
+		const RenderContextStats& GetStats() const { return stats; }
+		void ResetStats();
+
+		// Slots tracked per stage and kind, starting at 0
+		static const UINT maxSlots = 16;
+
+		virtual void SetRenderTargets(UINT count, ID3D11RenderTargetView* const* targets, ID3D11DepthStencilView* depthStencil);
+		virtual void SetRasterizerState(ID3D11RasterizerState* state);
+		virtual void SetBlendState(ID3D11BlendState* state);
+		virtual void SetDepthStencilState(ID3D11DepthStencilState* state);
+
+		virtual void SetInputLayout(ID3D11InputLayout* inputLayout);
+		virtual void SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+		virtual void SetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+		virtual void SetVertexShader(ID3D11VertexShader* shader);
+		virtual void SetPixelShader(ID3D11PixelShader* shader);
+		virtual void SetConstantBuffers(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers);
+		virtual void SetConstantBufferRanges(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+		virtual void SetShaderResources(ShaderStage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views);
+		virtual void SetSamplers(ShaderStage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+
+	private:
+		void FlushShaderResources();
+		// Whole buffers without firstConstants and constantCounts
+		void SetConstantBufferSlots(ShaderStage stage, UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants, const UINT* constantCounts);
+
+		std::shared_ptr<IRenderContext> target;
+		RenderContextStats stats;
+
+		// Bound state, each with whether it is known
+		static const UINT maxRenderTargets = 8;
+		UINT renderTargetCount;
+		ID3D11RenderTargetView* renderTargets[maxRenderTargets];
+		ID3D11DepthStencilView* depthStencil;
+		bool renderTargetsKnown;
+
+		ID3D11RasterizerState* rasterizerState;
+		ID3D11BlendState* blendState;
+		ID3D11DepthStencilState* depthStencilState;
+		ID3D11InputLayout* inputLayout;
+		D3D11_PRIMITIVE_TOPOLOGY topology;
+		ID3D11VertexShader* vertexShader;
+		ID3D11PixelShader* pixelShader;
+		bool rasterizerStateKnown, blendStateKnown, depthStencilStateKnown, inputLayoutKnown, topologyKnown, vertexShaderKnown, pixelShaderKnown;
+
+		struct VertexBufferSlot
+		{
+			ID3D11Buffer* buffer;
+			UINT stride;
+			UINT offset;
+		};
+		VertexBufferSlot vertexBuffers[maxSlots];
+		bool vertexBufferKnown[maxSlots];
+
+		ID3D11Buffer* indexBuffer;
+		DXGI_FORMAT indexFormat;
+		UINT indexOffset;
+		bool indexBufferKnown;
+
+		// Bound whole when constantCount is 0
+		struct ConstantBufferSlot
+		{
+			ID3D11Buffer* buffer;
+			UINT firstConstant;
+			UINT constantCount;
+		};
+
+		struct StageState
+		{
+			ConstantBufferSlot constantBuffers[maxSlots];
+			bool constantBufferKnown[maxSlots];
+			ID3D11SamplerState* samplers[maxSlots];
+			bool samplerKnown[maxSlots];
+			ID3D11ShaderResourceView* views[maxSlots];
+			bool viewKnown[maxSlots];
+			// Views asked for since the last draw, all in [pendingFirst, pendingEnd)
+			ID3D11ShaderResourceView* pendingViews[maxSlots];
+			bool pendingSet[maxSlots];
+			UINT pendingFirst;
+			UINT pendingEnd;
+		};
+		StageState stages[2];
+	};
+}
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "StateObjectCache.h"
+#include "Common\DirectXHelper.h"
+#include <cstring>
+
+using namespace Ocean;
+
+namespace
+{
+	void Append(std::string& key, const void* data, size_t size)
+	{
+		key.append((const char*)data, size);
+	}
+
+	template <typename T, typename Create>
+	T* Find(std::unordered_map<std::string, Microsoft::WRL::ComPtr<T>>& objects, StateCacheStats& stats, const std::string& key, Create create)
+	{
+		stats.requests++;
+		auto found = objects.find(key);
+		if (found != objects.end())
+		{
+			stats.hits++;
+			return found->second.Get();
+		}
+
+		Microsoft::WRL::ComPtr<T> object;
+		DX::ThrowIfFailed(create(&object));
+		objects[key] = object;
+		return object.Get();
+	}
+}
+
+void Ocean::FindInputSignature(const byte* bytecode, size_t length, const byte*& signature, size_t& signatureLength)
+{
+	signature = bytecode;
+	signatureLength = length;
+
+	// DXBC container: magic, 16 byte checksum, version, total size, chunk count and the offsets of the chunks,
+	// which start with their four character code and size
+	const size_t headerSize = 32;
+	if (length < headerSize || memcmp(bytecode, "DXBC", 4) != 0)
+		return;
+
+	UINT chunkCount;
+	memcpy(&chunkCount, bytecode + 28, sizeof(UINT));
+	for (UINT i = 0; i < chunkCount && headerSize + (i + 1) * sizeof(UINT) <= length; i++)
+	{
+		UINT offset, size;
+		memcpy(&offset, bytecode + headerSize + i * sizeof(UINT), sizeof(UINT));
+		if ((size_t)offset + 8 > length)
+			return;
+		memcpy(&size, bytecode + offset + 4, sizeof(UINT));
+		if ((size_t)offset + 8 + size > length)
+			return;
+
+		if (memcmp(bytecode + offset, "ISGN", 4) == 0 || memcmp(bytecode + offset, "ISG1", 4) == 0)
+		{
+			signature = bytecode + offset + 8;
+			signatureLength = size;
+			return;
+		}
+	}
+}
+
+StateObjectCache::StateObjectCache(std::shared_ptr<DX::DeviceResources> deviceResources)
+	: deviceResources(deviceResources)
+{
+	inputLayouts.stats.requests = inputLayouts.stats.hits = 0;
+	samplers.stats.requests = samplers.stats.hits = 0;
+}
+
+ID3D11InputLayout* StateObjectCache::GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const std::vector<byte>& shaderBytecode)
+{
+	// Semantic names are compared by their text, the rest of each element as it is
+	std::string key;
+	for (UINT i = 0; i < elementCount; i++)
+	{
+		const D3D11_INPUT_ELEMENT_DESC& element = elements[i];
+		key.append(element.SemanticName);
+		key.push_back('\0');
+		Append(key, &element.SemanticIndex, sizeof(element.SemanticIndex));
+		Append(key, &element.Format, sizeof(element.Format));
+		Append(key, &element.InputSlot, sizeof(element.InputSlot));
+		Append(key, &element.AlignedByteOffset, sizeof(element.AlignedByteOffset));
+		Append(key, &element.InputSlotClass, sizeof(element.InputSlotClass));
+		Append(key, &element.InstanceDataStepRate, sizeof(element.InstanceDataStepRate));
+	}
+
+	const byte* signature;
+	size_t signatureLength;
+	FindInputSignature(shaderBytecode.data(), shaderBytecode.size(), signature, signatureLength);
+	Append(key, signature, signatureLength);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return Find(inputLayouts.objects, inputLayouts.stats, key, [&](ID3D11InputLayout** inputLayout) {
+		return deviceResources->GetD3DDevice()->CreateInputLayout(
+			elements,
+			elementCount,
+			&shaderBytecode[0],
+			shaderBytecode.size(),
+			inputLayout
+			);
+	});
+}
+
+ID3D11SamplerState* StateObjectCache::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+	std::string key((const char*)&desc, sizeof(desc));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return Find(samplers.objects, samplers.stats, key, [&](ID3D11SamplerState** sampler) {
+		return deviceResources->GetD3DDevice()->CreateSamplerState(&desc, sampler);
+	});
+}
+
+ID3D11SamplerState* StateObjectCache::GetLinearWrapSampler()
+{
+	D3D11_SAMPLER_DESC sampDesc;
+	ZeroMemory(&sampDesc, sizeof(sampDesc));
+	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	sampDesc.MinLOD = 0;
+	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	return GetSamplerState(sampDesc);
+}
+
+StateCacheStats StateObjectCache::GetInputLayoutStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return inputLayouts.stats;
+}
+
+StateCacheStats StateObjectCache::GetSamplerStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return samplers.stats;
+}
+
+void StateObjectCache::ReportStats() const
+{
+#if defined(_DEBUG)
+	const char* names[] = { "input layouts", "samplers" };
+	StateCacheStats stats[] = { GetInputLayoutStats(), GetSamplerStats() };
+
+	char message[128];
+	for (int i = 0; i < 2; i++)
+	{
+		snprintf(message, sizeof(message), "State cache: %u %s requested, %u created, %.0f%% hits\n",
+			stats[i].requests, names[i], stats[i].GetCreated(), stats[i].GetHitRate() * 100.f);
+		OutputDebugStringA(message);
+	}
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "Common\DeviceResources.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Ocean
+{
+	// Requests of one kind of state object and how many of them an existing object answered
+	struct StateCacheStats
+	{
+		UINT requests;
+		UINT hits;
+
+		UINT GetCreated() const { return requests - hits; }
+		float GetHitRate() const { return requests > 0 ? (float)hits / (float)requests : 0.f; }
+	};
+
+	// Hands out one state object per distinct description, shared by every scene object of the device.
+	// Rasterizer, blend and depth states come from DirectXTK's CommonStates, which shares them already.
+	// Descriptions are compared byte for byte, so they should be zeroed before they are filled in.
+	// Input layouts only depend on the elements and the shader's input signature, so vertex shaders with the same
+	// inputs share them. Safe to use from the loading tasks, which run on different threads.
+	class StateObjectCache
+	{
+	public:
+		StateObjectCache(std::shared_ptr<DX::DeviceResources> deviceResources);
+
+		// The objects stay owned by the cache, hold on to them with a ComPtr
+		ID3D11InputLayout* GetInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT elementCount, const std::vector<byte>& shaderBytecode);
+		ID3D11SamplerState* GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+
+		// Trilinear filtering with wrapped texture coordinates
+		ID3D11SamplerState* GetLinearWrapSampler();
+
+		StateCacheStats GetInputLayoutStats() const;
+		StateCacheStats GetSamplerStats() const;
+
+		// Writes the hit rates to the debugger's output in debug builds
+		void ReportStats() const;
+
+	private:
+		template <typename T>
+		struct Entries
+		{
+			std::unordered_map<std::string, Microsoft::WRL::ComPtr<T>> objects;
+			StateCacheStats stats;
+		};
+
+		std::shared_ptr<DX::DeviceResources> deviceResources;
+		mutable std::mutex mutex;
+		Entries<ID3D11InputLayout> inputLayouts;
+		Entries<ID3D11SamplerState> samplers;
+	};
+
+	// The input signature chunk of compiled shader bytecode, the whole bytecode if it has none
+	void FindInputSignature(const byte* bytecode, size_t length, const byte*& signature, size_t& signatureLength);
+}
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+using namespace Ocean;
+
+ThreadPool::ThreadPool(int threadCount)
+	: body(nullptr), count(0), chunkSize(0), chunkCount(0), nextChunk(0), busyWorkers(0), generation(0), stopping(false)
+{
+	if (threadCount <= 0)
+		threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	for (int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(int count, int grain, const std::function<void(int begin, int end)>& body)
+{
+	if (count <= 0)
+		return;
+
+	std::lock_guard<std::mutex> jobLock(jobMutex);
+
+	// A few chunks per thread even out uneven work, but never smaller than grain
+	int chunkSize = std::max(grain, (count + GetThreadCount() * 4 - 1) / (GetThreadCount() * 4));
+	if (workers.empty() || chunkSize >= count)
+	{
+		body(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->body = &body;
+		this->count = count;
+		this->chunkSize = chunkSize;
+		chunkCount = (count + chunkSize - 1) / chunkSize;
+		nextChunk = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	workReady.notify_all();
+
+	RunChunks();
+
+	// The job lives on our stack, wait until no worker can touch it anymore
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this] { return busyWorkers == 0; });
+	this->body = nullptr;
+}
+
+void ThreadPool::RunChunks()
+{
+	for (;;)
+	{
+		int chunk = nextChunk++;
+		if (chunk >= chunkCount)
+			return;
+
+		int begin = chunk * chunkSize;
+		(*body)(begin, std::min(begin + chunkSize, count));
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned int seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [&] { return stopping || generation != seenGeneration; });
+			if (stopping)
+				return;
+			seenGeneration = generation;
+		}
+
+		RunChunks();
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = --busyWorkers == 0;
+		}
+		if (last)
+			workDone.notify_one();
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ocean
+{
+	// Worker threads for splitting per-frame CPU work, the thread calling ParallelFor works along.
+	// Only depends on the standard library.
+	class ThreadPool
+	{
+	public:
+		// threadCount includes the calling thread, 0 uses every hardware thread
+		explicit ThreadPool(int threadCount = 0);
+		~ThreadPool();
+
+		int GetThreadCount() const { return (int)workers.size() + 1; }
+
+		// Calls body(begin, end) on ranges covering [0, count) of at least grain items and returns when all are done.
+		// Calls from different threads take turns. Not reentrant, body must not call ParallelFor of the same pool.
+		void ParallelFor(int count, int grain, const std::function<void(int begin, int end)>& body);
+
+	private:
+		void WorkerLoop();
+		void RunChunks();
+
+		std::vector<std::thread> workers;
+		// Held for a whole ParallelFor, so one caller's job can't replace another's
+		std::mutex jobMutex;
+		std::mutex mutex;
+		std::condition_variable workReady;
+		std::condition_variable workDone;
+
+		// The current job, only changed while no worker is running chunks of it
+		const std::function<void(int, int)>* body;
+		int count;
+		int chunkSize;
+		int chunkCount;
+		std::atomic<int> nextChunk;
+		int busyWorkers;
+		unsigned int generation;
+		bool stopping;
+	};
+}
@@ -0,0 +1,245 @@
+#include "pch.h"
+#include "VertexCacheOptimizer.h"
+#include <climits>
+#include <cmath>
+
+using namespace Ocean;
+
+namespace
+{
+	// The values from Forsyth's article
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	const unsigned int noTriangles = UINT_MAX;
+}
+
+float VertexCacheOptimizer::VertexScore(int position, unsigned int remaining) const
+{
+	// Nothing left to draw with this vertex
+	if (remaining == 0)
+		return -1.f;
+
+	float score = 0.f;
+	if (position >= 0)
+	{
+		// The vertices of the last triangle get a fixed score so the next one doesn't just reuse one edge of it
+		if (position < 3)
+		{
+			score = lastTriangleScore;
+		}
+		else
+		{
+			const float scaler = 1.f / (modelledCacheSize - 3);
+			score = powf(1.f - (position - 3) * scaler, cacheDecayPower);
+		}
+	}
+
+	// Finish off vertices with few triangles left, so they can leave the cache for good
+	score += valenceBoostScale * powf((float)remaining, -valenceBoostPower);
+	return score;
+}
+
+void VertexCacheOptimizer::OptimizeTriangleOrder(unsigned int* indices, size_t indexCount, unsigned int vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	if (remainingTriangles.size() < vertexCount)
+	{
+		remainingTriangles.resize(vertexCount, 0);
+		firstTriangle.resize(vertexCount, noTriangles);
+		cachePosition.resize(vertexCount, -1);
+		vertexScores.resize(vertexCount, 0.f);
+	}
+
+	sourceIndices.assign(indices, indices + triangleCount * 3);
+	vertexTriangles.resize(triangleCount * 3);
+	triangleScores.assign(triangleCount, 0.f);
+	triangleEmitted.assign(triangleCount, false);
+
+	// Triangle lists of the vertices, only the vertices referenced here are touched
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remainingTriangles[sourceIndices[i]]++;
+
+	unsigned int offset = 0;
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int vertex = sourceIndices[i];
+		if (firstTriangle[vertex] == noTriangles)
+		{
+			firstTriangle[vertex] = offset;
+			offset += remainingTriangles[vertex];
+		}
+	}
+
+	// Counts down to zero while filling the lists, the second loop counts them up again
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int vertex = sourceIndices[i];
+		vertexTriangles[firstTriangle[vertex] + --remainingTriangles[vertex]] = (unsigned int)(i / 3);
+	}
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remainingTriangles[sourceIndices[i]]++;
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int vertex = sourceIndices[i];
+		cachePosition[vertex] = -1;
+		vertexScores[vertex] = VertexScore(-1, remainingTriangles[vertex]);
+	}
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		triangleScores[i / 3] += vertexScores[sourceIndices[i]];
+
+	unsigned int cache[modelledCacheSize + 3];
+	int cacheCount = 0;
+	size_t scanCursor = 0;
+	long long bestTriangle = -1;
+
+	for (size_t emitted = 0; emitted < triangleCount; emitted++)
+	{
+		// Nothing in the cache can be continued, start again from the first triangle left
+		if (bestTriangle < 0)
+		{
+			while (triangleEmitted[scanCursor])
+				scanCursor++;
+			bestTriangle = (long long)scanCursor;
+		}
+
+		size_t triangle = (size_t)bestTriangle;
+		triangleEmitted[triangle] = true;
+		const unsigned int* corners = &sourceIndices[triangle * 3];
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int vertex = corners[k];
+			indices[emitted * 3 + k] = vertex;
+
+			// Swap the triangle out of the vertex's list of triangles still to draw
+			unsigned int* list = &vertexTriangles[firstTriangle[vertex]];
+			unsigned int last = --remainingTriangles[vertex];
+			for (unsigned int j = 0; j <= last; j++)
+			{
+				if (list[j] == triangle)
+				{
+					list[j] = list[last];
+					list[last] = (unsigned int)triangle;
+					break;
+				}
+			}
+		}
+
+		// The triangle's vertices move to the front, everything else shifts back and the last three may fall out
+		unsigned int newCache[modelledCacheSize + 3];
+		int newCount = 0;
+		for (int k = 0; k < 3; k++)
+			newCache[newCount++] = corners[k];
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int vertex = cache[i];
+			if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+				newCache[newCount++] = vertex;
+		}
+
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int vertex = newCache[i];
+			int position = i < modelledCacheSize ? i : -1;
+			cachePosition[vertex] = position;
+
+			float score = VertexScore(position, remainingTriangles[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const unsigned int* list = &vertexTriangles[firstTriangle[vertex]];
+			for (unsigned int j = 0; j < remainingTriangles[vertex]; j++)
+				triangleScores[list[j]] += delta;
+		}
+
+		cacheCount = newCount < modelledCacheSize ? newCount : modelledCacheSize;
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+
+		// Only the triangles of cached vertices changed score, the best one to continue with is among them
+		bestTriangle = -1;
+		float bestScore = -1.f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int vertex = cache[i];
+			const unsigned int* list = &vertexTriangles[firstTriangle[vertex]];
+			for (unsigned int j = 0; j < remainingTriangles[vertex]; j++)
+			{
+				if (triangleScores[list[j]] > bestScore)
+				{
+					bestScore = triangleScores[list[j]];
+					bestTriangle = list[j];
+				}
+			}
+		}
+	}
+
+	// Leave the per vertex state clean for the next call
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int vertex = sourceIndices[i];
+		firstTriangle[vertex] = noTriangles;
+		cachePosition[vertex] = -1;
+	}
+}
+
+unsigned int VertexCacheOptimizer::BuildFetchRemap(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int* remap)
+{
+	for (unsigned int i = 0; i < vertexCount; i++)
+		remap[i] = UINT_MAX;
+
+	unsigned int next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == UINT_MAX)
+			remap[indices[i]] = next++;
+	}
+
+	unsigned int usedCount = next;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		if (remap[i] == UINT_MAX)
+			remap[i] = next++;
+	}
+
+	return usedCount;
+}
+
+void VertexCacheOptimizer::RemapIndices(unsigned int* indices, size_t indexCount, const unsigned int* remap)
+{
+	for (size_t i = 0; i < indexCount; i++)
+		indices[i] = remap[indices[i]];
+}
+
+VertexCacheStats VertexCacheOptimizer::Simulate(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	// A FIFO cache only changes on misses, so a vertex is cached while fewer than cacheSize misses came after its own
+	const size_t notCached = (size_t)-1;
+	std::vector<size_t> missedAt(vertexCount, notCached);
+	size_t misses = 0;
+	size_t referenced = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		size_t& missed = missedAt[indices[i]];
+		if (missed == notCached || misses - missed >= cacheSize)
+		{
+			if (missed == notCached)
+				referenced++;
+			missed = misses++;
+		}
+	}
+
+	VertexCacheStats stats = { 0.f, 0.f };
+	if (indexCount >= 3)
+		stats.acmr = (float)misses / (float)(indexCount / 3);
+	if (referenced > 0)
+		stats.atvr = (float)misses / (float)referenced;
+	return stats;
+}
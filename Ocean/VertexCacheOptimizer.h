@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace Ocean
+{
+	// ACMR: cache misses per triangle, 0.5 is the best a regular grid can get and 3 the worst.
+	// ATVR: cache misses per referenced vertex, 1 means every vertex is transformed exactly once.
+	struct VertexCacheStats
+	{
+		float acmr;
+		float atvr;
+	};
+
+	// Triangle reordering for the post-transform vertex cache (Tom Forsyth's linear-speed algorithm)
+	// and vertex renumbering for fetch locality. Only depends on the standard library.
+	class VertexCacheOptimizer
+	{
+	public:
+		// Size of the LRU cache the scoring models, a bit larger than real hardware to not be too specific to one GPU
+		static const int modelledCacheSize = 32;
+
+		// Reorders the triangles of indices in place, vertexCount bounds the values in indices
+		void OptimizeTriangleOrder(unsigned int* indices, size_t indexCount, unsigned int vertexCount);
+
+		// Fills remap so that remap[old vertex] is the new one, numbered in order of first use.
+		// Vertices the indices never reference go after the used ones. Returns the number of used vertices.
+		static unsigned int BuildFetchRemap(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int* remap);
+		static void RemapIndices(unsigned int* indices, size_t indexCount, const unsigned int* remap);
+
+		// Moves every vertex to remap[vertex], output has to hold vertexCount elements
+		template <typename T>
+		static void RemapVertices(const T* vertices, unsigned int vertexCount, const unsigned int* remap, T* output)
+		{
+			for (unsigned int i = 0; i < vertexCount; i++)
+				output[remap[i]] = vertices[i];
+		}
+
+		// Runs the indices through a FIFO cache like the ones in GPUs
+		static VertexCacheStats Simulate(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, unsigned int cacheSize = 16);
+
+	private:
+		float VertexScore(int cachePosition, unsigned int remainingTriangles) const;
+
+		// Kept between calls, meshes are optimized section by section
+		std::vector<unsigned int> remainingTriangles;
+		std::vector<unsigned int> firstTriangle;
+		std::vector<unsigned int> vertexTriangles;
+		std::vector<int> cachePosition;
+		std::vector<float> vertexScores;
+		std::vector<float> triangleScores;
+		std::vector<bool> triangleEmitted;
+		std::vector<unsigned int> sourceIndices;
+	};
+}
@@ -1,7 +1,14 @@
 #include "pch.h"
 #include "Water.h"
 #include "Camera.h"
+#include "Frustum.h"
+#include "GerstnerWaves.h"
+#include "GerstnerBaker.h"
 #include "DDSTextureLoader.h"
+#include "CommonStates.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace Windows::Foundation;
 using namespace Ocean;
@@ -10,12 +17,83 @@ Water::Water()
 {
 	polarMesh = std::shared_ptr<GeneratedMesh>(new GeneratedMesh());
 	projectedMesh = std::shared_ptr<GeneratedMesh>(new GeneratedMesh());
+	patchMesh = std::shared_ptr<GeneratedMesh>(new GeneratedMesh());
+	tileMesh = std::shared_ptr<GeneratedMesh>(new GeneratedMesh());
+
+	polarMesh->optimizeVertexCache = true;
+	polarMesh->vertexEncoding = VertexEncoding::PositionXZQuantized;
+
+	// The CPU displacement reads the plane positions back. The polar grid is generated once at load and holds
+	// quantized positions, so it keeps them for switching to that mode. The projected grid is regenerated every
+	// frame and only keeps them while the mode is on, otherwise it is written straight into the mapped buffer.
+	polarMesh->keepPlanePositions = true;
 
 	currentMesh = polarMesh;
+	memset(&objectConstants, 0, sizeof(objectConstants));
+
+	// 16 unit leaves with one unit quads like the polar grid near the camera, 5 x 5 roots of 512 units reach past the far plane
+	quadtree = std::shared_ptr<CdlodQuadtree>(new CdlodQuadtree(6, 16.f, 80.f, 5));
+
+	// Shared by the per-frame simulations, loading doesn't use it
+	threadPool = std::shared_ptr<ThreadPool>(new ThreadPool());
+
+	// 64 m around the camera in 25 cm cells, stepped with the app's fixed 60 Hz updates
+	RippleSettings rippleSettings;
+	rippleSettings.size = 256;
+	rippleSettings.cellSize = .25f;
+	rippleSettings.waveSpeed = 3.f;
+	rippleSettings.damping = .995f;
+	rippleSettings.stepSeconds = 1.f / 60.f;
+	ripples = std::shared_ptr<RippleSimulation>(new RippleSimulation(rippleSettings));
+
+	// Flat until the scene sets its waves
+	SetWaveSets(nullptr, 0);
+}
+
+void Water::SetWaveSets(const GerstnerWaveSet* waveSets, int waveSetCount)
+{
+	waveSetCount = std::min(waveSetCount, maxGerstnerWaveSets);
+	this->waveSets.assign(waveSets, waveSets + waveSetCount);
+
+	// The vertex shader stops at the first set that has faded out
+	std::stable_sort(this->waveSets.begin(), this->waveSets.end(), [](const GerstnerWaveSet& a, const GerstnerWaveSet& b) {
+		return a.lodFadeEnd > b.lodFadeEnd;
+	});
+
+	material.data.waveSetCount = XMUINT4(waveSetCount, 0, 0, 0);
+	for (int i = 0; i < waveSetCount; i++)
+	{
+		const GerstnerWaveSet& waves = this->waveSets[i];
+		material.data.waveAmplitude[i] = XMFLOAT4(waves.amplitude);
+		material.data.waveFrequency[i] = XMFLOAT4(waves.frequency);
+		material.data.waveSteepness[i] = XMFLOAT4(waves.steepness);
+		material.data.waveSpeed[i] = XMFLOAT4(waves.speed);
+		material.data.waveDirectionX[i] = XMFLOAT4(waves.directionX);
+		material.data.waveDirectionZ[i] = XMFLOAT4(waves.directionZ);
+		material.data.waveFade[i] = XMFLOAT4(waves.lodFadeStart, waves.lodFadeEnd, waves.intensity, 0.f);
+	}
+
+	meshDisplacer = std::shared_ptr<GerstnerMeshDisplacer>(new GerstnerMeshDisplacer(this->waveSets.data(), waveSetCount));
+
+	UpdateWaveBounds();
+}
+
+void Water::UpdateWaveBounds()
+{
+	projector.maxWaveHeight = GetMaxGerstnerHeight(waveSets.data(), (int)waveSets.size());
+	projector.maxWaveDisplacement = GetMaxGerstnerDisplacement(waveSets.data(), (int)waveSets.size());
+	quadtree->maxWaveHeight = projector.maxWaveHeight;
+	quadtree->maxWaveDisplacement = projector.maxWaveDisplacement;
+
+	// The tiles only move in whole tile steps, so their extents only change with the waves
+	std::fill(tileExtentX.begin(), tileExtentX.end(), tileSize * 0.5f + projector.maxWaveDisplacement);
+	std::fill(tileExtentY.begin(), tileExtentY.end(), projector.maxWaveHeight);
+	std::fill(tileExtentZ.begin(), tileExtentZ.end(), tileSize * 0.5f + projector.maxWaveDisplacement);
 }
 
 void Water::LoadTextures(
 	std::shared_ptr<DX::DeviceResources> deviceResources,
+	StateObjectCache& stateCache,
 	const wchar_t* normalTextureFile1,
 	const wchar_t* normalTextureFile2,
 	const wchar_t* environmentTextureFile,
@@ -29,21 +107,18 @@ void Water::LoadTextures(
 	DX::ThrowIfFailed(DirectX::CreateDDSTextureFromFile(device, normalTextureFile2, nullptr, normalTexture2.ReleaseAndGetAddressOf()));
 	DX::ThrowIfFailed(DirectX::CreateDDSTextureFromFile(device, foamTextureFile, nullptr, foamTexture.ReleaseAndGetAddressOf()));
 	
-	// Create samplers
-	D3D11_SAMPLER_DESC sampDesc;
-	ZeroMemory(&sampDesc, sizeof(sampDesc));
-	sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-	sampDesc.MinLOD = 0;
-	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&sampDesc, &linearSampler);
+	// Shared with the skybox
+	linearSampler = stateCache.GetLinearWrapSampler();
+
+	CD3D11_TEXTURE2D_DESC rippleDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, ripples->GetSize(), ripples->GetSize(), 1, 1,
+		D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(device->CreateTexture2D(&rippleDesc, nullptr, &rippleTexture));
+	DX::ThrowIfFailed(device->CreateShaderResourceView(rippleTexture.Get(), nullptr, &rippleView));
 }
 
 void Water::LoadVertexShader(
 	std::shared_ptr<DX::DeviceResources> deviceResources,
+	StateObjectCache& stateCache,
 	const std::vector<byte>& vsFileData)
 {
 	// Vertex Shader
@@ -56,25 +131,190 @@ void Water::LoadVertexShader(
 			)
 		);
 
-	// Input Layout
-	static const D3D11_INPUT_ELEMENT_DESC vertexDesc[] =
-	{
-		{ "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 44, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-	};
+	// Input Layouts, one for each encoding the water meshes use
+	inputLayout = stateCache.GetInputLayout(
+		VertexFormat<VertexPositionXZ>::Elements(),
+		VertexFormat<VertexPositionXZ>::elementCount,
+		vsFileData
+		);
+
+	quantizedInputLayout = stateCache.GetInputLayout(
+		VertexFormat<VertexPositionXZQuantized>::Elements(),
+		VertexFormat<VertexPositionXZQuantized>::elementCount,
+		vsFileData
+		);
+}
+
+void Water::LoadPatchVertexShader(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	StateObjectCache& stateCache,
+	const std::vector<byte>& vsFileData)
+{
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDevice()->CreateVertexShader(
+			&vsFileData[0],
+			vsFileData.size(),
+			nullptr,
+			&patchVertexShader
+			)
+		);
+
+	// Patch mesh vertices in slot 0, per patch data in slot 1
+	D3D11_INPUT_ELEMENT_DESC vertexDesc[VertexFormat<VertexPositionXZ>::elementCount + VertexFormat<PatchInstance>::elementCount];
+	std::copy_n(VertexFormat<VertexPositionXZ>::Elements(), VertexFormat<VertexPositionXZ>::elementCount, vertexDesc);
+	std::copy_n(VertexFormat<PatchInstance>::Elements(), VertexFormat<PatchInstance>::elementCount, vertexDesc + VertexFormat<VertexPositionXZ>::elementCount);
+
+	patchInputLayout = stateCache.GetInputLayout(
+		vertexDesc,
+		ARRAYSIZE(vertexDesc),
+		vsFileData
+		);
+}
+
+void Water::LoadFftVertexShader(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	const std::vector<byte>& vsFileData)
+{
+	// Vertex shaders can only sample textures from feature level 10_0 on
+	if (deviceResources->GetDeviceFeatureLevel() < D3D_FEATURE_LEVEL_10_0)
+		return;
+
+	auto device = deviceResources->GetD3DDevice();
+
+	// A 256 m patch sampled every metre, like the polar grid's quads near the camera
+	FftOceanSettings settings;
+	settings.size = 256;
+	settings.patchLength = 256.f;
+	settings.windSpeed = 10.f;
+	settings.windDirectionX = 1.f;
+	settings.windDirectionZ = 0.4f;
+	settings.spectrum = OceanSpectrum::Jonswap;
+	settings.phillipsAmplitude = 0.f;
+	settings.fetch = 100000.f;
+	settings.choppiness = 1.f;
+	settings.seed = 1;
+	std::shared_ptr<FftOcean> ocean(new FftOcean(settings));
+
+	// Built aside and published before the shader, UpdateMeshes picks the FFT mode as soon as it sees the shader
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> displacementTexture, slopeTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> displacementView, slopeView;
+	CD3D11_TEXTURE2D_DESC displacementDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, settings.size, settings.size, 1, 1,
+		D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(device->CreateTexture2D(&displacementDesc, nullptr, &displacementTexture));
+	DX::ThrowIfFailed(device->CreateShaderResourceView(displacementTexture.Get(), nullptr, &displacementView));
+
+	CD3D11_TEXTURE2D_DESC slopeDesc(DXGI_FORMAT_R32G32_FLOAT, settings.size, settings.size, 1, 1,
+		D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	DX::ThrowIfFailed(device->CreateTexture2D(&slopeDesc, nullptr, &slopeTexture));
+	DX::ThrowIfFailed(device->CreateShaderResourceView(slopeTexture.Get(), nullptr, &slopeView));
+
+	// Same input as the Gerstner vertex shader, so it shares its input layouts
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(
+			&vsFileData[0],
+			vsFileData.size(),
+			nullptr,
+			&shader
+			)
+		);
+
+	fftOcean = ocean;
+	fftDisplacementTexture = displacementTexture;
+	fftDisplacementView = displacementView;
+	fftSlopeTexture = slopeTexture;
+	fftSlopeView = slopeView;
+	fftVertexShader = shader;
+}
 
+std::vector<GerstnerWaveSet> Water::LoadBakedVertexShader(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	const std::vector<byte>& vsFileData)
+{
+	// Vertex shaders can only sample textures from feature level 10_0 on
+	if (deviceResources->GetDeviceFeatureLevel() < D3D_FEATURE_LEVEL_10_0)
+		return std::vector<GerstnerWaveSet>();
+
+	auto device = deviceResources->GetD3DDevice();
+
+	// Two metre texels over a 256 m tile and a frame every 2/3 s, the shortest waves take about 6 s to pass
+	GerstnerBakeSettings settings;
+	settings.size = 128;
+	settings.tileLength = 256.f;
+	settings.frameCount = 96;
+	settings.period = 64.f;
+	// The frame's simulations keep the shared pool, this one only lives for the bake
+	GerstnerBaker baker(waveSets.data(), (int)waveSets.size(), settings);
+	ThreadPool bakePool;
+	baker.Bake(&bakePool);
+	bakedTiling = XMFLOAT4(1.f / settings.tileLength, 1.f / settings.period, 0.5f / (float)settings.size, 0.5f / (float)settings.frameCount);
+
+	// Half floats are precise to a few millimetres here and halve the memory
+	size_t texelCount = (size_t)settings.size * settings.size * settings.frameCount;
+	std::vector<HALF> displacement(texelCount * 4);
+	std::vector<HALF> slope(texelCount * 2);
+	XMConvertFloatToHalfStream(displacement.data(), sizeof(HALF), baker.GetDisplacement(), sizeof(float), displacement.size());
+	XMConvertFloatToHalfStream(slope.data(), sizeof(HALF), baker.GetSlope(), sizeof(float), slope.size());
+
+	D3D11_SUBRESOURCE_DATA displacementData = { 0 };
+	displacementData.pSysMem = displacement.data();
+	displacementData.SysMemPitch = (UINT)(settings.size * 4 * sizeof(HALF));
+	displacementData.SysMemSlicePitch = (UINT)(settings.size * settings.size * 4 * sizeof(HALF));
+	CD3D11_TEXTURE3D_DESC displacementDesc(DXGI_FORMAT_R16G16B16A16_FLOAT, settings.size, settings.size, settings.frameCount, 1,
+		D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+	DX::ThrowIfFailed(device->CreateTexture3D(&displacementDesc, &displacementData, &bakedDisplacementTexture));
+	DX::ThrowIfFailed(device->CreateShaderResourceView(bakedDisplacementTexture.Get(), nullptr, &bakedDisplacementView));
+
+	D3D11_SUBRESOURCE_DATA slopeData = { 0 };
+	slopeData.pSysMem = slope.data();
+	slopeData.SysMemPitch = (UINT)(settings.size * 2 * sizeof(HALF));
+	slopeData.SysMemSlicePitch = (UINT)(settings.size * settings.size * 2 * sizeof(HALF));
+	CD3D11_TEXTURE3D_DESC slopeDesc(DXGI_FORMAT_R16G16_FLOAT, settings.size, settings.size, settings.frameCount, 1,
+		D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+	DX::ThrowIfFailed(device->CreateTexture3D(&slopeDesc, &slopeData, &bakedSlopeTexture));
+	DX::ThrowIfFailed(device->CreateShaderResourceView(bakedSlopeTexture.Get(), nullptr, &bakedSlopeView));
+
+	// Last, UpdateMeshes picks the baked mode as soon as it sees the shader
 	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateInputLayout(
-			vertexDesc,
-			ARRAYSIZE(vertexDesc),
+		device->CreateVertexShader(
 			&vsFileData[0],
 			vsFileData.size(),
-			&inputLayout
+			nullptr,
+			&bakedVertexShader
 			)
 		);
+
+#if defined(_DEBUG)
+	char message[128];
+	snprintf(message, sizeof(message), "Gerstner bake: %d x %d x %d in %.1f ms, %.1f MB on the CPU, %.1f MB of textures\n",
+		settings.size, settings.size, settings.frameCount, baker.GetBakeSeconds() * 1000.f, baker.GetMemorySize() / 1048576.f,
+		(displacement.size() + slope.size()) * sizeof(HALF) / 1048576.f);
+	OutputDebugStringA(message);
+#endif
+
+	// The analytic modes draw the snapped waves too, so every mode shows the same sea
+	return baker.GetSnappedWaveSets();
+}
+
+void Water::LoadCpuVertexShader(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	StateObjectCache& stateCache,
+	const std::vector<byte>& vsFileData)
+{
+	DX::ThrowIfFailed(
+		deviceResources->GetD3DDevice()->CreateVertexShader(
+			&vsFileData[0],
+			vsFileData.size(),
+			nullptr,
+			&cpuVertexShader
+			)
+		);
+
+	displacedInputLayout = stateCache.GetInputLayout(
+		VertexFormat<VertexPositionNormalPlane>::Elements(),
+		VertexFormat<VertexPositionNormalPlane>::elementCount,
+		vsFileData
+		);
 }
 
 void Water::LoadPixelShader(
@@ -108,38 +348,70 @@ void Water::LoadWireFramePixelShader(
 void Water::CreateConstantBuffers(
 	std::shared_ptr<DX::DeviceResources> deviceResources)
 {
-	CD3D11_BUFFER_DESC vsConstantBufferDesc(sizeof(WaterVSConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&vsConstantBufferDesc,
-			nullptr,
-			&vsConstantBuffer
-			)
-		);
-
-	CD3D11_BUFFER_DESC psConstantBufferDesc(sizeof(WaterPSConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
-	DX::ThrowIfFailed(
-		deviceResources->GetD3DDevice()->CreateBuffer(
-			&psConstantBufferDesc,
-			nullptr,
-			&psConstantBuffer
-			)
-		);
+	material.CreateBuffer(deviceResources);
 }
 
 void Water::LoadMeshes(
 	std::shared_ptr<DX::DeviceResources> deviceResources,
 	std::shared_ptr<Camera> camera)
 {
-	polarMesh->GeneratePolarGridMesh(deviceResources, 500, 100, 500);
-	projectedMesh->GenerateProjectedGridMesh(deviceResources, (int)((float)projectedGridHeight * camera->aspectRatio), projectedGridHeight, 7.0f, camera);
+	polarMesh->GeneratePolarGridMesh(deviceResources, 500, 100, 500, polarWedges, polarBands);
+	drawRanges.reserve(polarWedges * polarBands);
+	patchMesh->GeneratePatchMesh(deviceResources, patchResolution);
+	tileMesh->GeneratePatchMesh(deviceResources, tileResolution);
+
+	int tileCount = tilesAcross * tilesAcross;
+	tileCenterX.resize(tileCount);
+	tileCenterY.assign(tileCount, 0.f);
+	tileCenterZ.resize(tileCount);
+	tileExtentX.resize(tileCount);
+	tileExtentY.resize(tileCount);
+	tileExtentZ.resize(tileCount);
+	visibleTiles.resize(tileCount);
+	UpdateWaveBounds();
+	tileInstanceBuffer = std::shared_ptr<IDynamicBuffer>(new D3DDynamicBuffer(deviceResources, sizeof(PatchInstance) * tileCount, D3D11_BIND_VERTEX_BUFFER));
+
+	UpdateProjectedMesh(deviceResources, camera);
+}
+
+void Water::UpdateProjectedMesh(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	std::shared_ptr<Camera> camera)
+{
+	int projectedGridWidth = (int)((float)projectedGridHeight * camera->aspectRatio);
+
+	// The buffer only grows, so after the first frame this is just a capacity check
+	projectedMesh->EnsureDynamicBuffers(deviceResources, (projectedGridWidth + 1) * (projectedGridHeight + 1));
+	projector.Update(camera);
+	projectedMesh->GenerateProjectedGridMesh(deviceResources, projectedGridWidth, projectedGridHeight, projector);
 }
 
 void Water::UpdateMeshes(
 	std::shared_ptr<DX::DeviceResources> deviceResources,
 	std::shared_ptr<Camera> camera)
 {
-	if (camera->getPitch() < -XM_PIDIV4)
+	// Instanced drawing needs feature level 9_3
+	bool canInstance = patchVertexShader != nullptr && deviceResources->GetDeviceFeatureLevel() >= D3D_FEATURE_LEVEL_9_3;
+	// The loader creates the shaders after what they read
+	bool fftLoaded = fftVertexShader != nullptr && fftOcean != nullptr;
+	bool bakedLoaded = bakedVertexShader != nullptr;
+	if (meshMode == MeshMode::CDLOD && canInstance)
+	{
+		currentMesh = patchMesh;
+	}
+	else if (meshMode == MeshMode::Tiled && canInstance)
+	{
+		currentMesh = tileMesh;
+	}
+	else if (meshMode == MeshMode::Fft && fftLoaded)
+	{
+		currentMesh = polarMesh;
+	}
+	else if (meshMode == MeshMode::Baked && bakedLoaded)
+	{
+		currentMesh = polarMesh;
+	}
+	else if (camera->getPitch() < -XM_PIDIV4)
 	{
 		currentMesh = projectedMesh;
 	}
@@ -148,122 +420,422 @@ void Water::UpdateMeshes(
 		currentMesh = polarMesh;
 	}
 
+	useFftShader = meshMode == MeshMode::Fft && fftLoaded && currentMesh == polarMesh;
+	useBakedShader = meshMode == MeshMode::Baked && bakedLoaded && currentMesh == polarMesh;
+	useCpuDisplacement = meshMode == MeshMode::Cpu && cpuVertexShader != nullptr && (currentMesh == polarMesh || currentMesh == projectedMesh);
+
 	if (currentMesh == polarMesh)
 	{
-		XMStoreFloat4x4(&vsConstantBufferData.model, XMMatrixTranspose(XMMatrixTranslation(XMVectorGetX(camera->getEye()), 0, XMVectorGetZ(camera->getEye()))));
+		if (useFftShader)
+			UpdateFft(deviceResources);
+		else if (useBakedShader)
+			objectConstants.waveMapTiling = bakedTiling;
+
+		XMVECTOR meshOffset = XMVectorSet(XMVectorGetX(camera->getEye()), 0, XMVectorGetZ(camera->getEye()), 0);
+		XMStoreFloat4x4(&objectConstants.model, XMMatrixTranspose(XMMatrixTranslationFromVector(meshOffset)));
+		CullSections(camera, meshOffset);
+		if (useCpuDisplacement)
+			UpdateCpuDisplacement(deviceResources, camera, meshOffset);
 	}
 	else if (currentMesh == projectedMesh)
 	{
-		XMStoreFloat4x4(&vsConstantBufferData.model, XMMatrixTranspose(XMMatrixIdentity()));
-		projectedMesh->GenerateProjectedGridMesh(deviceResources, (int)((float)projectedGridHeight * camera->aspectRatio), projectedGridHeight, 7.0f, camera);
+		XMStoreFloat4x4(&objectConstants.model, XMMatrixTranspose(XMMatrixIdentity()));
+		projectedMesh->keepPlanePositions = useCpuDisplacement;
+		UpdateProjectedMesh(deviceResources, camera);
+		CullSections(camera, XMVectorZero());
+		if (useCpuDisplacement)
+			UpdateCpuDisplacement(deviceResources, camera, XMVectorZero());
+	}
+	else if (currentMesh == patchMesh)
+	{
+		XMStoreFloat4x4(&objectConstants.model, XMMatrixTranspose(XMMatrixIdentity()));
+		UpdatePatches(deviceResources, camera);
+		CullSections(camera, XMVectorZero());
 	}
+	else if (currentMesh == tileMesh)
+	{
+		XMStoreFloat4x4(&objectConstants.model, XMMatrixTranspose(XMMatrixIdentity()));
+		UpdateTiles(deviceResources, camera);
+		CullSections(camera, XMVectorZero());
+	}
+
+	objectConstants.positionDecode = currentMesh->positionDecode;
 }
 
-void Water::Draw(std::shared_ptr<DX::DeviceResources> deviceResources)
+void Water::UpdateRipples(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	std::shared_ptr<Camera> camera,
+	float elapsedSeconds)
 {
-	auto device = deviceResources->GetD3DDevice();
+	if (rippleTexture == nullptr)
+		return;
+
+	ripples->Recenter(XMVectorGetX(camera->getEye()), XMVectorGetZ(camera->getEye()));
+	if (ripples->Advance(elapsedSeconds, threadPool.get()) > 0)
+	{
+		auto context = deviceResources->GetD3DDeviceContext();
+		int size = ripples->GetSize();
+
+		// Rows of the mapped texture can be padded
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		DX::ThrowIfFailed(context->Map(rippleTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+		for (int row = 0; row < size; row++)
+			memcpy((byte*)mapped.pData + row * mapped.RowPitch, ripples->GetSurface() + row * size * 4, size * 4 * sizeof(float));
+		context->Unmap(rippleTexture.Get(), 0);
+	}
+
+	// Texel x, z holds the cell at origin + (x, z) * cellSize
+	float scale = 1.f / (ripples->GetCellSize() * (float)ripples->GetSize());
+	float halfTexel = .5f / (float)ripples->GetSize();
+	objectConstants.rippleMapping = XMFLOAT4(scale, halfTexel - ripples->GetOriginX() * scale, halfTexel - ripples->GetOriginZ() * scale, 1.f);
+}
+
+void Water::AddRipple(float x, float z, float radius, float strength)
+{
+	ripples->AddImpulse(x, z, radius, strength);
+}
+
+void Water::UpdatePatches(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	std::shared_ptr<Camera> camera)
+{
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, camera->getEye());
+	Frustum frustum = Frustum::FromCamera(camera);
+	quadtree->Select(eye.x, eye.y, eye.z, &frustum.planes[0].x);
+
+	const std::vector<CdlodPatch>& patches = quadtree->GetSelection();
+	patchInstanceCount = (UINT)patches.size();
+	if (patchInstanceCount == 0)
+		return;
+
+	// Grows with some headroom, the number of patches changes a little with every camera move
+	if (patchInstanceBuffer == nullptr || patchInstanceBuffer->GetCapacity() < sizeof(PatchInstance) * patchInstanceCount)
+	{
+		patchInstanceBuffer = std::shared_ptr<IDynamicBuffer>(new D3DDynamicBuffer(deviceResources, sizeof(PatchInstance) * patchInstanceCount * 3 / 2, D3D11_BIND_VERTEX_BUFFER));
+	}
+
+	PatchInstance* instances = (PatchInstance*)patchInstanceBuffer->Map();
+	for (UINT i = 0; i < patchInstanceCount; i++)
+	{
+		const CdlodPatch& patch = patches[i];
+		instances[i].originScale = XMFLOAT4(patch.x, patch.z, patch.size / (float)patchResolution, (float)patch.level);
+		instances[i].morph = XMFLOAT4(quadtree->GetMorphStart(patch.level), quadtree->GetRange(patch.level), 0.f, 0.f);
+	}
+	patchInstanceBuffer->Unmap();
+}
+
+void Water::UpdateFft(
+	std::shared_ptr<DX::DeviceResources> deviceResources)
+{
+	fftOcean->Update(totalTime, threadPool.get());
+	objectConstants.waveMapTiling = XMFLOAT4(1.f / fftOcean->GetPatchLength(), 0.f, 0.f, 0.f);
+
 	auto context = deviceResources->GetD3DDeviceContext();
+	int size = fftOcean->GetSize();
 
-	context->UpdateSubresource(
-		vsConstantBuffer.Get(),
-		0,
-		NULL,
-		&vsConstantBufferData,
-		0,
-		0);
+	// Rows of the mapped textures can be padded
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(context->Map(fftDisplacementTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	for (int row = 0; row < size; row++)
+		memcpy((byte*)mapped.pData + row * mapped.RowPitch, fftOcean->GetDisplacement() + row * size * 4, size * 4 * sizeof(float));
+	context->Unmap(fftDisplacementTexture.Get(), 0);
 
-	context->UpdateSubresource(
-		psConstantBuffer.Get(),
-		0,
-		NULL,
-		&psConstantBufferData,
-		0,
-		0);
+	DX::ThrowIfFailed(context->Map(fftSlopeTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	for (int row = 0; row < size; row++)
+		memcpy((byte*)mapped.pData + row * mapped.RowPitch, fftOcean->GetSlope() + row * size * 2, size * 2 * sizeof(float));
+	context->Unmap(fftSlopeTexture.Get(), 0);
+}
+
+void Water::UpdateCpuDisplacement(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	std::shared_ptr<Camera> camera,
+	FXMVECTOR meshOffset)
+{
+	if (currentMesh->vertexCount <= 0)
+		return;
+
+	UINT byteWidth = VertexFormat<VertexPositionNormalPlane>::stride * currentMesh->vertexCount;
+	if (displacedVertexBuffer == nullptr || displacedVertexBuffer->GetCapacity() < byteWidth)
+		displacedVertexBuffer = std::shared_ptr<IDynamicBuffer>(new D3DDynamicBuffer(deviceResources, byteWidth, D3D11_BIND_VERTEX_BUFFER));
+
+	// Every vertex of the mesh, the culled sections would save work but not the upload
+	static_assert(sizeof(VertexPositionNormalPlane) == sizeof(float) * GerstnerMeshDisplacer::floatsPerVertex, "The displacer writes VertexPositionNormalPlane");
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, camera->getEye());
+	meshDisplacer->Displace(
+		&currentMesh->planePositions[0].position.x,
+		currentMesh->vertexCount,
+		XMVectorGetX(meshOffset), XMVectorGetZ(meshOffset),
+		totalTime,
+		eye.x, eye.y, eye.z,
+		(float*)displacedVertexBuffer->Map(),
+		threadPool.get());
+	displacedVertexBuffer->Unmap();
+}
+
+void Water::UpdateTiles(
+	std::shared_ptr<DX::DeviceResources> deviceResources,
+	std::shared_ptr<Camera> camera)
+{
+	// LoadMeshes sizes the tile arrays and creates the instance buffer
+	if (tileInstanceBuffer == nullptr)
+	{
+		tileInstanceCount = 0;
+		return;
+	}
+
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, camera->getEye());
+
+	// Like the quadtree roots the tiles follow the camera in whole tile steps
+	float firstTileX = (floorf(eye.x / tileSize) - (float)(tilesAcross / 2)) * tileSize;
+	float firstTileZ = (floorf(eye.z / tileSize) - (float)(tilesAcross / 2)) * tileSize;
+	for (int z = 0; z < tilesAcross; z++)
+	{
+		for (int x = 0; x < tilesAcross; x++)
+		{
+			tileCenterX[z * tilesAcross + x] = firstTileX + ((float)x + 0.5f) * tileSize;
+			tileCenterZ[z * tilesAcross + x] = firstTileZ + ((float)z + 0.5f) * tileSize;
+		}
+	}
+
+	Frustum frustum = Frustum::FromCamera(camera);
+	tileInstanceCount = (UINT)frustum.CullBoxes(
+		tileCenterX.data(), tileCenterY.data(), tileCenterZ.data(),
+		tileExtentX.data(), tileExtentY.data(), tileExtentZ.data(),
+		tilesAcross * tilesAcross, visibleTiles.data());
+	if (tileInstanceCount == 0)
+		return;
+
+	// The morph range is out of reach, so the shader leaves the grid as it is
+	float halfSize = tileSize * 0.5f;
+	PatchInstance* instances = (PatchInstance*)tileInstanceBuffer->Map();
+	for (UINT i = 0; i < tileInstanceCount; i++)
+	{
+		unsigned int tile = visibleTiles[i];
+		instances[i].originScale = XMFLOAT4(tileCenterX[tile] - halfSize, tileCenterZ[tile] - halfSize, tileSize / (float)tileResolution, 0.f);
+		instances[i].morph = XMFLOAT4(1e30f, 2e30f, 0.f, 0.f);
+	}
+	tileInstanceBuffer->Unmap();
+}
+
+void Water::CullSections(
+	std::shared_ptr<Camera> camera,
+	FXMVECTOR meshOffset)
+{
+	drawRanges.clear();
 
-	UINT stride = sizeof(VertexPositionNormal);
+	if (currentMesh->sections.empty())
+	{
+		if (currentMesh->indexCount > 0)
+			drawRanges.push_back({ 0, (UINT)currentMesh->indexCount });
+		return;
+	}
+
+	// Waves can move the surface out of the flat mesh's bounds by this much
+	XMVECTOR waveMargin = XMVectorSet(projector.maxWaveDisplacement, projector.maxWaveHeight, projector.maxWaveDisplacement, 0);
+	if (useFftShader)
+		waveMargin = XMVectorSet(fftOcean->GetMaxDisplacement(), fftOcean->GetMaxHeight(), fftOcean->GetMaxDisplacement(), 0);
+
+	Frustum frustum = Frustum::FromCamera(camera);
+	for (const MeshSection& section : currentMesh->sections)
+	{
+		XMFLOAT3 center, extents;
+		XMStoreFloat3(&center, XMLoadFloat3(&section.boundsCenter) + meshOffset);
+		XMStoreFloat3(&extents, XMLoadFloat3(&section.boundsExtents) + waveMargin);
+		if (!frustum.IntersectsBox(center, extents))
+			continue;
+
+		// Neighbouring sections are neighbours in the index buffer too, draw them together
+		if (!drawRanges.empty() && drawRanges.back().startIndex + drawRanges.back().indexCount == section.startIndex)
+			drawRanges.back().indexCount += section.indexCount;
+		else
+			drawRanges.push_back({ section.startIndex, section.indexCount });
+	}
+}
+
+void Water::PrepareConstants(std::shared_ptr<DX::DeviceResources> deviceResources, ConstantBufferRing& ring)
+{
+	material.Upload(deviceResources);
+	objectAllocation = ring.Write(objectConstants);
+}
+
+void Water::SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states)
+{
+	DrawPacket packet;
+	packet.key = queue.MakeKey(ScenePass, TransparentLayer, 0.f, wireframe ? wireFramePixelShader.Get() : pixelShader.Get(), &material);
+	packet.rasterizerState = wireframe ? states.Wireframe() : states.CullCounterClockwise();
+	packet.blendState = states.AlphaBlend();
+	packet.depthStencilState = states.DepthDefault();
+	packet.drawable = this;
+	packet.item = 0;
+	queue.Submit(packet);
+}
+
+void Water::Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item)
+{
+	// Patches and tiles are instances of one small mesh
+	bool drawPatches = currentMesh == patchMesh || currentMesh == tileMesh;
+	UINT instanceCount = currentMesh == tileMesh ? tileInstanceCount : patchInstanceCount;
+	if (currentMesh->indexCount <= 0 || drawRanges.empty() || (drawPatches && instanceCount == 0))
+		return;
+
+	// CPU displaced meshes draw their own vertices with the mesh's indices
+	ID3D11Buffer* vertexBuffer = useCpuDisplacement ? displacedVertexBuffer->GetBuffer() : currentMesh->vertexBuffer.Get();
+	UINT stride = useCpuDisplacement ? VertexFormat<VertexPositionNormalPlane>::stride : currentMesh->vertexStride;
 	UINT offset = 0;
-	context->IASetVertexBuffers(
+	renderContext.SetVertexBuffers(
 		0,
 		1,
-		currentMesh->vertexBuffer.GetAddressOf(),
+		&vertexBuffer,
 		&stride,
 		&offset
 		);
 
-	context->IASetIndexBuffer(
+	if (drawPatches)
+	{
+		ID3D11Buffer* instanceBuffer = currentMesh == tileMesh ? tileInstanceBuffer->GetBuffer() : patchInstanceBuffer->GetBuffer();
+		UINT instanceStride = VertexFormat<PatchInstance>::stride;
+		renderContext.SetVertexBuffers(
+			1,
+			1,
+			&instanceBuffer,
+			&instanceStride,
+			&offset
+			);
+	}
+
+	renderContext.SetIndexBuffer(
 		currentMesh->indexBuffer.Get(),
 		DXGI_FORMAT_R32_UINT,
 		0
 		);
 
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	renderContext.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	context->IASetInputLayout(inputLayout.Get());
+	if (drawPatches)
+		renderContext.SetInputLayout(patchInputLayout.Get());
+	else if (useCpuDisplacement)
+		renderContext.SetInputLayout(displacedInputLayout.Get());
+	else if (currentMesh->vertexEncoding == VertexEncoding::PositionXZQuantized)
+		renderContext.SetInputLayout(quantizedInputLayout.Get());
+	else
+		renderContext.SetInputLayout(inputLayout.Get());
 
 	// Attach our vertex shader.
-	context->VSSetShader(
-		vertexShader.Get(),
-		nullptr,
-		0
-		);
+	ID3D11VertexShader* currentVertexShader = vertexShader.Get();
+	if (drawPatches)
+		currentVertexShader = patchVertexShader.Get();
+	else if (useFftShader)
+		currentVertexShader = fftVertexShader.Get();
+	else if (useBakedShader)
+		currentVertexShader = bakedVertexShader.Get();
+	else if (useCpuDisplacement)
+		currentVertexShader = cpuVertexShader.Get();
 
-	// Send the constant buffer to the graphics device.
-	context->VSSetConstantBuffers(
-		0,
+	renderContext.SetVertexShader(currentVertexShader);
+
+	if (useFftShader)
+	{
+		ID3D11ShaderResourceView* fftViews[] = { fftDisplacementView.Get(), fftSlopeView.Get(), rippleView.Get() };
+		renderContext.SetShaderResources(VertexStage, 0, 3, fftViews);
+		renderContext.SetSamplers(VertexStage, 0, 1, linearSampler.GetAddressOf());
+	}
+	else if (useBakedShader)
+	{
+		ID3D11ShaderResourceView* bakedViews[] = { bakedDisplacementView.Get(), bakedSlopeView.Get(), rippleView.Get() };
+		renderContext.SetShaderResources(VertexStage, 0, 3, bakedViews);
+		renderContext.SetSamplers(VertexStage, 0, 1, linearSampler.GetAddressOf());
+	}
+	else
+	{
+		// The Gerstner and CPU displaced vertices only read the ripples
+		renderContext.SetShaderResources(VertexStage, 2, 1, rippleView.GetAddressOf());
+		renderContext.SetSamplers(VertexStage, 0, 1, linearSampler.GetAddressOf());
+	}
+
+	// The frame's constants are bound already, these are the draw's and the material's.
+	BindConstants(renderContext, VertexStage, ObjectConstantSlot, objectAllocation);
+	renderContext.SetConstantBuffers(
+		VertexStage,
+		MaterialConstantSlot,
 		1,
-		vsConstantBuffer.GetAddressOf()
+		material.GetAddressOf()
 		);
 
 	if (wireframe)
 	{
 		// Attach our pixel shader.
-		context->PSSetShader(
-			wireFramePixelShader.Get(),
-			nullptr,
-			0
-			);
+		renderContext.SetPixelShader(wireFramePixelShader.Get());
 	}
 	else
 	{
 		// Attach our pixel shader.
-		context->PSSetShader(
-			pixelShader.Get(),
-			nullptr,
-			0
-			);
+		renderContext.SetPixelShader(pixelShader.Get());
 
-		// Send the constant buffer to the graphics device.
-		context->PSSetConstantBuffers(
-			0,
+		BindConstants(renderContext, PixelStage, ObjectConstantSlot, objectAllocation);
+		renderContext.SetConstantBuffers(
+			PixelStage,
+			MaterialConstantSlot,
 			1,
-			psConstantBuffer.GetAddressOf()
+			material.GetAddressOf()
 			);
 
-		context->PSSetShaderResources(0, 1, normalTexture1.GetAddressOf());
-		context->PSSetShaderResources(1, 1, normalTexture1.GetAddressOf());
-		context->PSSetShaderResources(2, 1, environmentTexture.GetAddressOf());
-		context->PSSetShaderResources(3, 1, foamTexture.GetAddressOf());
-		context->PSSetSamplers(0, 1, linearSampler.GetAddressOf());
+		ID3D11ShaderResourceView* pixelViews[] = { normalTexture1.Get(), normalTexture2.Get(), environmentTexture.Get(), foamTexture.Get(), rippleView.Get() };
+		renderContext.SetShaderResources(PixelStage, 0, 5, pixelViews);
+		renderContext.SetSamplers(PixelStage, 0, 1, linearSampler.GetAddressOf());
 	}
 
-	// Draw the objects.
-	context->DrawIndexed(
-		currentMesh->indexCount,
-		0,
-		0
-		);
+	// Every visible patch or tile is an instance of the mesh.
+	if (drawPatches)
+	{
+		renderContext.DrawIndexedInstanced(
+			currentMesh->indexCount,
+			instanceCount,
+			0,
+			0,
+			0
+			);
+		return;
+	}
+
+	// Draw the visible parts of the mesh.
+	for (const DrawRange& range : drawRanges)
+	{
+		renderContext.DrawIndexed(
+			range.indexCount,
+			range.startIndex,
+			0
+			);
+	}
 }
 
 Water::~Water()
 {
 	vertexShader.Reset();
+	patchVertexShader.Reset();
+	fftVertexShader.Reset();
+	bakedVertexShader.Reset();
+	cpuVertexShader.Reset();
 	pixelShader.Reset();
-	vsConstantBuffer.Reset();
-	psConstantBuffer.Reset();
 	inputLayout.Reset();
+	quantizedInputLayout.Reset();
+	patchInputLayout.Reset();
+	displacedInputLayout.Reset();
 	environmentTexture.Reset();
 	normalTexture1.Reset();
 	normalTexture2.Reset();
 	foamTexture.Reset();
 	linearSampler.Reset();
+	fftDisplacementView.Reset();
+	fftSlopeView.Reset();
+	fftDisplacementTexture.Reset();
+	fftSlopeTexture.Reset();
+	rippleView.Reset();
+	rippleTexture.Reset();
+	bakedDisplacementView.Reset();
+	bakedSlopeView.Reset();
+	bakedDisplacementTexture.Reset();
+	bakedSlopeTexture.Reset();
 }
\ No newline at end of file
@@ -2,6 +2,16 @@
 
 #include "Content\ShaderStructures.h"
 #include "GeneratedMesh.h"
+#include "CdlodQuadtree.h"
+#include "FftOcean.h"
+#include "GerstnerWaves.h"
+#include "GerstnerMeshDisplacer.h"
+#include "ThreadPool.h"
+#include "RippleSimulation.h"
+#include "RenderContext.h"
+#include "DrawQueue.h"
+#include "ConstantBuffers.h"
+#include "StateObjectCache.h"
 #include <vector>
 
 namespace Ocean
@@ -10,22 +20,59 @@ namespace Ocean
 	enum MeshMode
 	{
 		Polar,
-		Projected
+		Projected,
+		CDLOD,
+		Tiled,
+		Fft,
+		Baked,
+		Cpu
 	};
 
-	class Water
+	// Part of the current mesh's index buffer that is drawn this frame
+	struct DrawRange
+	{
+		UINT startIndex;
+		UINT indexCount;
+	};
+
+	class Water : public IDrawable
 	{
 	public:
 		Water();
+
+		// Copies up to maxGerstnerWaveSets sets into the material constants and widens the culling bounds for them
+		void SetWaveSets(const GerstnerWaveSet* waveSets, int waveSetCount);
+		const std::vector<GerstnerWaveSet>& GetWaveSets() const { return waveSets; }
+		// Shared with the other scene objects that split their CPU work on the thread updating the scene
+		std::shared_ptr<ThreadPool> GetThreadPool() const { return threadPool; }
+
 		void LoadTextures(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
 			const wchar_t* normalTextureFile1,
 			const wchar_t* normalTextureFile2,
 			const wchar_t* environmentTextureFile,
 			const wchar_t* foamTextureFile);
 		void LoadVertexShader(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
+			const std::vector<byte>& vsFileData);
+		void LoadPatchVertexShader(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
+			const std::vector<byte>& vsFileData);
+		void LoadFftVertexShader(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
 			const std::vector<byte>& vsFileData);
+		// Bakes the current wave sets into textures on threads of its own and returns the snapped sets the bake repeats.
+		// Runs on a loader thread, so the sets are left for SetWaveSets between frames.
+		std::vector<GerstnerWaveSet> LoadBakedVertexShader(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			const std::vector<byte>& vsFileData);
+		void LoadCpuVertexShader(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			StateObjectCache& stateCache,
+			const std::vector<byte>& vsFileData);
 		void LoadPixelShader(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
 			const std::vector<byte>& psFileData);
@@ -40,31 +87,125 @@ namespace Ocean
 		void UpdateMeshes(
 			std::shared_ptr<DX::DeviceResources> deviceResources,
 			std::shared_ptr<Camera> camera);
-		void Draw(std::shared_ptr<DX::DeviceResources> deviceResources);
+		// Keeps the ripples centred on the camera and runs their fixed steps for elapsedSeconds
+		void UpdateRipples(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			std::shared_ptr<Camera> camera,
+			float elapsedSeconds);
+		// Pushes the water down by strength at x, z, fading out over radius. Only shows near the camera.
+		void AddRipple(float x, float z, float radius, float strength);
+		// Uploads the material if it changed and writes the draw's constants into the frame's ring
+		void PrepareConstants(std::shared_ptr<DX::DeviceResources> deviceResources, ConstantBufferRing& ring);
+		// Blended over everything opaque, the sky included
+		virtual void SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states);
+		virtual void Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item);
 		~Water();
 
-		WaterVSConstantBuffer                                vsConstantBufferData;
-		WaterPSConstantBuffer                                psConstantBufferData;
+		WaterObjectConstantBuffer                            objectConstants;
+		ConstantBuffer<WaterMaterialConstantBuffer>          material;
+		// The frame's time, which the waves are simulated and displaced at
+		float totalTime = 0.f;
 
 		bool wireframe = false;
+		// Polar and Projected switch between the two meshes by the camera's pitch, CDLOD and Tiled need feature level 9_3.
+		// Fft draws the polar mesh displaced by the FFT simulation and needs feature level 10_0 to read textures in the vertex shader.
+		// Baked draws the polar mesh displaced by the Gerstner waves baked at load, with the same requirement.
+		// Cpu picks the polar or projected mesh like Polar, displaces it on the CPU every frame and draws it with
+		// a pass-through vertex shader, for devices where the waves in the vertex shader cost too much.
+		MeshMode meshMode = MeshMode::Polar;
 
 	protected:
-		MeshMode meshMode = MeshMode::Polar;
+		void UpdateWaveBounds();
+		void UpdateProjectedMesh(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			std::shared_ptr<Camera> camera);
+		void CullSections(
+			std::shared_ptr<Camera> camera,
+			FXMVECTOR meshOffset);
+		void UpdatePatches(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			std::shared_ptr<Camera> camera);
+		void UpdateTiles(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			std::shared_ptr<Camera> camera);
+		void UpdateFft(
+			std::shared_ptr<DX::DeviceResources> deviceResources);
+		void UpdateCpuDisplacement(
+			std::shared_ptr<DX::DeviceResources> deviceResources,
+			std::shared_ptr<Camera> camera,
+			FXMVECTOR meshOffset);
+
+		// Ordered like in the constant buffer
+		std::vector<GerstnerWaveSet> waveSets;
+
 		int projectedGridHeight = 60;
+		Projector projector;
 		std::shared_ptr<GeneratedMesh> polarMesh;
 		std::shared_ptr<GeneratedMesh> projectedMesh;
+		std::shared_ptr<GeneratedMesh> patchMesh;
+		std::shared_ptr<GeneratedMesh> tileMesh;
 		std::shared_ptr<GeneratedMesh> currentMesh;
 
+		static const int polarWedges = 50;
+		static const int polarBands = 4;
+		std::vector<DrawRange> drawRanges;
+
+		static const int patchResolution = 16;
+		std::shared_ptr<CdlodQuadtree> quadtree;
+		std::shared_ptr<IDynamicBuffer> patchInstanceBuffer;
+		UINT patchInstanceCount = 0;
+
+		// Tiles are drawn with the patch shader and never morph, their bounds are kept as arrays for Frustum::CullBoxes
+		static const int tileResolution = 32;
+		static const int tilesAcross = 31;
+		float tileSize = 64.f;
+		std::vector<float> tileCenterX, tileCenterY, tileCenterZ;
+		std::vector<float> tileExtentX, tileExtentY, tileExtentZ;
+		std::vector<unsigned int> visibleTiles;
+		std::shared_ptr<IDynamicBuffer> tileInstanceBuffer;
+		UINT tileInstanceCount = 0;
+
+		bool useFftShader = false;
+		std::shared_ptr<ThreadPool> threadPool;
+		std::shared_ptr<FftOcean> fftOcean;
+
+		std::shared_ptr<RippleSimulation> ripples;
+
+		bool useBakedShader = false;
+		XMFLOAT4 bakedTiling;
+
+		// Rebuilt with the wave sets, the displaced vertices only grow their buffer
+		bool useCpuDisplacement = false;
+		std::shared_ptr<GerstnerMeshDisplacer> meshDisplacer;
+		std::shared_ptr<IDynamicBuffer> displacedVertexBuffer;
+
+		ConstantAllocation objectAllocation;
+
 		Microsoft::WRL::ComPtr<ID3D11VertexShader>         vertexShader;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>         patchVertexShader;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>         fftVertexShader;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>         bakedVertexShader;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>         cpuVertexShader;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>          pixelShader;
 		Microsoft::WRL::ComPtr<ID3D11PixelShader>          wireFramePixelShader;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>               vsConstantBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>               psConstantBuffer;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout>          inputLayout;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>          quantizedInputLayout;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>          patchInputLayout;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>          displacedInputLayout;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   environmentTexture;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   normalTexture1;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   normalTexture2;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   foamTexture;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>            fftDisplacementTexture;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>            fftSlopeTexture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   fftDisplacementView;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   fftSlopeView;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>            rippleTexture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   rippleView;
+		Microsoft::WRL::ComPtr<ID3D11Texture3D>            bakedDisplacementTexture;
+		Microsoft::WRL::ComPtr<ID3D11Texture3D>            bakedSlopeTexture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   bakedDisplacementView;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>   bakedSlopeView;
 		Microsoft::WRL::ComPtr<ID3D11SamplerState>         linearSampler;
 
 	};
@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "WaveSpectrum.h"
+#include <cmath>
+
+using namespace Ocean;
+
+namespace
+{
+	const float pi = 3.14159265358979324f;
+}
+
+float Ocean::PhillipsSpectrum(float kx, float kz, float windSpeed, float windX, float windZ, float amplitude)
+{
+	float k2 = kx * kx + kz * kz;
+	if (k2 < 1e-12f)
+		return 0.f;
+
+	// Largest wave the wind makes, and a thousandth of it below which waves are damped
+	float largestWave = windSpeed * windSpeed / gravity;
+	float smallestWave = largestWave * 0.001f;
+
+	float cosWind = (kx * windX + kz * windZ) / sqrtf(k2);
+	return amplitude * expf(-1.f / (k2 * largestWave * largestWave)) / (k2 * k2) * cosWind * cosWind * expf(-k2 * smallestWave * smallestWave);
+}
+
+float Ocean::JonswapPeakFrequency(float windSpeed, float fetch)
+{
+	return 22.f * powf(gravity * gravity / (windSpeed * fetch), 1.f / 3.f);
+}
+
+float Ocean::JonswapSpectrum(float omega, float windSpeed, float fetch)
+{
+	if (omega <= 0.f)
+		return 0.f;
+
+	const float peakEnhancement = 3.3f;
+	float alpha = 0.076f * powf(windSpeed * windSpeed / (fetch * gravity), 0.22f);
+	float peak = JonswapPeakFrequency(windSpeed, fetch);
+	float sigma = omega <= peak ? 0.07f : 0.09f;
+
+	float peakDistance = (omega - peak) / (sigma * peak);
+	float r = expf(-0.5f * peakDistance * peakDistance);
+	float ratio = peak / omega;
+	return alpha * gravity * gravity / powf(omega, 5.f) * expf(-1.25f * ratio * ratio * ratio * ratio) * powf(peakEnhancement, r);
+}
+
+float Ocean::DeepWaterFrequency(float k)
+{
+	return sqrtf(gravity * k);
+}
+
+float Ocean::DirectionalSpreading(float theta)
+{
+	float c = cosf(theta);
+	return c > 0.f ? 2.f / pi * c * c : 0.f;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+namespace Ocean
+{
+	static const float gravity = 9.81f;
+
+	// Phillips spectrum (Tessendorf) at wave vector kx, kz for wind of windSpeed along the unit vector windX, windZ.
+	// amplitude scales the whole spectrum, it has no physical unit.
+	float PhillipsSpectrum(float kx, float kz, float windSpeed, float windX, float windZ, float amplitude);
+
+	// JONSWAP frequency spectrum S(omega) in m^2 s for wind of windSpeed m/s over fetch m of open water
+	float JonswapSpectrum(float omega, float windSpeed, float fetch);
+
+	// Angular frequency of the JONSWAP spectrum's peak
+	float JonswapPeakFrequency(float windSpeed, float fetch);
+
+	// Deep water dispersion, omega = sqrt(g k)
+	float DeepWaterFrequency(float k);
+
+	// Normalized cos^2 spreading of wave energy over the angle theta from the wind, zero for waves against it
+	float DirectionalSpreading(float theta);
+}
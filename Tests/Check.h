@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+
+namespace OceanTests
+{
+	inline int& GetCheckFailures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline void Check(bool condition, const char* expression, const char* file, int line)
+	{
+		if (condition)
+			return;
+
+		fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+		GetCheckFailures()++;
+	}
+
+	// What main returns, so ctest sees the failed checks
+	inline int ReportChecks(const char* name)
+	{
+		int failures = GetCheckFailures();
+		printf("%s: %s\n", name, failures == 0 ? "passed" : "FAILED");
+		return failures == 0 ? 0 : 1;
+	}
+
+	// Seconds per call of body, averaged over repetitions
+	template <typename Body>
+	double TimeSeconds(int repetitions, Body body)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < repetitions; i++)
+			body();
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / repetitions;
+	}
+}
+
+// Reports the failure and carries on, the rest of the test still prints its measurements
+#define CHECK(condition) OceanTests::Check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,17 @@
+#pragma once
+// Stand-in for Common\DeviceResources.h that hands out the device it was given
+#include <d3d11_2.h>
+
+namespace DX
+{
+	class DeviceResources
+	{
+	public:
+		DeviceResources(ID3D11Device* device) : device(device) { }
+
+		ID3D11Device* GetD3DDevice() const { return device; }
+
+	private:
+		ID3D11Device* device;
+	};
+}
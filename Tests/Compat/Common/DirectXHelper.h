@@ -0,0 +1,13 @@
+#pragma once
+// Stand-in for Common\DirectXHelper.h, failures throw a standard exception instead of a Platform one
+#include <d3d11_2.h>
+#include <stdexcept>
+
+namespace DX
+{
+	inline void ThrowIfFailed(HRESULT hr)
+	{
+		if (FAILED(hr))
+			throw std::runtime_error("A D3D call failed");
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+// Stand-in for the Windows SDK header with the packed type ShaderStructures.h uses
+#include "DirectXMath.h"
+
+namespace DirectX
+{
+	namespace PackedVector
+	{
+		struct XMSHORTN2
+		{
+			int16_t x, y;
+
+			XMSHORTN2() = default;
+			XMSHORTN2(int16_t _x, int16_t _y) : x(_x), y(_y) {}
+		};
+	}
+}
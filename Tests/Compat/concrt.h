@@ -0,0 +1,2 @@
+#pragma once
+// Empty stand-in for the Windows SDK header pch.h includes, the modules under test only use the standard library
@@ -0,0 +1,24 @@
+#pragma once
+// Stand-in for the Windows SDK header with a ComPtr that only holds the pointer. The tests never create COM objects,
+// so there is nothing to AddRef or Release.
+namespace Microsoft
+{
+	namespace WRL
+	{
+		template <typename T>
+		class ComPtr
+		{
+		public:
+			ComPtr() : pointer(nullptr) { }
+
+			T* Get() const { return pointer; }
+			T* const* GetAddressOf() const { return &pointer; }
+			T** GetAddressOf() { return &pointer; }
+			T** operator&() { return &pointer; }
+			void Reset() { pointer = nullptr; }
+
+		private:
+			T* pointer;
+		};
+	}
+}
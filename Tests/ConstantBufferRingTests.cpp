@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "Check.h"
+#include "ConstantBuffers.h"
+#include <memory>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	// Memory in place of a dynamic D3D buffer, counting the maps and checking they pair up with unmaps
+	class FakeDynamicBuffer : public IDynamicBuffer
+	{
+	public:
+		FakeDynamicBuffer(UINT byteWidth) : memory(byteWidth), mapped(false), mapCount(0), unmapCount(0) { }
+
+		virtual void* Map()
+		{
+			CHECK(!mapped);
+			mapped = true;
+			mapCount++;
+			return memory.data();
+		}
+
+		virtual void Unmap()
+		{
+			CHECK(mapped);
+			mapped = false;
+			unmapCount++;
+		}
+
+		virtual UINT GetCapacity() const { return (UINT)memory.size(); }
+
+		// The ring only passes the pointer on, so the fake's own address stands in for the D3D buffer
+		virtual ID3D11Buffer* GetBuffer() const { return (ID3D11Buffer*)this; }
+
+		std::vector<byte> memory;
+		bool mapped;
+		int mapCount;
+		int unmapCount;
+	};
+
+	struct Fixture
+	{
+		Fixture(UINT pageSize, bool offsetting)
+			: ring([this](UINT byteWidth) { return Create(byteWidth); }, pageSize, offsetting)
+		{
+		}
+
+		std::shared_ptr<IDynamicBuffer> Create(UINT byteWidth)
+		{
+			buffers.push_back(std::make_shared<FakeDynamicBuffer>(byteWidth));
+			return buffers.back();
+		}
+
+		bool AllUnmapped() const
+		{
+			for (const auto& buffer : buffers)
+			{
+				if (buffer->mapped)
+					return false;
+			}
+			return true;
+		}
+
+		std::vector<std::shared_ptr<FakeDynamicBuffer>> buffers;
+		ConstantBufferRing ring;
+	};
+
+	struct Constants
+	{
+		float values[20];
+	};
+
+	// Ranges start on 256 byte boundaries and cover whole 256 byte blocks, the data points at the range
+	void TestAlignment()
+	{
+		Fixture fixture(4096, true);
+		fixture.ring.BeginFrame();
+
+		const UINT sizes[] = { 16, 80, 256, 272, 48 };
+		UINT expectedOffset = 0;
+		for (UINT size : sizes)
+		{
+			ConstantAllocation allocation = fixture.ring.Allocate(size);
+			UINT alignedSize = (size + 255) / 256 * 256;
+			CHECK(allocation.firstConstant * constantRegisterSize % ConstantBufferRing::alignment == 0);
+			CHECK(allocation.firstConstant * constantRegisterSize == expectedOffset);
+			CHECK(allocation.constantCount * constantRegisterSize == alignedSize);
+			CHECK(allocation.data == fixture.buffers[0]->memory.data() + expectedOffset);
+			CHECK(allocation.buffer == fixture.buffers[0]->GetBuffer());
+			expectedOffset += alignedSize;
+		}
+
+		Constants constants;
+		for (int i = 0; i < 20; i++)
+			constants.values[i] = (float)i;
+		ConstantAllocation written = fixture.ring.Write(constants);
+		CHECK(memcmp(written.data, &constants, sizeof(constants)) == 0);
+
+		fixture.ring.EndFrame();
+		CHECK(fixture.buffers.size() == 1);
+		CHECK(fixture.ring.GetMapCount() == 1);
+		CHECK(fixture.AllUnmapped());
+	}
+
+	// A full page moves on to a new one, allocations bigger than a page get a page of their own size
+	void TestRollover()
+	{
+		Fixture fixture(1024, true);
+		fixture.ring.BeginFrame();
+
+		for (int i = 0; i < 4; i++)
+			fixture.ring.Allocate(256);
+		CHECK(fixture.ring.GetPageCount() == 1);
+
+		ConstantAllocation next = fixture.ring.Allocate(16);
+		CHECK(fixture.ring.GetPageCount() == 2);
+		CHECK(fixture.ring.GetMapCount() == 2);
+		CHECK(next.firstConstant == 0);
+		CHECK(next.buffer == fixture.buffers[1]->GetBuffer());
+		CHECK(fixture.buffers[0]->mapped && fixture.buffers[1]->mapped);
+
+		ConstantAllocation large = fixture.ring.Allocate(1500);
+		CHECK(fixture.ring.GetPageCount() == 3);
+		CHECK(fixture.buffers[2]->GetCapacity() == 1536);
+		CHECK(large.firstConstant == 0);
+		CHECK(large.constantCount == 1536 / constantRegisterSize);
+
+		fixture.ring.EndFrame();
+		CHECK(fixture.AllUnmapped());
+		for (const auto& buffer : fixture.buffers)
+			CHECK(buffer->mapCount == 1 && buffer->unmapCount == 1);
+	}
+
+	// The next frame maps the same pages again instead of creating buffers, and only as many as it needs
+	void TestReuseAfterBeginFrame()
+	{
+		Fixture fixture(1024, true);
+		for (int frame = 0; frame < 3; frame++)
+		{
+			fixture.ring.BeginFrame();
+			CHECK(fixture.ring.GetMapCount() == 0);
+			ConstantAllocation first = fixture.ring.Allocate(64);
+			for (int i = 0; i < 5; i++)
+				fixture.ring.Allocate(256);
+			fixture.ring.EndFrame();
+
+			CHECK(first.firstConstant == 0);
+			CHECK(first.buffer == fixture.buffers[0]->GetBuffer());
+			CHECK(fixture.ring.GetMapCount() == 2);
+		}
+		CHECK(fixture.buffers.size() == 2);
+		CHECK(fixture.ring.GetPageCount() == 2);
+		CHECK(fixture.buffers[0]->mapCount == 3 && fixture.buffers[1]->mapCount == 3);
+
+		// A quieter frame leaves the second page alone
+		fixture.ring.BeginFrame();
+		fixture.ring.Allocate(64);
+		fixture.ring.EndFrame();
+		CHECK(fixture.ring.GetMapCount() == 1);
+		CHECK(fixture.buffers[0]->mapCount == 4 && fixture.buffers[1]->mapCount == 3);
+		CHECK(fixture.AllUnmapped());
+	}
+
+	// Without offsetting every allocation is a whole buffer of its own, bound without a range
+	void TestWithoutOffsetting()
+	{
+		Fixture fixture(1024, false);
+		for (int frame = 0; frame < 2; frame++)
+		{
+			fixture.ring.BeginFrame();
+			ConstantAllocation a = fixture.ring.Allocate(64);
+			ConstantAllocation b = fixture.ring.Allocate(64);
+			fixture.ring.EndFrame();
+
+			CHECK(a.buffer != b.buffer);
+			CHECK(a.firstConstant == 0 && a.constantCount == 0);
+			CHECK(fixture.ring.GetMapCount() == 2);
+		}
+		CHECK(fixture.buffers.size() == 2);
+		CHECK(fixture.buffers[0]->GetCapacity() == ConstantBufferRing::alignment);
+
+		// Whole buffers bind with SetConstantBuffers, ranges with SetConstantBufferRanges
+		RecordingRenderContext recorder;
+		ConstantAllocation whole = { nullptr, fixture.buffers[0]->GetBuffer(), 0, 0 };
+		ConstantAllocation range = { nullptr, fixture.buffers[1]->GetBuffer(), 32, 16 };
+		BindConstants(recorder, VertexStage, 1, whole);
+		BindConstants(recorder, PixelStage, 1, range);
+		CHECK(recorder.GetCalls().size() == 2);
+		CHECK(recorder.GetCalls()[0].call == SetConstantBuffersCall);
+		CHECK(recorder.GetCalls()[1].call == SetConstantBufferRangesCall && recorder.GetCalls()[1].firstConstant == 32);
+	}
+}
+
+int main()
+{
+	TestAlignment();
+	TestRollover();
+	TestReuseAfterBeginFrame();
+	TestWithoutOffsetting();
+	return ReportChecks("ConstantBufferRingTests");
+}
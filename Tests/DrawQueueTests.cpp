@@ -0,0 +1,216 @@
+#include "pch.h"
+#include "Check.h"
+#include "DrawQueue.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	template <typename T>
+	T* Fake(size_t i)
+	{
+		return reinterpret_cast<T*>(0x1000 + i * 16);
+	}
+
+	bool SameCalls(const std::vector<RecordedCall>& a, const std::vector<RecordedCall>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].call != b[i].call || a[i].stage != b[i].stage || a[i].startSlot != b[i].startSlot ||
+				a[i].count != b[i].count || a[i].object != b[i].object || a[i].firstConstant != b[i].firstConstant)
+				return false;
+		}
+		return true;
+	}
+
+	// Binds a mix of everything for each item, only reading itself like the scene's drawables
+	class TestDrawable : public IDrawable
+	{
+	public:
+		explicit TestDrawable(UINT id) : id(id) { }
+
+		virtual void SubmitDraws(DrawQueue& queue, const DirectX::CommonStates& states) { }
+
+		virtual void Draw(std::shared_ptr<DX::DeviceResources> deviceResources, IRenderContext& renderContext, UINT item)
+		{
+			ID3D11Buffer* buffers[2] = { Fake<ID3D11Buffer>(id), Fake<ID3D11Buffer>(item) };
+			UINT strides[2] = { 8, 16 }, offsets[2] = { 0, item * 16 };
+			UINT firstConstants[1] = { item * 16 }, constantCounts[1] = { 16 };
+			ID3D11ShaderResourceView* views[2] = { Fake<ID3D11ShaderResourceView>(id), Fake<ID3D11ShaderResourceView>(item % 5) };
+			ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(id);
+
+			renderContext.SetInputLayout(Fake<ID3D11InputLayout>(id));
+			renderContext.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			renderContext.SetVertexBuffers(0, 2, buffers, strides, offsets);
+			renderContext.SetIndexBuffer(buffers[0], DXGI_FORMAT_R16_UINT, 0);
+			renderContext.SetVertexShader(Fake<ID3D11VertexShader>(id));
+			renderContext.SetPixelShader(Fake<ID3D11PixelShader>(id));
+			renderContext.SetConstantBuffers(VertexStage, 0, 1, buffers);
+			renderContext.SetConstantBufferRanges(PixelStage, 1, 1, buffers + 1, firstConstants, constantCounts);
+			renderContext.SetShaderResources(PixelStage, 0, 2, views);
+			renderContext.SetSamplers(PixelStage, 0, 1, &sampler);
+			if (item % 2 == 0)
+				renderContext.DrawIndexed(item * 3 + 3, item, (INT)id);
+			else
+				renderContext.DrawIndexedInstanced(6, item, 0, 0, id);
+		}
+
+	private:
+		UINT id;
+	};
+
+	struct Scene
+	{
+		Scene()
+		{
+			for (UINT i = 0; i < 8; i++)
+				drawables.push_back(TestDrawable(i));
+		}
+
+		// count packets over both layers, at random depths and with a few shaders and materials
+		void Submit(DrawQueue& queue, int count, unsigned int seed)
+		{
+			std::mt19937 random(seed);
+			queue.BeginFrame(1000.f);
+			for (int i = 0; i < count; i++)
+			{
+				UINT drawable = random() % drawables.size();
+				DrawLayer layer = random() % 4 == 0 ? TransparentLayer : OpaqueLayer;
+				float depth = (float)(random() % 100000) * 0.01f;
+				DrawPacket packet = {
+					queue.MakeKey(ScenePass, layer, depth, &drawables[drawable], &materials[random() % 16]),
+					Fake<ID3D11RasterizerState>(layer),
+					Fake<ID3D11BlendState>(layer),
+					Fake<ID3D11DepthStencilState>(layer),
+					&drawables[drawable],
+					(UINT)i
+				};
+				queue.Submit(packet);
+			}
+			queue.Sort();
+		}
+
+		std::vector<TestDrawable> drawables;
+		int materials[16];
+	};
+
+	void TestSort()
+	{
+		DrawQueue queue;
+		Scene scene;
+		scene.Submit(queue, 5000, 1);
+
+		// Packets with the same key keep their submission order, the item
+		bool ordered = true, stable = true;
+		for (UINT i = 1; i < queue.GetPacketCount(); i++)
+		{
+			const DrawPacket& previous = queue.GetSortedPacket(i - 1);
+			const DrawPacket& packet = queue.GetSortedPacket(i);
+			ordered = ordered && previous.key <= packet.key;
+			stable = stable && (previous.key != packet.key || previous.item < packet.item);
+		}
+		CHECK(queue.GetPacketCount() == 5000);
+		CHECK(ordered);
+		CHECK(stable);
+
+		// Opaque draws front to back, then transparent ones back to front
+		int a, b;
+		queue.BeginFrame(100.f);
+		UINT64 nearOpaque = queue.MakeKey(ScenePass, OpaqueLayer, 1.f, &a, &b);
+		UINT64 farOpaque = queue.MakeKey(ScenePass, OpaqueLayer, 90.f, &a, &b);
+		UINT64 nearTransparent = queue.MakeKey(ScenePass, TransparentLayer, 1.f, &a, &b);
+		UINT64 farTransparent = queue.MakeKey(ScenePass, TransparentLayer, 90.f, &a, &b);
+		CHECK(nearOpaque < farOpaque);
+		CHECK(farOpaque < farTransparent);
+		CHECK(farTransparent < nearTransparent);
+	}
+
+	void TestRadixSortMatchesStableSort()
+	{
+		std::mt19937 random(7);
+		const size_t count = 100000;
+		std::vector<DrawSortEntry> entries(count), scratch(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			// Few distinct high bits, so some passes are skipped and many keys are equal
+			entries[i].key = ((UINT64)(random() % 4) << 60) | ((UINT64)random() << 16) | (random() % 8);
+			entries[i].index = (UINT)i;
+		}
+
+		std::vector<DrawSortEntry> expected = entries;
+		std::stable_sort(expected.begin(), expected.end(), [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key < b.key; });
+		RadixSortDraws(entries.data(), scratch.data(), count);
+
+		bool same = true;
+		for (size_t i = 0; i < count; i++)
+			same = same && entries[i].key == expected[i].key && entries[i].index == expected[i].index;
+		CHECK(same);
+	}
+
+	void TestCommandListReplay()
+	{
+		Scene scene;
+		RecordingRenderContext direct, replayed;
+		CommandList list;
+
+		ID3D11RenderTargetView* targets[2] = { Fake<ID3D11RenderTargetView>(1), Fake<ID3D11RenderTargetView>(2) };
+		for (IRenderContext* context : { (IRenderContext*)&direct, (IRenderContext*)&list })
+		{
+			context->SetRenderTargets(2, targets, Fake<ID3D11DepthStencilView>(1));
+			context->SetRasterizerState(Fake<ID3D11RasterizerState>(1));
+			context->SetBlendState(Fake<ID3D11BlendState>(1));
+			context->SetDepthStencilState(Fake<ID3D11DepthStencilState>(1));
+			for (UINT item = 0; item < 20; item++)
+				scene.drawables[item % scene.drawables.size()].Draw(nullptr, *context, item);
+		}
+		list.Replay(replayed);
+
+		CHECK(list.GetCommandCount() == direct.GetCalls().size());
+		CHECK(SameCalls(direct.GetCalls(), replayed.GetCalls()));
+
+		// Cleared lists start over
+		list.Clear();
+		CHECK(list.GetCommandCount() == 0);
+		CHECK(list.GetRecordedSize() == 0);
+	}
+
+	// Recording runs of packets on the pool's threads and replaying them has to issue exactly the direct calls
+	void TestExecuteWithPool()
+	{
+		DrawQueue queue;
+		Scene scene;
+		ThreadPool pool(4);
+
+		for (int count : { 10, 200, 5000 })
+		{
+			scene.Submit(queue, count, count);
+
+			RecordingRenderContext direct, recorded;
+			queue.Execute(nullptr, direct);
+			queue.Execute(nullptr, recorded, &pool);
+			CHECK(!direct.GetCalls().empty());
+			CHECK(SameCalls(direct.GetCalls(), recorded.GetCalls()));
+
+			// Again with the lists' memory reused
+			recorded.Clear();
+			queue.Execute(nullptr, recorded, &pool);
+			CHECK(SameCalls(direct.GetCalls(), recorded.GetCalls()));
+		}
+	}
+}
+
+int main()
+{
+	TestSort();
+	TestRadixSortMatchesStableSort();
+	TestCommandListReplay();
+	TestExecuteWithPool();
+	return ReportChecks("DrawQueueTests");
+}
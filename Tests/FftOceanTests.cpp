@@ -0,0 +1,224 @@
+#include "pch.h"
+#include "Check.h"
+#include "FftOcean.h"
+#include "ThreadPool.h"
+#include "WaveSpectrum.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	typedef std::complex<double> Complex;
+
+	const double pi = 3.14159265358979324;
+
+	FftOceanSettings MakeSettings(int size, float patchLength)
+	{
+		FftOceanSettings settings = { size, patchLength, 10.f, 1.f, 0.3f, Jonswap, 0.0005f, 100000.f, 1.3f, 7 };
+		return settings;
+	}
+
+	// Plain O(n^3) 2D DFT of a size * size grid, exponent sign -1 forward and +1 inverse, neither normalized
+	void Transform(std::vector<Complex>& grid, int size, int sign)
+	{
+		std::vector<Complex> line(size);
+		for (int pass = 0; pass < 2; pass++)
+		{
+			int step = pass == 0 ? 1 : size, stride = pass == 0 ? size : 1;
+			for (int l = 0; l < size; l++)
+			{
+				Complex* values = &grid[l * stride];
+				for (int f = 0; f < size; f++)
+				{
+					Complex sum = 0.0;
+					for (int x = 0; x < size; x++)
+						sum += values[x * step] * std::polar(1.0, sign * 2.0 * pi * f * x / size);
+					line[f] = sum;
+				}
+				for (int f = 0; f < size; f++)
+					values[f * step] = line[f];
+			}
+		}
+	}
+
+	// The height output's spectrum, every other output has to be this times a factor of the wave vector
+	void TestOutputsMatchHeightSpectrum()
+	{
+		const int size = 32;
+		FftOceanSettings settings = MakeSettings(size, 64.f);
+		for (int spectrum = Phillips; spectrum <= Jonswap; spectrum++)
+		{
+			settings.spectrum = (OceanSpectrum)spectrum;
+			FftOcean ocean(settings);
+			ocean.Update(3.7f, nullptr);
+			const float* displacement = ocean.GetDisplacement();
+			const float* slope = ocean.GetSlope();
+
+			std::vector<Complex> heights(size * size);
+			for (int i = 0; i < size * size; i++)
+				heights[i] = displacement[i * 4 + 1];
+			Transform(heights, size, -1);
+
+			// Outputs as -i k/|k| h and i k h, with the grid's signed frequencies
+			std::vector<Complex> expected[4];
+			for (std::vector<Complex>& field : expected)
+				field.resize(size * size);
+			double deltaK = 2.0 * pi / settings.patchLength;
+			for (int z = 0; z < size; z++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					int i = z * size + x;
+					double kx = (x < size / 2 ? x : x - size) * deltaK, kz = (z < size / 2 ? z : z - size) * deltaK;
+					double k = sqrt(kx * kx + kz * kz);
+					Complex h = heights[i] / (double)(size * size);
+					expected[0][i] = k > 0.0 ? Complex(0.0, -kx / k) * h * (double)settings.choppiness : 0.0;
+					expected[1][i] = k > 0.0 ? Complex(0.0, -kz / k) * h * (double)settings.choppiness : 0.0;
+					expected[2][i] = Complex(0.0, kx) * h;
+					expected[3][i] = Complex(0.0, kz) * h;
+				}
+			}
+
+			double maxError[4] = { 0.0, 0.0, 0.0, 0.0 }, maxValue[4] = { 0.0, 0.0, 0.0, 0.0 };
+			for (int field = 0; field < 4; field++)
+			{
+				Transform(expected[field], size, 1);
+				for (int i = 0; i < size * size; i++)
+				{
+					double actual = field < 2 ? displacement[i * 4 + field * 2] : slope[i * 2 + field - 2];
+					maxError[field] = std::max(maxError[field], fabs(actual - expected[field][i].real()));
+					maxValue[field] = std::max(maxValue[field], fabs(actual));
+				}
+			}
+
+			printf("%s: displacement x, z and slope x, z off the height's spectrum by %.1e %.1e %.1e %.1e of their range\n",
+				spectrum == Phillips ? "Phillips" : "JONSWAP", maxError[0] / maxValue[0], maxError[1] / maxValue[1], maxError[2] / maxValue[2], maxError[3] / maxValue[3]);
+			for (int field = 0; field < 4; field++)
+				CHECK(maxValue[field] > 0.0 && maxError[field] < maxValue[field] * 1e-4);
+		}
+	}
+
+	// Split over a pool the results have to be the same, and GetMaxHeight has to cover them
+	void TestPoolAndMaxima()
+	{
+		FftOceanSettings settings = MakeSettings(128, 256.f);
+		FftOcean serial(settings), pooled(settings);
+		ThreadPool pool(4);
+		serial.Update(12.f, nullptr);
+		pooled.Update(12.f, &pool);
+
+		int count = settings.size * settings.size;
+		CHECK(std::equal(serial.GetDisplacement(), serial.GetDisplacement() + count * 4, pooled.GetDisplacement()));
+		CHECK(std::equal(serial.GetSlope(), serial.GetSlope() + count * 2, pooled.GetSlope()));
+
+		float maxHeight = 0.f, maxDisplacement = 0.f;
+		for (int i = 0; i < count; i++)
+		{
+			const float* texel = serial.GetDisplacement() + i * 4;
+			maxHeight = std::max(maxHeight, fabsf(texel[1]));
+			maxDisplacement = std::max(maxDisplacement, sqrtf(texel[0] * texel[0] + texel[2] * texel[2]));
+		}
+		CHECK(maxHeight > 0.f && maxHeight == serial.GetMaxHeight());
+		CHECK(maxDisplacement > 0.f && maxDisplacement == serial.GetMaxDisplacement());
+	}
+
+	// Four standard deviations of the height have to match the JONSWAP spectrum's significant wave height
+	void TestJonswapWaveHeight()
+	{
+		const float windSpeed = 10.f, fetch = 100000.f;
+		FftOceanSettings settings = MakeSettings(256, 1000.f);
+		settings.windSpeed = windSpeed;
+		settings.fetch = fetch;
+
+		// The grid holds the waves between its longest one and the Nyquist limit
+		double deltaK = 2.0 * pi / settings.patchLength;
+		double lowest = DeepWaterFrequency((float)deltaK), highest = DeepWaterFrequency((float)(deltaK * settings.size / 2));
+		double variance = 0.0;
+		const int steps = 10000;
+		for (int i = 0; i < steps; i++)
+		{
+			double omega = lowest + (highest - lowest) * (i + 0.5) / steps;
+			variance += JonswapSpectrum((float)omega, windSpeed, fetch) * (highest - lowest) / steps;
+		}
+		double expected = 4.0 * sqrt(variance);
+
+		double heights = 0.0;
+		for (unsigned int seed = 1; seed <= 4; seed++)
+		{
+			settings.seed = seed;
+			FftOcean ocean(settings);
+			ocean.Update(0.f, nullptr);
+			double sum = 0.0;
+			for (int i = 0; i < settings.size * settings.size; i++)
+				sum += ocean.GetDisplacement()[i * 4 + 1] * ocean.GetDisplacement()[i * 4 + 1];
+			heights += 4.0 * sqrt(sum / (settings.size * settings.size));
+		}
+		double simulated = heights / 4.0;
+
+		printf("JONSWAP at %.0f m/s over %.0f km: significant wave height %.2f m simulated, %.2f m from the spectrum\n", windSpeed, fetch * 0.001f, simulated, expected);
+		CHECK(fabs(simulated - expected) < expected * 0.1);
+	}
+
+	void TestSpectra()
+	{
+		// The peak of JONSWAP is where JonswapPeakFrequency puts it
+		const float windSpeed = 15.f, fetch = 50000.f;
+		float peak = JonswapPeakFrequency(windSpeed, fetch);
+		float best = 0.f, bestOmega = 0.f;
+		for (float omega = 0.05f; omega < 5.f; omega += 0.001f)
+		{
+			float value = JonswapSpectrum(omega, windSpeed, fetch);
+			if (value > best)
+			{
+				best = value;
+				bestOmega = omega;
+			}
+		}
+		CHECK(fabsf(bestOmega - peak) < 0.01f * peak);
+		CHECK(JonswapSpectrum(0.f, windSpeed, fetch) == 0.f);
+
+		// The spreading keeps the energy, and none goes against the wind
+		double spread = 0.0;
+		const int steps = 3600;
+		for (int i = 0; i < steps; i++)
+			spread += DirectionalSpreading((float)(-pi + 2.0 * pi * (i + 0.5) / steps)) * 2.0 * pi / steps;
+		CHECK(fabs(spread - 1.0) < 1e-3);
+		CHECK(DirectionalSpreading(3.f) == 0.f);
+
+		// Phillips only has waves along the wind
+		CHECK(PhillipsSpectrum(0.f, 0.1f, 10.f, 1.f, 0.f, 1.f) == 0.f);
+		CHECK(PhillipsSpectrum(0.1f, 0.f, 10.f, 1.f, 0.f, 1.f) > 0.f);
+		CHECK(fabsf(DeepWaterFrequency(1.f) - sqrtf(gravity)) < 1e-6f);
+	}
+
+	// Per grid size, on the calling thread only and split over every hardware thread
+	void BenchmarkUpdate()
+	{
+		ThreadPool pool;
+		for (int size = 128; size <= 1024; size *= 2)
+		{
+			FftOcean ocean(MakeSettings(size, 512.f));
+			ocean.Update(0.f, nullptr);
+			int repetitions = std::max(2, (1 << 20) / (size * size) * 4);
+			float time = 0.f;
+			double serialSeconds = TimeSeconds(repetitions, [&]() { ocean.Update(time += 0.016f, nullptr); });
+			double pooledSeconds = TimeSeconds(repetitions, [&]() { ocean.Update(time += 0.016f, &pool); });
+			printf("%4d^2 Update: %.2f ms on one thread, %.2f ms on %d\n", size, serialSeconds * 1000.0, pooledSeconds * 1000.0, pool.GetThreadCount());
+		}
+	}
+}
+
+int main()
+{
+	TestSpectra();
+	TestOutputsMatchHeightSpectrum();
+	TestPoolAndMaxima();
+	TestJonswapWaveHeight();
+	BenchmarkUpdate();
+	return ReportChecks("FftOceanTests");
+}
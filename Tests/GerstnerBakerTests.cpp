@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "Check.h"
+#include "GerstnerBaker.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	const float pi = 3.14159265358979324f;
+
+	// What Water bakes at load
+	GerstnerBakeSettings MakeSettings()
+	{
+		GerstnerBakeSettings settings = { 128, 256.f, 96, 64.f };
+		return settings;
+	}
+
+	// The snapped waves evaluated exactly, without the fades the bake leaves to the shader
+	class ExactWaves
+	{
+	public:
+		explicit ExactWaves(const GerstnerBaker& baker)
+			: waveSets(baker.GetSnappedWaveSets()), evaluator(WithoutFades(waveSets).data(), (int)waveSets.size())
+		{
+			evaluator.attenuationStart = 1e18f;
+			evaluator.attenuationEnd = 2e18f;
+		}
+
+		void Evaluate(float x, float z, float time, float* offset, float* normal) const
+		{
+			GerstnerSamples output = { &offset[0], &offset[1], &offset[2], &normal[0], &normal[1], &normal[2] };
+			evaluator.Evaluate(&x, &z, 1, time, 0.f, 0.f, 0.f, output);
+		}
+
+	private:
+		static std::vector<GerstnerWaveSet> WithoutFades(std::vector<GerstnerWaveSet> waveSets)
+		{
+			for (GerstnerWaveSet& waves : waveSets)
+			{
+				waves.lodFadeStart = 1e18f;
+				waves.lodFadeEnd = 2e18f;
+			}
+			return waveSets;
+		}
+
+		std::vector<GerstnerWaveSet> waveSets;
+		GerstnerEvaluator evaluator;
+	};
+
+	float Distance(const float* a, const float* b)
+	{
+		return sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+	}
+
+	// Largest differences between the filtered maps and the exact waves at random points of the tile and period.
+	// Offsets in world units, normals as the length of the difference of the unit normals.
+	void TestFilteredError(const GerstnerBaker& baker)
+	{
+		ExactWaves exact(baker);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(0.f, baker.GetTileLength());
+		std::uniform_real_distribution<float> moment(0.f, baker.GetPeriod());
+
+		float maxOffset = 0.f, maxNormal = 0.f;
+		for (int i = 0; i < 20000; i++)
+		{
+			float x = position(random), z = position(random), time = moment(random);
+			float bakedOffset[3], bakedNormal[3], exactOffset[3], exactNormal[3];
+			baker.Sample(x, z, time, bakedOffset, bakedNormal);
+			exact.Evaluate(x, z, time, exactOffset, exactNormal);
+			maxOffset = std::max(maxOffset, Distance(bakedOffset, exactOffset));
+			maxNormal = std::max(maxNormal, Distance(bakedNormal, exactNormal));
+		}
+
+		printf("Filtered maps against the snapped waves at 20000 points: max error %.3f offset, %.4f normal\n", maxOffset, maxNormal);
+		CHECK(maxOffset < 0.3f);
+		CHECK(maxNormal < 0.03f);
+	}
+
+	// On texels and frames the filter only picks up one texel, which has to hold the exact waves
+	void TestTexelsAreExact(const GerstnerBaker& baker)
+	{
+		ExactWaves exact(baker);
+		float texelLength = baker.GetTileLength() / (float)baker.GetSize();
+		float frameLength = baker.GetPeriod() / (float)baker.GetFrameCount();
+
+		float maxOffset = 0.f, maxNormal = 0.f;
+		for (int frame = 0; frame < baker.GetFrameCount(); frame += 7)
+		{
+			for (int z = 0; z < baker.GetSize(); z += 5)
+			{
+				for (int x = 0; x < baker.GetSize(); x += 3)
+				{
+					float bakedOffset[3], bakedNormal[3], exactOffset[3], exactNormal[3];
+					baker.Sample(x * texelLength, z * texelLength, frame * frameLength, bakedOffset, bakedNormal);
+					exact.Evaluate(x * texelLength, z * texelLength, frame * frameLength, exactOffset, exactNormal);
+					maxOffset = std::max(maxOffset, Distance(bakedOffset, exactOffset));
+					maxNormal = std::max(maxNormal, Distance(bakedNormal, exactNormal));
+				}
+			}
+		}
+		CHECK(maxOffset < 1e-4f);
+		CHECK(maxNormal < 1e-4f);
+	}
+
+	// The snapped waves repeat over the tile and the period, so the maps wrap without a seam
+	void TestPeriodic(const GerstnerBaker& baker)
+	{
+		float tileLength = baker.GetTileLength(), period = baker.GetPeriod();
+		float waveNumberStep = 2.f * pi / tileLength, speedStep = 2.f * pi / period;
+
+		bool snapped = true;
+		for (const GerstnerWaveSet& waves : baker.GetSnappedWaveSets())
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				float kx = waves.frequency[i] * waves.directionX[i] / waveNumberStep;
+				float kz = waves.frequency[i] * waves.directionZ[i] / waveNumberStep;
+				float speed = waves.speed[i] / speedStep;
+				snapped = snapped && fabsf(kx - roundf(kx)) < 1e-3f && fabsf(kz - roundf(kz)) < 1e-3f && fabsf(speed - roundf(speed)) < 1e-3f;
+			}
+		}
+		CHECK(snapped);
+
+		ExactWaves exact(baker);
+		float first[6], wrapped[6];
+		baker.Sample(16.3f, 32.7f, 2.f / 3.f, first, first + 3);
+		baker.Sample(16.3f + tileLength, 32.7f - tileLength, 2.f / 3.f + period, wrapped, wrapped + 3);
+		CHECK(Distance(first, wrapped) < 1e-3f && Distance(first + 3, wrapped + 3) < 1e-3f);
+		exact.Evaluate(16.3f, 32.7f, 2.f / 3.f, first, first + 3);
+		exact.Evaluate(16.3f + tileLength, 32.7f - tileLength, 2.f / 3.f + period, wrapped, wrapped + 3);
+		CHECK(Distance(first, wrapped) < 1e-3f && Distance(first + 3, wrapped + 3) < 1e-3f);
+	}
+}
+
+int main()
+{
+	GerstnerBakeSettings settings = MakeSettings();
+	ThreadPool pool;
+	GerstnerBaker baker(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount, settings);
+	baker.Bake(&pool);
+	printf("Bake of %d x %d x %d: %.1f ms on %d threads, %.1f MB\n", settings.size, settings.size, settings.frameCount,
+		baker.GetBakeSeconds() * 1000.f, pool.GetThreadCount(), baker.GetMemorySize() / 1048576.f);
+
+	// Rows are split over the pool, which mustn't change them
+	GerstnerBaker serial(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount, settings);
+	serial.Bake(nullptr);
+	size_t texelCount = (size_t)settings.size * settings.size * settings.frameCount;
+	CHECK(std::equal(serial.GetDisplacement(), serial.GetDisplacement() + texelCount * 4, baker.GetDisplacement()));
+	CHECK(std::equal(serial.GetSlope(), serial.GetSlope() + texelCount * 2, baker.GetSlope()));
+	printf("Bake on the calling thread: %.1f ms\n", serial.GetBakeSeconds() * 1000.f);
+
+	TestFilteredError(baker);
+	TestTexelsAreExact(baker);
+	TestPeriodic(baker);
+	return ReportChecks("GerstnerBakerTests");
+}
@@ -0,0 +1,233 @@
+#include "pch.h"
+#include "Check.h"
+#include "CpuFeatures.h"
+#include "GerstnerEvaluator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	const char* const simdNames[] = { "scalar", "SSE", "AVX" };
+
+	// The paths this CPU can run
+	std::vector<GerstnerSimd> SupportedPaths()
+	{
+		std::vector<GerstnerSimd> paths = { GerstnerScalar };
+		if (CpuFeatures::HasSse2())
+			paths.push_back(GerstnerSse);
+		if (CpuFeatures::HasAvx())
+			paths.push_back(GerstnerAvx);
+		return paths;
+	}
+
+	struct ReferenceSample
+	{
+		double offset[3];
+		double normal[3];
+	};
+
+	// DisplaceWaterSurface in double precision, straight from the wave sets
+	ReferenceSample Reference(const GerstnerWaveSet* waveSets, int waveSetCount, double x, double z, double time, double cameraX, double cameraY, double cameraZ)
+	{
+		double dx = x - cameraX, dy = -cameraY, dz = z - cameraZ;
+		double distance = sqrt(dx * dx + dy * dy + dz * dz);
+		double fromEnd = distance - gerstnerAttenuationEnd;
+		double attenuation = distance > gerstnerAttenuationEnd ? 0.0 :
+			std::min(fromEnd * fromEnd / ((gerstnerAttenuationStart - gerstnerAttenuationEnd) * (gerstnerAttenuationStart - gerstnerAttenuationEnd)), 1.0);
+
+		ReferenceSample sample = { };
+		double weights[maxGerstnerWaveSets];
+		for (int set = 0; set < waveSetCount; set++)
+		{
+			const GerstnerWaveSet& waves = waveSets[set];
+			double fadeScale = waves.lodFadeEnd > waves.lodFadeStart ? 1.0 / ((double)waves.lodFadeEnd - waves.lodFadeStart) : 1e30;
+			weights[set] = std::min(std::max((waves.lodFadeEnd - distance) * fadeScale, 0.0), 1.0) * attenuation;
+			for (int i = 0; i < 4; i++)
+			{
+				double phase = waves.frequency[i] * (waves.directionX[i] * x + waves.directionZ[i] * z) + time * waves.speed[i];
+				double horizontal = weights[set] * waves.steepness[i] * waves.amplitude[i] * cos(phase);
+				sample.offset[0] += horizontal * waves.directionX[i];
+				sample.offset[1] += weights[set] * waves.amplitude[i] * sin(phase);
+				sample.offset[2] += horizontal * waves.directionZ[i];
+			}
+		}
+
+		double displacedX = x + sample.offset[0], displacedZ = z + sample.offset[2];
+		for (int set = 0; set < waveSetCount; set++)
+		{
+			const GerstnerWaveSet& waves = waveSets[set];
+			double setX = 0.0, setZ = 0.0;
+			for (int i = 0; i < 4; i++)
+			{
+				double phase = waves.frequency[i] * (waves.directionX[i] * displacedX + waves.directionZ[i] * displacedZ) + time * waves.speed[i];
+				double slope = waves.frequency[i] * waves.amplitude[i] * cos(phase) * waves.intensity;
+				setX -= slope * waves.directionX[i];
+				setZ -= slope * waves.directionZ[i];
+			}
+
+			double weight = weights[set] / sqrt(setX * setX + 4.0 + setZ * setZ);
+			sample.normal[0] += setX * weight;
+			sample.normal[1] += 2.0 * weight;
+			sample.normal[2] += setZ * weight;
+		}
+
+		double length = sqrt(sample.normal[0] * sample.normal[0] + sample.normal[1] * sample.normal[1] + sample.normal[2] * sample.normal[2]);
+		if (length > 0.0)
+		{
+			for (int axis = 0; axis < 3; axis++)
+				sample.normal[axis] /= length;
+		}
+		else
+		{
+			sample.normal[1] = 1.0;
+		}
+		return sample;
+	}
+
+	// Every path against the reference within a kilometre of the camera, the count leaves a tail for the SIMD paths
+	void TestEvaluateMatchesReference()
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+
+		const int count = 4099;
+		const float time = 7.3f, cameraX = 120.f, cameraY = 15.f, cameraZ = -60.f;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> around(-1100.f, 1100.f);
+		std::vector<float> x(count), z(count);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = cameraX + around(random);
+			z[i] = cameraZ + around(random);
+		}
+
+		std::vector<float> samples(count * 6);
+		GerstnerSamples output = { &samples[0], &samples[count], &samples[count * 2], &samples[count * 3], &samples[count * 4], &samples[count * 5] };
+		for (GerstnerSimd simd : SupportedPaths())
+		{
+			evaluator.simd = simd;
+			evaluator.Evaluate(x.data(), z.data(), count, time, cameraX, cameraY, cameraZ, output);
+
+			double offsetError = 0.0, normalError = 0.0;
+			for (int i = 0; i < count; i++)
+			{
+				ReferenceSample expected = Reference(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount, x[i], z[i], time, cameraX, cameraY, cameraZ);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					offsetError = std::max(offsetError, fabs(samples[axis * count + i] - expected.offset[axis]));
+					normalError = std::max(normalError, fabs(samples[(axis + 3) * count + i] - expected.normal[axis]));
+				}
+			}
+
+			printf("Evaluate with %s: %.1e in the offsets and %.1e in the normals from exact math\n", simdNames[simd], offsetError, normalError);
+			CHECK(offsetError < 3e-5);
+			CHECK(normalError < 2e-6);
+		}
+	}
+
+	// Largest difference between EvaluateLattice and the reference
+	double LatticeReferenceError(const GerstnerEvaluator& evaluator, const GerstnerLattice& lattice, float time, float cameraX, float cameraY, float cameraZ)
+	{
+		int count = lattice.columns * lattice.rows;
+		std::vector<float> offsets(count * 3);
+		GerstnerSamples output = { &offsets[0], &offsets[count], &offsets[count * 2], nullptr, nullptr, nullptr };
+		evaluator.EvaluateLattice(lattice, time, cameraX, cameraY, cameraZ, output);
+
+		double maxError = 0.0;
+		for (int row = 0; row < lattice.rows; row++)
+		{
+			for (int column = 0; column < lattice.columns; column++)
+			{
+				float x = lattice.originX + (float)column * lattice.spacing;
+				float z = lattice.originZ + (float)row * lattice.spacing;
+				ReferenceSample expected = Reference(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount, x, z, time, cameraX, cameraY, cameraZ);
+				int index = row * lattice.columns + column;
+				for (int axis = 0; axis < 3; axis++)
+					maxError = std::max(maxError, fabs(offsets[axis * count + index] - expected.offset[axis]));
+			}
+		}
+		return maxError;
+	}
+
+	// Every path's lattice against the reference, on long rows and on rows that end in part of a SIMD batch
+	void TestLatticeMatchesReference()
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		for (GerstnerSimd simd : SupportedPaths())
+		{
+			evaluator.simd = simd;
+
+			GerstnerLattice wide = { -500.f, -40.f, 1.f, 1000, 16 };
+			double wideError = LatticeReferenceError(evaluator, wide, 12.5f, 0.f, 20.f, 0.f);
+
+			double tailError = 0.0;
+			for (int columns = 1; columns <= 17; columns++)
+			{
+				GerstnerLattice lattice = { -37.3f, 81.9f, 0.77f, columns, 3 };
+				tailError = std::max(tailError, LatticeReferenceError(evaluator, lattice, 3.1f, -20.f, 8.f, 70.f));
+			}
+
+			printf("EvaluateLattice with %s: %.1e on rows of 1000 points and %.1e on rows of 1 to 17 from exact math\n", simdNames[simd], wideError, tailError);
+			CHECK(wideError < 3e-5);
+			CHECK(tailError < 3e-5);
+		}
+	}
+
+	// Largest difference between EvaluateLattice and Evaluate on the lattice's points
+	float LatticeError(const GerstnerEvaluator& evaluator, const GerstnerLattice& lattice, float time, float cameraX, float cameraY, float cameraZ)
+	{
+		int count = lattice.columns * lattice.rows;
+		std::vector<float> x(count), z(count), expected(count * 3), actual(count * 3);
+		for (int row = 0; row < lattice.rows; row++)
+		{
+			for (int column = 0; column < lattice.columns; column++)
+			{
+				x[row * lattice.columns + column] = lattice.originX + (float)column * lattice.spacing;
+				z[row * lattice.columns + column] = lattice.originZ + (float)row * lattice.spacing;
+			}
+		}
+
+		GerstnerSamples pointOutput = { &expected[0], &expected[count], &expected[count * 2], nullptr, nullptr, nullptr };
+		GerstnerSamples latticeOutput = { &actual[0], &actual[count], &actual[count * 2], nullptr, nullptr, nullptr };
+		evaluator.Evaluate(x.data(), z.data(), count, time, cameraX, cameraY, cameraZ, pointOutput);
+		evaluator.EvaluateLattice(lattice, time, cameraX, cameraY, cameraZ, latticeOutput);
+
+		float maxError = 0.f;
+		for (int i = 0; i < count * 3; i++)
+			maxError = std::max(maxError, fabsf(actual[i] - expected[i]));
+		return maxError;
+	}
+
+	// Rows of a thousand points, as documented, and lattices whose rows end in part of a SIMD batch
+	void TestLatticeMatchesEvaluate()
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+
+		GerstnerLattice wide = { -500.f, -40.f, 1.f, 1000, 16 };
+		float wideError = LatticeError(evaluator, wide, 12.5f, 0.f, 20.f, 0.f);
+		printf("EvaluateLattice on rows of 1000 points: %.1e from Evaluate\n", wideError);
+		CHECK(wideError < 3e-5f);
+
+		float tailError = 0.f;
+		for (int columns = 1; columns <= 17; columns++)
+		{
+			GerstnerLattice lattice = { -37.3f, 81.9f, 0.77f, columns, 3 };
+			tailError = std::max(tailError, LatticeError(evaluator, lattice, 3.1f, -20.f, 8.f, 70.f));
+		}
+		printf("EvaluateLattice on rows of 1 to 17 points: %.1e from Evaluate\n", tailError);
+		CHECK(tailError < 3e-5f);
+	}
+}
+
+int main()
+{
+	TestEvaluateMatchesReference();
+	TestLatticeMatchesReference();
+	TestLatticeMatchesEvaluate();
+	return ReportChecks("GerstnerEvaluatorTests");
+}
@@ -0,0 +1,261 @@
+#include "pch.h"
+#include "Check.h"
+#include "GerstnerRaycaster.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	const float waveTime = 37.f;
+	const float cameraX = 0.f, cameraY = 10.f, cameraZ = 0.f;
+	const float maxDistance = 2000.f;
+
+	struct RaySet
+	{
+		std::vector<float> originX, originY, originZ, directionX, directionY, directionZ;
+
+		GerstnerRays GetRays() const
+		{
+			GerstnerRays rays = { originX.data(), originY.data(), originZ.data(), directionX.data(), directionY.data(), directionZ.data() };
+			return rays;
+		}
+	};
+
+	// Rays from 3 to 43 m over a 40 m square, grazingCount of them within 8 degrees of the horizon
+	RaySet MakeRays(int count, int grazingCount, unsigned int seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+		RaySet set;
+		for (int i = 0; i < count; i++)
+		{
+			float angle = uniform(random) * 6.2831853f;
+			float elevation = i < grazingCount ? 0.03f + uniform(random) * 0.1f : 0.1f + uniform(random) * 1.4f;
+			set.originX.push_back((uniform(random) - 0.5f) * 40.f);
+			set.originY.push_back(3.f + uniform(random) * 40.f);
+			set.originZ.push_back((uniform(random) - 0.5f) * 40.f);
+			set.directionX.push_back(cosf(angle) * cosf(elevation));
+			set.directionY.push_back(-sinf(elevation));
+			set.directionZ.push_back(sinf(angle) * cosf(elevation));
+		}
+		return set;
+	}
+
+	// Height over x, z from 40 damped fixed point steps towards the undisplaced point
+	float GetReferenceHeight(const GerstnerEvaluator& evaluator, float x, float z)
+	{
+		float pointX = x, pointZ = z;
+		float offset[3];
+		GerstnerSamples samples = { &offset[0], &offset[1], &offset[2], nullptr, nullptr, nullptr };
+		for (int i = 0; i < 40; i++)
+		{
+			evaluator.Evaluate(&pointX, &pointZ, 1, waveTime, cameraX, cameraY, cameraZ, samples);
+			pointX = (pointX + x - offset[0]) * 0.5f;
+			pointZ = (pointZ + z - offset[2]) * 0.5f;
+		}
+		evaluator.Evaluate(&pointX, &pointZ, 1, waveTime, cameraX, cameraY, cameraZ, samples);
+		return offset[1];
+	}
+
+	float GetReferenceGap(const GerstnerEvaluator& evaluator, const RaySet& set, int i, float t)
+	{
+		return set.originY[i] + set.directionY[i] * t - GetReferenceHeight(evaluator, set.originX[i] + set.directionX[i] * t, set.originZ[i] + set.directionZ[i] * t);
+	}
+
+	// Marches the ray in 2 cm steps through the slab and bisects the first step that ends below the surface
+	float IntersectReference(const GerstnerEvaluator& evaluator, const RaySet& set, int i, float maxHeight)
+	{
+		if (GetReferenceGap(evaluator, set, i, 0.f) <= 0.f)
+			return 0.f;
+
+		const float step = 0.02f;
+		for (float t = step; t < maxDistance; t += step)
+		{
+			float y = set.originY[i] + set.directionY[i] * t;
+			if (y > maxHeight)
+				continue;
+			if (y < -maxHeight)
+				break;
+			if (GetReferenceGap(evaluator, set, i, t) > 0.f)
+				continue;
+
+			float low = t - step, high = t;
+			for (int k = 0; k < 30; k++)
+			{
+				float middle = (low + high) * 0.5f;
+				if (GetReferenceGap(evaluator, set, i, middle) > 0.f)
+					low = middle;
+				else
+					high = middle;
+			}
+			return (low + high) * 0.5f;
+		}
+		return -1.f;
+	}
+
+	void TestIntersect()
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		GerstnerRaycaster raycaster(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		float maxHeight = GetMaxGerstnerHeight(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+
+		const int count = 200;
+		RaySet set = MakeRays(count, count / 4, 3);
+		std::vector<float> hits(count);
+		raycaster.Intersect(set.GetRays(), count, maxDistance, waveTime, cameraX, cameraY, cameraZ, hits.data());
+
+		// Grazing rays and folded crests can cross the surface more than once within a step, those may take a
+		// neighbouring crossing
+		int otherCrossings = 0, misses = 0, compared = 0;
+		double errorSum = 0.0, maxError = 0.0, maxGap = 0.0;
+		std::vector<float> references(count);
+		double referenceSeconds = TimeSeconds(1, [&]() {
+			for (int i = 0; i < count; i++)
+				references[i] = IntersectReference(evaluator, set, i, maxHeight);
+		});
+
+		for (int i = 0; i < count; i++)
+		{
+			if (references[i] < 0.f || hits[i] < 0.f)
+			{
+				misses += (references[i] < 0.f) != (hits[i] < 0.f) ? 1 : 0;
+				continue;
+			}
+
+			double error = fabs(hits[i] - references[i]);
+			if (error > 0.05)
+			{
+				otherCrossings++;
+				continue;
+			}
+			compared++;
+			errorSum += error;
+			maxError = std::max(maxError, error);
+			maxGap = std::max(maxGap, (double)fabsf(GetReferenceGap(evaluator, set, i, hits[i])));
+		}
+
+		printf("%d rays against a 2 cm march: %d took another crossing, %d missed, distance error mean %.2f mm max %.1f mm, vertical gap max %.1f mm\n",
+			count, otherCrossings, misses, errorSum / std::max(compared, 1) * 1000.0, maxError * 1000.0, maxGap * 1000.0);
+
+		CHECK(misses == 0);
+		CHECK(otherCrossings <= count / 40);
+		CHECK(errorSum / std::max(compared, 1) < 0.005);
+		CHECK(maxGap < 0.02);
+
+		double seconds = TimeSeconds(20, [&]() {
+			raycaster.Intersect(set.GetRays(), count, maxDistance, waveTime, cameraX, cameraY, cameraZ, hits.data());
+		});
+		printf("%d rays: %.0f us, the march takes %.0f us\n", count, seconds * 1e6, referenceSeconds * 1e6);
+		CHECK(seconds < referenceSeconds);
+	}
+
+	// Origins under the surface hit at 0 going down, up or sideways, also under the lowest trough where the slab
+	// the rays are clipped to is above them
+	void TestUnderwaterOrigins()
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		GerstnerRaycaster raycaster(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		float maxHeight = GetMaxGerstnerHeight(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+
+		RaySet set;
+		const float depths[] = { maxHeight + 0.5f, maxHeight * 4.f };
+		const float directions[][3] = { { 0.f, -1.f, 0.f }, { 0.6f, -0.8f, 0.f }, { 0.f, 1.f, 0.f }, { 0.6f, 0.8f, 0.f }, { 1.f, 0.f, 0.f } };
+		for (float depth : depths)
+		{
+			for (const float* direction : directions)
+			{
+				set.originX.push_back(3.f);
+				set.originY.push_back(-depth);
+				set.originZ.push_back(-7.f);
+				set.directionX.push_back(direction[0]);
+				set.directionY.push_back(direction[1]);
+				set.directionZ.push_back(direction[2]);
+			}
+		}
+
+		// And one 5 cm under the surface inside the slab, pointing up
+		float surfaceHeight = GetReferenceHeight(evaluator, 3.f, -7.f);
+		set.originX.push_back(3.f);
+		set.originY.push_back(surfaceHeight - 0.05f);
+		set.originZ.push_back(-7.f);
+		set.directionX.push_back(0.f);
+		set.directionY.push_back(1.f);
+		set.directionZ.push_back(0.f);
+
+		int count = (int)set.originX.size();
+		std::vector<float> hits(count);
+		raycaster.Intersect(set.GetRays(), count, maxDistance, waveTime, cameraX, cameraY, cameraZ, hits.data());
+
+		int wrong = 0;
+		for (int i = 0; i < count; i++)
+		{
+			CHECK(IntersectReference(evaluator, set, i, maxHeight) == 0.f);
+			wrong += hits[i] == 0.f ? 0 : 1;
+		}
+		printf("%d rays from under water: %d didn't hit at 0\n", count, wrong);
+		CHECK(wrong == 0);
+	}
+
+	void TestGetHeights()
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		GerstnerRaycaster raycaster(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> uniform(-300.f, 300.f);
+		const int count = 2000;
+		std::vector<float> x(count), z(count), heights(count);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = uniform(random);
+			z[i] = uniform(random);
+		}
+		raycaster.GetHeights(x.data(), z.data(), count, waveTime, cameraX, cameraY, cameraZ, heights.data());
+
+		int far = 0;
+		double maxError = 0.0;
+		for (int i = 0; i < count; i++)
+		{
+			double error = fabs(heights[i] - GetReferenceHeight(evaluator, x[i], z[i]));
+			if (error > 0.05)
+				far++;
+			else
+				maxError = std::max(maxError, error);
+		}
+
+		printf("%d heights: %d off by more than 5 cm, max error of the rest %.1f mm\n", count, far, maxError * 1000.0);
+		CHECK(far <= count / 100);
+		CHECK(maxError < 0.03);
+	}
+
+	// Steep rays leave the slab after a few steps, grazing ones march across it
+	void BenchmarkIntersect()
+	{
+		GerstnerRaycaster raycaster(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		const int count = 256;
+		std::vector<float> hits(count);
+		for (int grazing = 0; grazing < 2; grazing++)
+		{
+			RaySet set = MakeRays(count, grazing ? count : 0, 3);
+			double seconds = TimeSeconds(200, [&]() {
+				raycaster.Intersect(set.GetRays(), count, maxDistance, waveTime, cameraX, cameraY, cameraZ, hits.data());
+			});
+			printf("%d %s rays: %.0f us, %.2f M rays/s\n", count, grazing ? "grazing" : "steep", seconds * 1e6, count / seconds * 1e-6);
+		}
+	}
+}
+
+int main()
+{
+	TestIntersect();
+	TestUnderwaterOrigins();
+	TestGetHeights();
+	BenchmarkIntersect();
+	return ReportChecks("GerstnerRaycasterTests");
+}
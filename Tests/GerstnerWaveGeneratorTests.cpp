@@ -0,0 +1,147 @@
+#include "pch.h"
+#include "Check.h"
+#include "GerstnerWaveGenerator.h"
+#include "WaveSpectrum.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	// The scene's sea state and settings
+	GerstnerSeaState MakeSeaState()
+	{
+		GerstnerSeaState seaState;
+		seaState.windSpeed = 10.f;
+		seaState.fetch = 100000.f;
+		seaState.windDirectionX = 1.f;
+		seaState.windDirectionZ = .4f;
+		return seaState;
+	}
+
+	GerstnerGeneratorSettings MakeSettings()
+	{
+		GerstnerGeneratorSettings settings;
+		settings.frequencyCount = 12;
+		settings.lowestFrequency = .7f;
+		settings.highestFrequency = 4.f;
+		settings.directionCount = 7;
+		settings.maxSteepness = .8f;
+		settings.fadeWavelengths = 30.f;
+		settings.seed = 1;
+		return settings;
+	}
+
+	// Integral of the JONSWAP spectrum between two angular frequencies in double precision, trapezoids on a fine grid
+	double IntegrateSpectrum(double lowest, double highest, const GerstnerSeaState& seaState)
+	{
+		const int steps = 200000;
+		double step = (highest - lowest) / steps, energy = 0.0;
+		for (int i = 0; i <= steps; i++)
+		{
+			double weight = i == 0 || i == steps ? .5 : 1.;
+			energy += weight * JonswapSpectrum((float)(lowest + i * step), seaState.windSpeed, seaState.fetch);
+		}
+		return energy * step;
+	}
+
+	// The summed Q k A of every budget is maxSteepness, so the crests stop just short of looping
+	void TestSteepness()
+	{
+		GerstnerGeneratorSettings settings = MakeSettings();
+		GerstnerWaveGenerator generator(MakeSeaState(), settings);
+
+		for (int waveCount = 1; waveCount <= maxGerstnerWaveSets * 4; waveCount++)
+		{
+			std::vector<GerstnerWaveSet> waveSets = generator.Generate(waveCount);
+			CHECK((int)waveSets.size() == (waveCount + 3) / 4);
+
+			double steepness = 0.0;
+			int waves = 0;
+			for (const GerstnerWaveSet& waveSet : waveSets)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					steepness += (double)waveSet.steepness[i] * waveSet.frequency[i] * waveSet.amplitude[i];
+					if (waveSet.amplitude[i] > 0.f)
+						waves++;
+				}
+			}
+			CHECK(waves == waveCount);
+			CHECK(fabs(steepness - settings.maxSteepness) < 1e-5);
+		}
+
+		// Budgets past what the constant buffer holds are capped
+		CHECK((int)generator.Generate(100).size() == maxGerstnerWaveSets);
+		CHECK(generator.Generate(0).empty());
+	}
+
+	// Waves travel downwind at deep water speeds, longest first
+	void TestWaves()
+	{
+		GerstnerSeaState seaState = MakeSeaState();
+		GerstnerWaveGenerator generator(seaState, MakeSettings());
+		float windLength = sqrtf(seaState.windDirectionX * seaState.windDirectionX + seaState.windDirectionZ * seaState.windDirectionZ);
+
+		float previousWaveNumber = 0.f;
+		for (const GerstnerWaveSet& waveSet : generator.Generate(maxGerstnerWaveSets * 4))
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				float downwind = (waveSet.directionX[i] * seaState.windDirectionX + waveSet.directionZ[i] * seaState.windDirectionZ) / windLength;
+				CHECK(downwind >= -1e-6f);
+				CHECK(fabsf(waveSet.speed[i] + DeepWaterFrequency(waveSet.frequency[i])) < 1e-4f);
+				CHECK(waveSet.frequency[i] >= previousWaveNumber);
+				previousWaveNumber = waveSet.frequency[i];
+			}
+		}
+	}
+
+	// The total is the spectrum's integral, every budget keeps the energy of its waves, and all the bins together
+	// keep the integral over the sampled frequencies, since the spreading integrates to one
+	void TestKeptEnergy()
+	{
+		GerstnerSeaState seaState = MakeSeaState();
+		GerstnerGeneratorSettings settings = MakeSettings();
+		GerstnerWaveGenerator generator(seaState, settings);
+
+		double peak = JonswapPeakFrequency(seaState.windSpeed, seaState.fetch);
+		double total = IntegrateSpectrum(peak * .1, peak * 100., seaState);
+		printf("Total energy %.5f m^2, %.5f m^2 integrated, significant height %.2f m\n", generator.GetTotalEnergy(), total, generator.GetSignificantWaveHeight());
+		CHECK(fabs(generator.GetTotalEnergy() - total) < total * 1e-3);
+
+		double sampled = IntegrateSpectrum(peak * settings.lowestFrequency, peak * settings.highestFrequency, seaState);
+		float allBins = generator.GetKeptEnergy(generator.GetBinCount());
+		printf("All %d bins keep %.2f%%, the sampled frequencies hold %.2f%%\n", generator.GetBinCount(), allBins * 100.f, sampled / total * 100.);
+		CHECK(generator.GetBinCount() == settings.frequencyCount * settings.directionCount);
+		CHECK(fabs(allBins - sampled / total) < 2e-3);
+
+		float previous = 0.f;
+		for (int waveCount = 1; waveCount <= maxGerstnerWaveSets * 4; waveCount++)
+		{
+			double waveEnergy = 0.0;
+			for (const GerstnerWaveSet& waveSet : generator.Generate(waveCount))
+			{
+				for (int i = 0; i < 4; i++)
+					waveEnergy += .5 * waveSet.amplitude[i] * waveSet.amplitude[i];
+			}
+
+			float kept = generator.GetKeptEnergy(waveCount);
+			CHECK(fabs(waveEnergy / generator.GetTotalEnergy() - kept) < 1e-5);
+			CHECK(kept > previous);
+			previous = kept;
+		}
+		CHECK(previous < allBins);
+	}
+}
+
+int main()
+{
+	TestSteepness();
+	TestWaves();
+	TestKeptEnergy();
+	return ReportChecks("GerstnerWaveGeneratorTests");
+}
@@ -0,0 +1,275 @@
+#include "pch.h"
+#include "Check.h"
+#include "BuoyancySimulation.h"
+#include "CdlodQuadtree.h"
+#include "DrawQueue.h"
+#include "FftOcean.h"
+#include "GerstnerEvaluator.h"
+#include "GerstnerMeshDisplacer.h"
+#include "ProjectedGridKernel.h"
+#include "RippleSimulation.h"
+#include "ThreadPool.h"
+#include "VertexCacheOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+// Times the CPU paths of the scene, on the calling thread and split over every hardware thread.
+// --quick runs a few repetitions of the smaller cases only, which is what ctest does to keep it building.
+namespace
+{
+	bool quick = false;
+
+	int Repetitions(int full)
+	{
+		return quick ? std::max(1, full / 20) : full;
+	}
+
+	void BenchmarkThreadPool(ThreadPool& pool)
+	{
+		double dispatchSeconds = TimeSeconds(Repetitions(10000), [&]() {
+			pool.ParallelFor(pool.GetThreadCount(), 1, [](int, int) { });
+		});
+		printf("ThreadPool: %.1f us per ParallelFor with nothing to do\n", dispatchSeconds * 1e6);
+
+		const int count = 1 << 20;
+		std::vector<float> values(count);
+		auto body = [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				values[i] = sqrtf((float)i) * 0.5f + 1.f;
+		};
+		double serialSeconds = TimeSeconds(Repetitions(100), [&]() { body(0, count); });
+		double pooledSeconds = TimeSeconds(Repetitions(100), [&]() { pool.ParallelFor(count, 4096, body); });
+		printf("ThreadPool: 1M square roots in %.2f ms on one thread, %.2f ms on %d\n", serialSeconds * 1e3, pooledSeconds * 1e3, pool.GetThreadCount());
+	}
+
+	// Points scattered over a kilometre around the camera, and the lattice and mesh paths over a 256 x 256 grid
+	void BenchmarkGerstner(ThreadPool& pool)
+	{
+		GerstnerEvaluator evaluator(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+
+		const int count = 1 << 16;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-500.f, 500.f);
+		std::vector<float> x(count), z(count), samples(count * 6);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = position(random);
+			z[i] = position(random);
+		}
+
+		GerstnerSamples offsets = { &samples[0], &samples[count], &samples[count * 2], nullptr, nullptr, nullptr };
+		GerstnerSamples withNormals = { &samples[0], &samples[count], &samples[count * 2], &samples[count * 3], &samples[count * 4], &samples[count * 5] };
+		double offsetSeconds = TimeSeconds(Repetitions(100), [&]() { evaluator.Evaluate(x.data(), z.data(), count, 10.f, 0.f, 20.f, 0.f, offsets); });
+		double normalSeconds = TimeSeconds(Repetitions(100), [&]() { evaluator.Evaluate(x.data(), z.data(), count, 10.f, 0.f, 20.f, 0.f, withNormals); });
+		printf("GerstnerEvaluator::Evaluate: %.1f M points/s with offsets, %.1f M points/s with normals\n",
+			count / offsetSeconds * 1e-6, count / normalSeconds * 1e-6);
+
+		// The same points through Evaluate and EvaluateLattice
+		GerstnerLattice lattice = { -128.f, -128.f, 1.f, 256, 256 };
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = lattice.originX + (float)(i % lattice.columns) * lattice.spacing;
+			z[i] = lattice.originZ + (float)(i / lattice.columns) * lattice.spacing;
+		}
+		double pointSeconds = TimeSeconds(Repetitions(100), [&]() { evaluator.Evaluate(x.data(), z.data(), count, 10.f, 0.f, 20.f, 0.f, offsets); });
+		double latticeSeconds = TimeSeconds(Repetitions(100), [&]() { evaluator.EvaluateLattice(lattice, 10.f, 0.f, 20.f, 0.f, offsets); });
+		printf("GerstnerEvaluator on a 256 x 256 lattice: %.1f M points/s with Evaluate, %.1f M points/s with EvaluateLattice, %.2fx\n",
+			count / pointSeconds * 1e-6, count / latticeSeconds * 1e-6, pointSeconds / latticeSeconds);
+
+		GerstnerMeshDisplacer displacer(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		const int vertexCount = 256 * 256;
+		std::vector<float> planeXZ(vertexCount * 2), vertices(vertexCount * GerstnerMeshDisplacer::floatsPerVertex);
+		for (int i = 0; i < vertexCount; i++)
+		{
+			planeXZ[i * 2] = (float)(i % 256);
+			planeXZ[i * 2 + 1] = (float)(i / 256);
+		}
+		double serialSeconds = TimeSeconds(Repetitions(50), [&]() {
+			displacer.Displace(planeXZ.data(), vertexCount, -128.f, -128.f, 10.f, 0.f, 20.f, 0.f, vertices.data(), nullptr);
+		});
+		double pooledSeconds = TimeSeconds(Repetitions(50), [&]() {
+			displacer.Displace(planeXZ.data(), vertexCount, -128.f, -128.f, 10.f, 0.f, 20.f, 0.f, vertices.data(), &pool);
+		});
+		printf("GerstnerMeshDisplacer: %.1f M vertices/s on one thread, %.1f M vertices/s on %d\n",
+			vertexCount / serialSeconds * 1e-6, vertexCount / pooledSeconds * 1e-6, pool.GetThreadCount());
+	}
+
+	// Rows of a camera 20 units up looking down at the water, walked like GeneratedMesh::UpdateProjectedMesh does
+	void BenchmarkProjectedGrid()
+	{
+		const int width = 256, height = 256;
+		const XMFLOAT3 eye(0.f, 20.f, 0.f);
+		const XMFLOAT4 plane(0.f, 1.f, 0.f, 0.f);
+		std::vector<VertexPositionXZ> vertices((width + 1) * (height + 1));
+
+		int vertexCount = 0;
+		double seconds = TimeSeconds(Repetitions(200), [&]() {
+			vertexCount = 0;
+			for (int z = 0; z <= height; z++)
+			{
+				float y = 19.f - 0.99f * (float)z / (float)height;
+				XMFLOAT3 left(-1.f, y, 1.f), right(1.f, y, 1.f);
+				if (!IntersectGridRow(eye, left, right, width, plane, &vertices[vertexCount]))
+					break;
+				vertexCount += width + 1;
+			}
+		});
+		printf("IntersectGridRow on a %d x %d projected grid: %.1f M vertices/s\n", width, height, vertexCount / seconds * 1e-6);
+	}
+
+	void BenchmarkFftOcean(ThreadPool& pool)
+	{
+		for (int size = 128; size <= (quick ? 256 : 1024); size *= 2)
+		{
+			FftOceanSettings settings = { size, 512.f, 10.f, 1.f, 0.3f, Jonswap, 0.0005f, 100000.f, 1.3f, 7 };
+			FftOcean ocean(settings);
+			int repetitions = Repetitions(std::max(4, (1 << 22) / (size * size)));
+			float time = 0.f;
+			double serialSeconds = TimeSeconds(repetitions, [&]() { ocean.Update(time += 0.016f, nullptr); });
+			double pooledSeconds = TimeSeconds(repetitions, [&]() { ocean.Update(time += 0.016f, &pool); });
+			printf("FftOcean %4d^2: %.2f ms per Update on one thread, %.2f ms on %d\n", size, serialSeconds * 1e3, pooledSeconds * 1e3, pool.GetThreadCount());
+		}
+	}
+
+	// Water's settings, one step per Advance
+	void BenchmarkRipples(ThreadPool& pool)
+	{
+		for (int size = 256; size <= 512; size *= 2)
+		{
+			RippleSettings settings = { size, 0.25f, 3.f, 0.995f, 1.f / 60.f };
+			// Each from the same splash, so both time the same states of the ripples
+			RippleSimulation serial(settings), pooled(settings);
+			serial.AddImpulse(0.f, 0.f, 2.f, 0.5f);
+			pooled.AddImpulse(0.f, 0.f, 2.f, 0.5f);
+			int repetitions = Repetitions(size == 256 ? 400 : 100);
+			double serialSeconds = TimeSeconds(repetitions, [&]() { serial.Advance(settings.stepSeconds, nullptr); });
+			double pooledSeconds = TimeSeconds(repetitions, [&]() { pooled.Advance(settings.stepSeconds, &pool); });
+			printf("RippleSimulation %d^2: %.3f ms per step on one thread, %.3f ms on %d\n", size, serialSeconds * 1e3, pooledSeconds * 1e3, pool.GetThreadCount());
+		}
+	}
+
+	// Water's tree and a deeper one, from 20 m up looking along +x with a 90 degree view
+	void BenchmarkCdlod()
+	{
+		const float root2 = 0.70710678f;
+		float planes[24] = {
+			root2, 0.f, root2, 0.f,
+			root2, 0.f, -root2, 0.f,
+			1.f, 0.f, 0.f, 0.1f,
+			-1.f, 0.f, 0.f, 5000.f,
+			0.f, 1.f, 0.f, 1000.f,
+			0.f, -1.f, 0.f, 1000.f
+		};
+
+		for (int levelCount = 6; levelCount <= 8; levelCount += 2)
+		{
+			CdlodQuadtree quadtree(levelCount, 16.f, 80.f, 5);
+			quadtree.maxWaveHeight = 3.f;
+			quadtree.maxWaveDisplacement = 2.f;
+			float cameraX = 0.f;
+			double seconds = TimeSeconds(Repetitions(2000), [&]() { quadtree.Select(cameraX += 0.01f, 20.f, 0.f, planes); });
+			printf("CdlodQuadtree with %d levels: %.1f us per Select, %d patches from %d nodes\n",
+				levelCount, seconds * 1e6, (int)quadtree.GetSelection().size(), quadtree.GetVisitedNodeCount());
+		}
+	}
+
+	// 10000 buoys on a 100 x 100 grid 4 m apart
+	void BenchmarkBuoyancy(ThreadPool& pool)
+	{
+		BuoyancySimulation simulation(defaultGerstnerWaveSets, defaultGerstnerWaveSetCount);
+		FloatingBodyKind buoy = { 0.5f, 1.f, 0.35f, 1.5f, 2.f };
+		int kind = simulation.AddKind(buoy);
+		for (int z = 0; z < 100; z++)
+		{
+			for (int x = 0; x < 100; x++)
+				simulation.AddBody(kind, (float)x * 4.f - 200.f, (float)z * 4.f - 200.f, 0.f, 1.f);
+		}
+
+		float time = 0.f;
+		double serialSeconds = TimeSeconds(Repetitions(200), [&]() { simulation.Step(1.f / 60.f, time += 1.f / 60.f, 0.f, 20.f, 0.f, nullptr); });
+		double pooledSeconds = TimeSeconds(Repetitions(200), [&]() { simulation.Step(1.f / 60.f, time += 1.f / 60.f, 0.f, 20.f, 0.f, &pool); });
+		printf("BuoyancySimulation with %d bodies: %.2f ms per Step on one thread, %.2f ms on %d\n",
+			simulation.GetBodyCount(), serialSeconds * 1e3, pooledSeconds * 1e3, pool.GetThreadCount());
+	}
+
+	// 100k keys like a scene's, a quarter of them transparent, 8 shaders and 64 materials
+	void BenchmarkDrawSort()
+	{
+		const size_t count = 100000;
+		DrawQueue queue;
+		std::vector<int> shaders(8), materials(64);
+		std::mt19937 random(1);
+		queue.BeginFrame(1000.f);
+		std::vector<DrawSortEntry> keys(count), entries(count), scratch(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			DrawLayer layer = random() % 4 == 0 ? TransparentLayer : OpaqueLayer;
+			keys[i].key = queue.MakeKey(ScenePass, layer, (float)(random() % 100000) * 0.01f, &shaders[random() % 8], &materials[random() % 64]);
+			keys[i].index = (UINT)i;
+		}
+
+		int repetitions = Repetitions(100);
+		double radixSeconds = 0.0, stableSeconds = 0.0;
+		for (int i = 0; i < repetitions; i++)
+		{
+			entries = keys;
+			radixSeconds += TimeSeconds(1, [&]() { RadixSortDraws(entries.data(), scratch.data(), count); });
+			entries = keys;
+			stableSeconds += TimeSeconds(1, [&]() {
+				std::stable_sort(entries.begin(), entries.end(), [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key < b.key; });
+			});
+		}
+		printf("RadixSortDraws of 100k keys: %.2f ms, std::stable_sort %.2f ms\n", radixSeconds / repetitions * 1e3, stableSeconds / repetitions * 1e3);
+	}
+
+	// A 128 x 128 quad grid in row order, as the mesh generators emit it
+	void BenchmarkVertexCache()
+	{
+		const unsigned int quads = 128, columns = quads + 1;
+		std::vector<unsigned int> indices;
+		for (unsigned int z = 0; z < quads; z++)
+		{
+			for (unsigned int x = 0; x < quads; x++)
+			{
+				unsigned int corner = z * columns + x;
+				unsigned int quad[6] = { corner, corner + columns, corner + 1, corner + 1, corner + columns, corner + columns + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		unsigned int vertexCount = columns * columns;
+		VertexCacheStats before = VertexCacheOptimizer::Simulate(indices.data(), indices.size(), vertexCount);
+		VertexCacheOptimizer optimizer;
+		std::vector<unsigned int> optimized;
+		double seconds = TimeSeconds(Repetitions(20), [&]() {
+			optimized = indices;
+			optimizer.OptimizeTriangleOrder(optimized.data(), optimized.size(), vertexCount);
+		});
+		VertexCacheStats after = VertexCacheOptimizer::Simulate(optimized.data(), optimized.size(), vertexCount);
+		printf("VertexCacheOptimizer on %u triangles: %.2f ms, ACMR %.3f to %.3f in a 16 entry FIFO\n",
+			(unsigned int)indices.size() / 3, seconds * 1e3, before.acmr, after.acmr);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+	ThreadPool pool;
+	BenchmarkThreadPool(pool);
+	BenchmarkGerstner(pool);
+	BenchmarkProjectedGrid();
+	BenchmarkFftOcean(pool);
+	BenchmarkRipples(pool);
+	BenchmarkCdlod();
+	BenchmarkBuoyancy(pool);
+	BenchmarkDrawSort();
+	BenchmarkVertexCache();
+	return 0;
+}
@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "Check.h"
+#include "RippleSimulation.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	// A 32 m square of 25 cm cells centred on the origin, cell 64, 64 is at 0, 0
+	RippleSettings MakeSettings(float damping)
+	{
+		RippleSettings settings;
+		settings.size = 128;
+		settings.cellSize = .25f;
+		settings.waveSpeed = 3.f;
+		settings.damping = damping;
+		settings.stepSeconds = 1.f / 60.f;
+		return settings;
+	}
+
+	float GetHeight(const RippleSimulation& ripples, int x, int z)
+	{
+		return ripples.GetSurface()[(z * ripples.GetSize() + x) * 4];
+	}
+
+	void RunSteps(RippleSimulation& ripples, int steps, ThreadPool* pool = nullptr)
+	{
+		for (int i = 0; i < steps; i++)
+			ripples.Advance(1.f / 60.f, pool);
+	}
+
+	// Distance in cells from the centre to the highest crest or deepest trough along the +x row
+	int GetFrontCells(const RippleSimulation& ripples)
+	{
+		int centre = ripples.GetSize() / 2, front = 0;
+		float largest = 0.f;
+		for (int x = centre + 1; x < ripples.GetSize(); x++)
+		{
+			float height = fabsf(GetHeight(ripples, x, centre));
+			if (height > largest)
+			{
+				largest = height;
+				front = x - centre;
+			}
+		}
+		return front;
+	}
+
+	float GetSumOfSquares(const RippleSimulation& ripples)
+	{
+		float sum = 0.f;
+		for (int z = 0; z < ripples.GetSize(); z++)
+		{
+			for (int x = 0; x < ripples.GetSize(); x++)
+				sum += GetHeight(ripples, x, z) * GetHeight(ripples, x, z);
+		}
+		return sum;
+	}
+
+	// A point impulse spreads out as a ring at the wave speed, the same in every direction
+	void TestImpulseSpreads()
+	{
+		RippleSimulation ripples(MakeSettings(1.f));
+		ripples.AddImpulse(0.f, 0.f, .5f, 1.f);
+
+		RunSteps(ripples, 30);
+		int halfSecondFront = GetFrontCells(ripples);
+		RunSteps(ripples, 30);
+		int secondFront = GetFrontCells(ripples);
+		printf("Ring after 0.5 s: %.2f m out, after 1 s: %.2f m, 3 m/s waves\n", halfSecondFront * .25f, secondFront * .25f);
+
+		// The discrete waves run a little slower than the set speed and the ring starts 0.5 m wide
+		CHECK(halfSecondFront >= 4 && halfSecondFront <= 8);
+		CHECK(secondFront >= 10 && secondFront <= 14);
+
+		int centre = ripples.GetSize() / 2;
+		float asymmetry = 0.f, largest = 0.f;
+		for (int d = 1; d < centre - 1; d++)
+		{
+			float right = GetHeight(ripples, centre + d, centre);
+			largest = std::max(largest, fabsf(right));
+			asymmetry = std::max(asymmetry, fabsf(right - GetHeight(ripples, centre - d, centre)));
+			asymmetry = std::max(asymmetry, fabsf(right - GetHeight(ripples, centre, centre + d)));
+			asymmetry = std::max(asymmetry, fabsf(right - GetHeight(ripples, centre, centre - d)));
+		}
+		CHECK(asymmetry < largest * 1e-4f);
+
+		// The thread pool splits the rows without changing the result
+		RippleSimulation pooled(MakeSettings(1.f));
+		pooled.AddImpulse(0.f, 0.f, .5f, 1.f);
+		ThreadPool pool;
+		RunSteps(pooled, 60, &pool);
+		CHECK(std::equal(pooled.GetSurface(), pooled.GetSurface() + 128 * 128 * 4, ripples.GetSurface()));
+	}
+
+	// Damping scales the motion every step, so once the ring has formed the squared heights shrink by damping^steps.
+	// Calm water stays calm.
+	void TestDamping()
+	{
+		RippleSimulation calm(MakeSettings(.99f));
+		RunSteps(calm, 10);
+		CHECK(GetSumOfSquares(calm) == 0.f);
+
+		RippleSimulation ripples(MakeSettings(.99f));
+		ripples.AddImpulse(0.f, 0.f, .5f, 1.f);
+		RunSteps(ripples, 60);
+
+		float expected = powf(.99f, 60.f);
+		float previous = GetSumOfSquares(ripples);
+		for (int second = 2; second <= 5; second++)
+		{
+			RunSteps(ripples, 60);
+			float sum = GetSumOfSquares(ripples);
+			printf("Damped ripples after %d s: squared heights %.3f of a second before, damping^steps is %.3f\n", second, sum / previous, expected);
+			CHECK(fabsf(sum / previous - expected) < expected * .05f);
+			previous = sum;
+		}
+	}
+
+	// The border is held at zero, waves reaching it don't blow up, and the grid scrolls in calm water
+	void TestBoundary()
+	{
+		RippleSimulation ripples(MakeSettings(1.f));
+		int size = ripples.GetSize();
+
+		// Pushing right next to the border leaves the border cells alone
+		ripples.AddImpulse(-15.9f, 0.f, 1.f, 1.f);
+		RunSteps(ripples, 1);
+		CHECK(GetHeight(ripples, 0, size / 2) == 0.f);
+
+		RunSteps(ripples, 600);
+		float border = 0.f, largest = 0.f;
+		bool finite = true;
+		for (int i = 0; i < size; i++)
+		{
+			border = std::max({ border, fabsf(GetHeight(ripples, i, 0)), fabsf(GetHeight(ripples, i, size - 1)),
+				fabsf(GetHeight(ripples, 0, i)), fabsf(GetHeight(ripples, size - 1, i)) });
+			for (int j = 0; j < size; j++)
+			{
+				finite = finite && std::isfinite(GetHeight(ripples, i, j));
+				largest = std::max(largest, fabsf(GetHeight(ripples, i, j)));
+			}
+		}
+		printf("Ripples after 10 s of reflections: %.3f at most, %.0f on the border\n", largest, border);
+		CHECK(border == 0.f);
+		CHECK(finite);
+		CHECK(largest < 1.f);
+
+		// Moving the grid 4 m keeps the ripples where they are in the world
+		RippleSimulation moving(MakeSettings(1.f));
+		moving.AddImpulse(2.f, 0.f, .5f, 1.f);
+		RunSteps(moving, 1);
+		float before = GetHeight(moving, 72, 64);
+		moving.Recenter(4.f, 0.f);
+		RunSteps(moving, 1);
+		RippleSimulation fixed(MakeSettings(1.f));
+		fixed.AddImpulse(2.f, 0.f, .5f, 1.f);
+		RunSteps(fixed, 2);
+		CHECK(before != 0.f);
+		CHECK(moving.GetOriginX() == fixed.GetOriginX() + 4.f);
+		CHECK(GetHeight(moving, 56, 64) == GetHeight(fixed, 72, 64));
+		float scrolledIn = 0.f;
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = size - 16; x < size; x++)
+				scrolledIn = std::max(scrolledIn, fabsf(GetHeight(moving, x, z)));
+		}
+		CHECK(scrolledIn == 0.f);
+	}
+
+	// Steps are fixed, time left over carries into the next call, a long frame is capped
+	void TestFixedSteps()
+	{
+		RippleSimulation ripples(MakeSettings(1.f));
+		CHECK(ripples.Advance(1.f / 120.f, nullptr) == 0);
+		CHECK(ripples.Advance(1.f / 120.f, nullptr) == 1);
+		CHECK(ripples.Advance(1.f, nullptr) == ripples.maxStepsPerAdvance);
+		CHECK(ripples.Advance(0.f, nullptr) <= 1);
+	}
+}
+
+int main()
+{
+	TestImpulseSpreads();
+	TestDamping();
+	TestBoundary();
+	TestFixedSteps();
+	return ReportChecks("RippleSimulationTests");
+}
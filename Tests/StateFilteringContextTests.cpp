@@ -0,0 +1,229 @@
+#include "pch.h"
+#include "Check.h"
+#include "StateFilteringContext.h"
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	// The filter only compares the pointers, so made up ones stand in for the objects
+	template <typename T>
+	T* Fake(size_t i)
+	{
+		return reinterpret_cast<T*>(0x1000 + i * 16);
+	}
+
+	struct Fixture
+	{
+		Fixture()
+			: recorder(new RecordingRenderContext()), filter(recorder)
+		{
+		}
+
+		const std::vector<RecordedCall>& GetCalls() const { return recorder->GetCalls(); }
+
+		// Calls of one kind since the last Clear
+		std::vector<RecordedCall> GetCalls(RenderCall call) const
+		{
+			std::vector<RecordedCall> found;
+			for (const RecordedCall& recorded : recorder->GetCalls())
+			{
+				if (recorded.call == call)
+					found.push_back(recorded);
+			}
+			return found;
+		}
+
+		void Clear() { recorder->Clear(); }
+
+		std::shared_ptr<RecordingRenderContext> recorder;
+		StateFilteringContext filter;
+	};
+
+	bool IsCall(const RecordedCall& recorded, RenderCall call, ShaderStage stage, UINT startSlot, UINT count, const void* object)
+	{
+		return recorded.call == call && recorded.stage == stage && recorded.startSlot == startSlot && recorded.count == count && recorded.object == object;
+	}
+
+	void TestSkipsRepeatedBinds()
+	{
+		Fixture fixture;
+		StateFilteringContext& filter = fixture.filter;
+
+		for (int i = 0; i < 3; i++)
+		{
+			filter.SetRasterizerState(Fake<ID3D11RasterizerState>(1));
+			filter.SetBlendState(Fake<ID3D11BlendState>(1));
+			filter.SetDepthStencilState(Fake<ID3D11DepthStencilState>(1));
+			filter.SetInputLayout(Fake<ID3D11InputLayout>(1));
+			filter.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			filter.SetIndexBuffer(Fake<ID3D11Buffer>(1), DXGI_FORMAT_R16_UINT, 0);
+			filter.SetVertexShader(Fake<ID3D11VertexShader>(1));
+			filter.SetPixelShader(Fake<ID3D11PixelShader>(1));
+		}
+		CHECK(fixture.GetCalls().size() == 8);
+
+		// Only what differs goes out
+		filter.SetRasterizerState(Fake<ID3D11RasterizerState>(2));
+		filter.SetIndexBuffer(Fake<ID3D11Buffer>(1), DXGI_FORMAT_R16_UINT, 64);
+		filter.SetIndexBuffer(Fake<ID3D11Buffer>(1), DXGI_FORMAT_R16_UINT, 64);
+		filter.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		CHECK(fixture.GetCalls().size() == 11);
+		CHECK(fixture.GetCalls()[8].object == Fake<ID3D11RasterizerState>(2));
+		CHECK(fixture.GetCalls()[9].call == SetIndexBufferCall);
+		CHECK(fixture.GetCalls()[10].call == SetPrimitiveTopologyCall);
+	}
+
+	void TestTrimsSlotRanges()
+	{
+		Fixture fixture;
+		StateFilteringContext& filter = fixture.filter;
+
+		ID3D11Buffer* buffers[4] = { Fake<ID3D11Buffer>(1), Fake<ID3D11Buffer>(2), Fake<ID3D11Buffer>(3), Fake<ID3D11Buffer>(4) };
+		filter.SetConstantBuffers(VertexStage, 0, 4, buffers);
+		buffers[1] = Fake<ID3D11Buffer>(5);
+		buffers[2] = Fake<ID3D11Buffer>(6);
+		filter.SetConstantBuffers(VertexStage, 0, 4, buffers);
+		// The other stage keeps its own slots
+		filter.SetConstantBuffers(PixelStage, 0, 4, buffers);
+
+		std::vector<RecordedCall> calls = fixture.GetCalls(SetConstantBuffersCall);
+		CHECK(calls.size() == 3);
+		CHECK(calls.size() == 3 && IsCall(calls[0], SetConstantBuffersCall, VertexStage, 0, 4, Fake<ID3D11Buffer>(1)));
+		CHECK(calls.size() == 3 && IsCall(calls[1], SetConstantBuffersCall, VertexStage, 1, 2, Fake<ID3D11Buffer>(5)));
+		CHECK(calls.size() == 3 && IsCall(calls[2], SetConstantBuffersCall, PixelStage, 0, 4, Fake<ID3D11Buffer>(1)));
+
+		// A range of the same buffer is a different bind, the same range isn't
+		UINT firstConstants[1] = { 16 }, constantCounts[1] = { 16 };
+		filter.SetConstantBufferRanges(PixelStage, 1, 1, buffers + 1, firstConstants, constantCounts);
+		filter.SetConstantBufferRanges(PixelStage, 1, 1, buffers + 1, firstConstants, constantCounts);
+		firstConstants[0] = 32;
+		filter.SetConstantBufferRanges(PixelStage, 1, 1, buffers + 1, firstConstants, constantCounts);
+		calls = fixture.GetCalls(SetConstantBufferRangesCall);
+		CHECK(calls.size() == 2);
+		CHECK(calls.size() == 2 && calls[0].firstConstant == 16 && calls[1].firstConstant == 32);
+
+		UINT strides[2] = { 8, 8 }, offsets[2] = { 0, 0 };
+		filter.SetVertexBuffers(0, 2, buffers, strides, offsets);
+		offsets[1] = 256;
+		filter.SetVertexBuffers(0, 2, buffers, strides, offsets);
+		calls = fixture.GetCalls(SetVertexBuffersCall);
+		CHECK(calls.size() == 2);
+		CHECK(calls.size() == 2 && IsCall(calls[1], SetVertexBuffersCall, VertexStage, 1, 1, buffers[1]));
+	}
+
+	void TestMergesShaderResources()
+	{
+		Fixture fixture;
+		StateFilteringContext& filter = fixture.filter;
+		ID3D11ShaderResourceView* views[6];
+		for (int i = 0; i < 6; i++)
+			views[i] = Fake<ID3D11ShaderResourceView>(i + 1);
+
+		// Views set one slot at a time wait for the draw and go out as one call
+		for (UINT slot = 0; slot < 5; slot++)
+			filter.SetShaderResources(PixelStage, slot, 1, views + slot);
+		CHECK(fixture.GetCalls(SetShaderResourcesCall).empty());
+		filter.DrawIndexed(6, 0, 0);
+		std::vector<RecordedCall> calls = fixture.GetCalls();
+		CHECK(calls.size() == 2);
+		CHECK(calls.size() == 2 && IsCall(calls[0], SetShaderResourcesCall, PixelStage, 0, 5, views[0]));
+		CHECK(calls.size() == 2 && calls[1].call == DrawIndexedCall);
+
+		// Setting them again changes nothing, only the last slot differs
+		fixture.Clear();
+		for (UINT slot = 0; slot < 5; slot++)
+			filter.SetShaderResources(PixelStage, slot, 1, slot == 4 ? views + 5 : views + slot);
+		filter.DrawIndexed(6, 0, 0);
+		calls = fixture.GetCalls(SetShaderResourcesCall);
+		CHECK(calls.size() == 1);
+		CHECK(calls.size() == 1 && IsCall(calls[0], SetShaderResourcesCall, PixelStage, 4, 1, views[5]));
+
+		// Slot 1 wasn't asked for but its view is known, so it joins the call rather than splitting it
+		fixture.Clear();
+		filter.SetShaderResources(PixelStage, 0, 1, views + 5);
+		filter.SetShaderResources(PixelStage, 2, 1, views + 5);
+		filter.DrawIndexed(6, 0, 0);
+		calls = fixture.GetCalls(SetShaderResourcesCall);
+		CHECK(calls.size() == 1);
+		CHECK(calls.size() == 1 && IsCall(calls[0], SetShaderResourcesCall, PixelStage, 0, 3, views[5]));
+
+		// Slots nothing is known about can't be filled in, so the gap splits the run
+		fixture.Clear();
+		filter.SetShaderResources(VertexStage, 0, 1, views + 0);
+		filter.SetShaderResources(VertexStage, 1, 1, views + 1);
+		filter.SetShaderResources(VertexStage, 4, 1, views + 2);
+		filter.DrawIndexed(6, 0, 0);
+		calls = fixture.GetCalls(SetShaderResourcesCall);
+		CHECK(calls.size() == 2);
+		CHECK(calls.size() == 2 && IsCall(calls[0], SetShaderResourcesCall, VertexStage, 0, 2, views[0]));
+		CHECK(calls.size() == 2 && IsCall(calls[1], SetShaderResourcesCall, VertexStage, 4, 1, views[2]));
+	}
+
+	void TestInvalidate()
+	{
+		Fixture fixture;
+		StateFilteringContext& filter = fixture.filter;
+		ID3D11ShaderResourceView* view = Fake<ID3D11ShaderResourceView>(1);
+		ID3D11SamplerState* sampler = Fake<ID3D11SamplerState>(1);
+
+		filter.SetRasterizerState(Fake<ID3D11RasterizerState>(1));
+		filter.SetSamplers(PixelStage, 0, 1, &sampler);
+		filter.SetShaderResources(PixelStage, 0, 1, &view);
+		filter.DrawIndexed(6, 0, 0);
+		CHECK(fixture.GetCalls().size() == 4);
+
+		// Everything is passed on again after it
+		fixture.Clear();
+		filter.Invalidate();
+		filter.SetRasterizerState(Fake<ID3D11RasterizerState>(1));
+		filter.SetSamplers(PixelStage, 0, 1, &sampler);
+		filter.SetShaderResources(PixelStage, 0, 1, &view);
+		filter.DrawIndexed(6, 0, 0);
+		CHECK(fixture.GetCalls().size() == 4);
+
+		// Views waiting for a draw are dropped
+		fixture.Clear();
+		ID3D11ShaderResourceView* other = Fake<ID3D11ShaderResourceView>(2);
+		filter.SetShaderResources(PixelStage, 1, 1, &other);
+		filter.Invalidate();
+		filter.DrawIndexed(6, 0, 0);
+		CHECK(fixture.GetCalls(SetShaderResourcesCall).empty());
+	}
+
+	void TestStats()
+	{
+		Fixture fixture;
+		StateFilteringContext& filter = fixture.filter;
+		ID3D11ShaderResourceView* views[2] = { Fake<ID3D11ShaderResourceView>(1), Fake<ID3D11ShaderResourceView>(2) };
+
+		filter.SetInputLayout(Fake<ID3D11InputLayout>(1));
+		filter.SetInputLayout(Fake<ID3D11InputLayout>(1));
+		filter.SetShaderResources(PixelStage, 0, 1, views);
+		filter.SetShaderResources(PixelStage, 1, 1, views + 1);
+		filter.DrawIndexed(6, 0, 0);
+		filter.DrawIndexedInstanced(6, 4, 0, 0, 0);
+
+		// Two layouts with one issued, two views merged into one call
+		const RenderContextStats& stats = filter.GetStats();
+		CHECK(stats.bindsRequested == 4);
+		CHECK(stats.bindsIssued == 2);
+		CHECK(stats.GetBindsSkipped() == 2);
+		CHECK(stats.drawCalls == 2);
+
+		filter.ResetStats();
+		CHECK(stats.bindsRequested == 0 && stats.bindsIssued == 0 && stats.drawCalls == 0);
+	}
+}
+
+int main()
+{
+	TestSkipsRepeatedBinds();
+	TestTrimsSlotRanges();
+	TestMergesShaderResources();
+	TestInvalidate();
+	TestStats();
+	return ReportChecks("StateFilteringContextTests");
+}
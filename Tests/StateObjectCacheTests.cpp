@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "Check.h"
+#include "StateObjectCache.h"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Ocean;
+using namespace OceanTests;
+
+namespace
+{
+	// Counts the objects the cache asks for and hands out made up pointers, one per creation
+	class FakeDevice : public ID3D11Device
+	{
+	public:
+		FakeDevice() : inputLayoutCount(0), samplerCount(0) { }
+
+		virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC*, UINT, const void*, SIZE_T, ID3D11InputLayout** inputLayout)
+		{
+			*inputLayout = (ID3D11InputLayout*)(uintptr_t)(0x1000 + ++inputLayoutCount);
+			return S_OK;
+		}
+
+		virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC*, ID3D11SamplerState** sampler)
+		{
+			*sampler = (ID3D11SamplerState*)(uintptr_t)(0x2000 + ++samplerCount);
+			return S_OK;
+		}
+
+		int inputLayoutCount;
+		int samplerCount;
+	};
+
+	void AppendUint(std::vector<byte>& bytes, UINT value)
+	{
+		bytes.insert(bytes.end(), (const byte*)&value, (const byte*)&value + sizeof(value));
+	}
+
+	// A DXBC container with an input signature chunk followed by a shader chunk, the checksum left zeroed
+	std::vector<byte> MakeBytecode(const std::string& inputSignature, const std::string& shader)
+	{
+		std::vector<byte> bytecode = { 'D', 'X', 'B', 'C' };
+		bytecode.resize(20, 0);
+		AppendUint(bytecode, 1);
+		AppendUint(bytecode, 0);
+		AppendUint(bytecode, 2);
+
+		UINT firstOffset = 40;
+		AppendUint(bytecode, firstOffset);
+		AppendUint(bytecode, firstOffset + 8 + (UINT)inputSignature.size());
+
+		const char* names[] = { "ISGN", "SHDR" };
+		const std::string* contents[] = { &inputSignature, &shader };
+		for (int i = 0; i < 2; i++)
+		{
+			bytecode.insert(bytecode.end(), names[i], names[i] + 4);
+			AppendUint(bytecode, (UINT)contents[i]->size());
+			bytecode.insert(bytecode.end(), contents[i]->begin(), contents[i]->end());
+		}
+
+		UINT totalSize = (UINT)bytecode.size();
+		memcpy(&bytecode[24], &totalSize, sizeof(totalSize));
+		return bytecode;
+	}
+
+	struct Fixture
+	{
+		Fixture() : cache(std::make_shared<DX::DeviceResources>(&device)) { }
+
+		FakeDevice device;
+		StateObjectCache cache;
+	};
+
+	// The input signature is found in the container, and bytecode that isn't one is its own signature
+	void TestFindInputSignature()
+	{
+		std::vector<byte> bytecode = MakeBytecode("position", "mov o0, v0");
+		const byte* signature;
+		size_t signatureLength;
+		FindInputSignature(bytecode.data(), bytecode.size(), signature, signatureLength);
+		CHECK(signatureLength == 8 && memcmp(signature, "position", 8) == 0);
+
+		std::vector<byte> truncated(bytecode.begin(), bytecode.begin() + 45);
+		FindInputSignature(truncated.data(), truncated.size(), signature, signatureLength);
+		CHECK(signature == truncated.data() && signatureLength == truncated.size());
+
+		const byte notDxbc[] = { 1, 2, 3, 4 };
+		FindInputSignature(notDxbc, sizeof(notDxbc), signature, signatureLength);
+		CHECK(signature == notDxbc && signatureLength == sizeof(notDxbc));
+	}
+
+	// Layouts are shared by shaders with the same input signature whatever their code, and kept apart when the
+	// elements are the same bytes but the signatures differ
+	void TestInputLayoutDedup()
+	{
+		Fixture fixture;
+		char position[] = "POSITION";
+		char positionCopy[] = "POSITION";
+		D3D11_INPUT_ELEMENT_DESC elements[] = { { position, 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 } };
+		D3D11_INPUT_ELEMENT_DESC copiedName[] = { { positionCopy, 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 } };
+		D3D11_INPUT_ELEMENT_DESC otherFormat[] = { { position, 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 } };
+
+		std::vector<byte> water = MakeBytecode("float3 position", "water");
+		std::vector<byte> sky = MakeBytecode("float3 position", "sky");
+		std::vector<byte> otherInputs = MakeBytecode("float4 position", "water");
+
+		ID3D11InputLayout* waterLayout = fixture.cache.GetInputLayout(elements, 1, water);
+		CHECK(fixture.cache.GetInputLayout(elements, 1, sky) == waterLayout);
+		CHECK(fixture.cache.GetInputLayout(copiedName, 1, water) == waterLayout);
+		CHECK(fixture.device.inputLayoutCount == 1);
+
+		ID3D11InputLayout* otherSignatureLayout = fixture.cache.GetInputLayout(elements, 1, otherInputs);
+		CHECK(otherSignatureLayout != waterLayout);
+		CHECK(fixture.device.inputLayoutCount == 2);
+
+		CHECK(fixture.cache.GetInputLayout(otherFormat, 1, water) != waterLayout);
+		CHECK(fixture.device.inputLayoutCount == 3);
+
+		// Without a container the whole bytecode is compared
+		std::vector<byte> raw = { 1, 2, 3, 4 }, otherRaw = { 1, 2, 3, 5 };
+		ID3D11InputLayout* rawLayout = fixture.cache.GetInputLayout(elements, 1, raw);
+		CHECK(fixture.cache.GetInputLayout(elements, 1, raw) == rawLayout);
+		CHECK(fixture.cache.GetInputLayout(elements, 1, otherRaw) != rawLayout);
+		CHECK(fixture.device.inputLayoutCount == 5);
+
+		StateCacheStats stats = fixture.cache.GetInputLayoutStats();
+		CHECK(stats.requests == 8 && stats.hits == 3 && stats.GetCreated() == 5);
+	}
+
+	// Samplers with the same description are created once
+	void TestSamplerDedup()
+	{
+		Fixture fixture;
+		ID3D11SamplerState* linearWrap = fixture.cache.GetLinearWrapSampler();
+		CHECK(fixture.cache.GetLinearWrapSampler() == linearWrap);
+
+		D3D11_SAMPLER_DESC clamp;
+		ZeroMemory(&clamp, sizeof(clamp));
+		clamp.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		clamp.AddressU = clamp.AddressV = clamp.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		clamp.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		clamp.MaxLOD = D3D11_FLOAT32_MAX;
+		CHECK(fixture.cache.GetSamplerState(clamp) != linearWrap);
+		CHECK(fixture.device.samplerCount == 2);
+
+		StateCacheStats stats = fixture.cache.GetSamplerStats();
+		CHECK(stats.requests == 3 && stats.hits == 1);
+		CHECK(stats.GetHitRate() > .33f && stats.GetHitRate() < .34f);
+	}
+}
+
+int main()
+{
+	TestFindInputSignature();
+	TestInputLayoutDedup();
+	TestSamplerDedup();
+	return ReportChecks("StateObjectCacheTests");
+}